@@ -109,6 +109,8 @@
 #include <86box/acpi.h>
 #include <86box/nv/vid_nv_rivatimer.h>
 #include <86box/vfio.h>
+#include <86box/savestate.h>
+#include <86box/bench.h>
 
 // Disable c99-designator to avoid the warnings about int ng
 #ifdef __clang__
@@ -148,6 +150,9 @@ char       rom_path[1024] = { '\0' };     /* (O) full path to ROMs */
 rom_path_t rom_paths      = { "", NULL }; /* (O) full paths to ROMs */
 char       log_path[1024] = { '\0' };     /* (O) full path of logfile */
 char       vm_name[1024]  = { '\0' };     /* (O) display name of the VM */
+char       savestate_load_path[1024] = { '\0' }; /* (O) save state to restore on startup */
+char       dynarec_prof_path[1024]   = { '\0' }; /* (O) dynarec profile report, empty = off */
+char       savestate_exit_path[1024] = { '\0' }; /* (O) save state to write on exit */
 int      do_nothing                             = 0;
 int      dump_missing                           = 0;
 int      clear_cmos                             = 0;
@@ -197,6 +202,7 @@ uint32_t mem_size                               = 0;              /* (C) memory
                                                                          system board)*/
 uint32_t isa_mem_size                           = 0;              /* (C) memory size (ISA Memory Cards) */
 int      cpu_use_dynarec                        = 0;              /* (C) cpu uses/needs Dyna */
+int      cpu_dynarec_cache                      = 0;              /* (C) keep dynarec blocks across runs */
 int      cpu                                    = 0;              /* (C) cpu type */
 int      fpu_type                               = 0;              /* (C) fpu type */
 int      fpu_softfloat                          = 0;              /* (C) fpu uses softfloat */
@@ -657,6 +663,8 @@ pc_show_usage(char *s)
             "\n%sUsage: 86box [options] [cfg-file]\n\n"
             "Valid options are:\n\n"
             "-? or --help\t\t\t- show this information\n"
+            "-A or --loadstate path\t\t- restore the save state 'path' on startup\n"
+            "-B or --savestate path\t\t- write a save state to 'path' on exit\n"
 #ifdef SHOW_EXTRA_PARAMS
             "-C or --config path\t\t- set 'path' to be config file\n"
 #endif
@@ -675,6 +683,9 @@ pc_show_usage(char *s)
 #endif
 #endif
             "-I or --image d:path\t\t- load 'path' as floppy image on drive d\n"
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC)
+            "-K or --dynarec-prof path\t- profile the dynarec and write a report to 'path'\n"
+#endif
 #ifdef USE_INSTRUMENT
             "-J or --instrument name\t- set 'name' to be the profiling instrument\n"
 #endif
@@ -682,11 +693,13 @@ pc_show_usage(char *s)
             "-M or --missing\t\t- dump missing machines and video cards\n"
             "-N or --noconfirm\t\t- do not ask for confirmation on quit\n"
             "-P or --vmpath path\t\t- set 'path' to be root for vm\n"
+            "-Q or --bench secs\t\t- run for 'secs' emulated seconds, print a report and exit\n"
             "-O or --global path\t\t- set 'path' to be global config file\n"
             "-R or --rompath path\t\t- set 'path' to be ROM path\n"
 #ifndef USE_SDL_UI
             "-S or --settings\t\t\t- show only the settings dialog\n"
 #endif
+            "-U or --pack src dst\t\t- pack hard disk image 'src' into 'dst' (.hdz) and exit\n"
 #ifdef SHOW_EXTRA_PARAMS
             "-T or --testmode\t\t- test mode: execute the test mode entry\n"
             "\t\t\t\t   point on init/hard reset\n"
@@ -720,7 +733,8 @@ pc_show_usage(char *s)
  *
  * This is the platform-indepenent part of the startup,
  * where we check commandline arguments and load a
- * configuration file.
+ * configuration file. Returns 1 to go on, 0 to exit,
+ * or -1 to exit with a failure status.
  */
 int
 pc_init(int argc, char *argv[])
@@ -881,6 +895,41 @@ usage:
             pclog("Drive %c: %s\n", drive + 0x41, fn[(int) drive]);
             free(temp2);
             temp2 = NULL;
+        } else if (!strcasecmp(argv[c], "--bench") || !strcasecmp(argv[c], "-Q")) {
+            if ((c + 1) == argc)
+                goto usage;
+
+            bench_seconds = atoi(argv[++c]);
+            if (bench_seconds <= 0)
+                goto usage;
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC)
+        } else if (!strcasecmp(argv[c], "--dynarec-prof") || !strcasecmp(argv[c], "-K")) {
+            if ((c + 1) == argc)
+                goto usage;
+
+            strncpy(dynarec_prof_path, argv[++c], sizeof(dynarec_prof_path) - 1);
+#endif
+        } else if (!strcasecmp(argv[c], "--loadstate") || !strcasecmp(argv[c], "-A")) {
+            if ((c + 1) == argc)
+                goto usage;
+
+            strncpy(savestate_load_path, argv[++c], sizeof(savestate_load_path) - 1);
+        } else if (!strcasecmp(argv[c], "--savestate") || !strcasecmp(argv[c], "-B")) {
+            if ((c + 1) == argc)
+                goto usage;
+
+            strncpy(savestate_exit_path, argv[++c], sizeof(savestate_exit_path) - 1);
+        } else if (!strcasecmp(argv[c], "--pack") || !strcasecmp(argv[c], "-U")) {
+            if ((c + 2) >= argc)
+                goto usage;
+
+            /* Packs, mounts the result and reads it back, then exits. */
+            if (hdd_packed_create(argv[c + 1], argv[c + 2]) < 0) {
+                always_log("Unable to pack %s into %s\n", argv[c + 1], argv[c + 2]);
+                return -1;
+            }
+            always_log("Packed %s into %s\n", argv[c + 1], argv[c + 2]);
+            return 0;
         } else if (!strcasecmp(argv[c], "--vmname") || !strcasecmp(argv[c], "-V")) {
             if ((c + 1) == argc)
                 goto usage;
@@ -1504,6 +1553,10 @@ pc_reset_hard_close(void)
 {
     ui_sb_set_ready(0);
 
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC)
+    codegen_cache_close();
+#endif
+
     /* Close all the memory mappings. */
     mem_close();
 
@@ -1772,12 +1825,20 @@ pc_close(UNUSED(thread_t *ptr))
     /* Terminate the UI thread. */
     is_quit = 1;
 
+    if (savestate_exit_path[0] != '\0')
+        pc_save_state(savestate_exit_path);
+
     nvr_save();
 
     config_save();
 
     plat_mouse_capture(0);
 
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC)
+    codegen_prof_dump();
+    codegen_cache_close();
+#endif
+
     /* Close all the memory mappings. */
     mem_close();
 
@@ -1820,6 +1881,119 @@ pc_close(UNUSED(thread_t *ptr))
 
 }
 
+/*
+ * Save the state of the running machine. This must be called from the
+ * emulation thread, or with the emulation thread stopped.
+ */
+int
+pc_save_state(const char *fn)
+{
+    savestate_t st;
+    int         missing;
+
+    if (!savestate_open(&st, fn, 0))
+        return 0;
+
+    savestate_begin(&st, "cpu", 1);
+    cpu_savestate(&st);
+    savestate_end(&st);
+
+    /* The TSC must come before anything that owns a timer. */
+    savestate_begin(&st, "timer", 1);
+    timer_savestate(&st);
+    savestate_end(&st);
+
+    savestate_begin(&st, "mem", 1);
+    mem_savestate(&st);
+    savestate_end(&st);
+
+    savestate_begin(&st, "pic", 1);
+    pic_savestate(&st);
+    savestate_end(&st);
+
+    savestate_begin(&st, "dma", 1);
+    dma_savestate(&st);
+    savestate_end(&st);
+
+    missing = device_savestate(&st);
+
+    if (!savestate_close(&st)) {
+        pclog("SaveState: error writing %s\n", fn);
+        return 0;
+    }
+
+    pclog("SaveState: machine state saved to %s", fn);
+    if (missing)
+        pclog(" (%i device(s) will be restored from their reset state)", missing);
+    pclog("\n");
+
+    return 1;
+}
+
+/*
+ * Restore a machine state saved by pc_save_state(). The machine must
+ * have been hard reset with the same configuration the state was saved
+ * with, sections are applied on top of that.
+ */
+int
+pc_load_state(const char *fn)
+{
+    static const struct {
+        const char *tag;
+        uint32_t    version;
+        void      (*sync)(savestate_t *st);
+    } core[] = {
+        { "cpu",   1, cpu_savestate   },
+        { "timer", 1, timer_savestate },
+        { "mem",   1, mem_savestate   },
+        { "pic",   1, pic_savestate   },
+        { "dma",   1, dma_savestate   },
+        { NULL,    0, NULL            }
+    };
+    savestate_t st;
+    char        tag[SAVESTATE_TAG_LEN];
+    int         found;
+
+    if (!savestate_open(&st, fn, 1))
+        return 0;
+
+    while (savestate_next(&st, tag)) {
+        found = 0;
+
+        for (int i = 0; core[i].tag != NULL; i++) {
+            if (!strcmp(tag, core[i].tag)) {
+                if (st.version <= core[i].version) {
+                    core[i].sync(&st);
+                    found = 1;
+                }
+                break;
+            }
+        }
+
+        if (!found && !strncmp(tag, "dev:", 4))
+            found = device_loadstate(&st, tag);
+
+        if (!found)
+            pclog("SaveState: skipping unknown section \"%s\"\n", tag);
+
+        savestate_end(&st);
+    }
+
+    if (!savestate_close(&st)) {
+        pclog("SaveState: error reading %s, the machine state may be inconsistent\n", fn);
+        return 0;
+    }
+
+    cycles = 0;
+#ifdef USE_DYNAREC
+    cycles_main = 0;
+#endif
+
+    pclog("SaveState: machine state restored from %s\n", fn);
+
+    return 1;
+}
+
 #ifdef __APPLE__
 static void
 _ui_window_title(void *s)
@@ -1833,6 +2007,10 @@ void
 ack_pause(void)
 {
     if (atomic_load(&do_pause_ack)) {
+        /* Emulated time stops, and with it the write-back cache timers. */
+        for (uint8_t i = 0; i < HDD_NUM; i++)
+            hdd_image_flush(i);
+
         atomic_store(&do_pause_ack, 0);
         atomic_store(&pause_ack, 1);
     }
@@ -1851,6 +2029,14 @@ pc_run(void)
         pc_reset_hard_init();
     }
 
+    /* Restore the startup save state once the machine is up. */
+    if (savestate_load_path[0] != '\0') {
+        if (!pc_load_state(savestate_load_path))
+            pclog("SaveState: unable to restore %s, continuing with a cold boot\n",
+                  savestate_load_path);
+        savestate_load_path[0] = '\0';
+    }
+
     /* Update the guest-CPU independent timer for devices with independent clock speed */
     rivatimer_update_all();
 
@@ -1858,6 +2044,9 @@ pc_run(void)
     startblit();
     cpu_exec((int32_t) cpu_s->rspeed / (force_10ms ? 100 : 1000));
     ack_pause();
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC)
+    codegen_prof_poll();
+#endif
 #ifdef USE_GDBSTUB /* avoid a KBC FIFO overflow when CPU emulation is stalled */
     if (gdbstub_step == GDBSTUB_EXEC) {
 #endif
@@ -0,0 +1,159 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Headless benchmark mode.
+ *
+ *          Runs the machine unthrottled for a fixed amount of emulated
+ *          time and prints a JSON report of the emulation speed to the
+ *          standard output, so runs can be compared across builds.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <time.h>
+#endif
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/timer.h>
+#include <86box/machine.h>
+#include <86box/plat.h>
+#include <86box/bench.h>
+
+int bench_seconds = 0;
+int bench_active  = 0;
+
+uint64_t bench_insns           = 0;
+uint64_t bench_blocks_hit      = 0;
+uint64_t bench_blocks_compiled = 0;
+uint64_t bench_blocks_marked   = 0;
+
+uint64_t bench_timer_us = 0;
+
+uint64_t
+bench_time_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq = { 0 };
+    LARGE_INTEGER        now;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+
+    return ((now.QuadPart / freq.QuadPart) * 1000000000ULL) +
+           (((now.QuadPart % freq.QuadPart) * 1000000000ULL) / freq.QuadPart);
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t) now.tv_sec * 1000000000ULL) + (uint64_t) now.tv_nsec;
+#endif
+}
+
+uint64_t
+bench_time_us(void)
+{
+    return bench_time_ns() / 1000ULL;
+}
+
+static void
+bench_print_str(const char *key, const char *str, int last)
+{
+    printf("  \"%s\": \"", key);
+    for (; *str; str++) {
+        if ((*str == '"') || (*str == '\\'))
+            putchar('\\');
+        putchar(*str);
+    }
+    printf("\"%s\n", last ? "" : ",");
+}
+
+static double
+bench_ratio(uint64_t num, uint64_t den)
+{
+    return den ? ((double) num / (double) den) : 0.0;
+}
+
+/*
+ * Run the benchmark on the emulation thread, in place of the regular
+ * frame-paced loop. The machine must have been hard reset already, and
+ * any --loadstate request is honored by the first pc_run() call.
+ */
+void
+bench_run(void)
+{
+    const int frame_us = force_10ms ? 10000 : 1000;
+    uint64_t  frames   = ((uint64_t) bench_seconds * 1000000ULL) / frame_us;
+    uint64_t  run_us   = 0;
+    uint64_t  done     = 0;
+    uint64_t  start;
+    uint64_t  end;
+    uint64_t  t;
+    uint64_t  emu_us;
+    uint64_t  real_us;
+
+    bench_insns           = 0;
+    bench_blocks_hit      = 0;
+    bench_blocks_compiled = 0;
+    bench_blocks_marked   = 0;
+    bench_timer_us        = 0;
+
+    pclog("Bench: running %s for %i emulated seconds\n", machine_get_internal_name(), bench_seconds);
+
+    bench_active = 1;
+    start        = bench_time_us();
+
+    while ((done < frames) && !is_quit && cpu_thread_run) {
+        t = bench_time_us();
+        pc_run();
+        run_us += bench_time_us() - t;
+        done++;
+    }
+
+    end          = bench_time_us();
+    bench_active = 0;
+
+    emu_us  = done * frame_us;
+    real_us = end - start;
+
+    printf("{\n");
+    bench_print_str("machine", machine_get_internal_name(), 0);
+    bench_print_str("cpu", cpu_s->name, 0);
+    printf("  \"cpu_speed\": %" PRIu32 ",\n", (uint32_t) cpu_s->rspeed);
+    printf("  \"dynarec\": %s,\n", cpu_use_dynarec ? "true" : "false");
+    printf("  \"emulated_seconds\": %.6f,\n", (double) emu_us / 1000000.0);
+    printf("  \"real_seconds\": %.6f,\n", (double) real_us / 1000000.0);
+    printf("  \"speed_ratio\": %.4f,\n", bench_ratio(emu_us, real_us));
+    printf("  \"instructions\": %" PRIu64 ",\n", bench_insns);
+    printf("  \"mips\": %.3f,\n", bench_ratio(bench_insns, real_us));
+    printf("  \"blocks\": {\n");
+    printf("    \"compiled\": %" PRIu64 ",\n", bench_blocks_compiled);
+    printf("    \"marked\": %" PRIu64 ",\n", bench_blocks_marked);
+    printf("    \"hits\": %" PRIu64 "\n", bench_blocks_hit);
+    printf("  },\n");
+    printf("  \"time_us\": {\n");
+    printf("    \"cpu\": %" PRIu64 ",\n", (run_us > bench_timer_us) ? (run_us - bench_timer_us) : 0);
+    printf("    \"timers\": %" PRIu64 ",\n", bench_timer_us);
+    printf("    \"host\": %" PRIu64 "\n", (real_us > run_us) ? (real_us - run_us) : 0);
+    printf("  }\n");
+    printf("}\n");
+    fflush(stdout);
+
+    /* Let the platform code shut down as if the user quit. */
+    is_quit = 1;
+}
@@ -35,6 +35,7 @@
 #include <86box/log.h>
 #include <86box/path.h>
 #include <86box/plat.h>
+#include <86box/thread.h>
 #include <86box/cdrom.h>
 #include <86box/cdrom_image.h>
 #include <86box/cdrom_image_viso.h>
@@ -106,6 +107,33 @@ typedef struct
 
 #define dstruct_t mds_disc_struct_t
 
+#define IMAGE_CACHE_SHIFT  16 /* 64 kB blocks of image file data. */
+#define IMAGE_CACHE_SIZE   (1 << IMAGE_CACHE_SHIFT)
+#define IMAGE_CACHE_MASK   (IMAGE_CACHE_SIZE - 1)
+#define IMAGE_CACHE_BLOCKS 32
+#define IMAGE_READAHEAD    4 /* Blocks read ahead of sequential reads. */
+
+typedef struct image_cache_blk_t {
+    track_file_t *file; /* NULL = unused */
+    uint64_t      block;
+    uint32_t      len;  /* Short at the end of the file */
+    uint32_t      last_use;
+    uint8_t      *data;
+} image_cache_blk_t;
+
+/* Index ranges, sorted by start, to look up sectors without a scan. */
+typedef struct image_range_t {
+    uint64_t start;
+    uint64_t end;
+    int      track;
+    int      index;
+} image_range_t;
+
+typedef struct image_lookup_t {
+    image_range_t *ranges; /* NULL = ranges overlap, scan the tracks */
+    int            num;
+} image_lookup_t;
+
 typedef struct cd_image_t {
     cdrom_t      *dev;
     void         *log;
@@ -117,6 +145,27 @@ typedef struct cd_image_t {
     track_t      *tracks;
     uint32_t     *bad_sectors;
     dstruct_t     dstruct;
+
+    image_lookup_t data_lookup; /* Tracks 01-99 */
+    image_lookup_t all_lookup;  /* Every track */
+
+    image_cache_blk_t cache[IMAGE_CACHE_BLOCKS];
+    uint8_t          *cache_mem;
+    uint8_t          *cache_buf; /* Block being read by the emulation thread */
+    uint32_t          cache_use;
+    mutex_t          *cache_mutex;
+    mutex_t          *io_mutex; /* The file handles are shared with the thread. */
+    track_file_t     *last_file;
+    uint64_t          last_block;
+
+    /* Readahead thread. */
+    thread_t     *ra_thread;
+    event_t      *ra_wake;
+    uint8_t      *ra_buf;
+    track_file_t *ra_file;
+    uint64_t      ra_first;
+    uint64_t      ra_last;
+    int           ra_stop;
 } cd_image_t;
 
 typedef enum
@@ -519,12 +568,354 @@ index_file_close(track_index_t *idx)
     idx->file = NULL;
 }
 
+/*
+ * Image data cache.
+ *
+ * Reads from binary files go through a cache of 64 kB blocks, shared by
+ * all the files of an image, so reading a sector is a copy rather than a
+ * seek and a read. When the reads move on to the block right after the
+ * previous one, a thread reads the next few blocks ahead of them.
+ */
+static uint32_t
+bin_read_block(track_file_t *tf, uint8_t *buffer, const uint64_t block)
+{
+    size_t len;
+
+    if ((tf->fp == NULL) || (fseeko64(tf->fp, block << IMAGE_CACHE_SHIFT, SEEK_SET) == -1))
+        return 0;
+
+    len = fread(buffer, 1, IMAGE_CACHE_SIZE, tf->fp);
+
+    if (UNLIKELY(tf->motorola)) {
+        for (size_t i = 0; (i + 1) < len; i += 2) {
+            const uint8_t buffer0 = buffer[i];
+            buffer[i]             = buffer[i + 1];
+            buffer[i + 1]         = buffer0;
+        }
+    }
+
+    return (uint32_t) len;
+}
+
+/* With the cache mutex held. */
+static image_cache_blk_t *
+image_cache_find(cd_image_t *img, const track_file_t *tf, const uint64_t block)
+{
+    for (int i = 0; i < IMAGE_CACHE_BLOCKS; i++) {
+        if ((img->cache[i].file == tf) && (img->cache[i].block == block))
+            return &img->cache[i];
+    }
+
+    return NULL;
+}
+
+static void
+image_cache_insert(cd_image_t *img, track_file_t *tf, const uint64_t block,
+                   const uint8_t *data, const uint32_t len)
+{
+    image_cache_blk_t *blk;
+    int                victim = 0;
+
+    thread_wait_mutex(img->cache_mutex);
+
+    if (image_cache_find(img, tf, block) == NULL) {
+        for (int i = 1; i < IMAGE_CACHE_BLOCKS; i++) {
+            if (img->cache[i].last_use < img->cache[victim].last_use)
+                victim = i;
+        }
+
+        blk           = &img->cache[victim];
+        blk->file     = tf;
+        blk->block    = block;
+        blk->len      = len;
+        blk->last_use = ++img->cache_use;
+        memcpy(blk->data, data, len);
+    }
+
+    thread_release_mutex(img->cache_mutex);
+}
+
+static void
+image_readahead_thread(void *priv)
+{
+    cd_image_t   *img  = (cd_image_t *) priv;
+    track_file_t *tf;
+    uint64_t      block;
+    uint32_t      len;
+    int           cached;
+    int           stop = 0;
+
+    while (!stop) {
+        thread_wait_event(img->ra_wake, -1);
+        thread_reset_event(img->ra_wake);
+
+        while (1) {
+            thread_wait_mutex(img->cache_mutex);
+            stop = img->ra_stop;
+            if (stop || (img->ra_first > img->ra_last)) {
+                thread_release_mutex(img->cache_mutex);
+                break;
+            }
+            tf     = img->ra_file;
+            block  = img->ra_first++;
+            cached = (image_cache_find(img, tf, block) != NULL);
+            thread_release_mutex(img->cache_mutex);
+
+            if (cached)
+                continue;
+
+            thread_wait_mutex(img->io_mutex);
+            len = bin_read_block(tf, img->ra_buf, block);
+            thread_release_mutex(img->io_mutex);
+
+            /* Past the end of the file, nothing more to read ahead. */
+            if (len == 0) {
+                thread_wait_mutex(img->cache_mutex);
+                img->ra_first = 1;
+                img->ra_last  = 0;
+                thread_release_mutex(img->cache_mutex);
+            } else
+                image_cache_insert(img, tf, block, img->ra_buf, len);
+        }
+    }
+}
+
+static void
+image_cache_init(cd_image_t *img)
+{
+    img->cache_mem = (uint8_t *) malloc((size_t) (IMAGE_CACHE_BLOCKS + 2) * IMAGE_CACHE_SIZE);
+    if (img->cache_mem == NULL) {
+        image_log(img->log, "Unable to allocate the image cache\n");
+        return;
+    }
+
+    for (int i = 0; i < IMAGE_CACHE_BLOCKS; i++)
+        img->cache[i].data = img->cache_mem + ((size_t) i * IMAGE_CACHE_SIZE);
+    img->cache_buf = img->cache_mem + ((size_t) IMAGE_CACHE_BLOCKS * IMAGE_CACHE_SIZE);
+    img->ra_buf    = img->cache_buf + IMAGE_CACHE_SIZE;
+
+    img->cache_mutex = thread_create_mutex();
+    img->io_mutex    = thread_create_mutex();
+    img->ra_first    = 1;
+    img->ra_last     = 0;
+    img->ra_stop     = 0;
+    img->ra_wake     = thread_create_event();
+
+    /* Without the thread, the cache still works, it just does not read ahead. */
+    img->ra_thread = thread_create_named(image_readahead_thread, img, "CD-ROM readahead");
+    if (img->ra_thread == NULL) {
+        thread_destroy_event(img->ra_wake);
+        img->ra_wake = NULL;
+    }
+}
+
+static void
+image_cache_close(cd_image_t *img)
+{
+    if (img->ra_thread != NULL) {
+        thread_wait_mutex(img->cache_mutex);
+        img->ra_stop = 1;
+        thread_release_mutex(img->cache_mutex);
+        thread_set_event(img->ra_wake);
+        thread_wait(img->ra_thread);
+        img->ra_thread = NULL;
+
+        thread_destroy_event(img->ra_wake);
+        img->ra_wake = NULL;
+    }
+
+    if (img->cache_mem != NULL) {
+        thread_close_mutex(img->io_mutex);
+        thread_close_mutex(img->cache_mutex);
+        img->io_mutex    = NULL;
+        img->cache_mutex = NULL;
+
+        free(img->cache_mem);
+        img->cache_mem = NULL;
+    }
+}
+
+/* Copy from a cached block, returns 0 on a miss. */
+static int
+image_cache_copy(cd_image_t *img, const track_file_t *tf, const uint64_t block,
+                 const uint32_t offset, const uint32_t count, uint8_t *buffer)
+{
+    image_cache_blk_t *blk;
+    int                ret = 0;
+
+    thread_wait_mutex(img->cache_mutex);
+
+    blk = image_cache_find(img, tf, block);
+    if (blk != NULL) {
+        blk->last_use = ++img->cache_use;
+        /* A short block means the end of the file, same as a failed read. */
+        ret = ((offset + count) <= blk->len) ? 1 : -1;
+        if (ret > 0)
+            memcpy(buffer, blk->data + offset, count);
+    }
+
+    thread_release_mutex(img->cache_mutex);
+
+    return ret;
+}
+
+static int
+image_file_read(cd_image_t *img, track_file_t *tf, uint8_t *buffer,
+                uint64_t seek, size_t count)
+{
+    uint64_t block;
+    uint32_t offset;
+    uint32_t n;
+    uint32_t len;
+    int      ret;
+
+    /* Audio and virtual ISO files are read as they are. */
+    if ((img->cache_mem == NULL) || (tf->read != bin_read))
+        return tf->read(tf, buffer, seek, count);
+
+    while (count > 0) {
+        block  = seek >> IMAGE_CACHE_SHIFT;
+        offset = seek & IMAGE_CACHE_MASK;
+        n      = IMAGE_CACHE_SIZE - offset;
+        if (n > count)
+            n = count;
+
+        /* Moved on to the next block, have the one after it read ahead. */
+        if ((tf == img->last_file) && (block == (img->last_block + 1)) && (img->ra_thread != NULL)) {
+            thread_wait_mutex(img->cache_mutex);
+            img->ra_file  = tf;
+            img->ra_first = block + 1;
+            img->ra_last  = block + IMAGE_READAHEAD;
+            thread_release_mutex(img->cache_mutex);
+            thread_set_event(img->ra_wake);
+        }
+        img->last_file  = tf;
+        img->last_block = block;
+
+        ret = image_cache_copy(img, tf, block, offset, n, buffer);
+        if (ret == 0) {
+            thread_wait_mutex(img->io_mutex);
+            len = bin_read_block(tf, img->cache_buf, block);
+            thread_release_mutex(img->io_mutex);
+
+            if ((offset + n) > len) {
+                image_log(tf->log, "binary_read failed during read!\n");
+                return -1;
+            }
+
+            memcpy(buffer, img->cache_buf + offset, n);
+            image_cache_insert(img, tf, block, img->cache_buf, len);
+        } else if (ret < 0)
+            return -1;
+
+        seek += n;
+        count -= n;
+        buffer += n;
+    }
+
+    return 1;
+}
+
+/*
+ * Sector lookup.
+ *
+ * The index ranges of the tracks are put in order once the image is
+ * loaded, so a sector is found with a binary search. Should any of them
+ * overlap, the tracks are scanned in order like before, so the answer
+ * stays the same.
+ */
+static int
+image_range_compare(const void *a, const void *b)
+{
+    const image_range_t *ra = (const image_range_t *) a;
+    const image_range_t *rb = (const image_range_t *) b;
+
+    return (ra->start > rb->start) - (ra->start < rb->start);
+}
+
+static void
+image_build_lookup(const cd_image_t *img, image_lookup_t *lk, const int data_only)
+{
+    int num = 0;
+
+    free(lk->ranges);
+    lk->ranges = NULL;
+    lk->num    = 0;
+
+    for (int i = 0; i < img->tracks_num; i++)
+        num += img->tracks[i].max_index + 1;
+
+    if (num == 0)
+        return;
+
+    lk->ranges = (image_range_t *) malloc(num * sizeof(image_range_t));
+    if (lk->ranges == NULL)
+        return;
+
+    for (int i = 0; i < img->tracks_num; i++) {
+        const track_t *ct = &(img->tracks[i]);
+
+        if (data_only && ((ct->point < 1) || (ct->point > 99)))
+            continue;
+
+        for (int j = 0; j <= ct->max_index; j++) {
+            const track_index_t *ci = &(ct->idx[j]);
+
+            if ((ci->type >= INDEX_ZERO) && (ci->length != 0ULL)) {
+                lk->ranges[lk->num].start = ci->start;
+                lk->ranges[lk->num].end   = ci->start + ci->length - 1;
+                lk->ranges[lk->num].track = i;
+                lk->ranges[lk->num].index = j;
+                lk->num++;
+            }
+        }
+    }
+
+    qsort(lk->ranges, lk->num, sizeof(image_range_t), image_range_compare);
+
+    for (int i = 1; i < lk->num; i++) {
+        if (lk->ranges[i].start <= lk->ranges[i - 1].end) {
+            image_log(img->log, "Overlapping track indexes, sectors will be looked up by scanning\n");
+            free(lk->ranges);
+            lk->ranges = NULL;
+            lk->num    = 0;
+            break;
+        }
+    }
+}
+
+static const image_range_t *
+image_lookup(const image_lookup_t *lk, const uint64_t pos)
+{
+    int lo = 0;
+    int hi = lk->num - 1;
+
+    while (lo <= hi) {
+        const int mid = (lo + hi) >> 1;
+
+        if (pos < lk->ranges[mid].start)
+            hi = mid - 1;
+        else if (pos > lk->ranges[mid].end)
+            lo = mid + 1;
+        else
+            return &(lk->ranges[mid]);
+    }
+
+    return NULL;
+}
+
 /* Internal functions. */
 static int
 image_get_track(const cd_image_t *img, const uint32_t sector)
 {
     int ret = -1;
 
+    if (img->all_lookup.ranges != NULL) {
+        const image_range_t *r = image_lookup(&img->all_lookup, (uint32_t) (sector + 150));
+
+        return (r != NULL) ? r->track : -1;
+    }
+
     for (int i = 0; i < img->tracks_num; i++) {
         track_t *ct = &(img->tracks[i]);
         for (int j = 0; j <= ct->max_index; j++) {
@@ -547,6 +938,16 @@ image_get_track_and_index(const cd_image_t *img, const uint32_t sector,
     *track = -1;
     *index = -1;
 
+    if (img->data_lookup.ranges != NULL) {
+        const image_range_t *r = image_lookup(&img->data_lookup, (uint32_t) (sector + 150));
+
+        if (r != NULL) {
+            *track = r->track;
+            *index = r->index;
+        }
+        return;
+    }
+
     for (int i = 0; i < img->tracks_num; i++) {
         track_t *ct = &(img->tracks[i]);
         if ((ct->point >= 1) && (ct->point <= 99))  for (int j = 0; j <= ct->max_index; j++) {
@@ -2403,7 +2804,7 @@ static int
 image_read_sector(const void *local, uint8_t *buffer,
                   const uint32_t sector)
 {
-    const cd_image_t *img    = (const cd_image_t *) local;
+    cd_image_t       *img    = (cd_image_t *) local;
     cdrom_t          *dev    = (cdrom_t *) img->dev;
     int               m      = 0;
     int               s      = 0;
@@ -2468,7 +2869,7 @@ image_read_sector(const void *local, uint8_t *buffer,
 
             if (idx->type >= INDEX_NORMAL)
                 /* Read the data from the file. */
-                ret = idx->file->read(idx->file, buffer, seek, trk->sector_size);
+                ret = image_file_read(img, idx->file, buffer, seek, trk->sector_size);
             else
                 /* Index is not in the file, no read to fail here. */
                 ret = 1;
@@ -2632,8 +3033,14 @@ image_close(void *local)
     cd_image_t *img = (cd_image_t *) local;
 
     if (img != NULL) {
+        /* The readahead thread may still be using the files. */
+        image_cache_close(img);
+
         image_clear_tracks(img);
 
+        free(img->data_lookup.ranges);
+        free(img->all_lookup.ranges);
+
         image_log(img->log, "Log closed\n");
 
         log_close(img->log);
@@ -2711,6 +3118,10 @@ image_open(cdrom_t *dev, const char *path)
                 img->is_dvd = (lb >= 524287);    /* Minimum 1 GB total capacity as threshold for DVD. */
             }
 
+            image_build_lookup(img, &img->data_lookup, 1);
+            image_build_lookup(img, &img->all_lookup, 0);
+            image_cache_init(img);
+
             dev->ops = &image_ops;
         } else {
             log_warning(img->log, "Unable to load CD-ROM image: %s\n", path);
@@ -113,6 +113,7 @@ typedef struct _viso_entry_ {
         uint64_t data_offset;
     };
     uint16_t pt_idx;
+    uint32_t file_use;
 
     stat_t stats;
 
@@ -121,18 +122,31 @@ typedef struct _viso_entry_ {
     char *basename, path[];
 } viso_entry_t;
 
+typedef struct {
+    uint8_t used;
+    char    key[13];
+    int     tail;
+} viso_name_hint_t;
+
+typedef struct {
+    size_t            size;
+    const char      **names;
+    viso_name_hint_t *hints;
+} viso_names_t;
+
 typedef struct {
     uint64_t vol_size_offsets[2];
     uint64_t pt_meta_offsets[2];
     int      format;
     uint8_t  use_version_suffix : 1;
-    size_t   metadata_sectors, all_sectors, entry_map_size, sector_size, file_fifo_pos;
+    size_t   metadata_sectors, all_sectors, entry_map_size, sector_size;
+    uint32_t file_use;
     uint8_t *metadata;
 
     track_file_t   tf;
     viso_entry_t  *root_dir;
-    viso_entry_t **entry_map;
-    viso_entry_t  *file_fifo[VISO_OPEN_FILES];
+    viso_entry_t **entry_map; /* files with data, in LBA order */
+    viso_entry_t  *open_files[VISO_OPEN_FILES];
 } viso_t;
 
 static const char rr_eid[]   = "RRIP_1991A"; /* identifiers used in ER field for Rock Ridge */
@@ -321,8 +335,88 @@ viso_convert_utf8(wchar_t *dest, const char *src, ssize_t buf_size)
 VISO_WRITE_STR_FUNC(viso_write_string, uint8_t, char, , 0)
 VISO_WRITE_STR_FUNC(viso_write_wstring, uint16_t, wchar_t, cpu_to_be16, c > 0xffff)
 
+/* Short names already taken in the directory being traversed, and for each
+   name and extension pair, the first numeric tail that may still be free. */
+static uint32_t
+viso_names_hash(const char *str)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    while (*str)
+        hash = (hash ^ (uint8_t) *str++) * 0x01000193;
+
+    return hash;
+}
+
+static int
+viso_names_init(viso_names_t *names, size_t count)
+{
+    size_t size = 16;
+
+    while (size < (count * 2))
+        size <<= 1;
+
+    if (size > names->size) {
+        const char       **new_names = (const char **) realloc(names->names, size * sizeof(const char *));
+        if (new_names)
+            names->names = new_names;
+        viso_name_hint_t *new_hints = (viso_name_hint_t *) realloc(names->hints, size * sizeof(viso_name_hint_t));
+        if (new_hints)
+            names->hints = new_hints;
+        if (!new_names || !new_hints)
+            return 0;
+        names->size = size;
+    }
+
+    memset(names->names, 0x00, names->size * sizeof(const char *));
+    memset(names->hints, 0x00, names->size * sizeof(viso_name_hint_t));
+
+    return 1;
+}
+
+static void
+viso_names_close(viso_names_t *names)
+{
+    free(names->names);
+    free(names->hints);
+}
+
+/* Returns 0 if the name is taken, otherwise adds it and returns 1. */
 static int
-viso_fill_fn_short(char *data, const viso_entry_t *entry, viso_entry_t **entries)
+viso_names_add(viso_names_t *names, const char *name)
+{
+    size_t mask = names->size - 1;
+    size_t i    = viso_names_hash(name) & mask;
+
+    while (names->names[i]) {
+        if (!strcmp(names->names[i], name))
+            return 0;
+        i = (i + 1) & mask;
+    }
+    names->names[i] = name;
+
+    return 1;
+}
+
+static int *
+viso_names_hint(viso_names_t *names, const char *key)
+{
+    size_t mask = names->size - 1;
+    size_t i    = viso_names_hash(key) & mask;
+
+    while (names->hints[i].used) {
+        if (!strcmp(names->hints[i].key, key))
+            return &names->hints[i].tail;
+        i = (i + 1) & mask;
+    }
+    names->hints[i].used = 1;
+    strcpy(names->hints[i].key, key);
+
+    return &names->hints[i].tail;
+}
+
+static int
+viso_fill_fn_short(char *data, const viso_entry_t *entry, viso_names_t *names)
 {
     /* Get name and extension length. */
     const char *ext_pos = strrchr(entry->basename, '.');
@@ -353,33 +447,38 @@ viso_fill_fn_short(char *data, const viso_entry_t *entry, viso_entry_t **entries
         viso_write_string((uint8_t *) &ext[1], &ext_pos[1], ext_len - 1, VISO_CHARSET_D);
     }
 
-    /* Check if this filename is unique, and add a tail if required, while also adding the extension. */
+    /* Use the name as is if it fits. */
+    if (!force_tail) {
+        if (ext[0])
+            strcat(data, ext);
+        if (viso_names_add(names, data))
+            return 0;
+    }
+
+    /* Tails below the hint were all taken by earlier entries with the same name and extension. */
+    char key[sizeof(names->hints[0].key)];
+    data[name_copy_len] = '\0';
+    strcpy(key, data);
+    strcat(key, ext);
+    int *hint = viso_names_hint(names, key);
+
+    /* Add a tail until the filename is unique, while also adding the extension. */
     char tail[16];
-    for (int i = force_tail; i <= 999999; i++) {
-        /* Add tail to the filename if this is not the first run. */
-        int tail_len = -1;
-        if (i) {
-            tail_len = sprintf(tail, "~%d", i);
-            strcpy(&data[MIN(name_copy_len, 8 - tail_len)], tail);
-        }
+    for (int i = MAX(1, *hint); i <= 999999; i++) {
+        int tail_len = sprintf(tail, "~%d", i);
+        strcpy(&data[MIN(name_copy_len, 8 - tail_len)], tail);
 
         /* Add extension to the filename if present. */
         if (ext[0])
             strcat(data, ext);
 
-        /* Go through files in this directory to make sure this filename is unique. */
-        for (size_t j = 0; entries[j] != entry; j++) {
-            /* Flag and stop if this filename was seen. */
-            if (!strcmp(data, entries[j]->name_short)) {
-                tail_len = 0;
-                break;
-            }
-        }
-
         /* Stop if this is an unique name. */
-        if (tail_len)
+        if (viso_names_add(names, data)) {
+            *hint = i + 1;
             return 0;
+        }
     }
+    *hint = 1000000;
     return 1;
 }
 
@@ -680,13 +779,70 @@ viso_compare_entries(const void *a, const void *b)
     return strcmp((*((viso_entry_t **) a))->name_short, (*((viso_entry_t **) b))->name_short);
 }
 
+/* Find the file whose data covers the given offset in the data area. */
+static viso_entry_t *
+viso_find_file(const viso_t *viso, uint64_t seek)
+{
+    size_t lo = 0;
+    size_t hi = viso->entry_map_size;
+
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) >> 1);
+        if (viso->entry_map[mid]->data_offset <= seek)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo ? viso->entry_map[lo - 1] : NULL;
+}
+
+/* Open a file's host counterpart, closing the least recently used one if all slots are taken. */
+static FILE *
+viso_open_file(viso_t *viso, viso_entry_t *entry)
+{
+    entry->file_use = ++viso->file_use;
+    if (entry->file)
+        return entry->file;
+
+    /* Pick a free slot, or the least recently used file. */
+    int slot = 0;
+    for (int i = 0; i < VISO_OPEN_FILES; i++) {
+        if (!viso->open_files[i]) {
+            slot = i;
+            break;
+        }
+        if (viso->open_files[i]->file_use < viso->open_files[slot]->file_use)
+            slot = i;
+    }
+
+    viso_entry_t *other_entry = viso->open_files[slot];
+    if (other_entry) {
+        image_viso_log(viso->tf.log, "Closing [%s]...\n", other_entry->path);
+        fclose(other_entry->file);
+        other_entry->file        = NULL;
+        viso->open_files[slot] = NULL;
+        image_viso_log(viso->tf.log, "Done\n");
+    }
+
+    image_viso_log(viso->tf.log, "Opening [%s]...\n", entry->path);
+    if ((entry->file = fopen(entry->path, "rb"))) {
+        image_viso_log(viso->tf.log, "Done\n");
+        viso->open_files[slot] = entry;
+    } else {
+        image_viso_log(viso->tf.log, "Failed\n");
+    }
+
+    return entry->file;
+}
+
 int
 viso_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
 {
     track_file_t *tf   = (track_file_t *) priv;
     viso_t       *viso = (viso_t *) tf->priv;
 
-    /* Handle reads in a sector by sector basis. */
+    /* Handle reads in a sector by sector basis, or file run by file run for data. */
     while (count > 0) {
         /* Determine the current sector, offset and remainder. */
         size_t sector        = seek / viso->sector_size;
@@ -701,39 +857,15 @@ viso_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
             size_t read = 0;
 
             /* Get the file entry corresponding to this sector. */
-            viso_entry_t *entry = viso->entry_map[sector - viso->metadata_sectors];
-            if (entry) {
-                /* Open file if it's not already open. */
-                if (!entry->file) {
-                    /* Close any existing FIFO entry's file. */
-                    viso_entry_t *other_entry = viso->file_fifo[viso->file_fifo_pos];
-                    if (other_entry && other_entry->file) {
-                        image_viso_log(viso->tf.log, "Closing [%s]...\n", other_entry->path);
-                        fclose(other_entry->file);
-                        other_entry->file = NULL;
-                        image_viso_log(viso->tf.log, "Done\n");
-                    }
-
-                    /* Open file. */
-                    image_viso_log(viso->tf.log, "Opening [%s]...\n", entry->path);
-                    if ((entry->file = fopen(entry->path, "rb"))) {
-                        image_viso_log(viso->tf.log, "Done\n");
-
-                        /* Add this entry to the FIFO. */
-                        viso->file_fifo[viso->file_fifo_pos++] = entry;
-                        viso->file_fifo_pos &= (sizeof(viso->file_fifo) / sizeof(viso->file_fifo[0])) - 1;
-                    } else {
-                        image_viso_log(viso->tf.log, "Failed\n");
+            viso_entry_t *entry = viso_find_file(viso, seek);
+            if (entry && (seek < (entry->data_offset + entry->stats.st_size))) {
+                /* Read as much of this file as was asked for in one go. */
+                sector_remain = MIN(count, entry->data_offset + entry->stats.st_size - seek);
 
-                        /* Clear any existing FIFO entry. */
-                        viso->file_fifo[viso->file_fifo_pos] = NULL;
-                    }
-                }
-
-                /* Read data. */
-                if (!entry->file || (fseeko64(entry->file, seek - entry->data_offset, SEEK_SET) == -1))
+                FILE *fp = viso_open_file(viso, entry);
+                if (!fp || (fseeko64(fp, seek - entry->data_offset, SEEK_SET) == -1))
                     return -1;
-                read = fread(buffer, 1, sector_remain, entry->file);
+                read = fread(buffer, 1, sector_remain, fp);
                 if (sector_remain && !read)
                     return -1;
             }
@@ -871,6 +1003,7 @@ viso_init(const uint8_t id, const char *dirname, int *error)
     /* Traverse directories, starting with the root. */
     viso_entry_t **dir_entries     = NULL;
     size_t         dir_entries_len = 0;
+    viso_names_t   names           = { 0 };
     while (dir) {
         /* Open directory for listing. */
         DIR *dirp = opendir(dir->path);
@@ -896,6 +1029,8 @@ viso_init(const uint8_t id, const char *dirname, int *error)
                 goto next_dir;
             }
         }
+        if (!viso_names_init(&names, children_count))
+            goto next_dir;
 
         /* Add . and .. pseudo-directories. */
         dir_path_len = strlen(dir->path);
@@ -907,14 +1042,12 @@ viso_init(const uint8_t id, const char *dirname, int *error)
             if (!children_count)
                 dir->first_child = entry;
 
-            /* Stat the current directory or parent directory. */
-            if (stat(children_count ? dir->parent->path : dir->path, &entry->stats) != 0) {
-                /* Use a blank structure if stat failed. */
-                memset(&entry->stats, 0x00, sizeof(stat_t));
-            }
+            /* Both directories were already stat'd when they were added. */
+            entry->stats = children_count ? dir->parent->stats : dir->stats;
 
             /* Set basename. */
             strcpy(entry->name_short, children_count ? ".." : ".");
+            viso_names_add(&names, entry->name_short);
 
             image_viso_log(viso->tf.log, "[%08X] %s => %s\n", entry,
                            dir->path, entry->name_short);
@@ -955,9 +1088,8 @@ viso_init(const uint8_t id, const char *dirname, int *error)
                         entry->stats.st_size = (uint32_t) -1;
 
                     /* Increase entry map size. */
-                    viso->entry_map_size += entry->stats.st_size / viso->sector_size;
-                    if (entry->stats.st_size % viso->sector_size)
-                        viso->entry_map_size++; /* round up to the next sector */
+                    if (entry->stats.st_size)
+                        viso->entry_map_size++;
 
                     /* Detect El Torito boot code file and set it accordingly. */
                     if (dir == eltorito_dir) {
@@ -998,7 +1130,7 @@ have_eltorito_entry:
                 }
 
                 /* Set short filename. */
-                if (viso_fill_fn_short(entry->name_short, entry, dir_entries)) {
+                if (viso_fill_fn_short(entry->name_short, entry, &names)) {
                     free(entry);
                     children_count--;
                     continue;
@@ -1037,6 +1169,7 @@ next_dir:
     }
     if (dir_entries)
         free(dir_entries);
+    viso_names_close(&names);
 
     /* Write 16 blank sectors. */
     for (int i = 0; i < 16; i++)
@@ -1482,45 +1615,11 @@ next_entry:
         }
     }
 
-    /* Allocate entry map for sector->file lookups. */
-    size_t orig_sector_size = viso->sector_size;
-    while (1) {
-        image_viso_log(viso->tf.log, "Allocating entry map for %zu %zu-byte sectors\n",
-                       viso->entry_map_size, viso->sector_size);
-        viso->entry_map = (viso_entry_t **) calloc(viso->entry_map_size, sizeof(viso_entry_t *));
-        if (viso->entry_map) {
-            /* Successfully allocated. */
-            break;
-        } else {
-            /* Blank data buffer for padding if this is the first run. */
-            if (orig_sector_size == viso->sector_size)
-                memset(data, 0x00, orig_sector_size);
-
-            /* If we don't have enough memory, double the sector size. */
-            viso->sector_size *= 2;
-            if ((viso->sector_size < VISO_SECTOR_SIZE) || (viso->sector_size > (1 << 30))) /* give up if sectors become too large */
-                goto end;
-
-            /* Go through files, recalculating the entry map size. */
-            size_t orig_entry_map_size = viso->entry_map_size;
-            viso->entry_map_size       = 0;
-            entry                      = viso->root_dir;
-            while (entry) {
-                if (!S_ISDIR(entry->stats.st_mode)) {
-                    viso->entry_map_size += entry->stats.st_size / viso->sector_size;
-                    if (entry->stats.st_size % viso->sector_size)
-                        viso->entry_map_size++; /* round up to the next sector */
-                }
-                entry = entry->next;
-            }
-            if (viso->entry_map_size == orig_entry_map_size) /* give up if there was no change in map size */
-                goto end;
-
-            /* Pad metadata to the new size's next sector. */
-            while (ftello64(viso->tf.fp) % viso->sector_size)
-                fwrite(data, orig_sector_size, 1, viso->tf.fp);
-        }
-    }
+    /* Allocate entry map for offset->file lookups. */
+    image_viso_log(viso->tf.log, "Allocating entry map for %zu files\n", viso->entry_map_size);
+    viso->entry_map = (viso_entry_t **) calloc(MAX(viso->entry_map_size, 1), sizeof(viso_entry_t *));
+    if (viso->entry_map == NULL)
+        goto end;
 
     /* Start sector counts. */
     viso->metadata_sectors = ftello64(viso->tf.fp) / viso->sector_size;
@@ -1528,7 +1627,6 @@ next_entry:
 
     /* Go through files, assigning sectors to them. */
     image_viso_log(viso->tf.log, "Assigning sectors to files:\n");
-    size_t        base_factor  = viso->sector_size / orig_sector_size;
     viso_entry_t *prev_entry   = viso->root_dir;
     viso_entry_t **entry_map_p = viso->entry_map;
     entry                      = prev_entry->next;
@@ -1556,11 +1654,11 @@ next_entry:
             } else { /* emulation */
                 AS_U16(data[0]) = cpu_to_le16(1);
             }
-            AS_U32(data[2]) = cpu_to_le32(viso->all_sectors * base_factor);
+            AS_U32(data[2]) = cpu_to_le32(viso->all_sectors);
             viso_pwrite(data, eltorito_offset, 6, 1, viso->tf.fp);
         } else {
             p = data;
-            VISO_LBE_32(p, viso->all_sectors * base_factor);
+            VISO_LBE_32(p, viso->all_sectors);
             for (int i = 0; i <= max_vd; i++)
                 viso_pwrite(data, entry->dr_offsets[i] + 2, 8, 1, viso->tf.fp);
         }
@@ -1577,13 +1675,14 @@ next_entry:
 
         /* Allocate sectors to this file. */
         viso->all_sectors += size;
-        while (size-- > 0)
+        if (size)
             *entry_map_p++ = entry;
 
         /* Move on to the next entry. */
         prev_entry = entry;
         entry      = entry->next;
     }
+    viso->entry_map_size = entry_map_p - viso->entry_map; /* entries may have been dropped */
 
     /* Write final volume size to all volume descriptors. */
     p = data;
@@ -292,9 +292,44 @@ codegen_mark_code_present(codeblock_t *block, uint32_t start_pc, int len)
 extern void codegen_init(void);
 extern void codegen_reset(void);
 extern void codegen_block_init(uint32_t phys_addr);
+extern void codegen_block_init_cached(uint32_t phys_addr, uint16_t flags, uint64_t page_mask);
 extern void codegen_block_remove(void);
 extern void codegen_block_start_recompile(codeblock_t *block);
 extern void codegen_block_end_recompile(codeblock_t *block);
+
+extern int  codegen_cache_lookup(uint32_t phys_addr, uint16_t *flags, uint64_t *page_mask);
+extern void codegen_cache_record(codeblock_t *block);
+
+/*Reasons a block was thrown away or had to be recompiled, for the profiler*/
+enum {
+    CODEGEN_PROF_WRITE = 0,     /*Guest wrote to the block's code*/
+    CODEGEN_PROF_PURGE,         /*Invalidated early to reclaim a block*/
+    CODEGEN_PROF_DIRTY_EVICT,   /*Dropped from the dirty list before being recompiled*/
+    CODEGEN_PROF_RANDOM_DELETE, /*No free code blocks left*/
+    CODEGEN_PROF_MEM_PRESSURE,  /*No free memory blocks left*/
+    CODEGEN_PROF_ABORT,         /*Recompile or mark aborted*/
+    CODEGEN_PROF_STATIC_TOP,    /*Entered with a different FPU top-of-stack*/
+    CODEGEN_PROF_BYTE_MASK,     /*Demoted to byte granularity code masks*/
+    CODEGEN_PROF_NO_IMMEDIATES, /*Demoted to fetching immediates from memory*/
+    CODEGEN_PROF_NR
+};
+
+extern int  codegen_prof_enabled;
+extern void codegen_prof_init(void);
+extern void codegen_prof_block_init(codeblock_t *block);
+extern void codegen_prof_hit(codeblock_t *block);
+extern void codegen_prof_mark(codeblock_t *block);
+extern void codegen_prof_compile_start(void);
+extern void codegen_prof_compile_end(codeblock_t *block, int uops);
+extern void codegen_prof_event(codeblock_t *block, int event);
+extern void codegen_prof_blocks_full(void);
+extern void codegen_prof_mem_usage(void);
+
+#define CODEGEN_PROF_EVENT(block, event)      \
+    do {                                      \
+        if (codegen_prof_enabled)             \
+            codegen_prof_event(block, event); \
+    } while (0)
 extern void codegen_block_end(void);
 extern void codegen_delete_block(codeblock_t *block);
 extern void codegen_generate_call(uint8_t opcode, OpFn op, uint32_t fetchdat, uint32_t new_pc, uint32_t old_pc);
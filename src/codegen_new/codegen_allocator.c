@@ -58,8 +58,10 @@ codegen_allocator_allocate(mem_block_t *parent, int code_block)
         block_nr = rand() & MEM_BLOCK_MASK;
         block    = &mem_blocks[block_nr];
 
-        if (block->code_block && block->code_block != code_block)
+        if (block->code_block && block->code_block != code_block) {
+            CODEGEN_PROF_EVENT(&codeblock[block->code_block], CODEGEN_PROF_MEM_PRESSURE);
             codegen_delete_block(&codeblock[block->code_block]);
+        }
     }
 
     /*Remove from free list*/
@@ -76,6 +78,8 @@ codegen_allocator_allocate(mem_block_t *parent, int code_block)
         block->next = 0;
 
     codegen_allocator_usage++;
+    if (codegen_prof_enabled)
+        codegen_prof_mem_usage();
     return block;
 }
 void
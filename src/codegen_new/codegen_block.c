@@ -72,6 +72,9 @@ static uint16_t block_dirty_list_tail;
 static int      dirty_list_size = 0;
 #define DIRTY_LIST_MAX_SIZE 64
 
+/*Cause reported to the profiler for blocks invalidated by codegen_check_flush()*/
+static int flush_event = CODEGEN_PROF_WRITE;
+
 static void
 block_free_list_add(codeblock_t *block)
 {
@@ -125,6 +128,7 @@ block_dirty_list_add(codeblock_t *block)
 
         dirty_list_size--;
         evict_block->flags &= ~CODEBLOCK_IN_DIRTY_LIST;
+        CODEGEN_PROF_EVENT(evict_block, CODEGEN_PROF_DIRTY_EVICT);
         delete_dirty_block(evict_block);
     }
 }
@@ -167,7 +171,9 @@ codegen_purge_purgable_list(void)
         page_t *page = &pages[purgable_page_list_head];
 
         if (page->code_present_mask & page->dirty_mask) {
+            flush_event = CODEGEN_PROF_PURGE;
             codegen_check_flush(page, page->dirty_mask, purgable_page_list_head << 12);
+            flush_event = CODEGEN_PROF_WRITE;
 
             if (block_free_list)
                 return 1;
@@ -181,6 +187,9 @@ block_free_list_get(void)
 {
     codeblock_t *block = NULL;
 
+    if (!block_free_list && codegen_prof_enabled)
+        codegen_prof_blocks_full();
+
     while (!block_free_list) {
         /*Free list is empty, check the dirty list*/
         if (block_dirty_list_tail) {
@@ -198,6 +207,7 @@ block_free_list_get(void)
                 codeblock[block->prev].next = BLOCK_INVALID;
             dirty_list_size--;
             block->flags &= ~CODEBLOCK_IN_DIRTY_LIST;
+            CODEGEN_PROF_EVENT(block, CODEGEN_PROF_DIRTY_EVICT);
             delete_dirty_block(block);
             block_free_list = get_block_nr(block);
             break;
@@ -229,6 +239,7 @@ codegen_init(void)
 #ifdef DEBUG_EXTRA
     memset(instr_counts, 0, sizeof(instr_counts));
 #endif
+    codegen_prof_init();
 }
 
 void
@@ -377,6 +388,7 @@ invalidate_block(codeblock_t *block)
     if (block->pc == BLOCK_PC_INVALID)
         fatal("Invalidating deleted block\n");
 #endif
+    CODEGEN_PROF_EVENT(block, flush_event);
     remove_from_block_list(block, old_pc);
     block_dirty_list_add(block);
     if (block->head_mem_block)
@@ -442,6 +454,7 @@ codegen_delete_random_block(int required_mem_block)
             codeblock_t *block = &codeblock[block_nr];
 
             if (block->pc != BLOCK_PC_INVALID && (!required_mem_block || block->head_mem_block)) {
+                CODEGEN_PROF_EVENT(block, CODEGEN_PROF_RANDOM_DELETE);
                 delete_block(block);
                 return;
             }
@@ -533,6 +546,41 @@ codegen_block_init(uint32_t phys_addr)
 
     recomp_page = block->phys & ~0xfff;
     codeblock_tree_add(block);
+
+    if (codegen_prof_enabled)
+        codegen_prof_block_init(block);
+}
+
+/*
+ * Start a block the shape cache knows from an earlier run. It goes on the
+ * page's block list with the cached mask, the same as a block that has just
+ * been marked, so that the recompile can take it off again.
+ */
+void
+codegen_block_init_cached(uint32_t phys_addr, uint16_t flags, uint64_t page_mask)
+{
+    codeblock_t *block;
+    page_t      *p = &pages[phys_addr >> 12];
+
+    codegen_block_init(phys_addr);
+    block = &codeblock[block_current];
+
+    block->flags |= flags;
+    block->page_mask = page_mask;
+    if (flags & CODEBLOCK_BYTE_MASK) {
+        int offset = (phys_addr >> PAGE_BYTE_MASK_SHIFT) & PAGE_BYTE_MASK_OFFSET_MASK;
+
+        p->byte_code_present_mask[offset] |= page_mask;
+        block->dirty_mask = &p->byte_dirty_mask[offset];
+    } else
+        p->code_present_mask |= page_mask;
+
+    if ((*(block->dirty_mask) & page_mask) && !page_in_evict_list(p))
+        page_add_to_evict_list(p);
+
+    block->phys_2 = -1;
+    add_to_block_list(block);
+    recomp_page = -1;
 }
 
 static ir_data_t *ir_data;
@@ -554,6 +602,9 @@ codegen_block_start_recompile(codeblock_t *block)
     block_num     = HASH(block->phys);
     block_current = get_block_nr(block); // block->pnt;
 
+    if (codegen_prof_enabled)
+        codegen_prof_compile_start();
+
 #ifndef RELEASE_BUILD
     if (block->pc != cs + cpu_state.pc || (block->flags & CODEBLOCK_WAS_RECOMPILED))
         fatal("Recompile to used block!\n");
@@ -612,6 +663,7 @@ codegen_block_remove(void)
 {
     codeblock_t *block = &codeblock[block_current];
 
+    CODEGEN_PROF_EVENT(block, CODEGEN_PROF_ABORT);
     delete_block(block);
 
     recomp_page = -1;
@@ -755,6 +807,9 @@ codegen_block_end(void)
 
     codegen_block_generate_end_mask_mark();
     add_to_block_list(block);
+
+    if (codegen_prof_enabled)
+        codegen_prof_mark(block);
 }
 
 void
@@ -777,6 +832,11 @@ codegen_block_end_recompile(codeblock_t *block)
 
     codegen_accumulate_flush(ir_data);
     codegen_ir_compile(ir_data, block);
+
+    if (codegen_prof_enabled)
+        codegen_prof_compile_end(block, ir_data->wr_pos);
+
+    codegen_cache_record(block);
 }
 
 void
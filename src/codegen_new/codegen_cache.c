@@ -0,0 +1,389 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Persistent cache of recompiled block shapes.
+ *
+ *          Host code and IR both refer to host addresses that change
+ *          from one run to the next, so neither can be reused. What is
+ *          kept is what the recompiler learned about every block: where
+ *          it starts, which bytes it covers, the masking mode it ended
+ *          up using and a hash of those bytes. When a block is reached
+ *          whose bytes still hash the same, it is compiled right away
+ *          with those flags, instead of being interpreted and marked
+ *          first, and self-modifying code does not have to demote it
+ *          to byte masks all over again.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/mem.h>
+#include <86box/machine.h>
+#include <86box/path.h>
+#include <86box/plat.h>
+
+#include "codegen.h"
+
+#define CACHE_MAGIC    "86BoxDRC"
+#define CACHE_VERSION  1
+#define CACHE_FILE     "dynarec.cache"
+#define CACHE_MIN_SIZE 4096
+#define CACHE_MAX_SIZE (1 << 20)
+
+/* Flags that are worth carrying over into the next run. */
+#define CACHE_FLAGS (CODEBLOCK_BYTE_MASK | CODEBLOCK_NO_IMMEDIATES)
+/* In memory only: the entry has had its one chance this run. */
+#define CACHE_CHECKED 0x8000
+
+typedef struct codegen_cache_header_t {
+    char     magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t key;
+} codegen_cache_header_t;
+
+typedef struct codegen_cache_entry_t {
+    uint32_t phys;
+    uint32_t pc;
+    uint32_t _cs;
+    uint16_t status;
+    uint16_t flags; /* 0 = empty slot */
+    uint64_t page_mask;
+    uint64_t hash;
+} codegen_cache_entry_t;
+
+static codegen_cache_entry_t *entries;
+static uint32_t               entries_size;
+static uint32_t               entries_count;
+static uint64_t               cache_key;
+static int                    cache_open;
+static int                    cache_dirty;
+
+#ifdef ENABLE_CODEGEN_CACHE_LOG
+int codegen_cache_do_log = ENABLE_CODEGEN_CACHE_LOG;
+
+static void
+codegen_cache_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (codegen_cache_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define codegen_cache_log(fmt, ...)
+#endif
+
+static uint64_t
+fnv_add(uint64_t hash, uint32_t val)
+{
+    for (int i = 0; i < 4; i++) {
+        hash ^= (val >> (i << 3)) & 0xff;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static uint64_t
+fnv_add_str(uint64_t hash, const char *str)
+{
+    for (; *str; str++) {
+        hash ^= (uint8_t) *str;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return fnv_add(hash, 0);
+}
+
+/* Everything that changes how the same guest code is translated or timed. */
+static uint64_t
+codegen_cache_get_key(void)
+{
+    uint64_t key = 0xcbf29ce484222325ULL;
+
+    key = fnv_add_str(key, machine_get_internal_name());
+    key = fnv_add_str(key, cpu_f->internal_name);
+    key = fnv_add_str(key, cpu_s->name);
+    key = fnv_add(key, cpu_s->rspeed);
+    key = fnv_add(key, fpu_type);
+    key = fnv_add(key, fpu_softfloat);
+    key = fnv_add(key, cpu_waitstates);
+
+    return key;
+}
+
+/* Hash the guest bytes a block covers, at the granularity it tracks them with. */
+static uint64_t
+codegen_cache_hash(uint32_t phys, uint16_t flags, uint64_t page_mask)
+{
+    uint32_t old_logical = mem_logical_addr;
+    uint64_t hash        = 0xcbf29ce484222325ULL;
+    uint32_t base;
+
+    if (flags & CODEBLOCK_BYTE_MASK) {
+        base = phys & ~0x3f;
+        for (int i = 0; i < 64; i++) {
+            if (page_mask & (1ULL << i))
+                hash = fnv_add(hash, mem_readb_phys(base + i));
+        }
+    } else {
+        base = phys & ~0xfff;
+        for (int i = 0; i < 64; i++) {
+            if (page_mask & (1ULL << i)) {
+                for (int j = 0; j < (1 << PAGE_MASK_SHIFT); j += 4)
+                    hash = fnv_add(hash, mem_readl_phys(base + (i << PAGE_MASK_SHIFT) + j));
+            }
+        }
+    }
+
+    mem_logical_addr = old_logical;
+
+    return hash;
+}
+
+static uint32_t
+codegen_cache_slot(uint32_t phys, uint32_t pc, uint32_t _cs, uint16_t status)
+{
+    uint32_t h = (phys * 0x9e3779b1) ^ (pc * 0x85ebca6b) ^ (_cs * 0xc2b2ae35) ^ status;
+
+    h ^= h >> 16;
+
+    return h & (entries_size - 1);
+}
+
+static codegen_cache_entry_t *
+codegen_cache_find(uint32_t phys, uint32_t pc, uint32_t _cs, uint16_t status, int insert)
+{
+    uint32_t               slot = codegen_cache_slot(phys, pc, _cs, status);
+    codegen_cache_entry_t *ent;
+
+    for (uint32_t i = 0; i < entries_size; i++) {
+        ent = &entries[(slot + i) & (entries_size - 1)];
+        if (!ent->flags)
+            return insert ? ent : NULL;
+        if ((ent->phys == phys) && (ent->pc == pc) && (ent->_cs == _cs) && (ent->status == status))
+            return ent;
+    }
+
+    return NULL;
+}
+
+static int
+codegen_cache_resize(uint32_t size)
+{
+    codegen_cache_entry_t *old      = entries;
+    uint32_t               old_size = entries_size;
+    codegen_cache_entry_t *ent;
+
+    entries = (codegen_cache_entry_t *) calloc(size, sizeof(codegen_cache_entry_t));
+    if (entries == NULL) {
+        entries = old;
+        return 0;
+    }
+    entries_size = size;
+
+    for (uint32_t i = 0; i < old_size; i++) {
+        if (old[i].flags) {
+            ent  = codegen_cache_find(old[i].phys, old[i].pc, old[i]._cs, old[i].status, 1);
+            *ent = old[i];
+        }
+    }
+
+    free(old);
+
+    return 1;
+}
+
+static void
+codegen_cache_get_path(char *fn, int size)
+{
+    if ((size_t) size > (strlen(usr_path) + strlen(CACHE_FILE) + 1))
+        path_append_filename(fn, usr_path, CACHE_FILE);
+    else
+        fn[0] = '\0';
+}
+
+static void
+codegen_cache_load(void)
+{
+    codegen_cache_header_t hdr;
+    codegen_cache_entry_t  ent;
+    codegen_cache_entry_t *slot;
+    char                   fn[1024];
+    FILE                  *fp;
+    uint32_t               size = CACHE_MIN_SIZE;
+
+    cache_key   = codegen_cache_get_key();
+    cache_open  = 1;
+    cache_dirty = 0;
+
+    codegen_cache_get_path(fn, sizeof(fn));
+    fp = (fn[0] != '\0') ? plat_fopen(fn, "rb") : NULL;
+
+    if ((fp != NULL) && (fread(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr)) &&
+        !memcmp(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic)) && (hdr.version == CACHE_VERSION) &&
+        (hdr.key == cache_key) && (hdr.count <= (CACHE_MAX_SIZE / 2))) {
+        while ((size / 2) < hdr.count)
+            size <<= 1;
+    } else
+        hdr.count = 0;
+
+    entries_count = 0;
+    if (!codegen_cache_resize(size)) {
+        if (fp != NULL)
+            fclose(fp);
+        return;
+    }
+
+    for (uint32_t i = 0; i < hdr.count; i++) {
+        if (fread(&ent, 1, sizeof(ent), fp) != sizeof(ent))
+            break;
+        if (!(ent.flags & ~CACHE_FLAGS))
+            continue;
+        slot = codegen_cache_find(ent.phys, ent.pc, ent._cs, ent.status, 1);
+        if (!slot->flags)
+            entries_count++;
+        *slot = ent;
+    }
+
+    if (fp != NULL)
+        fclose(fp);
+
+    codegen_cache_log("CodegenCache: %u blocks loaded from %s\n", entries_count, fn);
+}
+
+/*
+ * Look up the block about to be marked. Returns 1 and the flags to
+ * compile it with if it was compiled in an earlier run and its bytes
+ * are still the same.
+ */
+int
+codegen_cache_lookup(uint32_t phys_addr, uint16_t *flags, uint64_t *page_mask)
+{
+    codegen_cache_entry_t *ent;
+
+    if (!cpu_dynarec_cache)
+        return 0;
+
+    if (!cache_open)
+        codegen_cache_load();
+
+    if (entries == NULL)
+        return 0;
+
+    /* Only the first compile of a block in a run can skip marking, after
+       that it goes through the normal path and is recorded again. So the
+       guest bytes are hashed at most once per entry. */
+    ent = codegen_cache_find(phys_addr, cs + cpu_state.pc, cs, cpu_cur_status, 0);
+    if ((ent == NULL) || (ent->flags & CACHE_CHECKED))
+        return 0;
+
+    ent->flags |= CACHE_CHECKED;
+    if (ent->hash != codegen_cache_hash(ent->phys, ent->flags, ent->page_mask))
+        return 0;
+
+    *flags     = ent->flags & CACHE_FLAGS;
+    *page_mask = ent->page_mask;
+
+    return 1;
+}
+
+/* Remember a block that has just been compiled. */
+void
+codegen_cache_record(codeblock_t *block)
+{
+    codegen_cache_entry_t *ent;
+
+    /* Blocks spanning two pages would need both to be present to be checked. */
+    if (!cpu_dynarec_cache || block->page_mask2 || !block->page_mask)
+        return;
+
+    if (!cache_open)
+        codegen_cache_load();
+
+    if (entries == NULL)
+        return;
+
+    if ((entries_count >= (entries_size / 2)) &&
+        ((entries_size >= CACHE_MAX_SIZE) || !codegen_cache_resize(entries_size << 1)))
+        return;
+
+    ent = codegen_cache_find(block->phys, block->pc, block->_cs, block->status, 1);
+    if (ent == NULL)
+        return;
+
+    if (!ent->flags)
+        entries_count++;
+
+    ent->phys      = block->phys;
+    ent->pc        = block->pc;
+    ent->_cs       = block->_cs;
+    ent->status    = block->status;
+    /* CODEBLOCK_WAS_RECOMPILED keeps the slot marked as used. */
+    ent->flags     = (block->flags & CACHE_FLAGS) | CODEBLOCK_WAS_RECOMPILED | CACHE_CHECKED;
+    ent->page_mask = block->page_mask;
+    ent->hash      = codegen_cache_hash(block->phys, block->flags, block->page_mask);
+
+    cache_dirty = 1;
+}
+
+/* Write the cache out and drop it, the machine may be about to change. */
+void
+codegen_cache_close(void)
+{
+    codegen_cache_header_t hdr;
+    char                   fn[1024];
+    FILE                  *fp;
+
+    if (cache_open && cache_dirty && (entries != NULL)) {
+        codegen_cache_get_path(fn, sizeof(fn));
+        fp = (fn[0] != '\0') ? plat_fopen(fn, "wb") : NULL;
+
+        if (fp != NULL) {
+            memset(&hdr, 0x00, sizeof(hdr));
+            memcpy(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic));
+            hdr.version = CACHE_VERSION;
+            hdr.count   = entries_count;
+            hdr.key     = cache_key;
+
+            fwrite(&hdr, 1, sizeof(hdr), fp);
+            for (uint32_t i = 0; i < entries_size; i++) {
+                if (entries[i].flags) {
+                    codegen_cache_entry_t ent = entries[i];
+
+                    ent.flags &= ~CACHE_CHECKED;
+                    fwrite(&ent, 1, sizeof(codegen_cache_entry_t), fp);
+                }
+            }
+            fclose(fp);
+
+            codegen_cache_log("CodegenCache: %u blocks saved to %s\n", entries_count, fn);
+        } else
+            pclog("CodegenCache: unable to write %s\n", fn);
+    }
+
+    free(entries);
+    entries       = NULL;
+    entries_size  = 0;
+    entries_count = 0;
+    cache_open    = 0;
+    cache_dirty   = 0;
+}
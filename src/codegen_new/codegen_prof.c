@@ -0,0 +1,380 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Dynarec profiler.
+ *
+ *          Opt-in instrumentation of the recompiler, enabled with the
+ *          --dynarec-prof command line option. For every guest block it
+ *          counts executions, interpreted (marking) passes, recompiles,
+ *          the host time and uOPs spent compiling it and the reasons it
+ *          was thrown away or had to be recompiled. It also tracks how
+ *          close the code block and memory block allocators got to
+ *          running out. The report is written on exit, and on SIGUSR1
+ *          where available.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <inttypes.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/mem.h>
+#include <86box/machine.h>
+#include <86box/plat.h>
+#include <86box/bench.h>
+
+#include "codegen.h"
+#include "codegen_allocator.h"
+
+#define PROF_MIN_SIZE 4096
+#define PROF_MAX_SIZE (1 << 22)
+/* Code block numbers are 16-bit, whatever the backend's BLOCK_SIZE. */
+#define PROF_BLOCK_NR 65536
+
+typedef struct codegen_prof_entry_t {
+    uint32_t phys;
+    uint32_t pc;
+    uint32_t _cs;
+    uint32_t used;
+    uint64_t hits;
+    uint64_t ins;
+    uint32_t marks;
+    uint32_t compiles;
+    uint64_t compile_ns;
+    uint32_t uops;
+    uint32_t uops_max;
+    uint32_t events[CODEGEN_PROF_NR];
+} codegen_prof_entry_t;
+
+static const char *event_names[CODEGEN_PROF_NR] = {
+    "write",
+    "purge",
+    "dirty_evict",
+    "random_delete",
+    "mem_pressure",
+    "abort",
+    "static_top",
+    "byte_mask",
+    "no_immediates"
+};
+
+int codegen_prof_enabled = 0;
+
+static codegen_prof_entry_t *entries;
+static uint32_t              entries_size;
+static uint32_t              entries_count;
+static uint32_t              entries_dropped;
+static uint32_t             *block_slot;
+static uint64_t              compile_start;
+static uint64_t              events[CODEGEN_PROF_NR];
+static uint64_t              blocks_full;
+static int                   mem_peak;
+static uint64_t              start_ns;
+
+static volatile sig_atomic_t dump_pending;
+
+static uint32_t
+codegen_prof_hash(uint32_t phys, uint32_t pc, uint32_t _cs)
+{
+    uint32_t h = (phys * 0x9e3779b1) ^ (pc * 0x85ebca6b) ^ (_cs * 0xc2b2ae35);
+
+    h ^= h >> 16;
+
+    return h & (entries_size - 1);
+}
+
+static codegen_prof_entry_t *
+codegen_prof_find(uint32_t phys, uint32_t pc, uint32_t _cs)
+{
+    uint32_t              slot = codegen_prof_hash(phys, pc, _cs);
+    codegen_prof_entry_t *ent;
+
+    for (;;) {
+        ent = &entries[slot];
+        if (!ent->used || ((ent->phys == phys) && (ent->pc == pc) && (ent->_cs == _cs)))
+            return ent;
+        slot = (slot + 1) & (entries_size - 1);
+    }
+}
+
+static int
+codegen_prof_resize(uint32_t size)
+{
+    codegen_prof_entry_t *old      = entries;
+    uint32_t              old_size = entries_size;
+    codegen_prof_entry_t *ent;
+
+    entries = (codegen_prof_entry_t *) calloc(size, sizeof(codegen_prof_entry_t));
+    if (entries == NULL) {
+        entries = old;
+        return 0;
+    }
+    entries_size = size;
+
+    for (uint32_t i = 0; i < old_size; i++) {
+        if (old[i].used) {
+            ent  = codegen_prof_find(old[i].phys, old[i].pc, old[i]._cs);
+            *ent = old[i];
+        }
+    }
+
+    /* Entries moved, so point the live blocks at their new slots. */
+    for (uint32_t i = 0; i < PROF_BLOCK_NR; i++) {
+        if (block_slot[i] < old_size) {
+            ent           = &old[block_slot[i]];
+            block_slot[i] = codegen_prof_find(ent->phys, ent->pc, ent->_cs) - entries;
+        }
+    }
+
+    free(old);
+
+    return 1;
+}
+
+static codegen_prof_entry_t *
+codegen_prof_get(codeblock_t *block)
+{
+    uint32_t slot = block_slot[get_block_nr(block)];
+
+    if (slot < entries_size)
+        return &entries[slot];
+
+    return NULL;
+}
+
+#ifndef _WIN32
+static void
+codegen_prof_signal(int sig)
+{
+    (void) sig;
+
+    dump_pending = 1;
+}
+#endif
+
+void
+codegen_prof_init(void)
+{
+    if (codegen_prof_enabled || (dynarec_prof_path[0] == '\0'))
+        return;
+
+    block_slot = (uint32_t *) malloc(PROF_BLOCK_NR * sizeof(uint32_t));
+    if (block_slot == NULL)
+        return;
+    memset(block_slot, 0xff, PROF_BLOCK_NR * sizeof(uint32_t));
+
+    if (!codegen_prof_resize(PROF_MIN_SIZE)) {
+        free(block_slot);
+        block_slot = NULL;
+        return;
+    }
+
+    start_ns             = bench_time_ns();
+    codegen_prof_enabled = 1;
+
+#ifndef _WIN32
+    signal(SIGUSR1, codegen_prof_signal);
+#endif
+
+    pclog("CodegenProf: profiling the recompiler into %s\n", dynarec_prof_path);
+}
+
+/* A block has been (re)initialized for marking, attach it to its entry. */
+void
+codegen_prof_block_init(codeblock_t *block)
+{
+    codegen_prof_entry_t *ent;
+
+    if ((entries_count >= (entries_size / 2)) &&
+        ((entries_size >= PROF_MAX_SIZE) || !codegen_prof_resize(entries_size << 1))) {
+        block_slot[get_block_nr(block)] = 0xffffffff;
+        entries_dropped++;
+        return;
+    }
+
+    ent = codegen_prof_find(block->phys, block->pc, block->_cs);
+    if (!ent->used) {
+        ent->used = 1;
+        ent->phys = block->phys;
+        ent->pc   = block->pc;
+        ent->_cs  = block->_cs;
+        entries_count++;
+    }
+
+    block_slot[get_block_nr(block)] = ent - entries;
+}
+
+void
+codegen_prof_hit(codeblock_t *block)
+{
+    codegen_prof_entry_t *ent = codegen_prof_get(block);
+
+    if (ent != NULL) {
+        ent->hits++;
+        ent->ins += block->ins;
+    }
+}
+
+void
+codegen_prof_mark(codeblock_t *block)
+{
+    codegen_prof_entry_t *ent = codegen_prof_get(block);
+
+    if (ent != NULL)
+        ent->marks++;
+}
+
+void
+codegen_prof_compile_start(void)
+{
+    compile_start = bench_time_ns();
+}
+
+/*
+ * The time covers the whole recompile pass, which interprets the block's
+ * instructions once while generating the IR, plus the backend.
+ */
+void
+codegen_prof_compile_end(codeblock_t *block, int uops)
+{
+    codegen_prof_entry_t *ent = codegen_prof_get(block);
+
+    if (ent != NULL) {
+        ent->compiles++;
+        ent->compile_ns += bench_time_ns() - compile_start;
+        ent->uops += uops;
+        if ((uint32_t) uops > ent->uops_max)
+            ent->uops_max = uops;
+    }
+}
+
+void
+codegen_prof_event(codeblock_t *block, int event)
+{
+    codegen_prof_entry_t *ent = codegen_prof_get(block);
+
+    events[event]++;
+    if (ent != NULL)
+        ent->events[event]++;
+}
+
+/* The code block free list ran dry and a live block had to go. */
+void
+codegen_prof_blocks_full(void)
+{
+    blocks_full++;
+}
+
+void
+codegen_prof_mem_usage(void)
+{
+    if (codegen_allocator_usage > mem_peak)
+        mem_peak = codegen_allocator_usage;
+}
+
+static int
+codegen_prof_compare(const void *a, const void *b)
+{
+    const codegen_prof_entry_t *ea = *(const codegen_prof_entry_t * const *) a;
+    const codegen_prof_entry_t *eb = *(const codegen_prof_entry_t * const *) b;
+
+    if (ea->hits != eb->hits)
+        return (ea->hits < eb->hits) ? 1 : -1;
+    if (ea->compile_ns != eb->compile_ns)
+        return (ea->compile_ns < eb->compile_ns) ? 1 : -1;
+
+    return (ea->phys > eb->phys) - (ea->phys < eb->phys);
+}
+
+void
+codegen_prof_dump(void)
+{
+    codegen_prof_entry_t **sorted;
+    codegen_prof_entry_t  *ent;
+    uint64_t               hits     = 0;
+    uint64_t               marks    = 0;
+    uint64_t               compiles = 0;
+    uint64_t               ns       = 0;
+    uint32_t               n        = 0;
+    FILE                  *fp;
+    int                    c;
+
+    dump_pending = 0;
+
+    if (!codegen_prof_enabled)
+        return;
+
+    fp = plat_fopen(dynarec_prof_path, "w");
+    if (fp == NULL) {
+        pclog("CodegenProf: unable to write %s\n", dynarec_prof_path);
+        return;
+    }
+
+    sorted = (codegen_prof_entry_t **) malloc(entries_count * sizeof(codegen_prof_entry_t *));
+    for (uint32_t i = 0; i < entries_size; i++) {
+        ent = &entries[i];
+        if (!ent->used)
+            continue;
+        hits += ent->hits;
+        marks += ent->marks;
+        compiles += ent->compiles;
+        ns += ent->compile_ns;
+        if (sorted != NULL)
+            sorted[n++] = ent;
+    }
+    if (sorted != NULL)
+        qsort(sorted, n, sizeof(codegen_prof_entry_t *), codegen_prof_compare);
+
+    fprintf(fp, "# 86Box dynarec profile: %s, %s\n", machine_get_internal_name(), cpu_s->name);
+    fprintf(fp, "# wall time %.3f s, %u blocks seen, %u not tracked\n",
+            (double) (bench_time_ns() - start_ns) / 1000000000.0, entries_count, entries_dropped);
+    fprintf(fp, "# hits %" PRIu64 ", marks %" PRIu64 ", compiles %" PRIu64 ", compile time %.3f ms\n",
+            hits, marks, compiles, (double) ns / 1000000.0);
+    fprintf(fp, "# code blocks: free list exhausted %" PRIu64 " times\n", blocks_full);
+    fprintf(fp, "# memory blocks: %i, in use %i, peak %i\n", MEM_BLOCK_NR, codegen_allocator_usage, mem_peak);
+    fprintf(fp, "# events:");
+    for (c = 0; c < CODEGEN_PROF_NR; c++)
+        fprintf(fp, " %s=%" PRIu64, event_names[c], events[c]);
+    fprintf(fp, "\n");
+
+    fprintf(fp, "phys,cs,pc,hits,ins,marks,compiles,compile_us,uops_avg,uops_max");
+    for (c = 0; c < CODEGEN_PROF_NR; c++)
+        fprintf(fp, ",%s", event_names[c]);
+    fprintf(fp, "\n");
+
+    for (uint32_t i = 0; i < n; i++) {
+        ent = sorted[i];
+        fprintf(fp, "%08x,%08x,%08x,%" PRIu64 ",%" PRIu64 ",%u,%u,%.3f,%u,%u",
+                ent->phys, ent->_cs, ent->pc - ent->_cs, ent->hits, ent->ins, ent->marks,
+                ent->compiles, (double) ent->compile_ns / 1000.0,
+                ent->compiles ? (ent->uops / ent->compiles) : 0, ent->uops_max);
+        for (c = 0; c < CODEGEN_PROF_NR; c++)
+            fprintf(fp, ",%u", ent->events[c]);
+        fprintf(fp, "\n");
+    }
+
+    free(sorted);
+    fclose(fp);
+
+    pclog("CodegenProf: %u blocks written to %s\n", n, dynarec_prof_path);
+}
+
+/* Called once per frame on the emulation thread. */
+void
+codegen_prof_poll(void)
+{
+    if (dump_pending)
+        codegen_prof_dump();
+}
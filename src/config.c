@@ -73,6 +73,7 @@
 #include <86box/midi.h>
 #include <86box/snd_mpu401.h>
 #include <86box/video.h>
+#include <86box/vnc.h>
 #include <86box/path.h>
 #include <86box/plat.h>
 #include <86box/plat_dir.h>
@@ -207,6 +208,18 @@ load_general(void)
     video_grayscale  = ini_section_get_int(cat, "video_grayscale", 0);
     video_graytype   = ini_section_get_int(cat, "video_graytype", 0);
 
+    svga_render_threads = ini_section_get_int(cat, "svga_render_threads", 0);
+    if (svga_render_threads < 0)
+        svga_render_threads = 0;
+
+#ifdef USE_VNC
+    vnc_max_fps = ini_section_get_int(cat, "vnc_max_fps", 0);
+    if (vnc_max_fps < 0)
+        vnc_max_fps = 0;
+    p = ini_section_get_string(cat, "vnc_encodings", "");
+    strncpy(vnc_encodings, p, sizeof(vnc_encodings) - 1);
+#endif
+
     force_10ms = !!ini_section_get_int(cat, "force_10ms", 0);
 
     rctrl_is_lalt = ini_section_get_int(cat, "rctrl_is_lalt", 0);
@@ -476,6 +489,7 @@ load_machine(void)
         mem_size = machine_get_max_ram(machine);
 
     cpu_use_dynarec = !!ini_section_get_int(cat, "cpu_use_dynarec", 0);
+    cpu_dynarec_cache = !!ini_section_get_int(cat, "cpu_dynarec_cache", 0);
     fpu_softfloat = !!ini_section_get_int(cat, "fpu_softfloat", 0);
     if ((fpu_type != FPU_NONE) && machine_has_flags(machine, MACHINE_SOFTFLOAT_ONLY))
         fpu_softfloat = 1;
@@ -866,6 +880,23 @@ load_network(void)
          else
             strncpy(net_cards_conf[c].nrs_hostname, "", sizeof(net_cards_conf[c].nrs_hostname) - 1);
 
+        sprintf(temp, "net_%02i_queue_len", c + 1);
+        nc->queue_len = ini_section_get_int(cat, temp, 0);
+
+        sprintf(temp, "net_%02i_switch_shm", c + 1);
+        nc->switch_shm = !!ini_section_get_int(cat, temp, 0);
+
+        sprintf(temp, "net_%02i_capture", c + 1);
+        p = ini_section_get_string(cat, temp, "");
+        nc->capture_fn[0] = '\0';
+        if (p[0] != '\0') {
+            if (path_abs(p))
+                strncpy(nc->capture_fn, p, sizeof(nc->capture_fn) - 1);
+            else
+                path_append_filename(nc->capture_fn, usr_path, p);
+            path_normalize(nc->capture_fn);
+        }
+
         sprintf(temp, "net_%02i_link", c + 1);
         nc->link_state = ini_section_get_int(cat, temp,
                                              (NET_LINK_10_HD | NET_LINK_10_FD |
@@ -1181,6 +1212,8 @@ load_hard_disks(void)
     uint32_t      board = 0;
     uint32_t      dev = 0;
 
+    hdd_image_async = !!ini_section_get_int(cat, "hdd_async_io", 0);
+
     memset(temp, '\0', sizeof(temp));
     for (uint8_t c = 0; c < HDD_NUM; c++) {
         sprintf(temp, "hdd_%02i_parameters", c + 1);
@@ -1249,6 +1282,26 @@ load_hard_disks(void)
         p                   = ini_section_get_string(cat, temp, tmp2);
         hdd[c].speed_preset = hdd_preset_get_from_internal_name(p);
 
+        sprintf(temp, "hdd_%02i_cache_size", c + 1);
+        hdd[c].cache_size = MIN(MAX(ini_section_get_int(cat, temp, 0), 0), 4096);
+
+        sprintf(temp, "hdd_%02i_cache_writeback", c + 1);
+        hdd[c].cache_writeback = !!ini_section_get_int(cat, temp, 0);
+
+        sprintf(temp, "hdd_%02i_mmap", c + 1);
+        hdd[c].mmap = !!ini_section_get_int(cat, temp, 0);
+
+        sprintf(temp, "hdd_%02i_overlay", c + 1);
+        p = ini_section_get_string(cat, temp, "none");
+        if (!strcmp(p, "discard"))
+            hdd[c].overlay = HDD_OVERLAY_DISCARD;
+        else if (!strcmp(p, "commit"))
+            hdd[c].overlay = HDD_OVERLAY_COMMIT;
+        else if (!strcmp(p, "keep"))
+            hdd[c].overlay = HDD_OVERLAY_KEEP;
+        else
+            hdd[c].overlay = HDD_OVERLAY_NONE;
+
         /* MFM/RLL */
         sprintf(temp, "hdd_%02i_mfm_channel", c + 1);
         if (hdd[c].bus_type == HDD_BUS_MFM)
@@ -2415,6 +2468,23 @@ save_general(void)
     else
         ini_section_set_int(cat, "video_graytype", video_graytype);
 
+    if (svga_render_threads == 0)
+        ini_section_delete_var(cat, "svga_render_threads");
+    else
+        ini_section_set_int(cat, "svga_render_threads", svga_render_threads);
+
+#ifdef USE_VNC
+    if (vnc_max_fps == 0)
+        ini_section_delete_var(cat, "vnc_max_fps");
+    else
+        ini_section_set_int(cat, "vnc_max_fps", vnc_max_fps);
+
+    if (vnc_encodings[0] == '\0')
+        ini_section_delete_var(cat, "vnc_encodings");
+    else
+        ini_section_set_string(cat, "vnc_encodings", vnc_encodings);
+#endif
+
     if (rctrl_is_lalt == 0)
         ini_section_delete_var(cat, "rctrl_is_lalt");
     else
@@ -2590,6 +2660,11 @@ save_machine(void)
 
     ini_section_set_int(cat, "cpu_use_dynarec", cpu_use_dynarec);
 
+    if (cpu_dynarec_cache == 0)
+        ini_section_delete_var(cat, "cpu_dynarec_cache");
+    else
+        ini_section_set_int(cat, "cpu_dynarec_cache", cpu_dynarec_cache);
+
     if (fpu_softfloat == 0)
         ini_section_delete_var(cat, "fpu_softfloat");
     else
@@ -2927,6 +3002,26 @@ save_network(void)
             else
                 ini_section_delete_var(cat, temp);
         }
+
+        sprintf(temp, "net_%02i_queue_len", c + 1);
+        if ((nc->device_num == 0) || (nc->queue_len == 0))
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_int(cat, temp, nc->queue_len);
+
+        sprintf(temp, "net_%02i_switch_shm", c + 1);
+        if ((nc->device_num == 0) || !nc->switch_shm)
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_int(cat, temp, nc->switch_shm);
+
+        sprintf(temp, "net_%02i_capture", c + 1);
+        if ((nc->device_num == 0) || (nc->capture_fn[0] == '\0'))
+            ini_section_delete_var(cat, temp);
+        else if (!strnicmp(nc->capture_fn, usr_path, strlen(usr_path)))
+            ini_section_set_string(cat, temp, &nc->capture_fn[strlen(usr_path)]);
+        else
+            ini_section_set_string(cat, temp, nc->capture_fn);
     }
 
     ini_delete_section_if_empty(config, cat);
@@ -3386,8 +3481,38 @@ save_hard_disks(void)
             ini_section_delete_var(cat, temp);
         else
             ini_section_set_string(cat, temp, hdd_preset_get_internal_name(hdd[c].speed_preset));
+
+        sprintf(temp, "hdd_%02i_cache_size", c + 1);
+        if (hdd_is_valid(c) && (hdd[c].cache_size > 0))
+            ini_section_set_int(cat, temp, hdd[c].cache_size);
+        else
+            ini_section_delete_var(cat, temp);
+
+        sprintf(temp, "hdd_%02i_cache_writeback", c + 1);
+        if (hdd_is_valid(c) && (hdd[c].cache_size > 0) && hdd[c].cache_writeback)
+            ini_section_set_int(cat, temp, 1);
+        else
+            ini_section_delete_var(cat, temp);
+
+        sprintf(temp, "hdd_%02i_mmap", c + 1);
+        if (hdd_is_valid(c) && hdd[c].mmap)
+            ini_section_set_int(cat, temp, 1);
+        else
+            ini_section_delete_var(cat, temp);
+
+        sprintf(temp, "hdd_%02i_overlay", c + 1);
+        if (hdd_is_valid(c) && (hdd[c].overlay != HDD_OVERLAY_NONE)) {
+            static const char *overlay_modes[] = { "none", "discard", "commit", "keep" };
+            ini_section_set_string(cat, temp, overlay_modes[hdd[c].overlay]);
+        } else
+            ini_section_delete_var(cat, temp);
     }
 
+    if (hdd_image_async == 0)
+        ini_section_delete_var(cat, "hdd_async_io");
+    else
+        ini_section_set_int(cat, "hdd_async_io", hdd_image_async);
+
     ini_delete_section_if_empty(config, cat);
 }
 
@@ -29,6 +29,7 @@
 #include <86box/plat_fallthrough.h>
 #include <86box/plat_unused.h>
 #include <86box/gdbstub.h>
+#include <86box/bench.h>
 #ifndef OPS_286_386
 #    define OPS_286_386
 #endif
@@ -233,6 +234,7 @@ exec386_2386(int32_t cycs)
     int32_t  cycle_period;
     int32_t  ins_cycles;
     uint32_t addr;
+    const int bench = bench_active; /* Only counted while benchmarking */
 
     cycles += cycs;
 
@@ -294,6 +296,8 @@ exec386_2386(int32_t cycs)
                     in_lock = 1;
                 x86_2386_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
                 in_lock = 0;
+                if (bench)
+                    bench_insns++;
                 if (x86_was_reset)
                     break;
             }
@@ -32,6 +32,7 @@
 #include <86box/plat_fallthrough.h>
 #include <86box/plat_unused.h>
 #include <86box/gdbstub.h>
+#include <86box/bench.h>
 #ifdef USE_DYNAREC
 #    include "codegen.h"
 #    ifdef USE_NEW_DYNAREC
@@ -273,6 +274,8 @@ update_tsc(void)
 static __inline void
 exec386_dynarec_int(void)
 {
+    const int bench = bench_active; /* Only counted while benchmarking */
+
     cpu_block_end = 0;
     x86_was_reset = 0;
 
@@ -314,6 +317,8 @@ exec386_dynarec_int(void)
             cpu_state.eflags &= ~(RF_FLAG);
 #    endif
             x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+            if (bench)
+                bench_insns++;
         }
 
 #    ifndef USE_NEW_DYNAREC
@@ -387,7 +392,12 @@ exec386_dynarec_dyn(void)
 #    else
     codeblock_t *block = codeblock_hash[hash];
 #    endif
-    int valid_block = 0;
+    int       valid_block = 0;
+    const int bench       = bench_active;
+#    ifdef USE_NEW_DYNAREC
+    uint16_t cache_flags;
+    uint64_t cache_mask;
+#    endif
 
 #    ifdef USE_NEW_DYNAREC
     if (!cpu_state.abrt)
@@ -476,10 +486,14 @@ exec386_dynarec_dyn(void)
 #    ifdef USE_NEW_DYNAREC
         if (valid_block && (block->flags & CODEBLOCK_IN_DIRTY_LIST)) {
             block->flags &= ~CODEBLOCK_WAS_RECOMPILED;
-            if (block->flags & CODEBLOCK_BYTE_MASK)
+            if (block->flags & CODEBLOCK_BYTE_MASK) {
+                if (!(block->flags & CODEBLOCK_NO_IMMEDIATES))
+                    CODEGEN_PROF_EVENT(block, CODEGEN_PROF_NO_IMMEDIATES);
                 block->flags |= CODEBLOCK_NO_IMMEDIATES;
-            else
+            } else {
+                CODEGEN_PROF_EVENT(block, CODEGEN_PROF_BYTE_MASK);
                 block->flags |= CODEBLOCK_BYTE_MASK;
+            }
         }
         if (valid_block && (block->flags & CODEBLOCK_WAS_RECOMPILED) && (block->flags & CODEBLOCK_STATIC_TOP) && block->TOP != (cpu_state.TOP & 7))
 #    else
@@ -489,6 +503,7 @@ exec386_dynarec_dyn(void)
             /* FPU top-of-stack does not match the value this block was compiled
                with, re-compile using dynamic top-of-stack*/
 #    ifdef USE_NEW_DYNAREC
+            CODEGEN_PROF_EVENT(block, CODEGEN_PROF_STATIC_TOP);
             block->flags &= ~(CODEBLOCK_STATIC_TOP | CODEBLOCK_WAS_RECOMPILED);
 #    else
             block->flags &= ~CODEBLOCK_STATIC_TOP;
@@ -498,6 +513,13 @@ exec386_dynarec_dyn(void)
     }
 
 #    ifdef USE_NEW_DYNAREC
+    /* Blocks compiled in an earlier run, with the same bytes, skip marking. */
+    if (!valid_block && !cpu_state.abrt && codegen_cache_lookup(phys_addr, &cache_flags, &cache_mask)) {
+        codegen_block_init_cached(phys_addr, cache_flags, cache_mask);
+        block       = &codeblock[block_current];
+        valid_block = 1;
+    }
+
     if (valid_block && (block->flags & CODEBLOCK_WAS_RECOMPILED))
 #    else
     if (valid_block && block->was_recompiled)
@@ -505,11 +527,18 @@ exec386_dynarec_dyn(void)
     {
         void (*code)(void) = (void *) &block->data[BLOCK_START];
 
-#    ifndef USE_NEW_DYNAREC
+#    ifdef USE_NEW_DYNAREC
+        if (codegen_prof_enabled)
+            codegen_prof_hit(block);
+#    else
         codeblock_hash[hash] = block;
 #    endif
         inrecomp = 1;
         code();
+        if (bench) {
+            bench_blocks_hit++;
+            bench_insns += block->ins;
+        }
 #    ifdef USE_ACYCS
         acycs = 0;
 #    endif
@@ -564,6 +593,8 @@ exec386_dynarec_dyn(void)
                 codegen_generate_call(opcode, x86_opcodes[(opcode | cpu_state.op32) & 0x3ff], fetchdat, cpu_state.pc, cpu_state.pc - 1);
 
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                if (bench)
+                    bench_insns++;
 
                 if (x86_was_reset)
                     break;
@@ -614,8 +645,11 @@ exec386_dynarec_dyn(void)
 
         cpu_end_block_after_ins = 0;
 
-        if ((!cpu_state.abrt || (cpu_state.abrt & ABRT_EXPECTED)) && !new_ne && !x86_was_reset)
+        if ((!cpu_state.abrt || (cpu_state.abrt & ABRT_EXPECTED)) && !new_ne && !x86_was_reset) {
             codegen_block_end_recompile(block);
+            if (bench)
+                bench_blocks_compiled++;
+        }
 
         if (x86_was_reset)
             codegen_reset();
@@ -666,6 +700,8 @@ exec386_dynarec_dyn(void)
                 cpu_state.pc++;
 
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                if (bench)
+                    bench_insns++;
 
                 if (x86_was_reset)
                     break;
@@ -716,8 +752,11 @@ exec386_dynarec_dyn(void)
 
         cpu_end_block_after_ins = 0;
 
-        if ((!cpu_state.abrt || (cpu_state.abrt & ABRT_EXPECTED)) && !new_ne && !x86_was_reset)
+        if ((!cpu_state.abrt || (cpu_state.abrt & ABRT_EXPECTED)) && !new_ne && !x86_was_reset) {
             codegen_block_end();
+            if (bench)
+                bench_blocks_marked++;
+        }
 
         if (x86_was_reset)
             codegen_reset();
@@ -875,6 +914,7 @@ exec386(int32_t cycs)
     int32_t  cycle_period;
     int32_t  ins_cycles;
     uint32_t addr;
+    const int bench = bench_active;
 
     cycles += cycs;
 
@@ -937,6 +977,8 @@ exec386(int32_t cycs)
                 cpu_state.eflags &= ~(RF_FLAG);
 #endif
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                if (bench)
+                    bench_insns++;
                 if (x86_was_reset)
                     break;
             }
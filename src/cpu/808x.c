@@ -38,6 +38,7 @@
 #include <86box/ppi.h>
 #include <86box/timer.h>
 #include <86box/gdbstub.h>
+#include <86box/bench.h>
 #include <86box/plat_fallthrough.h>
 #include <86box/plat_unused.h>
 
@@ -1931,6 +1932,7 @@ execx86(int cycs)
     int      bits;
     uint32_t dest_seg, i, carry, nibble;
     uint32_t srcseg, byteaddr;
+    const int bench = bench_active; /* Only counted while benchmarking */
 
     cycles += cycs;
 
@@ -1950,6 +1952,8 @@ execx86(int cycs)
             cpu_state.oldpc = cpu_state.pc;
             opcode          = pfq_fetchb();
             handled         = 0;
+            if (bench)
+                bench_insns++;
             oldc            = cpu_state.flags & C_FLAG;
             if (clear_lock) {
                 in_lock    = 0;
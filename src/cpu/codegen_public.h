@@ -51,6 +51,12 @@
 
 extern void codegen_init(void);
 extern void codegen_flush(void);
+#ifdef USE_NEW_DYNAREC
+extern void codegen_cache_close(void);
+extern void codegen_prof_init(void);
+extern void codegen_prof_poll(void);
+extern void codegen_prof_dump(void);
+#endif
 
 /*Current physical page of block being recompiled. -1 if no recompilation taking place */
 extern uint32_t recomp_page;
@@ -21,6 +21,7 @@
 #include <inttypes.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
@@ -40,6 +41,7 @@
 #include <86box/nmi.h>
 #include <86box/pic.h>
 #include <86box/pci.h>
+#include <86box/savestate.h>
 #include <86box/smram.h>
 #include <86box/timer.h>
 #include <86box/gdbstub.h>
@@ -1877,6 +1879,61 @@ cpu_close(void)
     cpu_inited = 0;
 }
 
+void
+cpu_savestate(savestate_t *st)
+{
+    savestate_var(st, cpu_state);
+    savestate_var(st, fpu_state);
+    savestate_var(st, msr);
+
+    savestate_var(st, cr2);
+    savestate_var(st, cr3);
+    savestate_var(st, cr4);
+    savestate_var(st, dr);
+    savestate_var(st, _tr);
+
+    savestate_var(st, gdt);
+    savestate_var(st, ldt);
+    savestate_var(st, idt);
+    savestate_var(st, tr);
+
+    savestate_var(st, cpu_cur_status);
+    savestate_var(st, use32);
+    savestate_var(st, stack32);
+    savestate_var(st, in_sys);
+    savestate_var(st, trap);
+    savestate_var(st, nmi);
+    savestate_var(st, nmi_mask);
+    savestate_var(st, nmi_enable);
+    savestate_var(st, smi_latched);
+    savestate_var(st, smm_in_hlt);
+    savestate_var(st, smi_block);
+    savestate_var(st, cpu_old_paging);
+
+    savestate_var(st, ccr0);
+    savestate_var(st, ccr1);
+    savestate_var(st, ccr2);
+    savestate_var(st, ccr3);
+    savestate_var(st, ccr4);
+    savestate_var(st, ccr5);
+    savestate_var(st, ccr6);
+    savestate_var(st, ccr7);
+
+    savestate_var(st, cache_index);
+    savestate_var(st, _cache);
+
+    if (st->loading) {
+        /* Host pointer, only meaningful during an instruction. */
+        cpu_state.ea_seg = &cpu_state.seg_ds;
+
+        cpu_flush_pending = 0;
+        flushmmucache();
+#ifdef USE_DYNAREC
+        codegen_reset();
+#endif
+    }
+}
+
 void
 cpu_set_isa_speed(int speed)
 {
@@ -53,6 +53,7 @@
 #include <86box/mem.h>
 #include <86box/plat.h>
 #include <86box/rom.h>
+#include <86box/savestate.h>
 #include <86box/sound.h>
 #include <86box/ui.h>
 
@@ -349,6 +350,73 @@ device_reset_all(uint32_t match_flags)
     }
 }
 
+/* Build the save state section tag of a device slot, the instance
+   number tells apart several devices of the same type. */
+static void
+device_savestate_tag(int c, char *tag)
+{
+    int inst = 0;
+
+    for (int i = 0; i < c; i++) {
+        if (devices[i] == devices[c])
+            inst++;
+    }
+
+    snprintf(tag, SAVESTATE_TAG_LEN, "dev:%s.%i",
+             devices[c]->internal_name ? devices[c]->internal_name : devices[c]->name, inst);
+}
+
+/* Save all devices, returns the number of devices that have no save state handler. */
+int
+device_savestate(savestate_t *st)
+{
+    char tag[SAVESTATE_TAG_LEN];
+    int  missing = 0;
+
+    for (int c = 0; c < DEVICE_MAX; c++) {
+        if (devices[c] == NULL)
+            continue;
+
+        if (devices[c]->savestate == NULL) {
+            pclog("SaveState: device \"%s\" has no save state support\n", devices[c]->name);
+            missing++;
+            continue;
+        }
+
+        device_savestate_tag(c, tag);
+        savestate_begin(st, tag, devices[c]->savestate_ver);
+        devices[c]->savestate(device_priv[c], st);
+        savestate_end(st);
+    }
+
+    return missing;
+}
+
+/* Restore the device a section belongs to, returns 0 if there is no such device. */
+int
+device_loadstate(savestate_t *st, const char *tag)
+{
+    char dev_tag[SAVESTATE_TAG_LEN];
+
+    for (int c = 0; c < DEVICE_MAX; c++) {
+        if ((devices[c] == NULL) || (devices[c]->savestate == NULL))
+            continue;
+
+        device_savestate_tag(c, dev_tag);
+        if (!strcmp(tag, dev_tag)) {
+            if (st->version > devices[c]->savestate_ver) {
+                pclog("SaveState: device \"%s\" state version %i is too new\n",
+                      devices[c]->name, st->version);
+                return 0;
+            }
+            devices[c]->savestate(device_priv[c], st);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 void *
 device_find_first_priv(uint32_t match_flags)
 {
@@ -96,6 +96,8 @@
 #define WIN_SETIDLE1                   0xe3
 #define WIN_CHECKPOWERMODE1            0xe5
 #define WIN_SLEEP1                     0xe6
+#define WIN_FLUSH_CACHE                0xe7
+#define WIN_FLUSH_CACHE_EXT            0xea /* 48-Bit Flush Cache */
 #define WIN_IDENTIFY                   0xec /* Ask drive to identify itself */
 #define WIN_SET_FEATURES               0xef
 #define WIN_READ_NATIVE_MAX            0xf8
@@ -109,6 +111,8 @@
 #define FEATURE_DISABLE_IRQ_SERVICE    0xde
 
 #define IDE_TIME                       10.0
+/* How often to check on a queued read once the emulated seek is over. */
+#define IDE_IO_POLL_TIME               (5.0 * IDE_TIME)
 
 #define IDE_ATAPI_IS_EARLY             ide->sc->pad0
 
@@ -788,6 +792,36 @@ ide_next_sector(ide_t *ide)
     ide->tf->head   = head & 0x0f;
 }
 
+/* Wait for a read queued by ide_hdd_read_start(), returns its status. */
+static int
+ide_hdd_read_finish(ide_t *ide)
+{
+    if (!ide->io_pending)
+        return 0;
+
+    ide->io_pending = 0;
+
+    return hdd_image_read_result(ide->hdd_num);
+}
+
+/*
+ * With asynchronous disk I/O, start reading the sectors of the command just
+ * issued while the emulated seek runs, ide_callback() picks them up.
+ */
+static void
+ide_hdd_read_start(ide_t *ide)
+{
+    ide_hdd_read_finish(ide);
+
+    if (!hdd_image_async)
+        return;
+
+    ide->io_pending = 1;
+    if (hdd_image_read_async(ide->hdd_num, ide_get_sector(ide),
+                             ide->tf->secount ? ide->tf->secount : 256, ide->sector_buffer) < 0)
+        ide->io_pending = 0;
+}
+
 static void
 loadhd(ide_t *ide, int d, UNUSED(const char *fn))
 {
@@ -1588,6 +1622,9 @@ ide_reset_registers(ide_t *ide)
 
     ide->reset        = 0;
 
+    /* A read queued for the aborted command must not land after the reset. */
+    ide_hdd_read_finish(ide);
+
     if (ide->type == IDE_ATAPI)
         ide->sc->callback       = 0.0;
 
@@ -1796,6 +1833,7 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
                         } else if ((val == WIN_READ_MULTIPLE) && (hdd[ide->hdd_num].speed_preset == 0)) {
                            ide_set_callback(ide, 200.0 * IDE_TIME);
                            ide->do_initial_read = 1;
+                           ide_hdd_read_start(ide);
                            break;
                         } else if ((val == WIN_READ_MULTIPLE) && (ide->blocksize > 0)) {
                             sec_count = ide->tf->secount ? ide->tf->secount : 256;
@@ -1818,6 +1856,8 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
                     } else
                         ide_set_callback(ide, 200.0 * IDE_TIME);
                     ide->do_initial_read = 1;
+                    if (ide->type == IDE_HDD)
+                        ide_hdd_read_start(ide);
                     break;
 
                 case WIN_WRITE_MULTIPLE:
@@ -1841,6 +1881,8 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
                 case WIN_IDENTIFY:     /* Identify Device */
                 case WIN_SET_FEATURES: /* Set Features */
                 case WIN_READ_NATIVE_MAX:
+                case WIN_FLUSH_CACHE:
+                case WIN_FLUSH_CACHE_EXT:
                     ide->tf->atastat = BSY_STAT;
 
                     if (ide->type == IDE_ATAPI)
@@ -2353,10 +2395,17 @@ ide_callback(void *priv)
                 err = IDNF_ERR;
             else {
                 if (ide->do_initial_read) {
+                    if (ide->io_pending && hdd_image_busy(ide->hdd_num)) {
+                        ide_set_callback(ide, IDE_IO_POLL_TIME);
+                        return;
+                    }
                     ide->do_initial_read = 0;
                     ide->sector_pos      = 0;
-                    ret = hdd_image_read(ide->hdd_num, ide_get_sector(ide),
-                                         ide->tf->secount ? ide->tf->secount : 256, ide->sector_buffer);
+                    if (ide->io_pending)
+                        ret = ide_hdd_read_finish(ide);
+                    else
+                        ret = hdd_image_read(ide->hdd_num, ide_get_sector(ide),
+                                             ide->tf->secount ? ide->tf->secount : 256, ide->sector_buffer);
                 } else
                     ret = 0;
 
@@ -2394,7 +2443,17 @@ ide_callback(void *priv)
 
                 ide->tf->pos = 0;
 
-                if (hdd_image_read(ide->hdd_num, ide_get_sector(ide), ide->sector_pos, ide->sector_buffer) < 0) {
+                if (ide->io_pending && hdd_image_busy(ide->hdd_num)) {
+                    ide_set_callback(ide, IDE_IO_POLL_TIME);
+                    return;
+                }
+
+                if (ide->io_pending)
+                    ret = ide_hdd_read_finish(ide);
+                else
+                    ret = hdd_image_read(ide->hdd_num, ide_get_sector(ide), ide->sector_pos, ide->sector_buffer);
+
+                if (ret < 0) {
                     ide_log("IDE %i: DMA read aborted (image read error)\n", ide->channel);
                     err = UNC_ERR;
                 } else if (!ide_boards[ide->board]->force_ata3 && bm->dma) {
@@ -2438,10 +2497,17 @@ ide_callback(void *priv)
                 err = IDNF_ERR;
             else {
                 if (ide->do_initial_read) {
+                    if (ide->io_pending && hdd_image_busy(ide->hdd_num)) {
+                        ide_set_callback(ide, IDE_IO_POLL_TIME);
+                        return;
+                    }
                     ide->do_initial_read = 0;
                     ide->sector_pos      = 0;
-                    ret = hdd_image_read(ide->hdd_num, ide_get_sector(ide),
-                                         ide->tf->secount ? ide->tf->secount : 256, ide->sector_buffer);
+                    if (ide->io_pending)
+                        ret = ide_hdd_read_finish(ide);
+                    else
+                        ret = hdd_image_read(ide->hdd_num, ide_get_sector(ide),
+                                             ide->tf->secount ? ide->tf->secount : 256, ide->sector_buffer);
                 } else {
                     ret = 0;
                 }
@@ -2475,7 +2541,7 @@ ide_callback(void *priv)
                 err = IDNF_ERR;
             else {
                 ui_sb_update_icon_write(SB_HDD | hdd[ide->hdd_num].bus_type, 1);
-                ret = hdd_image_write(ide->hdd_num, ide_get_sector(ide), 1, (uint8_t *) ide->buffer);
+                ret = hdd_image_write_async(ide->hdd_num, ide_get_sector(ide), 1, (uint8_t *) ide->buffer);
                 ide_irq_raise(ide);
                 ide->tf->secount--;
                 if (ide->tf->secount) {
@@ -2506,6 +2572,9 @@ ide_callback(void *priv)
                     else
                         ide->sector_pos = 256;
 
+                    /* Do not let a stale queued read land on top of the data. */
+                    ide_hdd_read_finish(ide);
+
                     ret = bm->dma(ide->sector_buffer, ide->sector_pos * 512, 0, 1, bm->priv);
 
                     if (ret == 2) {
@@ -2516,8 +2585,8 @@ ide_callback(void *priv)
                     } else if (ret & 1) {
                         /* DMA successful */
                         ui_sb_update_icon_write(SB_HDD | hdd[ide->hdd_num].bus_type, 1);
-                        ret = hdd_image_write(ide->hdd_num, ide_get_sector(ide),
-                                              ide->sector_pos, ide->sector_buffer);
+                        ret = hdd_image_write_async(ide->hdd_num, ide_get_sector(ide),
+                                                    ide->sector_pos, ide->sector_buffer);
 
                         ide_log("IDE %i: DMA write %ssuccessful\n", ide->channel, (ret < 0) ? "un" : "");
 
@@ -2550,12 +2619,18 @@ ide_callback(void *priv)
             else if (!ide->tf->lba && (ide->cfg_spt == 0))
                 err = IDNF_ERR;
             else {
-                ret = hdd_image_write(ide->hdd_num, ide_get_sector(ide), 1, (uint8_t *) ide->buffer);
+                /* Gather the block and write it with a single request once it is complete. */
+                if (!ide->blockcount)
+                    ide_hdd_read_finish(ide);
+                memcpy(&ide->sector_buffer[ide->blockcount << 9], ide->buffer, 512);
                 ide->blockcount++;
                 if (ide->blockcount >= ide->blocksize || ide->tf->secount == 1) {
+                    ret = hdd_image_write_async(ide->hdd_num, ide_get_sector(ide) - (ide->blockcount - 1),
+                                                ide->blockcount, ide->sector_buffer);
                     ide->blockcount = 0;
                     ide_irq_raise(ide);
-                }
+                } else
+                    ret = 0;
                 ide->tf->secount--;
                 if (ide->tf->secount) {
                     ide->tf->atastat = DRQ_STAT | DRDY_STAT | DSC_STAT;
@@ -2656,6 +2731,18 @@ ide_callback(void *priv)
             }
             break;
 
+        case WIN_FLUSH_CACHE:
+        case WIN_FLUSH_CACHE_EXT:
+            if (ide->type != IDE_HDD)
+                err = ABRT_ERR;
+            else if (hdd_image_flush(ide->hdd_num) < 0)
+                err = UNC_ERR;
+            else {
+                ide->tf->atastat = DRDY_STAT | DSC_STAT;
+                ide_irq_raise(ide);
+            }
+            break;
+
         case WIN_READ_NATIVE_MAX:
             if (ide->type == IDE_HDD) {
                 int snum = hdd[ide->hdd_num].spt;
@@ -3204,6 +3291,8 @@ ide_drive_reset(int d)
 
     ide_set_signature(ide_drives[d]);
 
+    ide_hdd_read_finish(ide_drives[d]);
+
     if (ide_drives[d]->sector_buffer)
         memset(ide_drives[d]->sector_buffer, 0, 256 * 512);
 
@@ -24,14 +24,23 @@
 #include <time.h>
 #include <wchar.h>
 #include <errno.h>
-#ifdef __unix__
+#include <inttypes.h>
+#if defined(__unix__) || defined(__APPLE__)
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define USE_HDD_MMAP
+#endif
+#ifdef __linux__
+#include <fcntl.h>
 #endif
 #define HAVE_STDARG_H
 #include <86box/86box.h>
 #include <86box/path.h>
 #include <86box/plat.h>
 #include <86box/random.h>
+#include <86box/thread.h>
+#include <86box/timer.h>
 #include <86box/hdd.h>
 #include "minivhd/minivhd.h"
 #include "minivhd/internal.h"
@@ -40,19 +49,94 @@
 #define HDD_IMAGE_HDI 1
 #define HDD_IMAGE_HDX 2
 #define HDD_IMAGE_VHD 3
+#define HDD_IMAGE_HDZ 4
+
+#define HDD_IO_QUEUE  32 /* Must be a power of 2. */
+#define HDD_IO_FLUSH  0xff /* Queued periodic write-back, next to HDD_OP_READ and HDD_OP_WRITE. */
+
+#define HDD_CACHE_SHIFT    6 /* 64 sectors (32 kB) per cache block. */
+#define HDD_CACHE_SECTORS  (1 << HDD_CACHE_SHIFT)
+#define HDD_CACHE_MASK     (HDD_CACHE_SECTORS - 1)
+#define HDD_CACHE_FLUSH_MS 5000 /* Write-back: write dirty blocks at least this often. */
+
+typedef struct hdd_cache_blk_t {
+    uint32_t block; /* First sector >> HDD_CACHE_SHIFT */
+    int32_t  prev;  /* LRU list, most recently used first */
+    int32_t  next;  /* LRU list, or free list */
+    int32_t  hnext; /* Hash chain */
+    uint64_t valid; /* One bit per sector */
+    uint64_t dirty;
+    uint8_t *data;
+} hdd_cache_blk_t;
+
+typedef struct hdd_image_cache_t {
+    hdd_cache_blk_t *blks;
+    int32_t         *hash;
+    uint32_t         hash_mask;
+    int32_t          lru_head;
+    int32_t          lru_tail;
+    int32_t          free;
+    int              writeback;
+    uint32_t         last_flush;
+    uint8_t         *mem;
+} hdd_image_cache_t;
+
+typedef struct hdd_image_req_t {
+    uint8_t  op; /* HDD_OP_READ, HDD_OP_WRITE or HDD_IO_FLUSH */
+    uint32_t sector;
+    uint32_t count;
+    uint8_t *buffer; /* The caller's buffer for reads, data for writes. */
+    uint8_t *data;   /* Private copy of the data for writes. */
+    uint32_t data_size;
+} hdd_image_req_t;
 
 typedef struct hdd_image_t {
     FILE     *file; /* Used for HDD_IMAGE_RAW, HDD_IMAGE_HDI, and HDD_IMAGE_HDX. */
     MVHDMeta *vhd;  /* Used for HDD_IMAGE_VHD. */
     uint32_t  base;
-    uint32_t  pos;
+    uint32_t  pos; /* Sector after the last request, only set by the emulation thread. */
     uint32_t  last_sector;
-    uint8_t   type; /* HDD_IMAGE_RAW, HDD_IMAGE_HDI, HDD_IMAGE_HDX, or HDD_IMAGE_VHD */
+    uint8_t   type; /* HDD_IMAGE_RAW, HDD_IMAGE_HDI, HDD_IMAGE_HDX, HDD_IMAGE_VHD, or HDD_IMAGE_HDZ */
     uint8_t   loaded;
+    uint8_t   cache_init;
+
+    hdd_image_cache_t *cache;
+    pc_timer_t         cache_timer; /* Write-back, so dirty blocks don't wait for the next I/O. */
+    hdd_overlay_t     *overlay;
+    hdd_packed_t      *packed; /* Used for HDD_IMAGE_HDZ. */
+
+    /* Mapping of the whole image file, for HDD_IMAGE_RAW, HDD_IMAGE_HDI, and HDD_IMAGE_HDX. */
+    uint8_t  *map;
+    uint64_t  map_size;
+    int       map_writable;
+    uint32_t  map_next; /* Sector after the previous read, to spot sequential reads. */
+
+    /* Requests queued to the I/O thread, owned by it from io_tail to io_head. */
+    thread_t       *io_thread;
+    event_t        *io_wake;
+    event_t        *io_done;
+    mutex_t        *io_mutex;
+    hdd_image_req_t io_queue[HDD_IO_QUEUE];
+    uint32_t        io_head;
+    uint32_t        io_tail;
+    int             io_stop;
+    int             io_read_error;
+    int             io_write_error;
 } hdd_image_t;
 
 hdd_image_t hdd_images[HDD_NUM];
 
+int hdd_image_async = 0; /* (C) queue IDE and SCSI disk I/O to a host thread */
+
+static void hdd_image_io_sync(uint8_t id);
+static void hdd_image_io_stop(uint8_t id);
+static int  hdd_image_do_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+static int  hdd_image_cache_flush(uint8_t id);
+static void hdd_image_cache_timer(void *priv);
+static void hdd_image_cache_close(uint8_t id);
+static void hdd_image_overlay_close(uint8_t id);
+static void hdd_image_unmap(uint8_t id);
+
 static char  empty_sector[512];
 #ifndef __unix__
 static char *empty_sector_1mb;
@@ -248,8 +332,8 @@ hdd_image_init(void)
         memset(&hdd_images[i], 0, sizeof(hdd_image_t));
 }
 
-int
-hdd_image_load(int id)
+static int
+hdd_image_load_image(int id)
 {
     uint32_t sector_size = 512;
     uint32_t zero        = 0;
@@ -264,6 +348,8 @@ hdd_image_load(int id)
     int      is_hdx[2] = { 0, 0 };
     int      is_vhd[2] = { 0, 0 };
     int      vhd_error = 0;
+    /* With an overlay, the base image is only written to when committing it. */
+    int      read_only = (hdd[id].overlay != HDD_OVERLAY_NONE) && (hdd[id].overlay != HDD_OVERLAY_COMMIT);
 
     memset(empty_sector, 0, sizeof(empty_sector));
     if (fn) {
@@ -272,6 +358,11 @@ hdd_image_load(int id)
 
     hdd_images[id].base = 0;
 
+    hdd_image_io_stop(id);
+    hdd_image_cache_close(id);
+    hdd_image_overlay_close(id);
+    hdd_image_unmap(id);
+
     if (hdd_images[id].loaded) {
         if (hdd_images[id].file) {
             fclose(hdd_images[id].file);
@@ -279,6 +370,9 @@ hdd_image_load(int id)
         } else if (hdd_images[id].vhd) {
             mvhd_close(hdd_images[id].vhd);
             hdd_images[id].vhd = NULL;
+        } else if (hdd_images[id].packed) {
+            hdd_packed_close(hdd_images[id].packed);
+            hdd_images[id].packed = NULL;
         }
         hdd_images[id].loaded = 0;
     }
@@ -297,14 +391,27 @@ hdd_image_load(int id)
         memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
         goto fail_raw;
     }
-    hdd_images[id].file = plat_fopen(fn, "rb+");
+    /* Packed images are read-only, their writes all go to the overlay. */
+    if (image_is_hdz(fn, 1)) {
+        hdd_images[id].packed = hdd_packed_open(fn);
+        if (hdd_images[id].packed == NULL) {
+            memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+            goto fail_raw;
+        }
+        hdd_packed_get_geometry(hdd_images[id].packed, &hdd[id].spt, &hdd[id].hpc, &hdd[id].tracks);
+        hdd_images[id].type        = HDD_IMAGE_HDZ;
+        hdd_images[id].last_sector = hdd_packed_get_sectors(hdd_images[id].packed) - 1;
+        hdd_images[id].loaded      = 1;
+        return 1;
+    }
+    hdd_images[id].file = plat_fopen(fn, read_only ? "rb" : "rb+");
     if (hdd_images[id].file == NULL) {
         /* Failed to open existing hard disk image */
         if (errno == ENOENT) {
             /* Failed because it does not exist,
                so try to create new file */
-            if (hdd[id].wp) {
-                hdd_image_log("A write-protected image must exist\n");
+            if (hdd[id].wp || (hdd[id].overlay != HDD_OVERLAY_NONE)) {
+                hdd_image_log("A write-protected or overlaid image must exist\n");
                 memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
                 goto fail_raw;
             }
@@ -343,6 +450,7 @@ hdd_image_load(int id)
                     hdd_images[id].type = HDD_IMAGE_HDX;
                 } else if (is_vhd[0]) {
                     fclose(hdd_images[id].file);
+                    hdd_images[id].file = NULL;
                     MVHDGeom geometry = { 0 };
                     geometry.cyl               = hdd[id].tracks;
                     geometry.heads             = hdd[id].hpc;
@@ -377,7 +485,9 @@ retry_vhd:
                         }
                         fatal("hdd_image_load(): VHD: Could not create VHD : %s\n", mvhd_strerr(vhd_error));
                     }
-                    hdd_images[id].type = HDD_IMAGE_VHD;
+                    hdd_images[id].type   = HDD_IMAGE_VHD;
+                    /* So that closing it writes the BAT and bitmaps back. */
+                    hdd_images[id].loaded = 1;
 
                     return 1;
                 } else {
@@ -464,7 +574,7 @@ fail_raw:
         } else if (is_vhd[1]) {
             fclose(hdd_images[id].file);
             hdd_images[id].file = NULL;
-            hdd_images[id].vhd  = mvhd_open(fn, (bool) 0, &vhd_error);
+            hdd_images[id].vhd  = mvhd_open(fn, read_only, &vhd_error);
             if (hdd_images[id].vhd == NULL) {
                 if (vhd_error == MVHD_ERR_FILE)
                     fatal("hdd_image_load(): VHD: Error opening VHD file '%s': %s\n", fn, strerror(mvhd_errno));
@@ -497,7 +607,8 @@ fail_raw:
     if (fseeko64(hdd_images[id].file, 0, SEEK_END) == -1)
         fatal("hdd_image_load(): Error seeking to the end of file\n");
     s = ftello64(hdd_images[id].file);
-    if (s < (full_size + hdd_images[id].base))
+    /* A short base image under an overlay reads as zeroes past its end. */
+    if ((s < (full_size + hdd_images[id].base)) && (hdd[id].overlay == HDD_OVERLAY_NONE))
         ret = prepare_new_hard_disk(id, full_size);
     else {
         hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
@@ -508,14 +619,240 @@ fail_raw:
     return ret;
 }
 
+static int hdd_image_base_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+static int hdd_image_base_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+
+static int
+hdd_image_overlay_base_read(void *priv, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    return hdd_image_base_read((hdd_image_t *) priv - hdd_images, sector, count, buffer);
+}
+
+static int
+hdd_image_overlay_base_write(void *priv, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    return hdd_image_base_write((hdd_image_t *) priv - hdd_images, sector, count, buffer);
+}
+
+/*
+ * Memory-mapped images.
+ *
+ * With hdd[id].mmap set, raw, HDI and HDX images are mapped whole and
+ * reads and writes become copies to and from the mapping, without any
+ * system calls once the pages are in. Writes land in the host page cache
+ * just like fwrite() followed by fflush() would. Sequential reads get the
+ * range after them prefetched, as much again as the guest asked for,
+ * so large transfers do not fault a page at a time.
+ *
+ * Sparse images are mapped read-only and written through the file, since
+ * a store into a hole faults with SIGBUS instead of failing when the host
+ * disk is full.
+ */
+static void
+hdd_image_map(uint8_t id)
+{
+#ifdef USE_HDD_MMAP
+    hdd_image_t *img = &hdd_images[id];
+    uint64_t     size;
+    void        *map;
+    struct stat  st;
+    int          prot = PROT_READ;
+
+    if (!hdd[id].mmap || !img->loaded || (img->file == NULL) || (img->type == HDD_IMAGE_VHD))
+        return;
+
+    size = (((uint64_t) img->last_sector + 1) << 9) + img->base;
+    if ((sizeof(size_t) < 8) && (size > 0x40000000ULL)) {
+        hdd_image_log("Hard disk image %i: Too large to map\n", id);
+        return;
+    }
+
+    /* Write access is only needed and granted where the file was opened for it. */
+    if ((hdd[id].overlay == HDD_OVERLAY_NONE) || (hdd[id].overlay == HDD_OVERLAY_COMMIT))
+        prot |= PROT_WRITE;
+
+    if ((fseeko64(img->file, 0, SEEK_END) == -1) || ((uint64_t) ftello64(img->file) < size)) {
+        hdd_image_log("Hard disk image %i: Shorter than the disk, not mapping it\n", id);
+        return;
+    }
+
+    fflush(img->file);
+    if ((prot & PROT_WRITE) && (fstat(fileno(img->file), &st) == 0) &&
+        (((uint64_t) st.st_blocks << 9) < (uint64_t) st.st_size)) {
+        hdd_image_log("Hard disk image %i: Sparse, writing through the file\n", id);
+        prot &= ~PROT_WRITE;
+    }
+
+    map = mmap(NULL, (size_t) size, prot, MAP_SHARED, fileno(img->file), 0);
+    if (map == MAP_FAILED) {
+        pclog("Hard disk image %i: Unable to map the image: %s\n", id, strerror(errno));
+        return;
+    }
+
+#    ifdef MADV_RANDOM
+    /* The guest file system decides what is sequential, see hdd_image_map_advise(). */
+    madvise(map, (size_t) size, MADV_RANDOM);
+#    endif
+
+    img->map          = (uint8_t *) map;
+    img->map_size     = size;
+    img->map_writable = !!(prot & PROT_WRITE);
+    img->map_next     = 0xffffffff;
+
+    hdd_image_log("Hard disk image %i: Mapped %" PRIu64 " bytes\n", id, size);
+#else
+    (void) id;
+#endif
+}
+
+static void
+hdd_image_unmap(uint8_t id)
+{
+#ifdef USE_HDD_MMAP
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->map == NULL)
+        return;
+
+    if (img->map_writable)
+        msync(img->map, (size_t) img->map_size, MS_ASYNC);
+    munmap(img->map, (size_t) img->map_size);
+
+    img->map      = NULL;
+    img->map_size = 0;
+#else
+    (void) id;
+#endif
+}
+
+#ifdef USE_HDD_MMAP
+static void
+hdd_image_map_advise(hdd_image_t *img, uint32_t sector, uint32_t count)
+{
+#    ifdef MADV_WILLNEED
+    static long page_mask = 0;
+    uint64_t    start;
+    uint64_t    end;
+
+    if (page_mask == 0)
+        page_mask = sysconf(_SC_PAGESIZE) - 1;
+
+    if (sector == img->map_next) {
+        start = (((uint64_t) sector + count) << 9) + img->base;
+        end   = start + ((uint64_t) count << 9);
+        if (end > img->map_size)
+            end = img->map_size;
+        start &= ~(uint64_t) page_mask;
+        if (start < end)
+            madvise(img->map + start, (size_t) (end - start), MADV_WILLNEED);
+    }
+#    endif
+
+    img->map_next = sector + count;
+}
+#endif
+
+/* Packed images can not be written to, their changes are always kept in the overlay. */
+static int
+hdd_image_overlay_mode(uint8_t id)
+{
+    if ((hdd_images[id].type == HDD_IMAGE_HDZ) &&
+        ((hdd[id].overlay == HDD_OVERLAY_NONE) || (hdd[id].overlay == HDD_OVERLAY_COMMIT)))
+        return HDD_OVERLAY_KEEP;
+
+    return hdd[id].overlay;
+}
+
+/*
+ * Put a copy-on-write overlay in front of the image. It lives in the
+ * machine's directory, so several machines can share one base image.
+ */
+static int
+hdd_image_overlay_open(uint8_t id)
+{
+    char fn[1024];
+    char name[16];
+    int  mode = hdd_image_overlay_mode(id);
+
+    if ((mode == HDD_OVERLAY_NONE) || !hdd_images[id].loaded)
+        return 1;
+
+    sprintf(name, "hdd_%02i.ovl", id + 1);
+    path_append_filename(fn, usr_path, name);
+
+    hdd_images[id].overlay = hdd_overlay_open(fn, hdd_images[id].last_sector + 1,
+                                              mode == HDD_OVERLAY_KEEP,
+                                              hdd_image_overlay_base_read,
+                                              (mode == HDD_OVERLAY_COMMIT) ? hdd_image_overlay_base_write : NULL,
+                                              &hdd_images[id]);
+
+    /* Rather no disk at all than writes to a base image meant to stay untouched. */
+    if (hdd_images[id].overlay == NULL) {
+        pclog("Hard disk image %i: Unable to create overlay %s\n", id, fn);
+        return 0;
+    }
+
+    return 1;
+}
+
+static void
+hdd_image_overlay_close(uint8_t id)
+{
+    int discard;
+
+    if (hdd_images[id].overlay == NULL)
+        return;
+
+    switch (hdd_image_overlay_mode(id)) {
+        case HDD_OVERLAY_COMMIT:
+            /* Keep the overlay around if it could not be written back. */
+            discard = (hdd_overlay_commit(hdd_images[id].overlay) == 0);
+            if (hdd_images[id].file != NULL)
+                fflush(hdd_images[id].file);
+            break;
+        case HDD_OVERLAY_KEEP:
+            discard = 0;
+            break;
+        default:
+            discard = 1;
+            break;
+    }
+
+    hdd_overlay_close(hdd_images[id].overlay, discard);
+    hdd_images[id].overlay = NULL;
+}
+
+int
+hdd_image_load(int id)
+{
+    int ret = hdd_image_load_image(id);
+
+    if (ret > 0)
+        hdd_image_map(id);
+
+    if ((ret > 0) && hdd[id].cache_size && hdd[id].cache_writeback) {
+        timer_add(&hdd_images[id].cache_timer, hdd_image_cache_timer, &hdd_images[id], 0);
+        timer_on_auto(&hdd_images[id].cache_timer, HDD_CACHE_FLUSH_MS * 1000.0);
+    }
+
+    if ((ret > 0) && !hdd_image_overlay_open(id)) {
+        hdd_image_close(id);
+        ret = 0;
+    }
+
+    return ret;
+}
+
 int
 hdd_image_seek(uint8_t id, uint32_t sector)
 {
     off64_t addr = sector;
     addr         = (uint64_t) sector << 9LL;
 
+    hdd_image_io_sync(id);
+
     hdd_images[id].pos = sector;
-    if (hdd_images[id].type != HDD_IMAGE_VHD) {
+    if ((hdd_images[id].type != HDD_IMAGE_VHD) && (hdd_images[id].type != HDD_IMAGE_HDZ)) {
         if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, addr + hdd_images[id].base, SEEK_SET) == -1)) {
             hdd_image_log("hdd_image_seek(): Error seeking\n");
             return -1;
@@ -525,28 +862,37 @@ hdd_image_seek(uint8_t id, uint32_t sector)
     return 0;
 }
 
-int
-hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+static int
+hdd_image_base_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
-    int    non_transferred_sectors;
     size_t num_read;
 
     if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error = 0;
-        non_transferred_sectors   = mvhd_read_sectors(hdd_images[id].vhd, sector, count, buffer);
-        hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
+        mvhd_read_sectors(hdd_images[id].vhd, sector, count, buffer);
         if (hdd_images[id].vhd->error)
             return -1;
+    } else if (hdd_images[id].type == HDD_IMAGE_HDZ) {
+        return hdd_packed_read(hdd_images[id].packed, sector, count, buffer);
+    } else if (hdd_images[id].map != NULL) {
+        if ((((uint64_t) sector + count) << 9) + hdd_images[id].base > hdd_images[id].map_size)
+            return -1;
+#ifdef USE_HDD_MMAP
+        hdd_image_map_advise(&hdd_images[id], sector, count);
+#endif
+        memcpy(buffer, hdd_images[id].map + ((uint64_t) sector << 9) + hdd_images[id].base, count << 9);
     } else {
         if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, ((uint64_t) (sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1)) {
             hdd_image_log("Hard disk image %i: Read error during seek\n", id);
             return -1;
         }
 
-        num_read           = fread(buffer, 512, count, hdd_images[id].file);
-        hdd_images[id].pos = sector + num_read;
+        num_read = fread(buffer, 512, count, hdd_images[id].file);
         if ((num_read < count) && !feof(hdd_images[id].file))
             return -1;
+        /* Only a base image under an overlay can be shorter than the disk. */
+        if (num_read < count)
+            memset(buffer + (num_read << 9), 0x00, (count - num_read) << 9);
     }
 
     return 0;
@@ -564,6 +910,16 @@ hdd_sectors(uint8_t id)
     return hdd_image_get_last_sector(id) - 1;
 }
 
+int
+hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_io_sync(id);
+
+    hdd_images[id].pos = sector + count;
+
+    return hdd_image_do_read(id, sector, count, buffer);
+}
+
 int
 hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
@@ -581,27 +937,34 @@ hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     return 0;
 }
 
-int
-hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+static int
+hdd_image_base_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
-    int    non_transferred_sectors;
     size_t num_write;
 
     if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error = 0;
-        non_transferred_sectors   = mvhd_write_sectors(hdd_images[id].vhd, sector, count, buffer);
-        hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
+        mvhd_write_sectors(hdd_images[id].vhd, sector, count, buffer);
         if (hdd_images[id].vhd->error)
             return -1;
+    } else if (hdd_images[id].type == HDD_IMAGE_HDZ) {
+        return -1;
+    } else if ((hdd_images[id].map != NULL) && hdd_images[id].map_writable) {
+        if ((((uint64_t) sector + count) << 9) + hdd_images[id].base > hdd_images[id].map_size)
+            return -1;
+        memcpy(hdd_images[id].map + ((uint64_t) sector << 9) + hdd_images[id].base, buffer, count << 9);
     } else {
         if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, ((uint64_t) (sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1)) {
             hdd_image_log("Hard disk image %i: Write error during seek\n", id);
             return -1;
         }
 
-        num_write          = fwrite(buffer, 512, count, hdd_images[id].file);
-        hdd_images[id].pos = sector + num_write;
-        fflush(hdd_images[id].file);
+        num_write = fwrite(buffer, 512, count, hdd_images[id].file);
+        /* In write-back mode, hdd_image_cache_flush() flushes once per batch,
+           unless reads come from a mapping, which only sees flushed data. */
+        if (((hdd_images[id].map != NULL) || (hdd_images[id].cache == NULL) || !hdd_images[id].cache->writeback) &&
+            fflush(hdd_images[id].file))
+            return -1;
         if (num_write < count)
             return -1;
     }
@@ -609,6 +972,427 @@ hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     return 0;
 }
 
+/* Everything above the image itself goes through these, they add the overlay. */
+static int
+hdd_image_raw_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    if (hdd_images[id].overlay == NULL)
+        return hdd_image_base_read(id, sector, count, buffer);
+
+    return hdd_overlay_read(hdd_images[id].overlay, sector, count, buffer);
+}
+
+static int
+hdd_image_raw_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    if (hdd_images[id].overlay == NULL)
+        return hdd_image_base_write(id, sector, count, buffer);
+
+    return hdd_overlay_write(hdd_images[id].overlay, sector, count, buffer);
+}
+
+/*
+ * Host block cache.
+ *
+ * An LRU cache of 32 kB blocks in front of the image, sized per disk
+ * (hdd[id].cache_size, in MB). Reads are served from it and fill whole
+ * blocks, which doubles as readahead. In write-through mode every write
+ * still goes to the image right away. In write-back mode, writes only
+ * land in the cache and reach the image when their block is evicted,
+ * every HDD_CACHE_FLUSH_MS (from a timer, even if the disk sits idle),
+ * on a guest cache flush command and when the
+ * image is closed; data written since the last flush is lost if the
+ * host crashes, which is fine for throwaway images.
+ *
+ * Only the thread currently allowed to touch the image (see the
+ * asynchronous I/O comment) uses the cache, so it needs no locking.
+ */
+static void
+hdd_image_cache_open(uint8_t id)
+{
+    hdd_image_t       *img = &hdd_images[id];
+    hdd_image_cache_t *c;
+    uint32_t           nr;
+    uint32_t           max_nr;
+    uint32_t           hash_size = 1;
+
+    img->cache_init = 1;
+
+    if (hdd[id].cache_size == 0)
+        return;
+
+    nr     = hdd[id].cache_size << (20 - 9 - HDD_CACHE_SHIFT);
+    max_nr = (img->last_sector >> HDD_CACHE_SHIFT) + 1;
+    if (nr > max_nr)
+        nr = max_nr;
+
+    while (hash_size < nr)
+        hash_size <<= 1;
+
+    c = (hdd_image_cache_t *) calloc(1, sizeof(hdd_image_cache_t));
+    if (c == NULL)
+        return;
+    c->blks = (hdd_cache_blk_t *) calloc(nr, sizeof(hdd_cache_blk_t));
+    c->hash = (int32_t *) malloc(hash_size * sizeof(int32_t));
+    c->mem  = (uint8_t *) malloc((size_t) nr << (HDD_CACHE_SHIFT + 9));
+    if ((c->blks == NULL) || (c->hash == NULL) || (c->mem == NULL)) {
+        hdd_image_log("Hard disk image %i: Unable to allocate %u MB of cache\n", id, hdd[id].cache_size);
+        free(c->mem);
+        free(c->hash);
+        free(c->blks);
+        free(c);
+        return;
+    }
+
+    memset(c->hash, 0xff, hash_size * sizeof(int32_t));
+    c->hash_mask = hash_size - 1;
+    c->lru_head  = -1;
+    c->lru_tail  = -1;
+    c->writeback = !!hdd[id].cache_writeback;
+
+    for (uint32_t i = 0; i < nr; i++) {
+        c->blks[i].data = c->mem + ((size_t) i << (HDD_CACHE_SHIFT + 9));
+        c->blks[i].next = (i + 1 < nr) ? (int32_t) (i + 1) : -1;
+    }
+    c->free       = 0;
+    c->last_flush = plat_get_ticks();
+
+    img->cache = c;
+
+    hdd_image_log("Hard disk image %i: %u blocks of cache, write-%s\n",
+                  id, nr, c->writeback ? "back" : "through");
+}
+
+static void
+hdd_image_cache_unlink(hdd_image_cache_t *c, int32_t i)
+{
+    hdd_cache_blk_t *blk = &c->blks[i];
+
+    if (blk->prev >= 0)
+        c->blks[blk->prev].next = blk->next;
+    else
+        c->lru_head = blk->next;
+
+    if (blk->next >= 0)
+        c->blks[blk->next].prev = blk->prev;
+    else
+        c->lru_tail = blk->prev;
+}
+
+static void
+hdd_image_cache_push(hdd_image_cache_t *c, int32_t i)
+{
+    hdd_cache_blk_t *blk = &c->blks[i];
+
+    blk->prev = -1;
+    blk->next = c->lru_head;
+    if (c->lru_head >= 0)
+        c->blks[c->lru_head].prev = i;
+    else
+        c->lru_tail = i;
+    c->lru_head = i;
+}
+
+static void
+hdd_image_cache_unhash(hdd_image_cache_t *c, int32_t i)
+{
+    int32_t *p = &c->hash[c->blks[i].block & c->hash_mask];
+
+    while (*p != i)
+        p = &c->blks[*p].hnext;
+    *p = c->blks[i].hnext;
+}
+
+static int
+hdd_image_cache_write_back(uint8_t id, hdd_cache_blk_t *blk)
+{
+    uint32_t first = blk->block << HDD_CACHE_SHIFT;
+    int      ret   = 0;
+    int      start;
+    int      end;
+
+    /* Write each run of dirty sectors with a single call. */
+    for (start = 0; start < HDD_CACHE_SECTORS; start = end) {
+        if (!(blk->dirty & (1ULL << start))) {
+            end = start + 1;
+            continue;
+        }
+        for (end = start + 1; (end < HDD_CACHE_SECTORS) && (blk->dirty & (1ULL << end)); end++)
+            ;
+        if (hdd_image_raw_write(id, first + start, end - start, blk->data + (start << 9)) < 0)
+            ret = -1;
+    }
+
+    blk->dirty = 0;
+
+    return ret;
+}
+
+/* Find the block, or recycle the least recently used one for it. */
+static hdd_cache_blk_t *
+hdd_image_cache_get(uint8_t id, uint32_t block)
+{
+    hdd_image_cache_t *c = hdd_images[id].cache;
+    hdd_cache_blk_t   *blk;
+    int32_t            i;
+
+    for (i = c->hash[block & c->hash_mask]; i >= 0; i = c->blks[i].hnext) {
+        if (c->blks[i].block == block) {
+            hdd_image_cache_unlink(c, i);
+            hdd_image_cache_push(c, i);
+            return &c->blks[i];
+        }
+    }
+
+    if (c->free >= 0) {
+        i       = c->free;
+        c->free = c->blks[i].next;
+    } else {
+        i = c->lru_tail;
+        hdd_image_cache_unlink(c, i);
+        hdd_image_cache_unhash(c, i);
+        if (c->blks[i].dirty && (hdd_image_cache_write_back(id, &c->blks[i]) < 0))
+            hdd_image_log("Hard disk image %i: Write-back of block %08X failed\n", id, c->blks[i].block);
+    }
+
+    blk        = &c->blks[i];
+    blk->block = block;
+    blk->valid = 0;
+    blk->dirty = 0;
+    blk->hnext = c->hash[block & c->hash_mask];
+
+    c->hash[block & c->hash_mask] = i;
+    hdd_image_cache_push(c, i);
+
+    return blk;
+}
+
+/* Read the sectors of a block that are not in the cache yet. */
+static int
+hdd_image_cache_fill(uint8_t id, hdd_cache_blk_t *blk)
+{
+    uint32_t first = blk->block << HDD_CACHE_SHIFT;
+    uint32_t count = HDD_CACHE_SECTORS;
+    uint8_t  temp[HDD_CACHE_SECTORS << 9];
+    uint8_t *buf   = blk->valid ? temp : blk->data;
+
+    /* The end of the image, the rest of the block reads as zeroes. */
+    if (first > hdd_images[id].last_sector)
+        count = 0;
+    else if ((first + count - 1) > hdd_images[id].last_sector)
+        count = hdd_images[id].last_sector + 1 - first;
+
+    if ((count > 0) && (hdd_image_raw_read(id, first, count, buf) < 0))
+        return -1;
+    if (count < HDD_CACHE_SECTORS)
+        memset(buf + (count << 9), 0x00, (HDD_CACHE_SECTORS - count) << 9);
+
+    if (blk->valid) {
+        for (int i = 0; i < HDD_CACHE_SECTORS; i++) {
+            if (!(blk->valid & (1ULL << i)))
+                memcpy(blk->data + (i << 9), temp + (i << 9), 512);
+        }
+    }
+
+    blk->valid = 0xffffffffffffffffULL;
+
+    return 0;
+}
+
+static uint64_t
+hdd_image_cache_mask(uint32_t start, uint32_t n)
+{
+    return (n >= 64) ? 0xffffffffffffffffULL : (((1ULL << n) - 1) << start);
+}
+
+static int
+hdd_image_cache_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_cache_blk_t *blk;
+    uint32_t         start;
+    uint32_t         n;
+    uint64_t         mask;
+
+    while (count > 0) {
+        start = sector & HDD_CACHE_MASK;
+        n     = MIN(count, HDD_CACHE_SECTORS - start);
+        mask  = hdd_image_cache_mask(start, n);
+
+        blk = hdd_image_cache_get(id, sector >> HDD_CACHE_SHIFT);
+        if (((blk->valid & mask) != mask) && (hdd_image_cache_fill(id, blk) < 0))
+            return -1;
+
+        memcpy(buffer, blk->data + (start << 9), n << 9);
+
+        sector += n;
+        count -= n;
+        buffer += n << 9;
+    }
+
+    return 0;
+}
+
+static int
+hdd_image_cache_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_cache_t *c = hdd_images[id].cache;
+    hdd_cache_blk_t   *blk;
+    uint32_t           start;
+    uint32_t           n;
+    uint64_t           mask;
+    int                ret = 0;
+
+    if (!c->writeback)
+        ret = hdd_image_raw_write(id, sector, count, buffer);
+
+    while (count > 0) {
+        start = sector & HDD_CACHE_MASK;
+        n     = MIN(count, HDD_CACHE_SECTORS - start);
+        mask  = hdd_image_cache_mask(start, n);
+
+        blk = hdd_image_cache_get(id, sector >> HDD_CACHE_SHIFT);
+        memcpy(blk->data + (start << 9), buffer, n << 9);
+        blk->valid |= mask;
+        if (c->writeback)
+            blk->dirty |= mask;
+
+        sector += n;
+        count -= n;
+        buffer += n << 9;
+    }
+
+    return ret;
+}
+
+/* Write all dirty blocks to the image and the image to the host. */
+static int
+hdd_image_cache_flush(uint8_t id)
+{
+    hdd_image_cache_t *c   = hdd_images[id].cache;
+    int                ret = 0;
+
+    if (c != NULL) {
+        for (int32_t i = c->lru_head; i >= 0; i = c->blks[i].next) {
+            if (c->blks[i].dirty && (hdd_image_cache_write_back(id, &c->blks[i]) < 0))
+                ret = -1;
+        }
+        c->last_flush = plat_get_ticks();
+    }
+
+    if (hdd_images[id].file != NULL)
+        fflush(hdd_images[id].file);
+    else if (hdd_images[id].vhd != NULL)
+        mvhd_flush(hdd_images[id].vhd);
+
+    return ret;
+}
+
+/* Forget the cached copies of a range of sectors, after writing them back. */
+static void
+hdd_image_cache_discard(uint8_t id, uint32_t sector, uint32_t count)
+{
+    hdd_image_cache_t *c = hdd_images[id].cache;
+    uint32_t           first;
+    uint32_t           last;
+    int32_t            i;
+    int32_t            next;
+
+    if ((c == NULL) || (count == 0))
+        return;
+
+    hdd_image_cache_flush(id);
+
+    first = sector >> HDD_CACHE_SHIFT;
+    last  = (sector + count - 1) >> HDD_CACHE_SHIFT;
+
+    for (i = c->lru_head; i >= 0; i = next) {
+        next = c->blks[i].next;
+        if ((c->blks[i].block >= first) && (c->blks[i].block <= last)) {
+            hdd_image_cache_unlink(c, i);
+            hdd_image_cache_unhash(c, i);
+            c->blks[i].next = c->free;
+            c->free         = i;
+        }
+    }
+}
+
+static void
+hdd_image_cache_close(uint8_t id)
+{
+    hdd_image_cache_t *c = hdd_images[id].cache;
+
+    if (c != NULL) {
+        if (hdd_image_cache_flush(id) < 0)
+            pclog("Hard disk image %i: Unable to write back the cache\n", id);
+
+        free(c->mem);
+        free(c->hash);
+        free(c->blks);
+        free(c);
+    }
+
+    hdd_images[id].cache      = NULL;
+    hdd_images[id].cache_init = 0;
+}
+
+/* Write-back, from the I/O path: do not let dirty blocks sit in the cache for too long. */
+static int
+hdd_image_cache_poll(uint8_t id)
+{
+    hdd_image_cache_t *c = hdd_images[id].cache;
+
+    if ((c != NULL) && c->writeback && ((plat_get_ticks() - c->last_flush) >= HDD_CACHE_FLUSH_MS))
+        return hdd_image_cache_flush(id);
+
+    return 0;
+}
+
+static int
+hdd_image_do_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    int ret;
+
+    if (!hdd_images[id].cache_init)
+        hdd_image_cache_open(id);
+
+    if (hdd_images[id].cache == NULL)
+        return hdd_image_raw_read(id, sector, count, buffer);
+
+    ret = hdd_image_cache_read(id, sector, count, buffer);
+    if (hdd_image_cache_poll(id) < 0)
+        hdd_image_log("Hard disk image %i: Periodic write-back failed\n", id);
+
+    return ret;
+}
+
+static int
+hdd_image_do_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    int ret;
+
+    if (!hdd_images[id].cache_init)
+        hdd_image_cache_open(id);
+
+    if (hdd_images[id].cache == NULL)
+        return hdd_image_raw_write(id, sector, count, buffer);
+
+    ret = hdd_image_cache_write(id, sector, count, buffer);
+    if (hdd_image_cache_poll(id) < 0)
+        hdd_image_log("Hard disk image %i: Periodic write-back failed\n", id);
+
+    return ret;
+}
+
+int
+hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_io_sync(id);
+
+    hdd_images[id].pos = sector + count;
+
+    return hdd_image_do_write(id, sector, count, buffer);
+}
+
 int
 hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
@@ -626,35 +1410,125 @@ hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     return 0;
 }
 
-int
-hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
+/*
+ * Zero a range of a raw image, by punching a hole into it where the host allows.
+ * A writable mapping must not get holes under it (see hdd_image_map()), so
+ * there the range is zeroed through the mapping instead.
+ */
+static int
+hdd_image_zero_raw(uint8_t id, uint32_t sector, uint32_t count)
 {
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
-        hdd_images[id].vhd->error   = 0;
-        int non_transferred_sectors = mvhd_format_sectors(hdd_images[id].vhd, sector, count);
-        hdd_images[id].pos          = sector + count - non_transferred_sectors - 1;
-        if (hdd_images[id].vhd->error)
+    uint64_t addr = ((uint64_t) sector << 9LL) + hdd_images[id].base;
+    uint8_t *buf;
+    uint32_t n;
+    int      ret = 0;
+
+    if (!hdd_images[id].file)
+        return -1;
+
+#ifdef USE_HDD_MMAP
+    if ((hdd_images[id].map != NULL) && hdd_images[id].map_writable) {
+        uint64_t page_mask = (uint64_t) sysconf(_SC_PAGESIZE) - 1;
+        uint64_t start     = addr & ~page_mask;
+
+        if (addr + ((uint64_t) count << 9) > hdd_images[id].map_size)
             return -1;
-    } else {
-        memset(empty_sector, 0, 512);
 
-        if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, ((uint64_t) (sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1)) {
-            hdd_image_log("Hard disk image %i: Zero error during seek\n", id);
+        memset(hdd_images[id].map + addr, 0x00, (size_t) count << 9);
+        hdd_images[id].pos = sector + count - 1;
+        if (msync(hdd_images[id].map + start, (size_t) (addr + ((uint64_t) count << 9) - start), MS_ASYNC) == -1)
             return -1;
-        }
+        return fflush(hdd_images[id].file) ? -1 : 0;
+    }
+#endif
 
-        for (uint32_t i = 0; i < count; i++) {
-            if (feof(hdd_images[id].file))
-                break;
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+    /* HDI and HDX images have their header in front of the data, the offset is still sector aligned. */
+    fflush(hdd_images[id].file);
+    if (fallocate(fileno(hdd_images[id].file), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  (off_t) addr, (off_t) count << 9) == 0) {
+        hdd_images[id].pos = sector + count - 1;
+        return 0;
+    }
+#endif
 
-            hdd_images[id].pos = sector + i;
-            if (!fwrite(empty_sector, 512, 1, hdd_images[id].file))
-                return -1;
+    if (fseeko64(hdd_images[id].file, addr, SEEK_SET) == -1) {
+        hdd_image_log("Hard disk image %i: Zero error during seek\n", id);
+        return -1;
+    }
+
+    buf = (uint8_t *) calloc(1, 65536);
+    if (buf == NULL)
+        return -1;
+
+    while (count > 0) {
+        n = MIN(count, 128);
+        if (feof(hdd_images[id].file))
+            break;
+
+        hdd_images[id].pos = sector + n - 1;
+        if (fwrite(buf, 512, n, hdd_images[id].file) != n) {
+            ret = -1;
+            break;
         }
 
-        fflush(hdd_images[id].file);
+        sector += n;
+        count -= n;
     }
 
+    free(buf);
+    /* Reads from a read-only mapping only see what has been flushed. */
+    if (fflush(hdd_images[id].file))
+        ret = -1;
+
+    return ret;
+}
+
+/* The base image must stay untouched, so zeroes get written into the overlay. */
+static int
+hdd_image_zero_overlay(uint8_t id, uint32_t sector, uint32_t count)
+{
+    uint8_t *buf = (uint8_t *) calloc(1, 65536);
+    uint32_t n;
+    int      ret = 0;
+
+    if (buf == NULL)
+        return -1;
+
+    while ((count > 0) && (ret == 0)) {
+        n   = MIN(count, 128);
+        ret = hdd_overlay_write(hdd_images[id].overlay, sector, n, buf);
+
+        sector += n;
+        count -= n;
+    }
+
+    hdd_images[id].pos = sector - 1;
+
+    free(buf);
+
+    return ret;
+}
+
+int
+hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
+{
+    hdd_image_io_sync(id);
+
+    hdd_image_cache_discard(id, sector, count);
+
+    if (hdd_images[id].overlay != NULL) {
+        if (hdd_image_zero_overlay(id, sector, count) < 0)
+            return -1;
+    } else if (hdd_images[id].type == HDD_IMAGE_VHD) {
+        hdd_images[id].vhd->error   = 0;
+        int non_transferred_sectors = mvhd_format_sectors(hdd_images[id].vhd, sector, count);
+        hdd_images[id].pos          = sector + count - non_transferred_sectors - 1;
+        if (hdd_images[id].vhd->error)
+            return -1;
+    } else if (hdd_image_zero_raw(id, sector, count) < 0)
+        return -1;
+
     return 0;
 }
 
@@ -674,6 +1548,312 @@ hdd_image_zero_ex(uint8_t id, uint32_t sector, uint32_t count)
     return 0;
 }
 
+/* Guest cache flush command: make everything written so far reach the host. */
+int
+hdd_image_flush(uint8_t id)
+{
+    if (!hdd_images[id].loaded)
+        return 0;
+
+    hdd_image_io_sync(id);
+
+    return hdd_image_cache_flush(id);
+}
+
+/*
+ * Asynchronous I/O.
+ *
+ * When enabled, the IDE and SCSI disk code hands reads and writes to a
+ * host thread per image instead of doing them on the emulation thread.
+ * Requests complete in order; writes work on a private copy of the data
+ * so the caller can reuse its buffer right away, and a read queued after
+ * a write sees the written data. The emulated drive still takes as long
+ * as hdd_timing_read() and hdd_timing_write() say, the controller only
+ * polls hdd_image_busy() once that time is up, so host latency is hidden
+ * behind the emulated one.
+ *
+ * Everything else (and every synchronous call) first waits for the queue
+ * to drain, so the thread and the emulation thread never use the file at
+ * the same time.
+ */
+static void
+hdd_image_io_thread(void *priv)
+{
+    hdd_image_t     *img = (hdd_image_t *) priv;
+    uint8_t          id  = img - hdd_images;
+    hdd_image_req_t *req;
+    int              ret;
+
+    while (1) {
+        thread_wait_event(img->io_wake, -1);
+        thread_reset_event(img->io_wake);
+
+        while (1) {
+            thread_wait_mutex(img->io_mutex);
+            if (img->io_tail == img->io_head) {
+                thread_release_mutex(img->io_mutex);
+                break;
+            }
+            req = &img->io_queue[img->io_tail & (HDD_IO_QUEUE - 1)];
+            thread_release_mutex(img->io_mutex);
+
+            if (req->op == HDD_IO_FLUSH)
+                ret = hdd_image_cache_flush(id);
+            else if (req->op == HDD_OP_WRITE)
+                ret = hdd_image_do_write(id, req->sector, req->count, req->buffer);
+            else
+                ret = hdd_image_do_read(id, req->sector, req->count, req->buffer);
+
+            thread_wait_mutex(img->io_mutex);
+            if (ret < 0) {
+                if (req->op != HDD_OP_READ)
+                    img->io_write_error = 1;
+                else
+                    img->io_read_error = 1;
+            }
+            img->io_tail++;
+            thread_release_mutex(img->io_mutex);
+
+            thread_set_event(img->io_done);
+        }
+
+        if (img->io_stop)
+            break;
+    }
+}
+
+static int
+hdd_image_io_start(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->io_thread != NULL)
+        return 1;
+
+    img->io_head        = 0;
+    img->io_tail        = 0;
+    img->io_stop        = 0;
+    img->io_read_error  = 0;
+    img->io_write_error = 0;
+
+    img->io_mutex = thread_create_mutex();
+    img->io_wake  = thread_create_event();
+    img->io_done  = thread_create_event();
+
+    img->io_thread = thread_create_named(hdd_image_io_thread, img, "HDD I/O");
+    if (img->io_thread == NULL) {
+        hdd_image_log("Hard disk image %i: Unable to start the I/O thread\n", id);
+        thread_destroy_event(img->io_done);
+        thread_destroy_event(img->io_wake);
+        thread_close_mutex(img->io_mutex);
+        img->io_done  = NULL;
+        img->io_wake  = NULL;
+        img->io_mutex = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Wait until every queued request up to (but not including) seq is done. */
+static void
+hdd_image_io_wait(hdd_image_t *img, uint32_t seq)
+{
+    while (1) {
+        thread_wait_mutex(img->io_mutex);
+        if ((int32_t) (img->io_tail - seq) >= 0) {
+            thread_release_mutex(img->io_mutex);
+            break;
+        }
+        thread_release_mutex(img->io_mutex);
+
+        thread_wait_event(img->io_done, -1);
+        thread_reset_event(img->io_done);
+    }
+}
+
+static void
+hdd_image_io_sync(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->io_thread != NULL)
+        hdd_image_io_wait(img, img->io_head);
+}
+
+static void
+hdd_image_io_stop(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->io_thread == NULL)
+        return;
+
+    hdd_image_io_sync(id);
+
+    img->io_stop = 1;
+    thread_set_event(img->io_wake);
+    thread_wait(img->io_thread);
+    img->io_thread = NULL;
+
+    thread_destroy_event(img->io_done);
+    thread_destroy_event(img->io_wake);
+    thread_close_mutex(img->io_mutex);
+    img->io_done  = NULL;
+    img->io_wake  = NULL;
+    img->io_mutex = NULL;
+
+    for (int i = 0; i < HDD_IO_QUEUE; i++) {
+        free(img->io_queue[i].data);
+        img->io_queue[i].data      = NULL;
+        img->io_queue[i].data_size = 0;
+    }
+}
+
+static int
+hdd_image_submit(uint8_t id, uint8_t op, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t     *img = &hdd_images[id];
+    hdd_image_req_t *req;
+    uint32_t         size = count << 9;
+
+    if (!hdd_image_io_start(id))
+        return -1;
+
+    /* Queue full, wait for the oldest request. */
+    hdd_image_io_wait(img, img->io_head - HDD_IO_QUEUE + 1);
+
+    req         = &img->io_queue[img->io_head & (HDD_IO_QUEUE - 1)];
+    req->op     = op;
+    req->sector = sector;
+    req->count  = count;
+
+    if (op == HDD_OP_WRITE) {
+        if (req->data_size < size) {
+            free(req->data);
+            req->data      = (uint8_t *) malloc(size);
+            req->data_size = req->data ? size : 0;
+            if (req->data == NULL)
+                return -1;
+        }
+        memcpy(req->data, buffer, size);
+        req->buffer = req->data;
+    } else
+        req->buffer = buffer;
+
+    if (op != HDD_IO_FLUSH)
+        img->pos = sector + count;
+
+    thread_wait_mutex(img->io_mutex);
+    img->io_head++;
+    thread_release_mutex(img->io_mutex);
+
+    thread_set_event(img->io_wake);
+
+    return 0;
+}
+
+/*
+ * Queue a read into buffer, which must stay untouched until hdd_image_busy()
+ * returns 0. Falls back to a synchronous read if asynchronous I/O is off.
+ */
+int
+hdd_image_read_async(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    if (!hdd_image_async)
+        return hdd_image_read(id, sector, count, buffer);
+
+    if (hdd_image_submit(id, HDD_OP_READ, sector, count, buffer) < 0)
+        return hdd_image_read(id, sector, count, buffer);
+
+    return 0;
+}
+
+/*
+ * Queue a write, buffer can be reused as soon as this returns. A failure
+ * of an earlier queued write is reported here, like a drive with its
+ * write cache enabled would.
+ */
+int
+hdd_image_write_async(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+    int          ret = 0;
+
+    if (!hdd_image_async)
+        return hdd_image_write(id, sector, count, buffer);
+
+    if (img->io_thread != NULL) {
+        thread_wait_mutex(img->io_mutex);
+        if (img->io_write_error)
+            ret = -1;
+        img->io_write_error = 0;
+        thread_release_mutex(img->io_mutex);
+    }
+
+    if (hdd_image_submit(id, HDD_OP_WRITE, sector, count, buffer) < 0)
+        return hdd_image_write(id, sector, count, buffer);
+
+    return ret;
+}
+
+/*
+ * Periodic write-back, done by whoever owns the image: the I/O thread if it
+ * is running, otherwise us. A failure is reported by the next write. This
+ * runs on emulated time, so it flushes without looking at the host clock
+ * that hdd_image_cache_poll() goes by.
+ */
+static void
+hdd_image_cache_timer(void *priv)
+{
+    hdd_image_t *img = (hdd_image_t *) priv;
+    uint8_t      id  = img - hdd_images;
+
+    if (img->io_thread != NULL)
+        hdd_image_submit(id, HDD_IO_FLUSH, 0, 0, NULL);
+    else if (hdd_image_cache_flush(id) < 0)
+        hdd_image_log("Hard disk image %i: Periodic write-back failed\n", id);
+
+    timer_on_auto(&img->cache_timer, HDD_CACHE_FLUSH_MS * 1000.0);
+}
+
+/* Returns 1 while queued requests are still being worked on. */
+int
+hdd_image_busy(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+    int          ret;
+
+    if (img->io_thread == NULL)
+        return 0;
+
+    thread_wait_mutex(img->io_mutex);
+    ret = (img->io_tail != img->io_head);
+    thread_release_mutex(img->io_mutex);
+
+    return ret;
+}
+
+/* Wait for queued reads and return -1 if any of them failed. */
+int
+hdd_image_read_result(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+    int          ret;
+
+    if (img->io_thread == NULL)
+        return 0;
+
+    hdd_image_io_sync(id);
+
+    thread_wait_mutex(img->io_mutex);
+    ret                = img->io_read_error ? -1 : 0;
+    img->io_read_error = 0;
+    thread_release_mutex(img->io_mutex);
+
+    return ret;
+}
+
 uint32_t
 hdd_image_get_pos(uint8_t id)
 {
@@ -692,6 +1872,12 @@ hdd_image_unload(uint8_t id, UNUSED(int fn_preserve))
     if (strlen(hdd[id].fn) == 0)
         return;
 
+    timer_stop(&hdd_images[id].cache_timer);
+    hdd_image_io_stop(id);
+    hdd_image_cache_close(id);
+    hdd_image_overlay_close(id);
+    hdd_image_unmap(id);
+
     if (hdd_images[id].loaded) {
         if (hdd_images[id].file != NULL) {
             fclose(hdd_images[id].file);
@@ -699,6 +1885,9 @@ hdd_image_unload(uint8_t id, UNUSED(int fn_preserve))
         } else if (hdd_images[id].vhd != NULL) {
             mvhd_close(hdd_images[id].vhd);
             hdd_images[id].vhd = NULL;
+        } else if (hdd_images[id].packed != NULL) {
+            hdd_packed_close(hdd_images[id].packed);
+            hdd_images[id].packed = NULL;
         }
         hdd_images[id].loaded = 0;
     }
@@ -716,12 +1905,21 @@ hdd_image_close(uint8_t id)
     if (!hdd_images[id].loaded)
         return;
 
+    timer_stop(&hdd_images[id].cache_timer);
+    hdd_image_io_stop(id);
+    hdd_image_cache_close(id);
+    hdd_image_overlay_close(id);
+    hdd_image_unmap(id);
+
     if (hdd_images[id].file != NULL) {
         fclose(hdd_images[id].file);
         hdd_images[id].file = NULL;
     } else if (hdd_images[id].vhd != NULL) {
         mvhd_close(hdd_images[id].vhd);
         hdd_images[id].vhd = NULL;
+    } else if (hdd_images[id].packed != NULL) {
+        hdd_packed_close(hdd_images[id].packed);
+        hdd_images[id].packed = NULL;
     }
 
     memset(&hdd_images[id], 0, sizeof(hdd_image_t));
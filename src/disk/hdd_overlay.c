@@ -0,0 +1,419 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Copy-on-write overlays for hard disk images.
+ *
+ *          An overlay sits in front of a base image of any type, which
+ *          is then only ever read. Writes go to the overlay a block at
+ *          a time; the first write to a block copies the rest of it
+ *          from the base. The overlay file is:
+ *
+ *              0x0000  header
+ *              0x1000  allocation bitmap, one bit per block
+ *              data    block n at data + (n * block size)
+ *
+ *          Block data lives at fixed offsets, so the file is as sparse
+ *          as the host filesystem allows and every block is page aligned
+ *          in it, ready to be mapped. The bitmap is written after the
+ *          data it covers, so an overlay that was not closed cleanly at
+ *          worst loses the last writes, it never returns stale blocks.
+ *
+ *          The header records the size of the base and a hash of its
+ *          first megabyte and of blocks sampled across the rest of it.
+ *          An overlay kept from an earlier run is only used again if both
+ *          still match; blocks copied from another image would corrupt
+ *          the disk. One that does not match is moved aside to a .bak
+ *          file rather than overwritten, since it holds the guest's
+ *          writes. The hash can not tell apart bases that only differ
+ *          outside of what it samples.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/plat.h>
+#include <86box/hdd.h>
+
+#define OVERLAY_MAGIC      "86BoxOVL"
+#define OVERLAY_VERSION    3
+#define OVERLAY_SHIFT      7 /* 128 sectors (64 kB) per block. */
+#define OVERLAY_BITMAP     0x1000ULL
+#define OVERLAY_DATA_ALIGN 0x100000ULL
+#define OVERLAY_ID_SECTORS 2048 /* Hashed to tell base images apart, */
+#define OVERLAY_ID_SAMPLES 64   /* along with this many blocks spread over the rest. */
+
+typedef struct hdd_overlay_header_t {
+    char     magic[8];
+    uint32_t version;
+    uint32_t block_shift;
+    uint64_t sectors; /* Size of the base image */
+    uint64_t bitmap_offset;
+    uint64_t data_offset;
+    uint64_t base_id; /* Hash of the start of the base image */
+} hdd_overlay_header_t;
+
+struct hdd_overlay_t {
+    FILE    *fp;
+    char     fn[1024];
+    uint32_t sectors;
+    uint32_t block_shift;
+    uint32_t blocks;
+    uint64_t bitmap_offset;
+    uint64_t data_offset;
+    uint64_t base_id;
+    uint8_t *bitmap;
+    uint8_t *temp; /* One block, for copying from the base */
+
+    hdd_overlay_io_t base_read;
+    hdd_overlay_io_t base_write;
+    void            *priv;
+};
+
+#ifdef ENABLE_HDD_OVERLAY_LOG
+int hdd_overlay_do_log = ENABLE_HDD_OVERLAY_LOG;
+
+static void
+hdd_overlay_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (hdd_overlay_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define hdd_overlay_log(fmt, ...)
+#endif
+
+static int
+hdd_overlay_is_set(hdd_overlay_t *ov, uint32_t block)
+{
+    if (block >= ov->blocks)
+        return 0;
+
+    return !!(ov->bitmap[block >> 3] & (1 << (block & 7)));
+}
+
+static int
+hdd_overlay_seek(hdd_overlay_t *ov, uint32_t sector)
+{
+    uint64_t addr = ov->data_offset + ((uint64_t) sector << 9);
+
+    return fseeko64(ov->fp, addr, SEEK_SET);
+}
+
+static int
+hdd_overlay_base_hash(hdd_overlay_t *ov, uint32_t sector, uint32_t count)
+{
+    if (ov->base_read(ov->priv, sector, count, ov->temp) < 0)
+        return 0;
+
+    for (uint32_t i = 0; i < (count << 9); i++)
+        ov->base_id = (ov->base_id ^ ov->temp[i]) * 0x100000001b3ULL;
+
+    return 1;
+}
+
+/*
+ * FNV-1a over the first sectors of the base, read a block at a time, then
+ * over OVERLAY_ID_SAMPLES blocks evenly spread over the rest, the last
+ * block included.
+ */
+static int
+hdd_overlay_base_id(hdd_overlay_t *ov)
+{
+    uint32_t sectors = (ov->sectors < OVERLAY_ID_SECTORS) ? ov->sectors : OVERLAY_ID_SECTORS;
+    uint32_t size    = 1 << ov->block_shift;
+    uint32_t n;
+    uint64_t sector;
+
+    ov->base_id = 0xcbf29ce484222325ULL;
+
+    for (sector = 0; sector < sectors; sector += n) {
+        n = MIN(size, sectors - (uint32_t) sector);
+        if (!hdd_overlay_base_hash(ov, (uint32_t) sector, n))
+            return 0;
+    }
+
+    if (ov->sectors <= (OVERLAY_ID_SECTORS + size))
+        return 1;
+
+    for (uint32_t i = 1; i <= OVERLAY_ID_SAMPLES; i++) {
+        sector = OVERLAY_ID_SECTORS + (((uint64_t) (ov->sectors - OVERLAY_ID_SECTORS - size) * i) / OVERLAY_ID_SAMPLES);
+        if (!hdd_overlay_base_hash(ov, (uint32_t) sector, size))
+            return 0;
+    }
+
+    return 1;
+}
+
+static int
+hdd_overlay_create(hdd_overlay_t *ov)
+{
+    hdd_overlay_header_t hdr;
+
+    ov->fp = plat_fopen(ov->fn, "wb+");
+    if (ov->fp == NULL)
+        return 0;
+
+    memset(&hdr, 0x00, sizeof(hdr));
+    memcpy(hdr.magic, OVERLAY_MAGIC, sizeof(hdr.magic));
+    hdr.version       = OVERLAY_VERSION;
+    hdr.block_shift   = ov->block_shift;
+    hdr.sectors       = ov->sectors;
+    hdr.bitmap_offset = ov->bitmap_offset;
+    hdr.data_offset   = ov->data_offset;
+    hdr.base_id       = ov->base_id;
+
+    if ((fwrite(&hdr, 1, sizeof(hdr), ov->fp) != sizeof(hdr)) ||
+        (fseeko64(ov->fp, ov->bitmap_offset, SEEK_SET) == -1) ||
+        (fwrite(ov->bitmap, 1, (ov->blocks + 7) >> 3, ov->fp) != ((ov->blocks + 7) >> 3)))
+        return 0;
+
+    fflush(ov->fp);
+
+    return 1;
+}
+
+/*
+ * Reopen an existing overlay, if it was made for this base image. One that
+ * was not is renamed to <name>.bak, replacing an earlier one, so that a new
+ * overlay can be made without losing what the old one held.
+ */
+static int
+hdd_overlay_reopen(hdd_overlay_t *ov)
+{
+    hdd_overlay_header_t hdr;
+    char                 bak[sizeof(ov->fn) + 4];
+
+    ov->fp = plat_fopen(ov->fn, "rb+");
+    if (ov->fp == NULL)
+        return 0;
+
+    if ((fread(&hdr, 1, sizeof(hdr), ov->fp) != sizeof(hdr)) ||
+        memcmp(hdr.magic, OVERLAY_MAGIC, sizeof(hdr.magic)) || (hdr.version != OVERLAY_VERSION) ||
+        (hdr.block_shift != ov->block_shift) || (hdr.sectors != ov->sectors) ||
+        (hdr.bitmap_offset != ov->bitmap_offset) || (hdr.data_offset != ov->data_offset) ||
+        (hdr.base_id != ov->base_id) || (fseeko64(ov->fp, ov->bitmap_offset, SEEK_SET) == -1) ||
+        (fread(ov->bitmap, 1, (ov->blocks + 7) >> 3, ov->fp) != ((ov->blocks + 7) >> 3))) {
+        fclose(ov->fp);
+        ov->fp = NULL;
+        memset(ov->bitmap, 0x00, (ov->blocks + 7) >> 3);
+
+        snprintf(bak, sizeof(bak), "%s.bak", ov->fn);
+        if (plat_rename(ov->fn, bak) != 0) {
+            pclog("HDD overlay: %s does not match its base image and can not be moved aside\n", ov->fn);
+            return -1;
+        }
+        pclog("HDD overlay: %s does not match its base image, moved it to %s and starting over\n", ov->fn, bak);
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Open the overlay file for a base image of the given size. With reuse
+ * set, an existing overlay is kept, otherwise a new, empty one is made.
+ */
+hdd_overlay_t *
+hdd_overlay_open(const char *fn, uint32_t sectors, int reuse,
+                 hdd_overlay_io_t base_read, hdd_overlay_io_t base_write, void *priv)
+{
+    hdd_overlay_t *ov;
+    uint32_t       bitmap_size;
+    int            ret;
+
+    ov = (hdd_overlay_t *) calloc(1, sizeof(hdd_overlay_t));
+    if (ov == NULL)
+        return NULL;
+
+    strncpy(ov->fn, fn, sizeof(ov->fn) - 1);
+    ov->sectors     = sectors;
+    ov->block_shift = OVERLAY_SHIFT;
+    ov->blocks      = (uint32_t) (((uint64_t) sectors + (1 << OVERLAY_SHIFT) - 1) >> OVERLAY_SHIFT);
+    ov->base_read   = base_read;
+    ov->base_write  = base_write;
+    ov->priv        = priv;
+
+    bitmap_size       = (ov->blocks + 7) >> 3;
+    ov->bitmap_offset = OVERLAY_BITMAP;
+    ov->data_offset   = (OVERLAY_BITMAP + bitmap_size + OVERLAY_DATA_ALIGN - 1) & ~(OVERLAY_DATA_ALIGN - 1);
+
+    ov->bitmap = (uint8_t *) calloc(1, bitmap_size);
+    ov->temp   = (uint8_t *) malloc(512 << OVERLAY_SHIFT);
+    if ((ov->bitmap == NULL) || (ov->temp == NULL))
+        goto fail;
+
+    if (!hdd_overlay_base_id(ov)) {
+        pclog("HDD overlay: Unable to read the base image of %s\n", fn);
+        goto fail;
+    }
+
+    ret = reuse ? hdd_overlay_reopen(ov) : 0;
+    if (ret < 0)
+        goto fail;
+    if (!ret && !hdd_overlay_create(ov)) {
+        pclog("HDD overlay: Unable to create %s\n", fn);
+        goto fail;
+    }
+
+    hdd_overlay_log("HDD overlay: %s, %u blocks\n", fn, ov->blocks);
+
+    return ov;
+
+fail:
+    if (ov->fp != NULL)
+        fclose(ov->fp);
+    free(ov->temp);
+    free(ov->bitmap);
+    free(ov);
+
+    return NULL;
+}
+
+int
+hdd_overlay_read(hdd_overlay_t *ov, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    uint32_t block;
+    uint32_t n;
+    int      alloc;
+
+    while (count > 0) {
+        /* Take the longest run of blocks that all come from the same place. */
+        block = sector >> ov->block_shift;
+        alloc = hdd_overlay_is_set(ov, block);
+        n     = ((block + 1) << ov->block_shift) - sector;
+        for (block++; (n < count) && (block < ov->blocks) && (hdd_overlay_is_set(ov, block) == alloc); block++)
+            n += 1 << ov->block_shift;
+        if (n > count)
+            n = count;
+
+        if (alloc) {
+            if ((hdd_overlay_seek(ov, sector) == -1) || (fread(buffer, 512, n, ov->fp) != n))
+                return -1;
+        } else if (ov->base_read(ov->priv, sector, n, buffer) < 0)
+            return -1;
+
+        sector += n;
+        count -= n;
+        buffer += n << 9;
+    }
+
+    return 0;
+}
+
+/* Copy a block from the base into the overlay, and mark it as present. */
+static int
+hdd_overlay_alloc(hdd_overlay_t *ov, uint32_t block)
+{
+    uint32_t first = block << ov->block_shift;
+    uint32_t n     = 1 << ov->block_shift;
+    uint8_t  byte;
+
+    if (first >= ov->sectors)
+        return -1;
+    if ((first + n) > ov->sectors)
+        n = ov->sectors - first;
+
+    if ((ov->base_read(ov->priv, first, n, ov->temp) < 0) ||
+        (hdd_overlay_seek(ov, first) == -1) || (fwrite(ov->temp, 512, n, ov->fp) != n))
+        return -1;
+
+    fflush(ov->fp);
+
+    ov->bitmap[block >> 3] |= (1 << (block & 7));
+    byte = ov->bitmap[block >> 3];
+    if ((fseeko64(ov->fp, ov->bitmap_offset + (block >> 3), SEEK_SET) == -1) ||
+        (fwrite(&byte, 1, 1, ov->fp) != 1))
+        return -1;
+
+    return 0;
+}
+
+int
+hdd_overlay_write(hdd_overlay_t *ov, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    uint32_t last = (sector + count - 1) >> ov->block_shift;
+    int      ret  = 0;
+
+    if (count == 0)
+        return 0;
+
+    for (uint32_t block = sector >> ov->block_shift; block <= last; block++) {
+        if (!hdd_overlay_is_set(ov, block) && (hdd_overlay_alloc(ov, block) < 0))
+            return -1;
+    }
+
+    if ((hdd_overlay_seek(ov, sector) == -1) || (fwrite(buffer, 512, count, ov->fp) != count))
+        ret = -1;
+
+    fflush(ov->fp);
+
+    return ret;
+}
+
+/* Write every block the overlay holds back into the base image. */
+int
+hdd_overlay_commit(hdd_overlay_t *ov)
+{
+    uint32_t first;
+    uint32_t n;
+    uint32_t committed = 0;
+
+    if (ov->base_write == NULL)
+        return -1;
+
+    for (uint32_t block = 0; block < ov->blocks; block++) {
+        if (!hdd_overlay_is_set(ov, block))
+            continue;
+
+        first = block << ov->block_shift;
+        n     = 1 << ov->block_shift;
+        if ((first + n) > ov->sectors)
+            n = ov->sectors - first;
+
+        if ((hdd_overlay_seek(ov, first) == -1) || (fread(ov->temp, 512, n, ov->fp) != n) ||
+            (ov->base_write(ov->priv, first, n, ov->temp) < 0)) {
+            pclog("HDD overlay: Commit of %s failed at block %u, keeping it\n", ov->fn, block);
+            return -1;
+        }
+        committed++;
+    }
+
+    hdd_overlay_log("HDD overlay: %u blocks committed from %s\n", committed, ov->fn);
+
+    return 0;
+}
+
+void
+hdd_overlay_close(hdd_overlay_t *ov, int discard)
+{
+    if (ov == NULL)
+        return;
+
+    if (ov->fp != NULL)
+        fclose(ov->fp);
+
+    if (discard)
+        remove(ov->fn);
+
+    free(ov->temp);
+    free(ov->bitmap);
+    free(ov);
+}
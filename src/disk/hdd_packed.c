@@ -0,0 +1,794 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Packed (compressed, deduplicated) hard disk images.
+ *
+ *          A packed image is read-only and always used with an overlay
+ *          in front of it. The disk is cut into chunks of a power of two
+ *          sectors, and every chunk has an index entry pointing at the
+ *          record holding its data. Chunks with the same contents share
+ *          one record, chunks that are all zeroes have none. The file
+ *          is (all values little endian):
+ *
+ *              0x00  "86BoxHDZ"
+ *              0x08  version, chunk shift (log2 of sectors per chunk)
+ *              0x10  sector size, sectors per track, heads, cylinders
+ *                    (where HDI and HDX images have them as well)
+ *              0x20  sectors, index offset, number of chunks
+ *              index offset, size and flags of every chunk's record
+ *
+ *          Records are either stored as they are or LZF compressed, and
+ *          always decompress to a whole chunk. Decompressed chunks are
+ *          kept in a small cache, looked up by record, so duplicates
+ *          share their entry as well. On sequential reads, a thread
+ *          decompresses the chunks after the one being read ahead of
+ *          the guest.
+ *
+ *          hdd_packed_create() makes one out of a raw, HDI, HDX or VHD
+ *          image (86Box --pack), then mounts it and reads it all back
+ *          to check it against the source.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/plat.h>
+#include <86box/path.h>
+#include <86box/thread.h>
+#include <86box/hdd.h>
+#include "minivhd/minivhd.h"
+#include <lzf.h>
+
+#define HDZ_MAGIC     "86BoxHDZ"
+#define HDZ_VERSION   1
+#define HDZ_MIN_SHIFT 3  /* 4 kB */
+#define HDZ_MAX_SHIFT 11 /* 1 MB */
+#define HDZ_LZF       0x0001
+#define HDZ_SHIFT     7 /* 64 kB, what the packer uses */
+
+#define PACKED_CACHE_CHUNKS 64
+#define PACKED_PREFETCH     4 /* Chunks decompressed ahead of sequential reads. */
+
+typedef struct hdz_header_t {
+    char     magic[8];
+    uint32_t version;
+    uint32_t chunk_shift;
+    uint32_t sector_size;
+    uint32_t spt;
+    uint32_t hpc;
+    uint32_t tracks;
+    uint64_t sectors;
+    uint64_t index_offset;
+    uint32_t chunks;
+    uint32_t reserved;
+} hdz_header_t;
+
+typedef struct hdz_index_t {
+    uint64_t offset; /* 0 = all zeroes */
+    uint32_t size;
+    uint32_t flags;
+} hdz_index_t;
+
+/* Image being packed. */
+typedef struct hdz_source_t {
+    FILE     *fp;
+    MVHDMeta *vhd;
+    uint64_t  base;
+    uint32_t  sectors;
+    uint32_t  spt;
+    uint32_t  hpc;
+    uint32_t  tracks;
+} hdz_source_t;
+
+typedef struct packed_chunk_t {
+    uint64_t offset; /* Record held, 0 = unused */
+    uint32_t last_use;
+    uint8_t *data;
+} packed_chunk_t;
+
+struct hdd_packed_t {
+    FILE        *fp;
+    char         fn[1024];
+    uint32_t     sectors;
+    uint32_t     chunk_shift;
+    uint32_t     chunk_size; /* In bytes */
+    uint32_t     chunks;
+    uint32_t     spt;
+    uint32_t     hpc;
+    uint32_t     tracks;
+    hdz_index_t *index;
+    uint8_t     *comp; /* Compressed record, for the reader */
+    uint8_t     *data; /* Decompressed chunk, for the reader */
+    uint32_t     next_sector;
+
+    packed_chunk_t cache[PACKED_CACHE_CHUNKS];
+    uint8_t       *cache_mem;
+    uint32_t       use_count;
+
+    /* Prefetch thread, with its own file handle and buffers. */
+    thread_t *pf_thread;
+    event_t  *pf_wake;
+    mutex_t  *pf_mutex; /* Also guards the cache. */
+    FILE     *pf_fp;
+    uint8_t  *pf_comp;
+    uint8_t  *pf_data;
+    uint32_t  pf_first;
+    uint32_t  pf_last;
+    int       pf_stop;
+};
+
+#ifdef ENABLE_HDD_PACKED_LOG
+int hdd_packed_do_log = ENABLE_HDD_PACKED_LOG;
+
+static void
+hdd_packed_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (hdd_packed_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define hdd_packed_log(fmt, ...)
+#endif
+
+int
+image_is_hdz(const char *s, int check_signature)
+{
+    FILE *fp;
+    char  magic[8];
+    int   ret;
+
+    if (strcasecmp(path_get_extension((char *) s), "HDZ"))
+        return 0;
+
+    if (!check_signature)
+        return 1;
+
+    fp = plat_fopen(s, "rb");
+    if (fp == NULL)
+        return 0;
+
+    ret = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) && !memcmp(magic, HDZ_MAGIC, sizeof(magic));
+    fclose(fp);
+
+    return ret;
+}
+
+/* Read a record and turn it back into a whole chunk. */
+static int
+hdd_packed_decode(hdd_packed_t *pk, FILE *fp, const hdz_index_t *idx, uint8_t *comp, uint8_t *out)
+{
+    if (fseeko64(fp, idx->offset, SEEK_SET) == -1)
+        return -1;
+
+    if (!(idx->flags & HDZ_LZF))
+        return (fread(out, 1, pk->chunk_size, fp) == pk->chunk_size) ? 0 : -1;
+
+    if ((fread(comp, 1, idx->size, fp) != idx->size) ||
+        (lzf_decompress(comp, idx->size, out, pk->chunk_size) != pk->chunk_size))
+        return -1;
+
+    return 0;
+}
+
+/* Cache lookup, with the mutex held. */
+static packed_chunk_t *
+hdd_packed_find(hdd_packed_t *pk, uint64_t offset)
+{
+    for (int i = 0; i < PACKED_CACHE_CHUNKS; i++) {
+        if (pk->cache[i].offset == offset)
+            return &pk->cache[i];
+    }
+
+    return NULL;
+}
+
+/* Put a decompressed chunk in the place of the least recently used one. */
+static void
+hdd_packed_insert(hdd_packed_t *pk, uint64_t offset, const uint8_t *data)
+{
+    packed_chunk_t *ent;
+    int             victim = 0;
+
+    if (pk->pf_mutex != NULL)
+        thread_wait_mutex(pk->pf_mutex);
+
+    /* The other thread may have been faster. */
+    if (hdd_packed_find(pk, offset) == NULL) {
+        for (int i = 1; i < PACKED_CACHE_CHUNKS; i++) {
+            if (pk->cache[i].last_use < pk->cache[victim].last_use)
+                victim = i;
+        }
+
+        ent           = &pk->cache[victim];
+        ent->offset   = offset;
+        ent->last_use = ++pk->use_count;
+        memcpy(ent->data, data, pk->chunk_size);
+    }
+
+    if (pk->pf_mutex != NULL)
+        thread_release_mutex(pk->pf_mutex);
+}
+
+/* Copy part of a chunk out of the cache, returns 0 on a miss. */
+static int
+hdd_packed_copy(hdd_packed_t *pk, uint64_t offset, uint32_t start, uint32_t len, uint8_t *buffer)
+{
+    packed_chunk_t *ent;
+
+    if (pk->pf_mutex != NULL)
+        thread_wait_mutex(pk->pf_mutex);
+
+    ent = hdd_packed_find(pk, offset);
+    if (ent != NULL) {
+        ent->last_use = ++pk->use_count;
+        memcpy(buffer, ent->data + start, len);
+    }
+
+    if (pk->pf_mutex != NULL)
+        thread_release_mutex(pk->pf_mutex);
+
+    return ent != NULL;
+}
+
+static void
+hdd_packed_prefetch_thread(void *priv)
+{
+    hdd_packed_t *pk = (hdd_packed_t *) priv;
+    hdz_index_t  *idx;
+    int           cached;
+    int           stop = 0;
+
+    while (!stop) {
+        thread_wait_event(pk->pf_wake, -1);
+        thread_reset_event(pk->pf_wake);
+
+        while (1) {
+            thread_wait_mutex(pk->pf_mutex);
+            stop = pk->pf_stop;
+            if (stop || (pk->pf_first > pk->pf_last) || (pk->pf_first >= pk->chunks)) {
+                thread_release_mutex(pk->pf_mutex);
+                break;
+            }
+            idx    = &pk->index[pk->pf_first++];
+            cached = (idx->offset == 0) || (hdd_packed_find(pk, idx->offset) != NULL);
+            thread_release_mutex(pk->pf_mutex);
+
+            /* A bad record is left for the reader to run into and report. */
+            if (!cached && (hdd_packed_decode(pk, pk->pf_fp, idx, pk->pf_comp, pk->pf_data) == 0))
+                hdd_packed_insert(pk, idx->offset, pk->pf_data);
+        }
+    }
+}
+
+static void
+hdd_packed_prefetch_start(hdd_packed_t *pk)
+{
+    pk->pf_fp   = plat_fopen64(pk->fn, "rb");
+    pk->pf_comp = (uint8_t *) malloc(pk->chunk_size);
+    pk->pf_data = (uint8_t *) malloc(pk->chunk_size);
+    if ((pk->pf_fp == NULL) || (pk->pf_comp == NULL) || (pk->pf_data == NULL))
+        goto fail;
+
+    pk->pf_first = 1;
+    pk->pf_last  = 0;
+    pk->pf_stop  = 0;
+    pk->pf_mutex = thread_create_mutex();
+    pk->pf_wake  = thread_create_event();
+
+    pk->pf_thread = thread_create_named(hdd_packed_prefetch_thread, pk, "HDD prefetch");
+    if (pk->pf_thread != NULL)
+        return;
+
+    thread_destroy_event(pk->pf_wake);
+    thread_close_mutex(pk->pf_mutex);
+    pk->pf_wake  = NULL;
+    pk->pf_mutex = NULL;
+
+fail:
+    /* Everything still works without it, just without reading ahead. */
+    hdd_packed_log("HDD packed: Unable to start prefetching for %s\n", pk->fn);
+    if (pk->pf_fp != NULL)
+        fclose(pk->pf_fp);
+    free(pk->pf_data);
+    free(pk->pf_comp);
+    pk->pf_fp   = NULL;
+    pk->pf_data = NULL;
+    pk->pf_comp = NULL;
+}
+
+static void
+hdd_packed_prefetch_stop(hdd_packed_t *pk)
+{
+    if (pk->pf_thread == NULL)
+        return;
+
+    thread_wait_mutex(pk->pf_mutex);
+    pk->pf_stop = 1;
+    thread_release_mutex(pk->pf_mutex);
+    thread_set_event(pk->pf_wake);
+    thread_wait(pk->pf_thread);
+    pk->pf_thread = NULL;
+
+    thread_destroy_event(pk->pf_wake);
+    thread_close_mutex(pk->pf_mutex);
+    pk->pf_wake  = NULL;
+    pk->pf_mutex = NULL;
+
+    fclose(pk->pf_fp);
+    free(pk->pf_data);
+    free(pk->pf_comp);
+    pk->pf_fp   = NULL;
+    pk->pf_data = NULL;
+    pk->pf_comp = NULL;
+}
+
+hdd_packed_t *
+hdd_packed_open(const char *fn)
+{
+    hdd_packed_t *pk;
+    hdz_header_t  hdr;
+
+    pk = (hdd_packed_t *) calloc(1, sizeof(hdd_packed_t));
+    if (pk == NULL)
+        return NULL;
+
+    strncpy(pk->fn, fn, sizeof(pk->fn) - 1);
+
+    pk->fp = plat_fopen64(fn, "rb");
+    if (pk->fp == NULL)
+        goto fail;
+
+    if ((fread(&hdr, 1, sizeof(hdr), pk->fp) != sizeof(hdr)) || memcmp(hdr.magic, HDZ_MAGIC, sizeof(hdr.magic)) ||
+        (hdr.version != HDZ_VERSION) || (hdr.sector_size != 512) ||
+        (hdr.chunk_shift < HDZ_MIN_SHIFT) || (hdr.chunk_shift > HDZ_MAX_SHIFT) ||
+        (hdr.sectors == 0) || (hdr.sectors > 0xffffffffULL) ||
+        (hdr.chunks != ((hdr.sectors + (1ULL << hdr.chunk_shift) - 1) >> hdr.chunk_shift))) {
+        pclog("HDD packed: %s is not a valid packed image\n", fn);
+        goto fail;
+    }
+
+    pk->sectors     = (uint32_t) hdr.sectors;
+    pk->chunk_shift = hdr.chunk_shift;
+    pk->chunk_size  = 512 << hdr.chunk_shift;
+    pk->chunks      = hdr.chunks;
+    pk->spt         = hdr.spt;
+    pk->hpc         = hdr.hpc;
+    pk->tracks      = hdr.tracks;
+    pk->next_sector = 0xffffffff;
+
+    pk->index     = (hdz_index_t *) malloc((size_t) pk->chunks * sizeof(hdz_index_t));
+    pk->comp      = (uint8_t *) malloc(pk->chunk_size);
+    pk->data      = (uint8_t *) malloc(pk->chunk_size);
+    pk->cache_mem = (uint8_t *) malloc((size_t) PACKED_CACHE_CHUNKS * pk->chunk_size);
+    if ((pk->index == NULL) || (pk->comp == NULL) || (pk->data == NULL) || (pk->cache_mem == NULL))
+        goto fail;
+
+    if ((fseeko64(pk->fp, hdr.index_offset, SEEK_SET) == -1) ||
+        (fread(pk->index, sizeof(hdz_index_t), pk->chunks, pk->fp) != pk->chunks)) {
+        pclog("HDD packed: Unable to read the index of %s\n", fn);
+        goto fail;
+    }
+
+    for (uint32_t i = 0; i < pk->chunks; i++) {
+        if ((pk->index[i].offset != 0) &&
+            ((pk->index[i].flags & ~HDZ_LZF) || (pk->index[i].size == 0) || (pk->index[i].size > pk->chunk_size) ||
+             (!(pk->index[i].flags & HDZ_LZF) && (pk->index[i].size != pk->chunk_size)))) {
+            pclog("HDD packed: Bad index entry for chunk %u of %s\n", i, fn);
+            goto fail;
+        }
+    }
+
+    for (int i = 0; i < PACKED_CACHE_CHUNKS; i++)
+        pk->cache[i].data = pk->cache_mem + ((size_t) i * pk->chunk_size);
+
+    hdd_packed_prefetch_start(pk);
+
+    hdd_packed_log("HDD packed: %s, %u sectors in %u chunks of %u kB\n", fn, pk->sectors, pk->chunks, pk->chunk_size >> 10);
+
+    return pk;
+
+fail:
+    if (pk->fp != NULL)
+        fclose(pk->fp);
+    free(pk->cache_mem);
+    free(pk->data);
+    free(pk->comp);
+    free(pk->index);
+    free(pk);
+
+    return NULL;
+}
+
+void
+hdd_packed_get_geometry(hdd_packed_t *pk, uint32_t *spt, uint32_t *hpc, uint32_t *tracks)
+{
+    *spt    = pk->spt;
+    *hpc    = pk->hpc;
+    *tracks = pk->tracks;
+}
+
+uint32_t
+hdd_packed_get_sectors(hdd_packed_t *pk)
+{
+    return pk->sectors;
+}
+
+int
+hdd_packed_read(hdd_packed_t *pk, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    uint32_t     mask = (1 << pk->chunk_shift) - 1;
+    uint32_t     first;
+    uint32_t     n;
+    hdz_index_t *idx;
+
+    if ((sector >= pk->sectors) || (count > (pk->sectors - sector)))
+        return -1;
+
+    /* Sequential, have the thread start on the chunks after this read. */
+    if ((sector == pk->next_sector) && (pk->pf_thread != NULL)) {
+        first = (sector + count + mask) >> pk->chunk_shift;
+        thread_wait_mutex(pk->pf_mutex);
+        pk->pf_first = first;
+        pk->pf_last  = first + PACKED_PREFETCH - 1;
+        thread_release_mutex(pk->pf_mutex);
+        thread_set_event(pk->pf_wake);
+    }
+    pk->next_sector = sector + count;
+
+    while (count > 0) {
+        idx = &pk->index[sector >> pk->chunk_shift];
+        n   = (mask + 1) - (sector & mask);
+        if (n > count)
+            n = count;
+
+        if (idx->offset == 0)
+            memset(buffer, 0x00, n << 9);
+        else if (!hdd_packed_copy(pk, idx->offset, (sector & mask) << 9, n << 9, buffer)) {
+            if (hdd_packed_decode(pk, pk->fp, idx, pk->comp, pk->data) < 0) {
+                pclog("HDD packed: Unable to read chunk %u of %s\n", sector >> pk->chunk_shift, pk->fn);
+                return -1;
+            }
+            memcpy(buffer, pk->data + ((sector & mask) << 9), n << 9);
+            hdd_packed_insert(pk, idx->offset, pk->data);
+        }
+
+        sector += n;
+        count -= n;
+        buffer += n << 9;
+    }
+
+    return 0;
+}
+
+void
+hdd_packed_close(hdd_packed_t *pk)
+{
+    if (pk == NULL)
+        return;
+
+    hdd_packed_prefetch_stop(pk);
+
+    fclose(pk->fp);
+    free(pk->cache_mem);
+    free(pk->data);
+    free(pk->comp);
+    free(pk->index);
+    free(pk);
+}
+
+static int
+hdd_packed_source_open(hdz_source_t *src, const char *fn)
+{
+    uint32_t header[8];
+    uint64_t size;
+    int      err;
+
+    memset(src, 0x00, sizeof(hdz_source_t));
+
+    if (image_is_hdz(fn, 1)) {
+        pclog("HDD packed: %s is packed already\n", fn);
+        return -1;
+    }
+
+    if (image_is_vhd(fn, 1)) {
+        src->vhd = mvhd_open(fn, 1, &err);
+        if (src->vhd == NULL) {
+            pclog("HDD packed: Unable to open %s: %s\n", fn, mvhd_strerr(err));
+            return -1;
+        }
+        MVHDGeom geom = mvhd_get_geometry(src->vhd);
+        src->sectors  = (uint32_t) (mvhd_get_current_size(src->vhd) >> 9);
+        src->spt      = geom.spt;
+        src->hpc      = geom.heads;
+        src->tracks   = geom.cyl;
+        return 0;
+    }
+
+    src->fp = plat_fopen64(fn, "rb");
+    if (src->fp == NULL) {
+        pclog("HDD packed: Unable to open %s\n", fn);
+        return -1;
+    }
+
+    if (image_is_hdi(fn) || image_is_hdx(fn, 1)) {
+        if (fread(header, 1, sizeof(header), src->fp) != sizeof(header))
+            goto fail;
+        if (image_is_hdi(fn)) {
+            src->base = header[2];
+            size      = header[3];
+        } else {
+            src->base = 0x28;
+            size      = header[2] | ((uint64_t) header[3] << 32);
+        }
+        if (header[4] != 512)
+            goto fail;
+        src->sectors = (uint32_t) (size >> 9);
+        src->spt     = header[5];
+        src->hpc     = header[6];
+        src->tracks  = header[7];
+    } else {
+        if ((fseeko64(src->fp, 0, SEEK_END) == -1) || ((int64_t) (size = ftello64(src->fp)) <= 0))
+            goto fail;
+        src->sectors = (uint32_t) (size >> 9);
+        /* Raw images carry no geometry, go with what the settings would pick. */
+        if ((src->sectors % (16 * 63)) == 0) {
+            src->spt    = 63;
+            src->hpc    = 16;
+            src->tracks = src->sectors / (16 * 63);
+        } else
+            hdd_image_calc_chs(&src->tracks, &src->hpc, &src->spt, (uint32_t) (size >> 20));
+    }
+
+    if (src->sectors != 0)
+        return 0;
+
+fail:
+    pclog("HDD packed: %s is not a usable image\n", fn);
+    fclose(src->fp);
+    return -1;
+}
+
+static int
+hdd_packed_source_read(hdz_source_t *src, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    if (src->vhd != NULL)
+        return (mvhd_read_sectors(src->vhd, sector, count, buffer) == 0) ? 0 : -1;
+
+    if (fseeko64(src->fp, src->base + ((uint64_t) sector << 9), SEEK_SET) == -1)
+        return -1;
+
+    return (fread(buffer, 512, count, src->fp) == count) ? 0 : -1;
+}
+
+static void
+hdd_packed_source_close(hdz_source_t *src)
+{
+    if (src->vhd != NULL)
+        mvhd_close(src->vhd);
+    else if (src->fp != NULL)
+        fclose(src->fp);
+}
+
+/* Read chunk i of the source, the part past the end of the disk is zeroes. */
+static int
+hdd_packed_source_chunk(hdz_source_t *src, const hdd_packed_t *pk, uint32_t i, uint8_t *buffer)
+{
+    uint32_t sector = i << pk->chunk_shift;
+    uint32_t count  = 1 << pk->chunk_shift;
+
+    if (count > (src->sectors - sector)) {
+        count = src->sectors - sector;
+        memset(buffer + (count << 9), 0x00, pk->chunk_size - (count << 9));
+    }
+
+    return hdd_packed_source_read(src, sector, count, buffer);
+}
+
+static uint64_t
+hdd_packed_hash(const uint8_t *data, uint32_t len)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL; /* FNV-1a */
+
+    for (uint32_t i = 0; i < len; i++)
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+
+    return hash;
+}
+
+/* Read everything back through the reader and compare it with the source. */
+static int
+hdd_packed_verify(hdz_source_t *src, const hdd_packed_t *pk, const char *fn, uint8_t *expect)
+{
+    hdd_packed_t *check = hdd_packed_open(fn);
+    uint8_t      *data  = (uint8_t *) malloc(pk->chunk_size);
+    uint32_t      count;
+    int           ret   = -1;
+
+    if ((check == NULL) || (data == NULL) || (hdd_packed_get_sectors(check) != src->sectors))
+        goto done;
+
+    for (uint32_t i = 0; i < pk->chunks; i++) {
+        count = MIN(1 << pk->chunk_shift, src->sectors - (i << pk->chunk_shift));
+        if ((hdd_packed_source_chunk(src, pk, i, expect) < 0) ||
+            (hdd_packed_read(check, i << pk->chunk_shift, count, data) < 0) || memcmp(data, expect, count << 9)) {
+            pclog("HDD packed: Chunk %u of %s does not read back right\n", i, fn);
+            goto done;
+        }
+    }
+    ret = 0;
+
+done:
+    free(data);
+    hdd_packed_close(check);
+    return ret;
+}
+
+int
+hdd_packed_create(const char *src_fn, const char *fn)
+{
+    hdz_source_t  src;
+    hdz_header_t  hdr   = { 0 };
+    hdd_packed_t *pk    = NULL;
+    FILE         *fp    = NULL;
+    uint64_t     *hash  = NULL;
+    uint32_t     *first = NULL; /* Chunk with each hash slot's contents, + 1 */
+    uint8_t      *prev  = NULL; /* Earlier chunk with the same hash, read back */
+    uint32_t      mask;
+    uint32_t      slot;
+    uint32_t      zero  = 0;
+    uint32_t      dup   = 0;
+    uint64_t      h;
+    uint64_t      offset;
+    int           ret   = -1;
+
+    /* Only mounted as a packed image with that extension. */
+    if (strcasecmp(path_get_extension((char *) fn), "HDZ")) {
+        pclog("HDD packed: %s does not end in .hdz\n", fn);
+        return -1;
+    }
+
+    if (hdd_packed_source_open(&src, src_fn) < 0)
+        return -1;
+
+    pk = (hdd_packed_t *) calloc(1, sizeof(hdd_packed_t));
+    if (pk == NULL)
+        goto done;
+
+    pk->chunk_shift = HDZ_SHIFT;
+    pk->chunk_size  = 512 << HDZ_SHIFT;
+    pk->chunks      = (uint32_t) (((uint64_t) src.sectors + (1 << HDZ_SHIFT) - 1) >> HDZ_SHIFT);
+    for (mask = 1; mask < (pk->chunks * 2); mask <<= 1)
+        ;
+    mask--;
+
+    pk->index = (hdz_index_t *) calloc(pk->chunks, sizeof(hdz_index_t));
+    pk->comp  = (uint8_t *) malloc(pk->chunk_size);
+    pk->data  = (uint8_t *) malloc(pk->chunk_size);
+    prev      = (uint8_t *) malloc(pk->chunk_size);
+    hash      = (uint64_t *) calloc(mask + 1, sizeof(uint64_t));
+    first     = (uint32_t *) calloc(mask + 1, sizeof(uint32_t));
+    fp        = plat_fopen64(fn, "wb+");
+    if ((pk->index == NULL) || (pk->comp == NULL) || (pk->data == NULL) || (prev == NULL) || (hash == NULL) || (first == NULL) || (fp == NULL)) {
+        pclog("HDD packed: Unable to create %s\n", fn);
+        goto done;
+    }
+
+    memcpy(hdr.magic, HDZ_MAGIC, sizeof(hdr.magic));
+    hdr.version     = HDZ_VERSION;
+    hdr.chunk_shift = HDZ_SHIFT;
+    hdr.sector_size = 512;
+    hdr.spt         = src.spt;
+    hdr.hpc         = src.hpc;
+    hdr.tracks      = src.tracks;
+    hdr.sectors     = src.sectors;
+    hdr.chunks      = pk->chunks;
+    if (fwrite(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr))
+        goto fail;
+    offset = sizeof(hdr);
+
+    for (uint32_t i = 0; i < pk->chunks; i++) {
+        hdz_index_t *idx = &pk->index[i];
+        uint32_t     j;
+
+        if (hdd_packed_source_chunk(&src, pk, i, pk->data) < 0) {
+            pclog("HDD packed: Unable to read chunk %u of %s\n", i, src_fn);
+            goto fail;
+        }
+
+        /* All zeroes, no record. */
+        for (j = 0; (j < pk->chunk_size) && !pk->data[j]; j++)
+            ;
+        if (j == pk->chunk_size) {
+            zero++;
+            continue;
+        }
+
+        /* Same contents as an earlier chunk, point at its record. */
+        h = hdd_packed_hash(pk->data, pk->chunk_size);
+        for (slot = h & mask; first[slot] != 0; slot = (slot + 1) & mask) {
+            if (hash[slot] != h)
+                continue;
+            if ((hdd_packed_decode(pk, fp, &pk->index[first[slot] - 1], pk->comp, prev) == 0) &&
+                !memcmp(prev, pk->data, pk->chunk_size))
+                break;
+        }
+        if (first[slot] != 0) {
+            *idx = pk->index[first[slot] - 1];
+            dup++;
+            continue;
+        }
+        hash[slot]  = h;
+        first[slot] = i + 1;
+
+        /* Stored as it is unless LZF makes it smaller. */
+        idx->offset = offset;
+        idx->size   = lzf_compress(pk->data, pk->chunk_size, pk->comp, pk->chunk_size - 1);
+        idx->flags  = idx->size ? HDZ_LZF : 0;
+        if (!idx->size)
+            idx->size = pk->chunk_size;
+
+        if ((fseeko64(fp, offset, SEEK_SET) == -1) ||
+            (fwrite(idx->size == pk->chunk_size ? pk->data : pk->comp, 1, idx->size, fp) != idx->size))
+            goto fail;
+        offset += idx->size;
+    }
+
+    hdr.index_offset = offset;
+    if ((fseeko64(fp, offset, SEEK_SET) == -1) ||
+        (fwrite(pk->index, sizeof(hdz_index_t), pk->chunks, fp) != pk->chunks) ||
+        (fseeko64(fp, 0, SEEK_SET) == -1) || (fwrite(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr)) || fclose(fp)) {
+        fp = NULL;
+        goto fail;
+    }
+    fp = NULL;
+
+    if (hdd_packed_verify(&src, pk, fn, pk->data) < 0)
+        goto fail;
+
+    pclog("HDD packed: %s: %u chunks, %u of zeroes, %u duplicates, %" PRIu64 " of %" PRIu64 " kB\n", fn, pk->chunks,
+          zero, dup, (offset + ((uint64_t) pk->chunks * sizeof(hdz_index_t))) >> 10, ((uint64_t) src.sectors) >> 1);
+    ret = 0;
+    goto done;
+
+fail:
+    pclog("HDD packed: Unable to pack %s into %s\n", src_fn, fn);
+    if (fp != NULL)
+        fclose(fp);
+    fp = NULL;
+    remove(fn);
+
+done:
+    if (fp != NULL)
+        fclose(fp);
+    free(prev);
+    free(first);
+    free(hash);
+    if (pk != NULL) {
+        free(pk->data);
+        free(pk->comp);
+        free(pk->index);
+        free(pk);
+    }
+    hdd_packed_source_close(&src);
+
+    return ret;
+}
@@ -61,10 +61,25 @@
 #define MVHD_START_TS          946684800
 
 
+#define MVHD_BITMAP_CACHE_SIZE 16
+/* Metadata updates held back at most before they are written */
+#define MVHD_META_DIRTY_MAX    64
+
+typedef struct MVHDBitmapEntry {
+    uint8_t* data;
+    int      block;      /* -1 if the entry is unused */
+    bool     dirty;      /* Not written to the file yet */
+    uint32_t last_use;
+} MVHDBitmapEntry;
+
 typedef struct MVHDSectorBitmap {
-    uint8_t* curr_bitmap;
-    int      sector_count;
-    int      curr_block;
+    uint8_t*        curr_bitmap;
+    int             sector_count;
+    int             curr_block;
+    int             curr_entry;
+    uint32_t        use_count;
+    uint8_t*        mem;
+    MVHDBitmapEntry cache[MVHD_BITMAP_CACHE_SIZE];
 } MVHDSectorBitmap;
 
 typedef struct MVHDFooter {
@@ -121,6 +136,10 @@ struct MVHDMeta {
     MVHDFooter       footer;
     MVHDSparseHeader sparse;
     uint32_t*        block_offset;
+    uint32_t         bat_dirty_first; /* Range of BAT entries not written to the file yet */
+    uint32_t         bat_dirty_last;
+    bool             bat_dirty;
+    uint32_t         meta_dirty;      /* Bitmap and BAT updates not written to the file yet */
     int              sect_per_block;
     MVHDSectorBitmap bitmap;
     int (*read_sectors)(struct MVHDMeta*, uint32_t, int, void*);
@@ -274,6 +293,13 @@ struct MVHDMeta* mvhd_create_fixed_raw(const char* path, FILE* raw_img, uint64_t
  */
 bool mvhd_write_empty_sectors(FILE* f, int sector_count);
 
+/**
+ * \brief Write the cached sector bitmaps and BAT entries to the file
+ *
+ * \param [in] vhdm MiniVHD data structure
+ */
+void mvhd_flush_meta(struct MVHDMeta* vhdm);
+
 /**
  * \brief Read a fixed VHD image
  * 
@@ -152,10 +152,14 @@ read_bat(MVHDMeta *vhdm, MVHDError* err)
 
     mvhd_fseeko64(vhdm->f, vhdm->sparse.bat_offset, SEEK_SET);
 
-    for (uint32_t i = 0; i < vhdm->sparse.max_bat_ent; i++) {
-        (void) !fread(&vhdm->block_offset[i], sizeof *vhdm->block_offset, 1, vhdm->f);
+    /* The whole table in one go, it stays in memory from now on. */
+    (void) !fread(vhdm->block_offset, sizeof *vhdm->block_offset, vhdm->sparse.max_bat_ent, vhdm->f);
+    for (uint32_t i = 0; i < vhdm->sparse.max_bat_ent; i++)
         vhdm->block_offset[i] = mvhd_from_be32(vhdm->block_offset[i]);
-    }
+
+    vhdm->bat_dirty  = false;
+    vhdm->meta_dirty = 0;
+
     return 0;
 }
 
@@ -179,11 +183,11 @@ calc_sparse_values(MVHDMeta* vhdm)
 
 
 /**
- * \brief Allocate memory for a sector bitmap.
+ * \brief Allocate memory for the sector bitmap cache.
  *
  * Each data block is preceded by a sector bitmap. Each bit indicates whether the corresponding sector
  * is considered 'clean' or 'dirty' (for sparse VHD images), or whether to read from the parent or current
- * image (for differencing images).
+ * image (for differencing images). The bitmaps of the most recently used blocks are kept in memory.
  *
  * \param [in] vhdm MiniVHD data structure
  * \param [out] err this is populated with MVHD_ERR_MEM if the calloc fails
@@ -194,13 +198,23 @@ calc_sparse_values(MVHDMeta* vhdm)
 static int
 init_sector_bitmap(MVHDMeta* vhdm, MVHDError* err)
 {
-    vhdm->bitmap.curr_bitmap = calloc(vhdm->bitmap.sector_count, MVHD_SECTOR_SIZE);
-    if (vhdm->bitmap.curr_bitmap == NULL) {
+    vhdm->bitmap.mem = calloc((size_t) vhdm->bitmap.sector_count * MVHD_BITMAP_CACHE_SIZE, MVHD_SECTOR_SIZE);
+    if (vhdm->bitmap.mem == NULL) {
         *err = MVHD_ERR_MEM;
         return -1;
     }
 
-    vhdm->bitmap.curr_block = -1;
+    for (int i = 0; i < MVHD_BITMAP_CACHE_SIZE; i++) {
+        vhdm->bitmap.cache[i].data     = vhdm->bitmap.mem + ((size_t) i * vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+        vhdm->bitmap.cache[i].block    = -1;
+        vhdm->bitmap.cache[i].dirty    = false;
+        vhdm->bitmap.cache[i].last_use = 0;
+    }
+
+    vhdm->bitmap.curr_bitmap = vhdm->bitmap.cache[0].data;
+    vhdm->bitmap.curr_block  = -1;
+    vhdm->bitmap.curr_entry  = 0;
+    vhdm->bitmap.use_count   = 0;
 
     return 0;
 }
@@ -595,7 +609,8 @@ cleanup_format_buff:
     vhdm->format_buffer.zero_data = NULL;
 
 cleanup_bitmap:
-    free(vhdm->bitmap.curr_bitmap);
+    free(vhdm->bitmap.mem);
+    vhdm->bitmap.mem         = NULL;
     vhdm->bitmap.curr_bitmap = NULL;
 
 cleanup_bat:
@@ -624,14 +639,16 @@ mvhd_close(MVHDMeta* vhdm)
     if (vhdm->parent != NULL)
         mvhd_close(vhdm->parent);
 
+    mvhd_flush_meta(vhdm);
     fclose(vhdm->f);
 
     if (vhdm->block_offset != NULL) {
         free(vhdm->block_offset);
         vhdm->block_offset = NULL;
     }
-    if (vhdm->bitmap.curr_bitmap != NULL) {
-        free(vhdm->bitmap.curr_bitmap);
+    if (vhdm->bitmap.mem != NULL) {
+        free(vhdm->bitmap.mem);
+        vhdm->bitmap.mem         = NULL;
         vhdm->bitmap.curr_bitmap = NULL;
     }
     if (vhdm->format_buffer.zero_data != NULL) {
@@ -643,6 +660,17 @@ mvhd_close(MVHDMeta* vhdm)
 }
 
 
+MVHDAPI void
+mvhd_flush(MVHDMeta* vhdm)
+{
+    if (vhdm == NULL)
+        return;
+
+    mvhd_flush_meta(vhdm);
+    fflush(vhdm->f);
+}
+
+
 MVHDAPI int
 mvhd_diff_update_par_timestamp(MVHDMeta* vhdm, int* err)
 {
@@ -259,6 +259,16 @@ MVHDAPI MVHDMeta* mvhd_create_ex(MVHDCreationOptions options, int* err);
  */
 MVHDAPI void mvhd_close(MVHDMeta* vhdm);
 
+/**
+ * \brief Write all cached metadata of a VHD image to the file
+ *
+ * Sector bitmaps and BAT entries are cached and written back lazily, this makes
+ * sure everything written so far would survive the process going away.
+ *
+ * \param [in] vhdm MiniVHD data structure to flush
+ */
+MVHDAPI void mvhd_flush(MVHDMeta* vhdm);
+
 /**
  * \brief Calculate hard disk geometry from a provided size
  *
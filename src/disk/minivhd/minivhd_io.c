@@ -85,11 +85,15 @@ check_sectors(uint32_t offset, int num_sectors, uint32_t total_sectors, int *tra
 bool
 mvhd_write_empty_sectors(FILE *f, int sector_count)
 {
-    uint8_t zero_bytes[MVHD_SECTOR_SIZE] = {0};
+    static const uint8_t zero_bytes[MVHD_SECTOR_SIZE * 64] = {0};
+    int n;
 
-    for (int i = 0; i < sector_count; i++) {
-        if (!fwrite(zero_bytes, sizeof zero_bytes, 1, f))
+    /* Up to 32 KiB per call rather than a sector at a time. */
+    while (sector_count > 0) {
+        n = (sector_count < 64) ? sector_count : 64;
+        if (!fwrite(zero_bytes, MVHD_SECTOR_SIZE, n, f))
             return 0;
+        sector_count -= n;
     }
 
     fflush(f);
@@ -97,10 +101,32 @@ mvhd_write_empty_sectors(FILE *f, int sector_count)
 }
 
 /**
- * \brief Read the sector bitmap for a block.
+ * \brief Write a cached sector bitmap to file
  *
- * If the block is sparse, the sector bitmap in memory will be
- * zeroed. Otherwise, the sector bitmap is read from the VHD file.
+ * \param [in] vhdm MiniVHD data structure
+ * \param [in] ent The cache entry to write
+ */
+static void
+write_bitmap_entry(MVHDMeta *vhdm, MVHDBitmapEntry *ent)
+{
+    int64_t abs_offset = (int64_t)vhdm->block_offset[ent->block] * MVHD_SECTOR_SIZE;
+
+    if (mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET) == -1)
+        vhdm->error = 1;
+    if (!fwrite(ent->data, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f))
+        vhdm->error = 1;
+
+    ent->dirty = false;
+}
+
+/**
+ * \brief Make the sector bitmap for a block the current one.
+ *
+ * The bitmaps of the last MVHD_BITMAP_CACHE_SIZE blocks used are kept in
+ * memory. On a miss, the least recently used one is written back if it
+ * was changed, and replaced. If the block is sparse, the sector bitmap in
+ * memory will be zeroed. Otherwise, the sector bitmap is read from the
+ * VHD file. The file position is left undefined.
  *
  * \param [in] vhdm MiniVHD data structure
  * \param [in] blk The block for which to read the sector bitmap from
@@ -108,18 +134,44 @@ mvhd_write_empty_sectors(FILE *f, int sector_count)
 static void
 read_sect_bitmap(MVHDMeta *vhdm, int blk)
 {
-    if (vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
-        mvhd_fseeko64(vhdm->f, (uint64_t)vhdm->block_offset[blk] * MVHD_SECTOR_SIZE, SEEK_SET);
-        if (!fread(vhdm->bitmap.curr_bitmap, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE, 1, vhdm->f))
-            vhdm->error = 1;
-    } else
-        memset(vhdm->bitmap.curr_bitmap, 0, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+    MVHDSectorBitmap *bm = &vhdm->bitmap;
+    MVHDBitmapEntry *ent = NULL;
+    int victim = 0;
+
+    for (int i = 0; i < MVHD_BITMAP_CACHE_SIZE; i++) {
+        if (bm->cache[i].block == blk) {
+            ent = &bm->cache[i];
+            break;
+        }
+        if (bm->cache[i].last_use < bm->cache[victim].last_use)
+            victim = i;
+    }
+
+    if (ent == NULL) {
+        ent = &bm->cache[victim];
+        if (ent->dirty)
+            write_bitmap_entry(vhdm, ent);
+
+        if (vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
+            mvhd_fseeko64(vhdm->f, (uint64_t)vhdm->block_offset[blk] * MVHD_SECTOR_SIZE, SEEK_SET);
+            if (!fread(ent->data, bm->sector_count * MVHD_SECTOR_SIZE, 1, vhdm->f))
+                vhdm->error = 1;
+        } else
+            memset(ent->data, 0, bm->sector_count * MVHD_SECTOR_SIZE);
 
-    vhdm->bitmap.curr_block = blk;
+        ent->block = blk;
+    }
+
+    ent->last_use   = ++bm->use_count;
+    bm->curr_bitmap = ent->data;
+    bm->curr_block  = blk;
+    bm->curr_entry  = (int) (ent - bm->cache);
 }
 
 /**
- * \brief Write the current sector bitmap in memory to file
+ * \brief Mark the current sector bitmap in memory as changed
+ *
+ * It is written to file when it leaves the cache, or by mvhd_flush_meta().
  *
  * \param [in] vhdm MiniVHD data structure
  */
@@ -127,16 +179,16 @@ static void
 write_curr_sect_bitmap(MVHDMeta* vhdm)
 {
     if (vhdm->bitmap.curr_block >= 0) {
-        int64_t abs_offset = (int64_t)vhdm->block_offset[vhdm->bitmap.curr_block] * MVHD_SECTOR_SIZE;
-        if (mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET) == -1)
-            vhdm->error = 1;
-        if (!fwrite(vhdm->bitmap.curr_bitmap, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f))
-            vhdm->error = 1;
+        vhdm->bitmap.cache[vhdm->bitmap.curr_entry].dirty = true;
+        vhdm->meta_dirty++;
     }
 }
 
 /**
- * \brief Write block offset from memory into file
+ * \brief Mark a block offset in memory as changed
+ *
+ * The BAT stays in memory, changed entries are written to file as one
+ * range by mvhd_flush_meta().
  *
  * \param [in] vhdm MiniVHD data structure
  * \param [in] blk The block for which to write the offset for
@@ -144,14 +196,53 @@ write_curr_sect_bitmap(MVHDMeta* vhdm)
 static void
 write_bat_entry(MVHDMeta *vhdm, int blk)
 {
-    uint64_t table_offset = vhdm->sparse.bat_offset + ((uint64_t)blk * sizeof *vhdm->block_offset);
-    uint32_t offset = mvhd_to_be32(vhdm->block_offset[blk]);
+    if (!vhdm->bat_dirty) {
+        vhdm->bat_dirty_first = blk;
+        vhdm->bat_dirty_last  = blk;
+        vhdm->bat_dirty       = true;
+    } else if ((uint32_t) blk < vhdm->bat_dirty_first)
+        vhdm->bat_dirty_first = blk;
+    else if ((uint32_t) blk > vhdm->bat_dirty_last)
+        vhdm->bat_dirty_last = blk;
+
+    vhdm->meta_dirty++;
+}
+
+void
+mvhd_flush_meta(MVHDMeta *vhdm)
+{
+    uint32_t count;
+    uint32_t *buf;
+
+    /* Bitmaps first: until the BAT points at a new block, nothing can see them. */
+    for (int i = 0; i < MVHD_BITMAP_CACHE_SIZE; i++) {
+        if (vhdm->bitmap.cache[i].dirty)
+            write_bitmap_entry(vhdm, &vhdm->bitmap.cache[i]);
+    }
+
+    vhdm->meta_dirty = 0;
 
-    if (mvhd_fseeko64(vhdm->f, table_offset, SEEK_SET) == -1)
+    if (!vhdm->bat_dirty)
+        return;
+
+    count = vhdm->bat_dirty_last - vhdm->bat_dirty_first + 1;
+    buf = malloc(count * sizeof *buf);
+    if (buf == NULL) {
         vhdm->error = 1;
-    if (!fwrite(&offset, sizeof offset, 1, vhdm->f))
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+        buf[i] = mvhd_to_be32(vhdm->block_offset[vhdm->bat_dirty_first + i]);
+
+    if (mvhd_fseeko64(vhdm->f, vhdm->sparse.bat_offset + ((uint64_t)vhdm->bat_dirty_first * sizeof *buf), SEEK_SET) == -1)
         vhdm->error = 1;
-    fflush(vhdm->f);
+    if (!fwrite(buf, sizeof *buf, count, vhdm->f))
+        vhdm->error = 1;
+
+    free(buf);
+
+    vhdm->bat_dirty = false;
 }
 
 /**
@@ -200,11 +291,10 @@ create_block(MVHDMeta *vhdm, int blk)
 
     uint32_t sect_offset = (uint32_t)(abs_offset / MVHD_SECTOR_SIZE);
     int blk_size_sectors = vhdm->sparse.block_sz / MVHD_SECTOR_SIZE;
-    if (!mvhd_write_empty_sectors(vhdm->f, vhdm->bitmap.sector_count + blk_size_sectors))
-        vhdm->error = 1;
 
-    /* Add a bit of padding. That's what Windows appears to do, although it's not strictly necessary... */
-    if (!mvhd_write_empty_sectors(vhdm->f, 5))
+    /* Bitmap, block and a bit of padding (that's what Windows appears to do, although
+       it's not strictly necessary...) in one go. */
+    if (!mvhd_write_empty_sectors(vhdm->f, vhdm->bitmap.sector_count + blk_size_sectors + 5))
         vhdm->error = 1;
 
     /* And we finish with the footer */
@@ -250,35 +340,45 @@ mvhd_sparse_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buf
     uint32_t s = 0;
     uint32_t ls = 0;
     int blk = 0;
-    int prev_blk = -1;
     int sib = 0;
+    int run = 0;
+    int n = 0;
+    int set = 0;
     ls = offset + transfer_sectors;
 
-    for (s = offset; s < ls; s++) {
+    for (s = offset; s < ls; s += run) {
         blk = s / vhdm->sect_per_block;
         sib = s % vhdm->sect_per_block;
-        if (blk != prev_blk) {
-            prev_blk = blk;
-            if (vhdm->bitmap.curr_block != blk) {
-                read_sect_bitmap(vhdm, blk);
-                if (mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR) == -1)
-                    vhdm->error = 1;
-            } else {
-                addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
+        run = vhdm->sect_per_block - sib;
+        if ((uint32_t) run > (ls - s))
+            run = ls - s;
+
+        if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK) {
+            memset(buff, 0, run * MVHD_SECTOR_SIZE);
+            buff += run * MVHD_SECTOR_SIZE;
+            continue;
+        }
+
+        read_sect_bitmap(vhdm, blk);
+
+        /* One read per run of sectors that are present, zeroes for the ones that are not. */
+        for (int i = 0; i < run; i += n) {
+            set = !!VHD_TESTBIT(vhdm->bitmap.curr_bitmap, (sib + i));
+            for (n = 1; ((i + n) < run) && (!!VHD_TESTBIT(vhdm->bitmap.curr_bitmap, (sib + i + n)) == set); n++)
+                ;
+
+            if (set) {
+                addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib + i) *
                        MVHD_SECTOR_SIZE;
                 if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
                     vhdm->error = 1;
-            }
-        }
+                if (!fread(buff, MVHD_SECTOR_SIZE, n, vhdm->f) && !feof(vhdm->f))
+                    vhdm->error = 1;
+            } else
+                memset(buff, 0, n * MVHD_SECTOR_SIZE);
 
-        if (VHD_TESTBIT(vhdm->bitmap.curr_bitmap, sib)) {
-            if (!fread(buff, MVHD_SECTOR_SIZE, 1, vhdm->f) && !feof(vhdm->f))
-                vhdm->error = 1;
-        } else {
-            memset(buff, 0, MVHD_SECTOR_SIZE);
-            mvhd_fseeko64(vhdm->f, MVHD_SECTOR_SIZE, SEEK_CUR);
+            buff += n * MVHD_SECTOR_SIZE;
         }
-        buff += MVHD_SECTOR_SIZE;
     }
 
     return truncated_sectors;
@@ -366,49 +466,47 @@ mvhd_sparse_diff_write(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *i
     uint32_t s = 0;
     uint32_t ls = 0;
     int blk = 0;
-    int prev_blk = -1;
     int sib = 0;
+    int run = 0;
+    bool created = false;
     ls = offset + transfer_sectors;
 
     if (offset < total_sectors) {
-        for (s = offset; s < ls; s++) {
+        /* One write per block touched, the sector bitmaps are written back later. */
+        for (s = offset; s < ls; s += run) {
             blk = s / vhdm->sect_per_block;
             sib = s % vhdm->sect_per_block;
-            if (vhdm->bitmap.curr_block != blk && prev_blk >= 0) {
-                /* Write the sector bitmap for the previous block, before we replace it. */
-                write_curr_sect_bitmap(vhdm);
-            }
+            run = vhdm->sect_per_block - sib;
+            if ((uint32_t) run > (ls - s))
+                run = ls - s;
 
+            /* "read" the sector bitmap first, before creating a new block, as the bitmap will be
+               zero either way */
+            read_sect_bitmap(vhdm, blk);
             if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK) {
-                /* "read" the sector bitmap first, before creating a new block, as the bitmap will be
-                   zero either way */
-                read_sect_bitmap(vhdm, blk);
                 create_block(vhdm, blk);
+                created = true;
             }
 
-            if (blk != prev_blk) {
-                if (vhdm->bitmap.curr_block != blk) {
-                    read_sect_bitmap(vhdm, blk);
-                    if (mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR) == -1)
-                        vhdm->error = 1;
-                } else {
-                    addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
-                           MVHD_SECTOR_SIZE;
-                    if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
-                        vhdm->error = 1;
-                }
-                prev_blk = blk;
-            }
-
-            if (!fwrite(buff, MVHD_SECTOR_SIZE, 1, vhdm->f))
+            addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
+                   MVHD_SECTOR_SIZE;
+            if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
                 vhdm->error = 1;
-            VHD_SETBIT(vhdm->bitmap.curr_bitmap, sib);
-            buff += MVHD_SECTOR_SIZE;
+            if (!fwrite(buff, MVHD_SECTOR_SIZE, run, vhdm->f))
+                vhdm->error = 1;
+
+            for (int i = 0; i < run; i++)
+                VHD_SETBIT(vhdm->bitmap.curr_bitmap, (sib + i));
+            write_curr_sect_bitmap(vhdm);
+
+            buff += run * MVHD_SECTOR_SIZE;
         }
     }
 
-    /* And write the sector bitmap for the last block we visited to disk */
-    write_curr_sect_bitmap(vhdm);
+    /* Data written to a new block is lost on a crash until the BAT points
+       at it, and the rest is only held back for so long. */
+    if (created || (vhdm->meta_dirty >= MVHD_META_DIRTY_MAX))
+        mvhd_flush_meta(vhdm);
 
     fflush(vhdm->f);
 
@@ -31,6 +31,7 @@
 #include <86box/io.h>
 #include <86box/pic.h>
 #include <86box/dma.h>
+#include <86box/savestate.h>
 #include <86box/plat_unused.h>
 
 dma_t   dma[8];
@@ -1151,6 +1152,26 @@ dma_reset(void)
     dma_at = is286;
 }
 
+/* The scatter/gather I/O base is owned by the chipset and is not saved. */
+void
+dma_savestate(savestate_t *st)
+{
+    savestate_var(st, dma);
+    savestate_var(st, dma_e);
+    savestate_var(st, dma_m);
+    savestate_var(st, dmaregs);
+    savestate_var(st, dma_wp);
+    savestate_var(st, dma_stat);
+    savestate_var(st, dma_stat_rq);
+    savestate_var(st, dma_stat_rq_pc);
+    savestate_var(st, dma_stat_adv_pend);
+    savestate_var(st, dma_command);
+    savestate_var(st, dma_req_is_soft);
+    savestate_var(st, dma_advanced);
+    savestate_var(st, dma_mask);
+    savestate_var(st, dma_ps2);
+}
+
 void
 dma_remove_sg(void)
 {
@@ -1875,10 +1896,8 @@ dma_bm_read(uint32_t PhysAddress, uint8_t *DataRead, uint32_t TotalSize, int Tra
     n2 = TotalSize - n;
 
     /* Do the divisible block, if there is one. */
-    if (n) {
-        for (uint32_t i = 0; i < n; i += TransferSize)
-            mem_read_phys((void *) &(DataRead[i]), PhysAddress + i, TransferSize);
-    }
+    if (n)
+        mem_read_phys_block(DataRead, PhysAddress, n, TransferSize);
 
     /* Do the non-divisible block, if there is one. */
     if (n2) {
@@ -1898,10 +1917,8 @@ dma_bm_write(uint32_t PhysAddress, const uint8_t *DataWrite, uint32_t TotalSize,
     n2 = TotalSize - n;
 
     /* Do the divisible block, if there is one. */
-    if (n) {
-        for (uint32_t i = 0; i < n; i += TransferSize)
-            mem_write_phys((void *) &(DataWrite[i]), PhysAddress + i, TransferSize);
-    }
+    if (n)
+        mem_write_phys_block(DataWrite, PhysAddress, n, TransferSize);
 
     /* Do the non-divisible block, if there is one. */
     if (n2) {
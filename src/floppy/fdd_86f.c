@@ -178,6 +178,18 @@ typedef struct sector_t {
  *      If bits 6, 5 are 0, and bit 7 is 1, the extra bitcell count
  *      specifies the entire bitcell count
  */
+#define D86F_CACHE_TRACKS 256
+
+/* A proxied image's track as it was last encoded, so seeking back to it is a copy. */
+typedef struct d86f_track_cache_t {
+    uint32_t  raw_size[2];
+    uint32_t  words[2];
+    uint16_t  preceding_bit[2];
+    uint16_t  last_word[2];
+    uint16_t *encoded[2];
+    uint16_t *surface[2];
+} d86f_track_cache_t;
+
 typedef struct d86f_t {
     FILE     *fp;
     uint8_t   state;
@@ -223,6 +235,8 @@ typedef struct d86f_t {
     uint8_t    *outbuf;
     sector_t   *last_side_sector[2];
     uint16_t    crc_table[256];
+
+    d86f_track_cache_t *track_cache[D86F_CACHE_TRACKS];
 } d86f_t;
 
 static const uint8_t encoded_fm[64] = {
@@ -246,6 +260,9 @@ static const uint8_t encoded_mfm[64] = {
     0x4a, 0x49, 0x44, 0x45, 0x52, 0x51, 0x54, 0x55
 };
 
+/* Whole bytes encoded with the two preceding data bits, built from the tables above. */
+static uint16_t encoded_byte_table[2][4][256];
+
 static d86f_t  *d86f[FDD_NUM];
 static fdc_t   *d86f_fdc;
 uint64_t        poly = 0x42F0E1EBA9EA3693LL; /* ECMA normal */
@@ -256,6 +273,7 @@ void     d86f_writeback(int drive);
 uint8_t  d86f_poll_read_data(int drive, int side, uint16_t pos);
 void     d86f_poll_write_data(int drive, int side, uint16_t pos, uint8_t data);
 int      d86f_format_conditions(int drive);
+static void d86f_cache_free(int drive);
 
 #ifdef ENABLE_D86F_LOG
 int d86f_do_log = ENABLE_D86F_LOG;
@@ -579,6 +597,8 @@ d86f_unregister(int drive)
     d86f_handler[drive].check_crc         = 0;
 
     dev->version = 0x0063; /* Proxied formats report as version 0.99. */
+
+    d86f_cache_free(drive);
 }
 
 void
@@ -945,10 +965,6 @@ d86f_encode_byte(int drive, int sync, decoded_t b, decoded_t prev_b)
 {
     uint8_t  encoding = d86f_get_encoding(drive);
     uint8_t  bits89AB = prev_b.nibbles.nibble0;
-    uint8_t  bits7654 = b.nibbles.nibble1;
-    uint8_t  bits3210 = b.nibbles.nibble0;
-    uint16_t encoded_7654;
-    uint16_t encoded_3210;
     uint16_t result;
 
     if (encoding > 1)
@@ -993,13 +1009,7 @@ d86f_encode_byte(int drive, int sync, decoded_t b, decoded_t prev_b)
         }
     }
 
-    bits3210 += ((bits7654 & 3) << 4);
-    bits7654 += ((bits89AB & 3) << 4);
-    encoded_3210 = (encoding == 1) ? encoded_mfm[bits3210] : encoded_fm[bits3210];
-    encoded_7654 = (encoding == 1) ? encoded_mfm[bits7654] : encoded_fm[bits7654];
-    result       = (encoded_7654 << 8) | encoded_3210;
-
-    return result;
+    return encoded_byte_table[encoding][bits89AB & 3][b.byte];
 }
 
 static int
@@ -3000,6 +3010,114 @@ d86f_read_track(int drive, int track, int thin_track, int side, uint16_t *da, ui
     }
 }
 
+static void
+d86f_cache_invalidate(int drive, int track)
+{
+    d86f_t             *dev = d86f[drive];
+    d86f_track_cache_t *tc;
+
+    if ((track < 0) || (track >= D86F_CACHE_TRACKS) || (dev->track_cache[track] == NULL))
+        return;
+
+    tc = dev->track_cache[track];
+    for (int side = 0; side < 2; side++) {
+        free(tc->encoded[side]);
+        free(tc->surface[side]);
+    }
+    free(tc);
+    dev->track_cache[track] = NULL;
+}
+
+static void
+d86f_cache_free(int drive)
+{
+    for (int track = 0; track < D86F_CACHE_TRACKS; track++)
+        d86f_cache_invalidate(drive, track);
+}
+
+/*
+ * Proxied formats call this before encoding a track on seek. If the track
+ * was encoded before at the same raw size and has not been written to since,
+ * its bits are copied back and 1 is returned, and the format only needs to
+ * redo its own bookkeeping. Turbo mode needs the sector lists that encoding
+ * builds, so it always encodes.
+ */
+int
+d86f_cache_load(int drive, int track)
+{
+    d86f_t                   *dev = d86f[drive];
+    const d86f_track_cache_t *tc;
+    int                       sides;
+
+    if ((track < 0) || (track >= D86F_CACHE_TRACKS) || fdd_get_turbo(drive))
+        return 0;
+
+    tc = dev->track_cache[track];
+    if (tc == NULL)
+        return 0;
+
+    sides = d86f_get_sides(drive);
+    for (int side = 0; side < sides; side++) {
+        if (tc->raw_size[side] != d86f_handler[drive].get_raw_size(drive, side))
+            return 0;
+    }
+
+    for (int side = 0; side < sides; side++) {
+        dev->preceding_bit[side] = tc->preceding_bit[side];
+        dev->last_word[side]     = tc->last_word[side];
+        memcpy(dev->track_encoded_data[side], tc->encoded[side], tc->words[side] << 1);
+        if (tc->surface[side] && dev->track_surface_data[side])
+            memcpy(dev->track_surface_data[side], tc->surface[side], tc->words[side] << 1);
+    }
+
+    return 1;
+}
+
+/* Keep a copy of a track the format has just encoded. */
+void
+d86f_cache_store(int drive, int track)
+{
+    d86f_t             *dev = d86f[drive];
+    d86f_track_cache_t *tc;
+    int                 sides;
+    uint32_t            words;
+
+    if ((track < 0) || (track >= D86F_CACHE_TRACKS) || fdd_get_turbo(drive) || fdc_get_diswr(d86f_fdc))
+        return;
+
+    d86f_cache_invalidate(drive, track);
+
+    tc = (d86f_track_cache_t *) calloc(1, sizeof(d86f_track_cache_t));
+    if (tc == NULL)
+        return;
+    dev->track_cache[track] = tc;
+
+    sides = d86f_get_sides(drive);
+    for (int side = 0; side < sides; side++) {
+        tc->raw_size[side]      = d86f_handler[drive].get_raw_size(drive, side);
+        tc->preceding_bit[side] = dev->preceding_bit[side];
+        tc->last_word[side]     = dev->last_word[side];
+        words                   = MIN((tc->raw_size[side] + 15) >> 4, 53048);
+        tc->words[side]         = words;
+
+        tc->encoded[side] = (uint16_t *) malloc(words << 1);
+        if (tc->encoded[side] == NULL) {
+            d86f_cache_invalidate(drive, track);
+            return;
+        }
+        memcpy(tc->encoded[side], dev->track_encoded_data[side], words << 1);
+
+        if (d86f_has_surface_desc(drive) && dev->track_surface_data[side]) {
+            tc->surface[side] = (uint16_t *) malloc(words << 1);
+            if (tc->surface[side] == NULL) {
+                d86f_cache_invalidate(drive, track);
+                return;
+            }
+            memcpy(tc->surface[side], dev->track_surface_data[side], words << 1);
+        }
+    }
+}
+
 void
 d86f_zero_track(int drive)
 {
@@ -3303,6 +3421,9 @@ d86f_writesector(int drive, int sector, int track, int side, int rate, int secto
         return;
     }
 
+    /* The write goes into the current track's bits, so its cached copy goes stale. */
+    d86f_cache_invalidate(drive, dev->cur_track);
+
     ret = d86f_common_command(drive, sector, track, side, rate, sector_size);
     if (!ret)
         return;
@@ -3406,6 +3527,8 @@ d86f_common_format(int drive, int side, UNUSED(int rate), uint8_t fill, int prox
         return;
     }
 
+    d86f_cache_invalidate(drive, dev->cur_track);
+
     if (!d86f_can_format(drive)) {
         fdc_cannotformat(d86f_fdc);
         dev->state       = STATE_IDLE;
@@ -3886,8 +4009,19 @@ d86f_load(int drive, char *fn)
 void
 d86f_init(void)
 {
+    const uint8_t *table;
+
     for (uint8_t i = 0; i < FDD_NUM; i++)
         d86f[i] = NULL;
+
+    for (int encoding = 0; encoding < 2; encoding++) {
+        table = encoding ? encoded_mfm : encoded_fm;
+        for (int prev = 0; prev < 4; prev++) {
+            for (int byte = 0; byte < 256; byte++)
+                encoded_byte_table[encoding][prev][byte] = (table[(byte >> 4) | (prev << 4)] << 8) |
+                                                           table[(byte & 0x0f) | (((byte >> 4) & 3) << 4)];
+        }
+    }
 }
 
 void
@@ -3985,6 +4119,8 @@ d86f_destroy(int drive)
     d86f_destroy_linked_lists(drive, 0);
     d86f_destroy_linked_lists(drive, 1);
 
+    d86f_cache_free(drive);
+
     free(d86f[drive]);
     d86f[drive] = NULL;
 
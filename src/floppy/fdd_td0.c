@@ -1076,6 +1076,7 @@ td0_seek(int drive, int track)
     int     actual_sector   = 0;
     int     fm;
     int     sector_adjusted;
+    int     cached;
 
     if (dev->fp == NULL)
         return;
@@ -1102,6 +1103,8 @@ td0_seek(int drive, int track)
         return;
     }
 
+    cached = d86f_cache_load(drive, track);
+
     for (int side = 0; side < dev->sides; side++) {
         track_rate = dev->current_side_flags[side] & 7;
         /* Make sure 300 kbps @ 360 rpm is treated the same as 250 kbps @ 300 rpm. */
@@ -1119,7 +1122,8 @@ td0_seek(int drive, int track)
 
         interleave_type = track_is_interleave(drive, side, track);
 
-        current_pos     = d86f_prepare_pretrack(drive, side, 0);
+        if (!cached)
+            current_pos = d86f_prepare_pretrack(drive, side, 0);
         sector_adjusted = 0;
 
         if (!xdf_type) {
@@ -1142,7 +1146,8 @@ td0_seek(int drive, int track)
                     ssize = 3;
                 else
                     ssize = 128 << ((uint32_t) id[3]);
-                current_pos = d86f_prepare_sector(drive, side, current_pos, id, dev->sects[track][side][actual_sector].data, ssize, track_gap2, track_gap3, dev->sects[track][side][actual_sector].flags);
+                if (!cached)
+                    current_pos = d86f_prepare_sector(drive, side, current_pos, id, dev->sects[track][side][actual_sector].data, ssize, track_gap2, track_gap3, dev->sects[track][side][actual_sector].flags);
 
                 if (sector_adjusted == 0)
                     d86f_initialize_last_sector_id(drive, id[0], id[1], id[2], id[3]);
@@ -1165,10 +1170,12 @@ td0_seek(int drive, int track)
                     ssize = 3;
                 else
                     ssize = 128 << ((uint32_t) id[3]);
-                if (is_trackx)
-                    current_pos = d86f_prepare_sector(drive, side, xdf_trackx_spos[xdf_type][xdf_sector], id, dev->sects[track][side][ordered_pos].data, ssize, track_gap2, xdf_gap3_sizes[xdf_type][is_trackx], dev->sects[track][side][ordered_pos].flags);
-                else
-                    current_pos = d86f_prepare_sector(drive, side, current_pos, id, dev->sects[track][side][ordered_pos].data, ssize, track_gap2, xdf_gap3_sizes[xdf_type][is_trackx], dev->sects[track][side][ordered_pos].flags);
+                if (!cached) {
+                    if (is_trackx)
+                        current_pos = d86f_prepare_sector(drive, side, xdf_trackx_spos[xdf_type][xdf_sector], id, dev->sects[track][side][ordered_pos].data, ssize, track_gap2, xdf_gap3_sizes[xdf_type][is_trackx], dev->sects[track][side][ordered_pos].flags);
+                    else
+                        current_pos = d86f_prepare_sector(drive, side, current_pos, id, dev->sects[track][side][ordered_pos].data, ssize, track_gap2, xdf_gap3_sizes[xdf_type][is_trackx], dev->sects[track][side][ordered_pos].flags);
+                }
 
                 if (sector_adjusted == 0)
                     d86f_initialize_last_sector_id(drive, id[0], id[1], id[2], id[3]);
@@ -1178,6 +1185,9 @@ td0_seek(int drive, int track)
             }
         }
     }
+
+    if (!cached)
+        d86f_cache_store(drive, track);
 }
 
 void
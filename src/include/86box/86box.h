@@ -120,6 +120,9 @@ extern uint64_t source_hwnd;
 extern char rom_path[1024]; /* (O) full path to ROMs */
 extern char log_path[1024]; /* (O) full path of logfile */
 extern char vm_name[1024];  /* (O) display name of the VM */
+extern char savestate_load_path[1024]; /* (O) save state to restore on startup */
+extern char dynarec_prof_path[1024];   /* (O) dynarec profile report, empty = off */
+extern char savestate_exit_path[1024]; /* (O) save state to write on exit */
 #ifdef USE_INSTRUMENT
 extern uint8_t  instru_enabled;
 extern uint64_t instru_run_ms;
@@ -171,6 +174,7 @@ extern uint32_t mem_size;                   /* (C) memory size (Installed on sys
 extern uint32_t isa_mem_size;               /* (C) memory size (ISA Memory Cards) */
 extern int      cpu;                        /* (C) cpu type */
 extern int      cpu_use_dynarec;            /* (C) cpu uses/needs Dyna */
+extern int      cpu_dynarec_cache;          /* (C) keep dynarec blocks across runs */
 extern int      fpu_type;                   /* (C) fpu type */
 extern int      fpu_softfloat;              /* (C) fpu uses softfloat */
 extern int      time_sync;                  /* (C) enable time sync */
@@ -261,6 +265,8 @@ extern void pc_send_cad(void);
 extern void pc_send_cae(void);
 extern void pc_send_cab(void);
 extern void pc_run(void);
+extern int  pc_save_state(const char *fn);
+extern int  pc_load_state(const char *fn);
 extern void pc_start(void);
 extern void pc_onesec(void);
 
@@ -0,0 +1,42 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Definitions for the headless benchmark mode.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#ifndef EMU_BENCH_H
+#define EMU_BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int bench_seconds; /* (O) emulated seconds to run, 0 = off */
+extern int bench_active;  /* benchmark loop is running */
+
+/* Execution counters, updated by the CPU cores. */
+extern uint64_t bench_insns;           /* instructions retired */
+extern uint64_t bench_blocks_hit;      /* dynarec: compiled blocks executed */
+extern uint64_t bench_blocks_compiled; /* dynarec: blocks recompiled */
+extern uint64_t bench_blocks_marked;   /* dynarec: blocks interpreted and marked */
+
+/* Host time spent in timer callbacks, in microseconds. */
+extern uint64_t bench_timer_us;
+
+extern uint64_t bench_time_ns(void);
+extern uint64_t bench_time_us(void);
+extern void     bench_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*EMU_BENCH_H*/
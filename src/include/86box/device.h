@@ -155,6 +155,8 @@ typedef struct _device_config_ {
     const device_config_bios_t       bios[32];
 } device_config_t;
 
+struct savestate_t;
+
 typedef struct _device_ {
     const char *name;
     const char *internal_name;
@@ -172,6 +174,11 @@ typedef struct _device_ {
     void (*force_redraw)(void *priv);
 
     const device_config_t *config;
+
+    /* Save state handler, both saves and restores the state depending
+       on the direction of the savestate_t. */
+    void (*savestate)(void *priv, struct savestate_t *st);
+    uint32_t savestate_ver;
 } device_t;
 
 typedef struct device_context_t {
@@ -77,6 +77,13 @@ enum {
 };
 #endif
 
+enum {
+    HDD_OVERLAY_NONE    = 0,
+    HDD_OVERLAY_DISCARD = 1, /* New overlay on every start, deleted on close */
+    HDD_OVERLAY_COMMIT  = 2, /* New overlay on every start, written to the base on close */
+    HDD_OVERLAY_KEEP    = 3  /* Overlay kept across runs */
+};
+
 enum {
     HDD_OP_SEEK  = 0,
     HDD_OP_READ  = 2,
@@ -183,7 +190,11 @@ typedef struct hard_disk_t {
     uint32_t           vhd_blocksize;
 
     uint8_t            max_multiple_block;
-    uint8_t            pad1[3];
+    uint8_t            cache_writeback; /* Host cache holds writes back */
+    uint8_t            overlay;      /* HDD_OVERLAY_* */
+    uint8_t            mmap;         /* Map raw, HDI and HDX images into memory */
+
+    uint32_t           cache_size;   /* Host cache in MB, 0 = none */
 
     const char        *model;
 
@@ -223,9 +234,37 @@ extern void     hdd_image_unload(uint8_t id, int fn_preserve);
 extern void     hdd_image_close(uint8_t id);
 extern void     hdd_image_calc_chs(uint32_t *c, uint32_t *h, uint32_t *s, uint32_t size);
 
+extern int hdd_image_async; /* (C) queue IDE and SCSI disk I/O to a host thread */
+
+extern int hdd_image_read_async(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern int hdd_image_write_async(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern int hdd_image_busy(uint8_t id);
+extern int hdd_image_read_result(uint8_t id);
+extern int hdd_image_flush(uint8_t id);
+
+typedef struct hdd_overlay_t hdd_overlay_t;
+typedef int (*hdd_overlay_io_t)(void *priv, uint32_t sector, uint32_t count, uint8_t *buffer);
+
+extern hdd_overlay_t *hdd_overlay_open(const char *fn, uint32_t sectors, int reuse,
+                                       hdd_overlay_io_t base_read, hdd_overlay_io_t base_write, void *priv);
+extern int            hdd_overlay_read(hdd_overlay_t *ov, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern int            hdd_overlay_write(hdd_overlay_t *ov, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern int            hdd_overlay_commit(hdd_overlay_t *ov);
+extern void           hdd_overlay_close(hdd_overlay_t *ov, int discard);
+
+typedef struct hdd_packed_t hdd_packed_t;
+
+extern hdd_packed_t *hdd_packed_open(const char *fn);
+extern void          hdd_packed_get_geometry(hdd_packed_t *pk, uint32_t *spt, uint32_t *hpc, uint32_t *tracks);
+extern uint32_t      hdd_packed_get_sectors(hdd_packed_t *pk);
+extern int           hdd_packed_read(hdd_packed_t *pk, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern void          hdd_packed_close(hdd_packed_t *pk);
+extern int           hdd_packed_create(const char *src_fn, const char *fn);
+
 extern int image_is_hdi(const char *s);
 extern int image_is_hdx(const char *s, int check_signature);
 extern int image_is_vhd(const char *s, int check_signature);
+extern int image_is_hdz(const char *s, int check_signature);
 
 extern double      hdd_timing_write(hard_disk_t *hdd, uint32_t addr, uint32_t len);
 extern double      hdd_timing_read(hard_disk_t *hdd, uint32_t addr, uint32_t len);
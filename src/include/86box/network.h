@@ -43,6 +43,12 @@
 #ifndef EMU_NETWORK_H
 #define EMU_NETWORK_H
 #include <stdint.h>
+#ifdef __cplusplus
+#    include <atomic>
+using atomic_uint = std::atomic_uint;
+#else
+#    include <stdatomic.h>
+#endif
 
 /* Network provider types. */
 #define NET_TYPE_NONE     0 /* use the null network driver */
@@ -54,10 +60,13 @@
 #define NET_TYPE_NRSWITCH 6 /* use the network remote switch provider */
 
 #define NET_MAX_FRAME  1518
-/* Queue size must be a power of 2 */
-#define NET_QUEUE_LEN      16
-#define NET_QUEUE_LEN_MASK (NET_QUEUE_LEN - 1)
-#define NET_QUEUE_COUNT    4
+/* Frame buffers have room for a NIC to pad runts and append the FCS in place. */
+#define NET_FRAME_BUF_SIZE (NET_MAX_FRAME + 4)
+/* Queue sizes must be powers of 2 */
+#define NET_QUEUE_LEN      64 /* Default ring depth, also the host driver batch size */
+#define NET_QUEUE_LEN_MIN  16
+#define NET_QUEUE_LEN_MAX  1024
+#define NET_QUEUE_COUNT    5
 #define NET_CARD_MAX       4
 #define NET_HOST_INTF_MAX  64
 
@@ -87,7 +96,8 @@ enum {
     NET_QUEUE_RX       = 0,
     NET_QUEUE_TX_VM    = 1,
     NET_QUEUE_TX_HOST  = 2,
-    NET_QUEUE_RX_ON_TX = 3
+    NET_QUEUE_RX_ON_TX = 3,
+    NET_QUEUE_RX_LOCAL = 4 /* Received frames queued from the emulation thread */
 };
 
 typedef struct netcard_conf_t {
@@ -98,6 +108,9 @@ typedef struct netcard_conf_t {
     uint8_t  switch_group;
     uint8_t  promisc_mode;
     char     nrs_hostname[128];
+    uint16_t queue_len; /* Ring depth, 0 for the default */
+    uint8_t  switch_shm; /* Local switch over shared memory instead of multicast */
+    char     capture_fn[1024]; /* pcapng file to capture to, empty for none */
 } netcard_conf_t;
 
 extern netcard_conf_t net_cards_conf[NET_CARD_MAX];
@@ -112,14 +125,40 @@ typedef struct netpkt {
     int      len;
 } netpkt_t;
 
+/*
+ * Single producer, single consumer ring. The head and tail are free running
+ * and each is only ever written by one side, so neither needs a lock.
+ */
 typedef struct netqueue_t {
-    netpkt_t packets[NET_QUEUE_LEN];
-    int      head;
-    int      tail;
+    netpkt_t   *packets;
+    uint32_t    mask;
+    atomic_uint head; /* Written by the producer */
+    atomic_uint tail; /* Written by the consumer */
 } netqueue_t;
 
+typedef struct netcard_stats_t {
+    uint64_t rx_frames;
+    uint64_t rx_bytes;
+    uint64_t tx_frames;
+    uint64_t tx_bytes;
+    uint64_t rx_drops;    /* Lost on the host side, the RX ring was full */
+    uint64_t tx_drops;    /* Lost on the guest side, the TX ring was full */
+    uint64_t rx_overruns; /* The NIC had no room for a frame in guest memory */
+    /* Over the last second of emulated time */
+    uint32_t rx_fps;
+    uint32_t rx_bps;
+    uint32_t tx_fps;
+    uint32_t tx_bps;
+} netcard_stats_t;
+
 typedef struct _netcard_t netcard_t;
 
+/* Packet capture of a card, see net_capture.c */
+typedef struct net_capture_t net_capture_t;
+
+#define NET_CAPTURE_IN  1
+#define NET_CAPTURE_OUT 2
+
 typedef struct netdrv_t {
     void (*notify_in)(void *priv);
     void *(*init)(const netcard_t *card, const uint8_t *mac_addr, void *priv, char *netdrv_errbuf);
@@ -142,14 +181,18 @@ struct _netcard_t {
     NETSETLINKSTATE set_link_state;
     netqueue_t      queues[NET_QUEUE_COUNT];
     netpkt_t        queued_pkt;
-    mutex_t        *tx_mutex;
-    mutex_t        *rx_mutex;
     pc_timer_t      timer;
     uint16_t        card_num;
     double          byte_period;
     uint32_t        led_timer;
     uint32_t        led_state;
     uint32_t        link_state;
+    netcard_stats_t stats;
+    netcard_stats_t stats_last; /* Totals at the start of the rate window */
+    double          stats_period;
+    atomic_uint     rx_drops;   /* Counted from the host driver threads */
+    uint8_t         rx_stalled; /* The NIC already turned queued_pkt away */
+    net_capture_t  *capture;
 };
 
 typedef struct {
@@ -200,17 +243,26 @@ extern int             network_card_available(int);
 extern int             network_card_has_config(int);
 extern int             network_type_has_config(int);
 extern const char     *network_card_get_internal_name(int);
+extern int             network_card_get_stats(int id, netcard_stats_t *stats);
 extern int             network_card_get_from_internal_name(char *);
 #ifdef EMU_DEVICE_H
 extern const device_t *network_card_getdevice(int);
 #endif
 
+extern net_capture_t *net_capture_open(const char *fn, int card_num);
+extern void           net_capture_frame(net_capture_t *cap, const uint8_t *data, int len, int dir);
+extern void           net_capture_close(net_capture_t *cap);
+
 extern int network_tx_pop(netcard_t *card, netpkt_t *out_pkt);
 extern int network_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size);
 extern int network_rx_put(netcard_t *card, uint8_t *bufp, int len);
 extern int network_rx_on_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size);
 extern int network_rx_on_tx_put(netcard_t *card, uint8_t *bufp, int len);
 extern int network_rx_put_pkt(netcard_t *card, netpkt_t *pkt);
+extern uint8_t *network_rx_get_buf(netcard_t *card);
+extern int      network_rx_commit(netcard_t *card, int len);
+extern void     network_rx_drop(netcard_t *card);
+extern void     network_rx_overrun(netcard_t *card);
 extern int network_rx_on_tx_put_pkt(netcard_t *card, netpkt_t *pkt);
 
 #ifdef EMU_DEVICE_H
@@ -0,0 +1,85 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Definitions for the machine save state subsystem.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#ifndef EMU_SAVESTATE_H
+#define EMU_SAVESTATE_H
+
+#define SAVESTATE_MAGIC   "86BoxSST"
+#define SAVESTATE_VERSION 1
+
+#define SAVESTATE_TAG_LEN 64
+
+/*
+ * A save state is a header followed by a sequence of tagged sections:
+ *
+ *   char     tag[SAVESTATE_TAG_LEN];
+ *   uint32_t version;
+ *   uint64_t length;
+ *   uint8_t  data[length];
+ *
+ * Sections are written and read through the same callback - the
+ * callback calls savestate_data() (or one of the helper macros) for
+ * every field, and the savestate_t tells it which way the data goes.
+ * A section the loader does not know about is skipped, and a section
+ * that is missing from the file leaves its module in the state it
+ * was put in by the hard reset.
+ */
+typedef struct savestate_t {
+    FILE    *fp;
+    int      loading;    /* 0 = saving, 1 = loading */
+    int      error;
+    uint32_t version;    /* version of the section being processed */
+    int64_t  sect_start; /* file offset of the current section's data */
+    uint64_t sect_len;   /* length of the current section (loading only) */
+} savestate_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int  savestate_open(savestate_t *st, const char *fn, int loading);
+extern int  savestate_close(savestate_t *st);
+
+extern void savestate_begin(savestate_t *st, const char *tag, uint32_t version);
+extern void savestate_end(savestate_t *st);
+extern int  savestate_next(savestate_t *st, char *tag);
+extern void savestate_skip(savestate_t *st);
+
+extern void savestate_data(savestate_t *st, void *data, size_t len);
+
+#ifdef _TIMER_H_
+extern void savestate_timer(savestate_t *st, pc_timer_t *timer);
+#endif
+
+#define savestate_var(st, var) savestate_data((st), &(var), sizeof(var))
+
+/* Sync a structure up to (but not including) the given member, used to
+   skip the trailing host pointers of a structure. */
+#define savestate_struct_until(st, ptr, type, member) \
+    savestate_data((st), (ptr), offsetof(type, member))
+
+/* Core module state. */
+extern void cpu_savestate(savestate_t *st);
+extern void mem_savestate(savestate_t *st);
+extern void timer_savestate(savestate_t *st);
+extern void pic_savestate(savestate_t *st);
+extern void dma_savestate(savestate_t *st);
+extern int  device_savestate(savestate_t *st);
+extern int  device_loadstate(savestate_t *st, const char *tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*EMU_SAVESTATE_H*/
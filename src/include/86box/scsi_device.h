@@ -72,6 +72,7 @@
 #define GPCMD_ERASE_10                                0x2c
 #define GPCMD_WRITE_AND_VERIFY_10                     0x2e
 #define GPCMD_VERIFY_10                               0x2f
+#define GPCMD_SYNCHRONIZE_CACHE                       0x35
 #define GPCMD_READ_BUFFER                             0x3c
 #define GPCMD_WRITE_SAME_10                           0x41
 #define GPCMD_READ_SUBCHANNEL                         0x42
@@ -52,6 +52,11 @@ typedef struct pc_timer_t {
 
     struct pc_timer_t *prev;
     struct pc_timer_t *next;
+
+#ifdef USE_TIMER_HEAP
+    int      heap_pos; /* 1-based position in the timer heap, 0 if not queued. */
+    uint32_t heap_seq; /* Enable order, used to break ties the way the list does. */
+#endif
 } pc_timer_t;
 
 #ifdef __cplusplus
@@ -113,6 +113,11 @@ typedef struct svga_t {
     int lastline;
     int firstline_draw;
     int lastline_draw;
+    /* What the previous frame was blitted with, for damage reporting. */
+    int damage_valid;
+    int damage_y_add;
+    int damage_dpms;
+    uint32_t damage_overscan_color;
     int displine;
     int fullchange;
     int left_overscan;
@@ -373,6 +378,8 @@ extern int  svga_init(const device_t *info, svga_t *svga, void *priv, int memsiz
 extern void svga_recalctimings(svga_t *svga);
 extern void svga_close(svga_t *svga);
 
+extern uint32_t svga_conv_16to32(struct svga_t *svga, uint16_t color, uint8_t bpp);
+
 uint8_t  svga_read(uint32_t addr, void *priv);
 uint16_t svga_readw(uint32_t addr, void *priv);
 uint32_t svga_readl(uint32_t addr, void *priv);
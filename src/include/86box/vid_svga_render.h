@@ -35,6 +35,26 @@ extern uint8_t egaremap2bpp[256];
 
 extern void svga_recalc_remap_func(svga_t *svga);
 
+/* Pixel format conversion kernels, see vid_svga_render_simd.c. They may
+   read up to SVGA_CONV_SLACK bytes past the end of the source. */
+#define SVGA_CONV_SLACK 32
+
+typedef void (*svga_conv_func_t)(uint32_t *dst, const uint8_t *src, int count);
+typedef void (*svga_conv_8bpp_t)(uint32_t *dst, const uint8_t *src, int count, const uint32_t *pal, uint8_t mask);
+
+extern svga_conv_8bpp_t svga_conv_8bpp;
+extern svga_conv_func_t svga_conv_15bpp;
+extern svga_conv_func_t svga_conv_16bpp;
+extern svga_conv_func_t svga_conv_24bpp;
+extern svga_conv_func_t svga_conv_32bpp;
+
+extern void svga_render_simd_init(void);
+
+/* Threaded rendering, see vid_svga_render_mt.c. */
+extern int  svga_render_mt_queue(svga_t *svga);
+extern void svga_render_mt_fence(void);
+extern void svga_render_mt_close(void);
+
 extern void svga_render_null(svga_t *svga);
 extern void svga_render_blank(svga_t *svga);
 extern void svga_render_overscan_left(svga_t *svga);
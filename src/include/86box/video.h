@@ -221,6 +221,7 @@ extern int          herc_blend;
 extern int          vid_cga_contrast;
 extern int          video_grayscale;
 extern int          video_graytype;
+extern int          svga_render_threads;
 
 extern double cpuclock;
 extern int    emu_fps;
@@ -268,6 +269,8 @@ extern void video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monit
 extern void video_blit_complete_monitor(int monitor_index);
 extern void video_wait_for_blit_monitor(int monitor_index);
 extern void video_wait_for_buffer_monitor(int monitor_index);
+extern void video_set_damage_monitor(int y, int h, int monitor_index);
+extern void video_get_damage_monitor(int *y, int *h, int monitor_index);
 
 extern bitmap_t *create_bitmap(int w, int h);
 extern void      destroy_bitmap(bitmap_t *b);
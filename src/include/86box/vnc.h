@@ -19,6 +19,9 @@
 extern "C" {
 #endif
 
+extern int  vnc_max_fps;        /* (C) per-client update limit, 0 = none */
+extern char vnc_encodings[128]; /* (C) allowed encodings, empty = any */
+
 extern int  vnc_init(void *);
 extern void vnc_close(void);
 extern void vnc_resize(int x, int y);
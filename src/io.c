@@ -54,9 +54,44 @@ typedef struct {
     void     *priv;
 } io_trap_t;
 
-int   initialized = 0;
-io_t *io[NPORTS];
-io_t *io_last[NPORTS];
+/*
+ * Flattened dispatch for a port, rebuilt from the io[] list whenever a
+ * handler is added to or removed from the port, so that a guest access
+ * does not have to walk the list. The handlers are grouped by the type
+ * of access they serve, with the groups for split accesses holding the
+ * handlers that lack the wider function.
+ */
+enum {
+    IO_INB = 0,
+    IO_INW,
+    IO_INL,
+    IO_INB_SPLIT_W, /* inb, no inw */
+    IO_INB_SPLIT_L, /* inb, no inw or inl */
+    IO_INW_SPLIT_L, /* inw, no inl */
+    IO_OUTB,
+    IO_OUTW,
+    IO_OUTL,
+    IO_OUTB_SPLIT_W, /* outb, no outw */
+    IO_OUTB_SPLIT_L, /* outb, no outw or outl */
+    IO_OUTW_SPLIT_L, /* outw, no outl */
+    IO_TYPES
+};
+
+typedef struct io_disp_t {
+    /* The only handler involved in a byte/word/dword access, or NULL. */
+    io_t *fast_in[3];
+    io_t *fast_out[3];
+
+    io_t   **list;
+    int      alloc;
+    uint32_t gen;
+    uint16_t start[IO_TYPES + 1];
+} io_disp_t;
+
+int        initialized = 0;
+io_t      *io[NPORTS];
+io_t      *io_last[NPORTS];
+io_disp_t *io_disp[NPORTS];
 
 #ifdef ENABLE_IO_LOG
 int io_do_log = ENABLE_IO_LOG;
@@ -76,6 +111,131 @@ io_log(const char *fmt, ...)
 #    define io_log(fmt, ...)
 #endif
 
+static int
+io_disp_match(io_t *p, int type)
+{
+    switch (type) {
+        case IO_INB:
+            return !!p->inb;
+        case IO_INW:
+            return !!p->inw;
+        case IO_INL:
+            return !!p->inl;
+        case IO_INB_SPLIT_W:
+            return p->inb && !p->inw;
+        case IO_INB_SPLIT_L:
+            return p->inb && !p->inw && !p->inl;
+        case IO_INW_SPLIT_L:
+            return p->inw && !p->inl;
+        case IO_OUTB:
+            return !!p->outb;
+        case IO_OUTW:
+            return !!p->outw;
+        case IO_OUTL:
+            return !!p->outl;
+        case IO_OUTB_SPLIT_W:
+            return p->outb && !p->outw;
+        case IO_OUTB_SPLIT_L:
+            return p->outb && !p->outw && !p->outl;
+        case IO_OUTW_SPLIT_L:
+            return p->outw && !p->outl;
+
+        default:
+            return 0;
+    }
+}
+
+static __inline int
+io_disp_count(uint16_t port, int type)
+{
+    const io_disp_t *d = io_disp[port];
+
+    return d ? (d->start[type + 1] - d->start[type]) : 0;
+}
+
+static __inline io_t *
+io_disp_single(uint16_t port, int type)
+{
+    const io_disp_t *d = io_disp[port];
+
+    return (io_disp_count(port, type) == 1) ? d->list[d->start[type]] : NULL;
+}
+
+/* Work out whether accesses starting at the port only involve one handler. */
+static void
+io_disp_update_fast(uint16_t port)
+{
+    io_disp_t *d = io_disp[port];
+
+    if (d == NULL)
+        return;
+
+    d->fast_in[0]  = io_disp_single(port, IO_INB);
+    d->fast_out[0] = io_disp_single(port, IO_OUTB);
+
+    d->fast_in[1] = NULL;
+    if (!io_disp_count(port, IO_INB_SPLIT_W) && !io_disp_count(port + 1, IO_INB_SPLIT_W))
+        d->fast_in[1] = io_disp_single(port, IO_INW);
+    d->fast_out[1] = NULL;
+    if (!io_disp_count(port, IO_OUTB_SPLIT_W) && !io_disp_count(port + 1, IO_OUTB_SPLIT_W))
+        d->fast_out[1] = io_disp_single(port, IO_OUTW);
+
+    d->fast_in[2] = NULL;
+    if (!io_disp_count(port, IO_INW_SPLIT_L) && !io_disp_count(port + 2, IO_INW_SPLIT_L) &&
+        !io_disp_count(port, IO_INB_SPLIT_L) && !io_disp_count(port + 1, IO_INB_SPLIT_L) &&
+        !io_disp_count(port + 2, IO_INB_SPLIT_L) && !io_disp_count(port + 3, IO_INB_SPLIT_L))
+        d->fast_in[2] = io_disp_single(port, IO_INL);
+    d->fast_out[2] = NULL;
+    if (!io_disp_count(port, IO_OUTW_SPLIT_L) && !io_disp_count(port + 2, IO_OUTW_SPLIT_L) &&
+        !io_disp_count(port, IO_OUTB_SPLIT_L) && !io_disp_count(port + 1, IO_OUTB_SPLIT_L) &&
+        !io_disp_count(port + 2, IO_OUTB_SPLIT_L) && !io_disp_count(port + 3, IO_OUTB_SPLIT_L))
+        d->fast_out[2] = io_disp_single(port, IO_OUTL);
+}
+
+/*
+ * Rebuild the dispatch for a port after its handler list changed. This
+ * can happen from within a handler (a device remapping itself), so the
+ * structure is updated in place and never freed here - the dispatch
+ * loops re-read it on every iteration.
+ */
+static void
+io_disp_rebuild(uint16_t port)
+{
+    io_disp_t *d = io_disp[port];
+    io_t      *p;
+    int        n = 0;
+
+    for (p = io[port]; p != NULL; p = p->next)
+        n++;
+
+    if ((d == NULL) && (n > 0)) {
+        d = (io_disp_t *) calloc(1, sizeof(io_disp_t));
+        io_disp[port] = d;
+    }
+
+    if (d != NULL) {
+        if ((n * (IO_TYPES / 2)) > d->alloc) {
+            d->alloc = n * (IO_TYPES / 2);
+            d->list  = (io_t **) realloc(d->list, d->alloc * sizeof(io_t *));
+        }
+
+        n = 0;
+        for (int t = 0; t < IO_TYPES; t++) {
+            d->start[t] = n;
+            for (p = io[port]; p != NULL; p = p->next) {
+                if (io_disp_match(p, t))
+                    d->list[n++] = p;
+            }
+        }
+        d->start[IO_TYPES] = n;
+        d->gen++;
+    }
+
+    /* Split accesses starting up to three ports below also use this one. */
+    for (int i = 0; i < 4; i++)
+        io_disp_update_fast(port - i);
+}
+
 void
 io_init(void)
 {
@@ -84,8 +244,10 @@ io_init(void)
     io_t *q;
 
     if (!initialized) {
-        for (c = 0; c < NPORTS; c++)
+        for (c = 0; c < NPORTS; c++) {
             io[c] = io_last[c] = NULL;
+            io_disp[c]         = NULL;
+        }
         initialized = 1;
     }
 
@@ -104,6 +266,12 @@ io_init(void)
 
         /* io[c] should be NULL. */
         io[c] = io_last[c] = NULL;
+
+        if (io_disp[c]) {
+            free(io_disp[c]->list);
+            free(io_disp[c]);
+            io_disp[c] = NULL;
+        }
     }
 }
 
@@ -146,6 +314,8 @@ io_sethandler_common(uint16_t base, int size,
         io_last[base + c] = q;
 
         q = NULL;
+
+        io_disp_rebuild(base + c);
     }
 }
 
@@ -179,6 +349,7 @@ io_removehandler_common(uint16_t base, int size,
                     io_last[base + c] = p->prev;
                 free(p);
                 p = NULL;
+                io_disp_rebuild(base + c);
                 break;
             }
             p = q;
@@ -332,15 +503,176 @@ io_debug_check_addr(uint16_t addr)
 }
 #endif
 
+/*
+ * Find where to continue after a handler changed the handlers of the
+ * port it was called for. Like the original list walk, this continues
+ * with the handler that followed the one that was called.
+ */
+static int
+io_disp_resume(const io_disp_t *d, int type, const io_t *next)
+{
+    if (next != NULL) {
+        for (int i = d->start[type]; i < d->start[type + 1]; i++) {
+            if (d->list[i] == next)
+                return i;
+        }
+    }
+
+    return d->start[type + 1];
+}
+
+static __inline const io_t *
+io_disp_peek(const io_disp_t *d, int type, int i)
+{
+    return ((i + 1) < d->start[type + 1]) ? d->list[i + 1] : NULL;
+}
+
+/*
+ * Run all the handlers of the given type on a port, and return how many
+ * there were. Used when an access involves more than one handler.
+ */
+static int
+io_disp_inb(uint16_t port, int type, uint8_t *ret)
+{
+    io_disp_t  *d = io_disp[port];
+    io_t       *p;
+    const io_t *next;
+    uint32_t    gen;
+    int         n = 0;
+
+    if (d != NULL) {
+        for (int i = d->start[type]; i < d->start[type + 1]; n++) {
+            p    = d->list[i];
+            next = io_disp_peek(d, type, i);
+            gen  = d->gen;
+            *ret &= p->inb(port, p->priv);
+            i = (d->gen == gen) ? (i + 1) : io_disp_resume(d, type, next);
+        }
+    }
+
+    return n;
+}
+
+static int
+io_disp_inw(uint16_t port, int type, uint16_t *ret)
+{
+    io_disp_t  *d = io_disp[port];
+    io_t       *p;
+    const io_t *next;
+    uint32_t    gen;
+    int         n = 0;
+
+    if (d != NULL) {
+        for (int i = d->start[type]; i < d->start[type + 1]; n++) {
+            p    = d->list[i];
+            next = io_disp_peek(d, type, i);
+            gen  = d->gen;
+            *ret &= p->inw(port, p->priv);
+            i = (d->gen == gen) ? (i + 1) : io_disp_resume(d, type, next);
+        }
+    }
+
+    return n;
+}
+
+static int
+io_disp_inl(uint16_t port, uint32_t *ret)
+{
+    io_disp_t  *d = io_disp[port];
+    io_t       *p;
+    const io_t *next;
+    uint32_t    gen;
+    int         n = 0;
+
+    if (d != NULL) {
+        for (int i = d->start[IO_INL]; i < d->start[IO_INL + 1]; n++) {
+            p    = d->list[i];
+            next = io_disp_peek(d, IO_INL, i);
+            gen  = d->gen;
+            *ret &= p->inl(port, p->priv);
+            i = (d->gen == gen) ? (i + 1) : io_disp_resume(d, IO_INL, next);
+        }
+    }
+
+    return n;
+}
+
+static int
+io_disp_outb(uint16_t port, int type, uint8_t val)
+{
+    io_disp_t  *d = io_disp[port];
+    io_t       *p;
+    const io_t *next;
+    uint32_t    gen;
+    int         n = 0;
+
+    if (d != NULL) {
+        for (int i = d->start[type]; i < d->start[type + 1]; n++) {
+            p    = d->list[i];
+            next = io_disp_peek(d, type, i);
+            gen  = d->gen;
+            p->outb(port, val, p->priv);
+            i = (d->gen == gen) ? (i + 1) : io_disp_resume(d, type, next);
+        }
+    }
+
+    return n;
+}
+
+static int
+io_disp_outw(uint16_t port, int type, uint16_t val)
+{
+    io_disp_t  *d = io_disp[port];
+    io_t       *p;
+    const io_t *next;
+    uint32_t    gen;
+    int         n = 0;
+
+    if (d != NULL) {
+        for (int i = d->start[type]; i < d->start[type + 1]; n++) {
+            p    = d->list[i];
+            next = io_disp_peek(d, type, i);
+            gen  = d->gen;
+            p->outw(port, val, p->priv);
+            i = (d->gen == gen) ? (i + 1) : io_disp_resume(d, type, next);
+        }
+    }
+
+    return n;
+}
+
+static int
+io_disp_outl(uint16_t port, uint32_t val)
+{
+    io_disp_t  *d = io_disp[port];
+    io_t       *p;
+    const io_t *next;
+    uint32_t    gen;
+    int         n = 0;
+
+    if (d != NULL) {
+        for (int i = d->start[IO_OUTL]; i < d->start[IO_OUTL + 1]; n++) {
+            p    = d->list[i];
+            next = io_disp_peek(d, IO_OUTL, i);
+            gen  = d->gen;
+            p->outl(port, val, p->priv);
+            i = (d->gen == gen) ? (i + 1) : io_disp_resume(d, IO_OUTL, next);
+        }
+    }
+
+    return n;
+}
+
 uint8_t
 inb(uint16_t port)
 {
-    uint8_t ret = 0xff;
-    io_t   *p;
-    io_t   *q;
-    int     found  = 0;
+    uint8_t    ret = 0xff;
+    io_disp_t *d;
+    io_t      *p;
+    int        n;
+    int        found  = 0;
 #ifdef ENABLE_IO_LOG
-    int     qfound = 0;
+    int        qfound = 0;
 #endif
 
     io_port = port;
@@ -361,19 +693,17 @@ inb(uint16_t port)
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
-    } else {
-        p = io[port];
-        while (p) {
-            q = p->next;
-            if (p->inb) {
-                ret &= p->inb(port, p->priv);
-                found |= 1;
+    } else if (((d = io_disp[port]) != NULL) && ((p = d->fast_in[0]) != NULL)) {
+        ret   = p->inb(port, p->priv);
+        found = 1;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+        qfound = 1;
+#endif
+    } else if ((n = io_disp_inb(port, IO_INB, &ret)) != 0) {
+        found |= 1;
+#ifdef ENABLE_IO_LOG
+        qfound += n;
 #endif
-            }
-            p = q;
-        }
     }
 
     if (amstrad_latch & 0x80000000) {
@@ -402,11 +732,12 @@ inb(uint16_t port)
 void
 outb(uint16_t port, uint8_t val)
 {
-    io_t *p;
-    io_t *q;
-    int   found  = 0;
+    io_disp_t *d;
+    io_t      *p;
+    int        n;
+    int        found  = 0;
 #ifdef ENABLE_IO_LOG
-    int   qfound = 0;
+    int        qfound = 0;
 #endif
 
     io_port = port;
@@ -428,19 +759,17 @@ outb(uint16_t port, uint8_t val)
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
-    } else {
-        p = io[port];
-        while (p) {
-            q = p->next;
-            if (p->outb) {
-                p->outb(port, val, p->priv);
-                found |= 1;
+    } else if (((d = io_disp[port]) != NULL) && ((p = d->fast_out[0]) != NULL)) {
+        p->outb(port, val, p->priv);
+        found = 1;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+        qfound = 1;
+#endif
+    } else if ((n = io_disp_outb(port, IO_OUTB, val)) != 0) {
+        found |= 1;
+#ifdef ENABLE_IO_LOG
+        qfound += n;
 #endif
-            }
-            p = q;
-        }
     }
 
     if (!found || (port == 0x84)) {
@@ -459,14 +788,15 @@ outb(uint16_t port, uint8_t val)
 uint16_t
 inw(uint16_t port)
 {
-    io_t    *p;
-    io_t    *q;
-    uint16_t ret    = 0xffff;
-    int      found  = 0;
+    io_disp_t *d;
+    io_t      *p;
+    uint16_t   ret    = 0xffff;
+    int        n;
+    int        found  = 0;
 #ifdef ENABLE_IO_LOG
-    int      qfound = 0;
+    int        qfound = 0;
 #endif
-    uint8_t  ret8[2];
+    uint8_t    ret8[2];
 
     io_port = port;
 
@@ -485,35 +815,29 @@ inw(uint16_t port)
         found = 2;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
+#endif
+    } else if (((d = io_disp[port]) != NULL) && ((p = d->fast_in[1]) != NULL)) {
+        ret   = p->inw(port, p->priv);
+        found = 2;
+#ifdef ENABLE_IO_LOG
+        qfound = 1;
 #endif
     } else {
-        p = io[port];
-        while (p) {
-            q = p->next;
-            if (p->inw) {
-                ret &= p->inw(port, p->priv);
-                found |= 2;
+        if ((n = io_disp_inw(port, IO_INW, &ret)) != 0) {
+            found |= 2;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+            qfound += n;
 #endif
-            }
-            p = q;
         }
 
         ret8[0] = ret & 0xff;
         ret8[1] = (ret >> 8) & 0xff;
         for (uint8_t i = 0; i < 2; i++) {
-            p = io[(port + i) & 0xffff];
-            while (p) {
-                q = p->next;
-                if (p->inb && !p->inw) {
-                    ret8[i] &= p->inb(port + i, p->priv);
-                    found |= 1;
+            if ((n = io_disp_inb(port + i, IO_INB_SPLIT_W, &ret8[i])) != 0) {
+                found |= 1;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+                qfound += n;
 #endif
-                }
-                p = q;
             }
         }
         ret = (ret8[1] << 8) | ret8[0];
@@ -539,11 +863,12 @@ inw(uint16_t port)
 void
 outw(uint16_t port, uint16_t val)
 {
-    io_t *p;
-    io_t *q;
-    int   found  = 0;
+    io_disp_t *d;
+    io_t      *p;
+    int        n;
+    int        found  = 0;
 #ifdef ENABLE_IO_LOG
-    int   qfound = 0;
+    int        qfound = 0;
 #endif
 
     io_port = port;
@@ -564,33 +889,27 @@ outw(uint16_t port, uint16_t val)
         found = 2;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
+#endif
+    } else if (((d = io_disp[port]) != NULL) && ((p = d->fast_out[1]) != NULL)) {
+        p->outw(port, val, p->priv);
+        found = 2;
+#ifdef ENABLE_IO_LOG
+        qfound = 1;
 #endif
     } else {
-        p = io[port];
-        while (p) {
-            q = p->next;
-            if (p->outw) {
-                p->outw(port, val, p->priv);
-                found |= 2;
+        if ((n = io_disp_outw(port, IO_OUTW, val)) != 0) {
+            found |= 2;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+            qfound += n;
 #endif
-            }
-            p = q;
         }
 
         for (uint8_t i = 0; i < 2; i++) {
-            p = io[(port + i) & 0xffff];
-            while (p) {
-                q = p->next;
-                if (p->outb && !p->outw) {
-                    p->outb(port + i, val >> (i << 3), p->priv);
-                    found |= 1;
+            if ((n = io_disp_outb(port + i, IO_OUTB_SPLIT_W, val >> (i << 3))) != 0) {
+                found |= 1;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+                qfound += n;
 #endif
-                }
-                p = q;
             }
         }
     }
@@ -611,14 +930,15 @@ outw(uint16_t port, uint16_t val)
 uint32_t
 inl(uint16_t port)
 {
-    io_t    *p;
-    io_t    *q;
-    uint32_t ret = 0xffffffff;
-    uint16_t ret16[2];
-    uint8_t  ret8[4];
-    int      found  = 0;
+    io_disp_t *d;
+    io_t      *p;
+    uint32_t   ret = 0xffffffff;
+    uint16_t   ret16[2];
+    uint8_t    ret8[4];
+    int        n;
+    int        found  = 0;
 #ifdef ENABLE_IO_LOG
-    int      qfound = 0;
+    int        qfound = 0;
 #endif
 
     io_port = port;
@@ -638,47 +958,30 @@ inl(uint16_t port)
         found = 4;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
+#endif
+    } else if (((d = io_disp[port]) != NULL) && ((p = d->fast_in[2]) != NULL)) {
+        ret   = p->inl(port, p->priv);
+        found = 4;
+#ifdef ENABLE_IO_LOG
+        qfound = 1;
 #endif
     } else {
-        p = io[port];
-        while (p) {
-            q = p->next;
-            if (p->inl) {
-                ret &= p->inl(port, p->priv);
-                found |= 4;
+        if ((n = io_disp_inl(port, &ret)) != 0) {
+            found |= 4;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+            qfound += n;
 #endif
-            }
-            p = q;
         }
 
         ret16[0] = ret & 0xffff;
         ret16[1] = (ret >> 16) & 0xffff;
-        p        = io[port & 0xffff];
-        while (p) {
-            q = p->next;
-            if (p->inw && !p->inl) {
-                ret16[0] &= p->inw(port, p->priv);
-                found |= 2;
-#ifdef ENABLE_IO_LOG
-                qfound++;
-#endif
-            }
-            p = q;
-        }
-
-        p = io[(port + 2) & 0xffff];
-        while (p) {
-            q = p->next;
-            if (p->inw && !p->inl) {
-                ret16[1] &= p->inw(port + 2, p->priv);
+        for (uint8_t i = 0; i < 2; i++) {
+            if ((n = io_disp_inw(port + (i << 1), IO_INW_SPLIT_L, &ret16[i])) != 0) {
                 found |= 2;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+                qfound += n;
 #endif
             }
-            p = q;
         }
         ret = (ret16[1] << 16) | ret16[0];
 
@@ -687,17 +990,11 @@ inl(uint16_t port)
         ret8[2] = (ret >> 16) & 0xff;
         ret8[3] = (ret >> 24) & 0xff;
         for (uint8_t i = 0; i < 4; i++) {
-            p = io[(port + i) & 0xffff];
-            while (p) {
-                q = p->next;
-                if (p->inb && !p->inw && !p->inl) {
-                    ret8[i] &= p->inb(port + i, p->priv);
-                    found |= 1;
+            if ((n = io_disp_inb(port + i, IO_INB_SPLIT_L, &ret8[i])) != 0) {
+                found |= 1;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+                qfound += n;
 #endif
-                }
-                p = q;
             }
         }
         ret = (ret8[3] << 24) | (ret8[2] << 16) | (ret8[1] << 8) | ret8[0];
@@ -723,13 +1020,14 @@ inl(uint16_t port)
 void
 outl(uint16_t port, uint32_t val)
 {
-    io_t *p;
-    io_t *q;
-    int   found  = 0;
+    io_disp_t *d;
+    io_t      *p;
+    int        n;
+    int        found  = 0;
 #ifdef ENABLE_IO_LOG
-    int   qfound = 0;
+    int        qfound = 0;
 #endif
-    int   i      = 0;
+    int        i      = 0;
 
     io_port = port;
     io_val  = val;
@@ -749,50 +1047,36 @@ outl(uint16_t port, uint32_t val)
         found = 4;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
+#endif
+    } else if (((d = io_disp[port]) != NULL) && ((p = d->fast_out[2]) != NULL)) {
+        p->outl(port, val, p->priv);
+        found = 4;
+#ifdef ENABLE_IO_LOG
+        qfound = 1;
 #endif
     } else {
-        p = io[port];
-        if (p) {
-            while (p) {
-                q = p->next;
-                if (p->outl) {
-                    p->outl(port, val, p->priv);
-                    found |= 4;
+        if ((n = io_disp_outl(port, val)) != 0) {
+            found |= 4;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+            qfound += n;
 #endif
-                }
-                p = q;
-            }
         }
 
         for (i = 0; i < 4; i += 2) {
-            p = io[(port + i) & 0xffff];
-            while (p) {
-                q = p->next;
-                if (p->outw && !p->outl) {
-                    p->outw(port + i, val >> (i << 3), p->priv);
-                    found |= 2;
+            if ((n = io_disp_outw(port + i, IO_OUTW_SPLIT_L, val >> (i << 3))) != 0) {
+                found |= 2;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+                qfound += n;
 #endif
-                }
-                p = q;
             }
         }
 
         for (i = 0; i < 4; i++) {
-            p = io[(port + i) & 0xffff];
-            while (p) {
-                q = p->next;
-                if (p->outb && !p->outw && !p->outl) {
-                    p->outb(port + i, val >> (i << 3), p->priv);
-                    found |= 1;
+            if ((n = io_disp_outb(port + i, IO_OUTB_SPLIT_L, val >> (i << 3))) != 0) {
+                found |= 1;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+                qfound += n;
 #endif
-                }
-                p = q;
             }
         }
     }
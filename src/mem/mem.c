@@ -37,6 +37,7 @@
 #include <86box/mem.h>
 #include <86box/plat.h>
 #include <86box/rom.h>
+#include <86box/savestate.h>
 #include <86box/gdbstub.h>
 #ifdef USE_DYNAREC
 #    include "codegen_public.h"
@@ -1772,6 +1773,76 @@ mem_write_phys(void *src, uint32_t addr, int transfer_size)
     }
 }
 
+/*
+ * Bus master copies: where a whole granule is plain memory, copy it in one
+ * go, anything else goes a unit at a time through mem_read_phys() and
+ * mem_write_phys(). Either way, the guest sees the same accesses.
+ */
+static uint8_t *
+mem_phys_block_ptr(mem_mapping_t *map, uint32_t addr, uint32_t len)
+{
+    uint32_t offset;
+
+    if (!cpu_use_exec || (map == NULL) || (map->exec == NULL) || (len == 0))
+        return NULL;
+
+    /* The mapping may mirror itself, in which case the range must not wrap. */
+    offset = (addr - map->base) & map->mask;
+    if ((offset + len - 1) != ((addr + len - 1 - map->base) & map->mask))
+        return NULL;
+
+    return &(map->exec[offset]);
+}
+
+void
+mem_read_phys_block(uint8_t *dest, uint32_t addr, uint32_t size, int transfer_size)
+{
+    uint32_t chunk;
+    uint8_t *p;
+
+    while (size > 0) {
+        /* Only whole units that do not cross into the next granule. */
+        chunk = MIN(size, MEM_GRANULARITY_SIZE - (addr & MEM_GRANULARITY_MASK)) & ~(transfer_size - 1);
+        p     = mem_phys_block_ptr(read_mapping_bus[addr >> MEM_GRANULARITY_BITS], addr, chunk);
+
+        if (p != NULL) {
+            mem_logical_addr = 0xffffffff;
+            memcpy(dest, p, chunk);
+        } else {
+            chunk = transfer_size;
+            mem_read_phys(dest, addr, transfer_size);
+        }
+
+        dest += chunk;
+        addr += chunk;
+        size -= chunk;
+    }
+}
+
+void
+mem_write_phys_block(const uint8_t *src, uint32_t addr, uint32_t size, int transfer_size)
+{
+    uint32_t chunk;
+    uint8_t *p;
+
+    while (size > 0) {
+        chunk = MIN(size, MEM_GRANULARITY_SIZE - (addr & MEM_GRANULARITY_MASK)) & ~(transfer_size - 1);
+        p     = mem_phys_block_ptr(write_mapping_bus[addr >> MEM_GRANULARITY_BITS], addr, chunk);
+
+        if (p != NULL) {
+            mem_logical_addr = 0xffffffff;
+            memcpy(p, src, chunk);
+        } else {
+            chunk = transfer_size;
+            mem_write_phys((void *) src, addr, transfer_size);
+        }
+
+        src += chunk;
+        addr += chunk;
+        size -= chunk;
+    }
+}
+
 uint8_t
 mem_read_ram(uint32_t addr, UNUSED(void *priv))
 {
@@ -2871,6 +2942,72 @@ mem_reset(void)
 #endif
 }
 
+void
+mem_savestate(savestate_t *st)
+{
+    mem_mapping_t *map;
+    uint64_t       size = ram_size;
+    uint32_t       maps = 0;
+
+    savestate_var(st, size);
+    if (st->loading && (size != ram_size)) {
+        pclog("SaveState: RAM size mismatch (%" PRIu64 " vs. %" PRIu64 ")\n",
+              size, (uint64_t) ram_size);
+        st->error = 1;
+        return;
+    }
+    savestate_data(st, ram, ram_size);
+
+    savestate_var(st, _mem_state);
+    savestate_var(st, _mem_wp);
+    savestate_var(st, _mem_wp_bus);
+
+    savestate_var(st, rammask);
+    savestate_var(st, mem_a20_key);
+    savestate_var(st, mem_a20_alt);
+    savestate_var(st, mem_a20_state);
+    savestate_var(st, shadowbios);
+    savestate_var(st, shadowbios_write);
+
+    /* The mapping list is built in the same order for the same configuration,
+       so the mappings are identified by their position in it. */
+    for (map = base_mapping; map != NULL; map = map->next)
+        maps++;
+    savestate_var(st, maps);
+
+    map = base_mapping;
+    for (uint32_t c = 0; c < maps; c++) {
+        mem_mapping_t tmp;
+
+        if (map != NULL)
+            tmp = *map;
+        else
+            memset(&tmp, 0x00, sizeof(mem_mapping_t));
+        savestate_var(st, tmp.enable);
+        savestate_var(st, tmp.base);
+        savestate_var(st, tmp.size);
+        savestate_var(st, tmp.base_ignore);
+        savestate_var(st, tmp.mask);
+
+        if (st->loading && (map != NULL)) {
+            map->enable      = tmp.enable;
+            map->base        = tmp.base;
+            map->size        = tmp.size;
+            map->base_ignore = tmp.base_ignore;
+            map->mask        = tmp.mask;
+        }
+
+        if (map != NULL)
+            map = map->next;
+    }
+
+    if (st->loading) {
+        mem_mapping_recalc(0ULL, (uint64_t) MEM_MAPPINGS_NO << MEM_GRANULARITY_BITS);
+        mem_reset_page_blocks();
+        flushmmucache();
+    }
+}
+
 void
 mem_init(void)
 {
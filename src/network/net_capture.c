@@ -0,0 +1,308 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Packet capture of a network card to a pcapng file.
+ *
+ *          Frames are captured on the emulation thread as they come from
+ *          and go to the NIC, into a ring that a writer thread empties
+ *          to disk, so the guest never waits on the file. If the writer
+ *          falls behind, frames are counted as dropped instead, and the
+ *          count goes into the statistics block written on close.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/timer.h>
+#include <86box/plat.h>
+#include <86box/thread.h>
+#include <86box/network.h>
+#include <86box/version.h>
+
+#define NET_CAPTURE_RING_LEN 512 /* Must be a power of 2 */
+#define NET_CAPTURE_WAKE     (NET_CAPTURE_RING_LEN / 4)
+#define NET_CAPTURE_PERIOD   50 /* In ms, how often the writer looks without being woken up */
+
+#define PCAPNG_SHB 0x0a0d0d0a
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_ISB 0x00000005
+#define PCAPNG_EPB 0x00000006
+
+typedef struct net_capture_frame_t {
+    uint64_t ts; /* In µs since the epoch */
+    uint16_t len;
+    uint8_t  dir;
+    uint8_t  data[NET_MAX_FRAME];
+} net_capture_frame_t;
+
+struct net_capture_t {
+    FILE                *fp;
+    thread_t            *thread;
+    event_t             *wake;
+    atomic_uint          stop;
+    atomic_uint          head;
+    atomic_uint          tail;
+    uint64_t             captured;
+    uint64_t             dropped; /* Only touched by the emulation thread until close */
+    net_capture_frame_t *ring;
+};
+
+#ifdef ENABLE_NET_CAPTURE_LOG
+int net_capture_do_log = ENABLE_NET_CAPTURE_LOG;
+
+static void
+net_capture_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (net_capture_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define net_capture_log(fmt, ...)
+#endif
+
+static uint64_t
+net_capture_time(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return ((uint64_t) ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000);
+}
+
+/* Options are padded to 32 bits, an empty one ends the list. */
+static uint32_t
+net_capture_option(uint8_t *p, uint16_t code, const void *data, uint16_t len)
+{
+    uint32_t size = 4 + ((len + 3) & ~3);
+
+    memset(p, 0x00, size);
+    memcpy(p, &code, 2);
+    memcpy(p + 2, &len, 2);
+    if (len)
+        memcpy(p + 4, data, len);
+
+    return size;
+}
+
+static void
+net_capture_block(net_capture_t *cap, uint32_t type, const uint8_t *body, uint32_t body_len)
+{
+    uint32_t len = 12 + body_len;
+
+    fwrite(&type, 1, 4, cap->fp);
+    fwrite(&len, 1, 4, cap->fp);
+    fwrite(body, 1, body_len, cap->fp);
+    fwrite(&len, 1, 4, cap->fp);
+}
+
+static void
+net_capture_header(net_capture_t *cap, int card_num)
+{
+    uint8_t  body[256];
+    uint32_t n;
+    uint32_t bom        = 0x1a2b3c4d;
+    uint16_t version[2] = { 1, 0 };
+    int64_t  section    = -1;
+    uint16_t linktype   = 1; /* Ethernet */
+    uint32_t snaplen    = NET_MAX_FRAME;
+    uint8_t  tsresol    = 6;
+    char     str[64];
+
+    memcpy(body, &bom, 4);
+    memcpy(body + 4, version, 4);
+    memcpy(body + 8, &section, 8);
+    n = 16;
+    snprintf(str, sizeof(str), "86Box %s", EMU_VERSION_FULL);
+    n += net_capture_option(body + n, 4, str, strlen(str)); /* shb_userappl */
+    n += net_capture_option(body + n, 0, NULL, 0);
+    net_capture_block(cap, PCAPNG_SHB, body, n);
+
+    memset(body, 0x00, 8);
+    memcpy(body, &linktype, 2);
+    memcpy(body + 4, &snaplen, 4);
+    n = 8;
+    snprintf(str, sizeof(str), "Network card %d", card_num + 1);
+    n += net_capture_option(body + n, 2, str, strlen(str)); /* if_name */
+    n += net_capture_option(body + n, 9, &tsresol, 1);      /* if_tsresol */
+    n += net_capture_option(body + n, 0, NULL, 0);
+    net_capture_block(cap, PCAPNG_IDB, body, n);
+}
+
+static void
+net_capture_write(net_capture_t *cap, const net_capture_frame_t *frame)
+{
+    static const uint8_t pad[4] = { 0 };
+    uint32_t             hdr[7];
+    uint8_t              opts[16];
+    uint32_t             padded = (frame->len + 3) & ~3;
+    uint32_t             flags  = frame->dir; /* Inbound or outbound */
+    uint32_t             n;
+
+    n = net_capture_option(opts, 2, &flags, 4); /* epb_flags */
+    n += net_capture_option(opts + n, 0, NULL, 0);
+
+    hdr[0] = PCAPNG_EPB;
+    hdr[1] = sizeof(hdr) + padded + n + 4;
+    hdr[2] = 0; /* Interface */
+    hdr[3] = (uint32_t) (frame->ts >> 32);
+    hdr[4] = (uint32_t) frame->ts;
+    hdr[5] = frame->len;
+    hdr[6] = frame->len;
+
+    fwrite(hdr, 1, sizeof(hdr), cap->fp);
+    fwrite(frame->data, 1, frame->len, cap->fp);
+    fwrite(pad, 1, padded - frame->len, cap->fp);
+    fwrite(opts, 1, n, cap->fp);
+    fwrite(&hdr[1], 1, 4, cap->fp);
+}
+
+static void
+net_capture_drain(net_capture_t *cap)
+{
+    uint32_t tail = atomic_load_explicit(&cap->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&cap->head, memory_order_acquire);
+
+    if (tail == head)
+        return;
+
+    for (; tail != head; tail++) {
+        net_capture_write(cap, &cap->ring[tail & (NET_CAPTURE_RING_LEN - 1)]);
+        cap->captured++;
+    }
+    atomic_store_explicit(&cap->tail, tail, memory_order_release);
+
+    fflush(cap->fp);
+}
+
+static void
+net_capture_thread(void *priv)
+{
+    net_capture_t *cap = (net_capture_t *) priv;
+
+    while (!atomic_load(&cap->stop)) {
+        thread_wait_event(cap->wake, NET_CAPTURE_PERIOD);
+        thread_reset_event(cap->wake);
+        net_capture_drain(cap);
+    }
+
+    net_capture_drain(cap);
+}
+
+net_capture_t *
+net_capture_open(const char *fn, int card_num)
+{
+    net_capture_t *cap = calloc(1, sizeof(net_capture_t));
+
+    if (cap == NULL)
+        return NULL;
+
+    cap->ring = malloc(NET_CAPTURE_RING_LEN * sizeof(net_capture_frame_t));
+    cap->fp   = plat_fopen(fn, "wb");
+    if ((cap->ring == NULL) || (cap->fp == NULL)) {
+        pclog("NETWORK: Unable to open capture file %s\n", fn);
+        if (cap->fp != NULL)
+            fclose(cap->fp);
+        free(cap->ring);
+        free(cap);
+        return NULL;
+    }
+
+    net_capture_header(cap, card_num);
+    fflush(cap->fp);
+
+    cap->wake   = thread_create_event();
+    cap->thread = thread_create(net_capture_thread, cap);
+
+    net_capture_log("NETWORK: card %d captured to %s\n", card_num + 1, fn);
+
+    return cap;
+}
+
+/* Called from the emulation thread only. */
+void
+net_capture_frame(net_capture_t *cap, const uint8_t *data, int len, int dir)
+{
+    net_capture_frame_t *frame;
+    uint32_t             head = atomic_load_explicit(&cap->head, memory_order_relaxed);
+    uint32_t             used = head - atomic_load_explicit(&cap->tail, memory_order_acquire);
+
+    if ((len <= 0) || (len > NET_MAX_FRAME))
+        return;
+
+    if (used >= NET_CAPTURE_RING_LEN) {
+        cap->dropped++;
+        return;
+    }
+
+    frame      = &cap->ring[head & (NET_CAPTURE_RING_LEN - 1)];
+    frame->ts  = net_capture_time();
+    frame->len = len;
+    frame->dir = dir;
+    memcpy(frame->data, data, len);
+    atomic_store_explicit(&cap->head, head + 1, memory_order_release);
+
+    /* Otherwise the writer gets to it on its own soon enough */
+    if ((used + 1) == NET_CAPTURE_WAKE)
+        thread_set_event(cap->wake);
+}
+
+void
+net_capture_close(net_capture_t *cap)
+{
+    uint8_t  body[64];
+    uint32_t n;
+    uint32_t hdr[3];
+    uint64_t ts;
+    uint64_t recv;
+
+    if (cap == NULL)
+        return;
+
+    atomic_store(&cap->stop, 1);
+    thread_set_event(cap->wake);
+    thread_wait(cap->thread);
+    thread_destroy_event(cap->wake);
+
+    /* Interface statistics, so the drops show up in the capture itself */
+    ts     = net_capture_time();
+    recv   = cap->captured + cap->dropped;
+    hdr[0] = 0; /* Interface */
+    hdr[1] = (uint32_t) (ts >> 32);
+    hdr[2] = (uint32_t) ts;
+    memcpy(body, hdr, sizeof(hdr));
+    n = sizeof(hdr);
+    n += net_capture_option(body + n, 4, &recv, 8);          /* isb_ifrecv */
+    n += net_capture_option(body + n, 5, &cap->dropped, 8);  /* isb_ifdrop */
+    n += net_capture_option(body + n, 0, NULL, 0);
+    net_capture_block(cap, PCAPNG_ISB, body, n);
+
+    if (cap->dropped)
+        pclog("NETWORK: capture dropped %" PRIu64 " frames\n", cap->dropped);
+
+    fclose(cap->fp);
+    free(cap->ring);
+    free(cap);
+}
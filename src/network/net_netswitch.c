@@ -36,6 +36,9 @@
 #include <86box/net_event.h>
 #include "netswitch.h"
 #include "networkmessage.pb.h"
+#ifndef _WIN32
+#    include "netswitch_shm.h"
+#endif
 
 enum {
     NET_EVENT_STOP = 0,
@@ -71,6 +74,8 @@ typedef struct {
     char            switch_type[16];
 #ifdef _WIN32
     HANDLE sock_event;
+#else
+    ns_shm_t *shmconn;
 #endif
 } net_netswitch_t;
 
@@ -346,6 +351,52 @@ net_netswitch_thread(void *priv)
     net_switch_log("%s Net Switch: polling stopped.\n", switch_type);
 }
 
+#ifndef _WIN32
+/* Local switch over shared memory, the frames never leave this thread */
+static void
+net_netswitch_shm_thread(void *priv)
+{
+    net_netswitch_t *net_netswitch = (net_netswitch_t *) priv;
+    int              timeout       = -1;
+    int              packets;
+
+    net_switch_log("SHM Net Switch: polling started.\n");
+
+    struct pollfd pfd[NET_EVENT_SWITCH];
+    pfd[NET_EVENT_STOP].fd     = net_event_get_fd(&net_netswitch->stop_event);
+    pfd[NET_EVENT_STOP].events = POLLIN | POLLPRI;
+
+    pfd[NET_EVENT_TX].fd     = net_event_get_fd(&net_netswitch->tx_event);
+    pfd[NET_EVENT_TX].events = POLLIN | POLLPRI;
+
+    pfd[NET_EVENT_RX].fd     = ns_shm_pollfd(net_netswitch->shmconn);
+    pfd[NET_EVENT_RX].events = POLLIN | POLLPRI;
+
+    while (1) {
+        poll(pfd, NET_EVENT_SWITCH, timeout);
+
+        if (pfd[NET_EVENT_STOP].revents & POLLIN) {
+            net_event_clear(&net_netswitch->stop_event);
+            break;
+        }
+        if (pfd[NET_EVENT_TX].revents & POLLIN) {
+            net_event_clear(&net_netswitch->tx_event);
+
+            do {
+                packets = network_tx_popv(net_netswitch->card, net_netswitch->pktv, SWITCH_PKT_BATCH);
+                for (int i = 0; i < packets; i++)
+                    ns_shm_send(net_netswitch->shmconn, &net_netswitch->pktv[i]);
+            } while (packets == SWITCH_PKT_BATCH);
+        }
+
+        /* Always look, frames the card had no room for last time may fit now */
+        timeout = ns_shm_recv(net_netswitch->shmconn, net_netswitch->card) ? NS_SHM_RETRY : -1;
+    }
+
+    net_switch_log("SHM Net Switch: polling stopped.\n");
+}
+#endif
+
 void
 net_netswitch_error(char *errbuf, const char *message) {
     strncpy(errbuf, message, NET_DRV_ERRBUF_SIZE);
@@ -387,6 +438,31 @@ net_netswitch_init(const netcard_t *card, const uint8_t *mac_addr, void *priv, c
     memcpy(net_netswitch->mac_addr, mac_addr, sizeof(net_netswitch->mac_addr));
     snprintf(net_netswitch->switch_type, sizeof(net_netswitch->switch_type), "%s", net_type == NET_TYPE_NRSWITCH ? "Remote" : "Local");
 
+#ifndef _WIN32
+    if ((switch_type == SWITCH_TYPE_LOCAL) && netcard->switch_shm) {
+        if ((net_netswitch->shmconn = ns_shm_open(netcard->switch_group, net_netswitch->mac_addr, netcard->promisc_mode)) == NULL) {
+            char buf[NET_DRV_ERRBUF_SIZE];
+            snprintf(buf, NET_DRV_ERRBUF_SIZE, "Unable to open shared memory switch group %d (%s)", netcard->switch_group, strerror(errno));
+            net_netswitch_error(netdrv_errbuf, buf);
+            free(net_netswitch);
+            return NULL;
+        }
+
+        for (int i = 0; i < SWITCH_PKT_BATCH; i++) {
+            net_netswitch->pktv[i].data = calloc(1, NET_FRAME_BUF_SIZE);
+        }
+
+        net_event_init(&net_netswitch->tx_event);
+        net_event_init(&net_netswitch->stop_event);
+        net_netswitch->poll_tid = thread_create(net_netswitch_shm_thread, net_netswitch);
+
+        return net_netswitch;
+    }
+#else
+    if ((switch_type == SWITCH_TYPE_LOCAL) && netcard->switch_shm)
+        net_switch_log("Local Net Switch: no shared memory transport on Windows, using multicast\n");
+#endif
+
 //    net_switch_log("%s Net Switch: mode: %d, group %d, hostname %s len %lu\n", net_netswitch->switch_type, netcard->promisc_mode, netcard->switch_group, netcard->nrs_hostname, strlen(netcard->nrs_hostname));
 
     struct ns_open_args ns_args;
@@ -423,9 +499,9 @@ net_netswitch_init(const netcard_t *card, const uint8_t *mac_addr, void *priv, c
     }
 
     for (int i = 0; i < SWITCH_PKT_BATCH; i++) {
-        net_netswitch->pktv[i].data = calloc(1, NET_MAX_FRAME);
+        net_netswitch->pktv[i].data = calloc(1, NET_FRAME_BUF_SIZE);
     }
-    net_netswitch->rx_packet.pkt.data = calloc(1, NET_MAX_FRAME);
+    net_netswitch->rx_packet.pkt.data = calloc(1, NET_FRAME_BUF_SIZE);
 
     net_event_init(&net_netswitch->tx_event);
     net_event_init(&net_netswitch->stop_event);
@@ -483,6 +559,12 @@ net_netswitch_close(void *priv)
 
 #ifdef _WIN32
     WSACleanup();
+#else
+    if (net_netswitch->shmconn != NULL) {
+        ns_shm_close(net_netswitch->shmconn);
+        free(net_netswitch);
+        return;
+    }
 #endif
 
     ns_close(net_netswitch->nsconn);
@@ -165,9 +165,9 @@ net_null_init(const netcard_t *card, const uint8_t *mac_addr, UNUSED(void *priv)
     memcpy(net_null->mac_addr, mac_addr, sizeof(net_null->mac_addr));
 
     for (int i = 0; i < NULL_PKT_BATCH; i++) {
-        net_null->pktv[i].data = calloc(1, NET_MAX_FRAME);
+        net_null->pktv[i].data = calloc(1, NET_FRAME_BUF_SIZE);
     }
-    net_null->pkt.data = calloc(1, NET_MAX_FRAME);
+    net_null->pkt.data = calloc(1, NET_FRAME_BUF_SIZE);
 
     net_event_init(&net_null->tx_event);
     net_event_init(&net_null->stop_event);
@@ -137,7 +137,6 @@ typedef struct {
     thread_t  *poll_tid;
     net_evt_t  tx_event;
     net_evt_t  stop_event;
-    netpkt_t   pkt;
     netpkt_t   pktv[PCAP_PKT_BATCH];
     uint8_t    mac_addr[6];
 #ifdef _WIN32
@@ -233,9 +232,16 @@ static void
 net_pcap_rx_handler(uint8_t *user, const struct pcap_pkthdr *h, const uint8_t *bytes)
 {
     net_pcap_t *pcap = (net_pcap_t *) user;
-    memcpy(pcap->pkt.data, bytes, h->caplen);
-    pcap->pkt.len = h->caplen;
-    network_rx_put_pkt(pcap->card, &pcap->pkt);
+    uint8_t    *buf  = network_rx_get_buf(pcap->card);
+
+    /* No room, drop it. */
+    if ((buf == NULL) || (h->caplen > NET_MAX_FRAME)) {
+        network_rx_drop(pcap->card);
+        return;
+    }
+
+    memcpy(buf, bytes, h->caplen);
+    network_rx_commit(pcap->card, h->caplen);
 }
 
 /* Send a packet to the Pcap interface. */
@@ -522,9 +528,8 @@ net_pcap_init(const netcard_t *card, const uint8_t *mac_addr, void *priv, char *
 #endif
 
     for (int i = 0; i < PCAP_PKT_BATCH; i++) {
-        pcap->pktv[i].data = calloc(1, NET_MAX_FRAME);
+        pcap->pktv[i].data = calloc(1, NET_FRAME_BUF_SIZE);
     }
-    pcap->pkt.data = calloc(1, NET_MAX_FRAME);
 
     net_event_init(&pcap->tx_event);
     net_event_init(&pcap->stop_event);
@@ -555,7 +560,6 @@ net_pcap_close(void *priv)
     for (int i = 0; i < PCAP_PKT_BATCH; i++) {
         free(pcap->pktv[i].data);
     }
-    free(pcap->pkt.data);
 
 #ifdef _WIN32
     f_pcap_sendqueue_destroy((void *) pcap->pcap_queue);
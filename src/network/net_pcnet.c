@@ -1218,7 +1218,7 @@ pcnetReceiveNoSync(void *priv, uint8_t *buf, int size)
     int      is_ladr  = 0;
     uint32_t iRxDesc;
     int      cbPacket;
-    uint8_t  buf1[60];
+    uint8_t  buf1[64];
     RMD      rmd      = { 0 };
 
     if (CSR_DRX(dev) || CSR_STOP(dev) || CSR_SPND(dev) || !size)
@@ -1272,12 +1272,13 @@ pcnetReceiveNoSync(void *priv, uint8_t *buf, int size)
             dev->aCSR[0] |= 0x1000; /* Set MISS flag */
             CSR_MISSC(dev)
             ++;
+            network_rx_overrun(dev->netcard);
             pcnet_log(2, "%s: pcnetReceiveNoSync: packet missed\n", dev->name);
         } else {
             const RTNETETHERHDR *pEth   = (RTNETETHERHDR *) buf;
             int                  fStrip = 0;
             size_t               len_802_3;
-            uint8_t             *src  = &dev->abRecvBuf[8];
+            uint8_t             *src  = buf;
             uint32_t             crda = CSR_CRDA(dev);
             uint32_t             next_crda;
             RMD                  rmd;
@@ -1298,7 +1299,15 @@ pcnetReceiveNoSync(void *priv, uint8_t *buf, int size)
                 fStrip = 1;
             }
 
-            memcpy(src, buf, size);
+            /*
+             * Frames from the network layer and our own loopback buffer have
+             * room for the padding and FCS, so the guest gets them straight
+             * from there. Anything larger goes through the receive buffer.
+             */
+            if (size > NET_MAX_FRAME) {
+                src = &dev->abRecvBuf[8];
+                memcpy(src, buf, size);
+            }
 
             if (!fStrip) {
                 /* In loopback mode, Runt Packed Accept is always enabled internally;
@@ -618,25 +618,32 @@ net_crc32(const uint8_t *p, int len)
     return crc;
 }
 
-uint32_t
-net_crc32_le(const uint8_t *p, int len)
+/* Every received frame goes through this, so a byte at a time from a table. */
+static uint32_t net_crc32_le_table[256];
+
+static void
+net_crc32_le_init(void)
 {
     uint32_t crc;
-    int      carry;
-    uint8_t  b;
 
-    crc = 0xffffffff;
-    for (int i = 0; i < len; i++) {
-        b = *p++;
-        for (uint8_t j = 0; j < 8; j++) {
-            carry = (crc & 0x1) ^ (b & 0x01);
-            crc >>= 1;
-            b >>= 1;
-            if (carry) {
-                crc ^= 0xedb88320;
-            }
-        }
+    for (uint32_t i = 0; i < 256; i++) {
+        crc = i;
+        for (uint8_t j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+        net_crc32_le_table[i] = crc;
     }
+}
+
+uint32_t
+net_crc32_le(const uint8_t *p, int len)
+{
+    uint32_t crc = 0xffffffff;
+
+    if (net_crc32_le_table[1] == 0)
+        net_crc32_le_init();
+
+    for (int i = 0; i < len; i++)
+        crc = (crc >> 8) ^ net_crc32_le_table[(crc ^ *p++) & 0xff];
 
     return crc;
 }
@@ -827,6 +834,7 @@ rtl8139_do_receive(void *priv, uint8_t *buf, int size_)
             /* update tally counter */
             ++s->tally_counters.RxERR;
             ++s->tally_counters.MissPkt;
+            network_rx_overrun(s->nic);
 
             rtl8139_update_irq(s);
             return size_;
@@ -867,6 +875,7 @@ rtl8139_do_receive(void *priv, uint8_t *buf, int size_)
             /* update tally counter */
             ++s->tally_counters.RxERR;
             ++s->tally_counters.MissPkt;
+            network_rx_overrun(s->nic);
 
             rtl8139_update_irq(s);
             return size_;
@@ -49,6 +49,9 @@
 #include <86box/net_event.h>
 
 #define SLIRP_PKT_BATCH NET_QUEUE_LEN
+/* Throughput mode: frames held back while the RX ring is full, power of 2 */
+#define SLIRP_BACKLOG_LEN  256
+#define SLIRP_BACKLOG_POLL 1 /* ms */
 
 enum {
     NET_EVENT_STOP = 0,
@@ -65,10 +68,15 @@ typedef struct net_slirp_t {
     net_evt_t      rx_event;
     net_evt_t      tx_event;
     net_evt_t      stop_event;
-    netpkt_t       pkt;
     netpkt_t       pkt_tx_v[SLIRP_PKT_BATCH];
     int            during_tx;
     int            recv_on_tx;
+    int            throughput;
+    int            throttle;
+    uint8_t       *backlog;
+    int            backlog_len[SLIRP_BACKLOG_LEN];
+    int            backlog_head;
+    int            backlog_count;
 #ifdef _WIN32
     HANDLE         sock_event;
 #else
@@ -180,6 +188,57 @@ net_slirp_notify(void *opaque)
     (void) opaque;
 }
 
+/* Move as many held back frames as the RX ring has room for. */
+static void
+net_slirp_backlog_flush(net_slirp_t *slirp)
+{
+    uint8_t *buf;
+    int      len;
+
+    while (slirp->backlog_count && ((buf = network_rx_get_buf(slirp->card)) != NULL)) {
+        len = slirp->backlog_len[slirp->backlog_head];
+        memcpy(buf, &slirp->backlog[slirp->backlog_head * NET_FRAME_BUF_SIZE], len);
+        network_rx_commit(slirp->card, len);
+
+        slirp->backlog_head = (slirp->backlog_head + 1) & (SLIRP_BACKLOG_LEN - 1);
+        slirp->backlog_count--;
+    }
+}
+
+/*
+ * In throughput mode a frame that does not fit in the RX ring is held back
+ * instead of dropped, which would cost the guest a TCP retransmission. The
+ * backlog is flushed on every pass of the poll loop, and reading from host
+ * sockets stops while it is more than half full.
+ */
+static void
+net_slirp_backlog_put(net_slirp_t *slirp, const uint8_t *data, int len)
+{
+    uint8_t *buf;
+    int      idx;
+
+    if (len > NET_MAX_FRAME)
+        return;
+
+    net_slirp_backlog_flush(slirp);
+
+    if (!slirp->backlog_count && ((buf = network_rx_get_buf(slirp->card)) != NULL)) {
+        memcpy(buf, data, len);
+        network_rx_commit(slirp->card, len);
+        return;
+    }
+
+    if (slirp->backlog_count == SLIRP_BACKLOG_LEN) {
+        slirp_log("SLiRP: backlog full, dropping %d-byte packet\n", len);
+        network_rx_drop(slirp->card);
+        return;
+    }
+
+    idx = (slirp->backlog_head + slirp->backlog_count++) & (SLIRP_BACKLOG_LEN - 1);
+    memcpy(&slirp->backlog[idx * NET_FRAME_BUF_SIZE], data, len);
+    slirp->backlog_len[idx] = len;
+}
+
 #if SLIRP_CHECK_VERSION(4, 8, 0)
 slirp_ssize_t
 #else
@@ -191,13 +250,18 @@ net_slirp_send_packet(const void *qp, size_t pkt_len, void *opaque)
 
     slirp_log("SLiRP: received %d-byte packet\n", pkt_len);
 
-    memcpy(slirp->pkt.data, (uint8_t *) qp, pkt_len);
-    slirp->pkt.len = pkt_len;
+    /* The backlog belongs to the poll thread, SLiRP timers run on the emulation thread. */
+    if (slirp->throughput && !is_cpu_thread) {
+        net_slirp_backlog_put(slirp, (const uint8_t *) qp, pkt_len);
+        return pkt_len;
+    }
+
+    /* Copied straight into the ring, the NIC takes it from there. */
     if (slirp->during_tx) {
-        network_rx_on_tx_put_pkt(slirp->card, &slirp->pkt);
+        network_rx_on_tx_put(slirp->card, (uint8_t *) qp, pkt_len);
         slirp->recv_on_tx = 1;
     } else
-        network_rx_put_pkt(slirp->card, &slirp->pkt);
+        network_rx_put(slirp->card, (uint8_t *) qp, pkt_len);
 
     return pkt_len;
 }
@@ -212,7 +276,7 @@ net_slirp_add_poll(int fd, int events, void *opaque)
 {
     net_slirp_t *slirp   = (net_slirp_t *) opaque;
     long         bitmask = 0;
-    if (events & SLIRP_POLL_IN)
+    if ((events & SLIRP_POLL_IN) && !slirp->throttle)
         bitmask |= FD_READ | FD_ACCEPT;
     if (events & SLIRP_POLL_OUT)
         bitmask |= FD_WRITE | FD_CONNECT;
@@ -246,7 +310,7 @@ net_slirp_add_poll(int fd, int events, void *opaque)
         int idx = slirp->pfd_len++;
         slirp->pfd[idx].fd = fd;
         int pevents = 0;
-        if (events & SLIRP_POLL_IN)
+        if ((events & SLIRP_POLL_IN) && !slirp->throttle)
             pevents |= POLLIN;
         if (events & SLIRP_POLL_OUT)
             pevents |= POLLOUT;
@@ -385,13 +449,22 @@ net_slirp_thread(void *priv)
     bool run               = true;
     while (run) {
         uint32_t timeout = -1;
+
+        if (slirp->throughput) {
+            net_slirp_backlog_flush(slirp);
+            slirp->throttle = (slirp->backlog_count >= (SLIRP_BACKLOG_LEN / 2));
+        }
+
 #    if SLIRP_CHECK_VERSION(4, 9, 0)
         slirp_pollfds_fill_socket(slirp->slirp, &timeout, net_slirp_add_poll, slirp);
 #    else
         slirp_pollfds_fill(slirp->slirp, &timeout, net_slirp_add_poll, slirp);
 #    endif
+        slirp->throttle = 0;
         if (timeout < 0)
             timeout = INFINITE;
+        if (slirp->backlog_count && (timeout > SLIRP_BACKLOG_POLL))
+            timeout = SLIRP_BACKLOG_POLL;
 
         int ret = WaitForMultipleObjects(3, events, FALSE, (DWORD) timeout);
         switch (ret - WAIT_OBJECT_0) {
@@ -401,10 +474,14 @@ net_slirp_thread(void *priv)
 
             case NET_EVENT_TX:
                 {
+                    int packets;
+
                     slirp->during_tx = 1;
-                    int packets = network_tx_popv(slirp->card, slirp->pkt_tx_v, SLIRP_PKT_BATCH);
-                    for (int i = 0; i < packets; i++)
-                        net_slirp_in(slirp, slirp->pkt_tx_v[i].data, slirp->pkt_tx_v[i].len);
+                    do {
+                        packets = network_tx_popv(slirp->card, slirp->pkt_tx_v, SLIRP_PKT_BATCH);
+                        for (int i = 0; i < packets; i++)
+                            net_slirp_in(slirp, slirp->pkt_tx_v[i].data, slirp->pkt_tx_v[i].len);
+                    } while (slirp->throughput && (packets == SLIRP_PKT_BATCH));
                     slirp->during_tx = 0;
 
                     net_slirp_rx_deferred_packets(slirp);
@@ -436,11 +513,19 @@ net_slirp_thread(void *priv)
         net_slirp_add_poll(net_event_get_fd(&slirp->stop_event), SLIRP_POLL_IN, slirp);
         net_slirp_add_poll(net_event_get_fd(&slirp->tx_event), SLIRP_POLL_IN, slirp);
 
+        if (slirp->throughput) {
+            net_slirp_backlog_flush(slirp);
+            slirp->throttle = (slirp->backlog_count >= (SLIRP_BACKLOG_LEN / 2));
+        }
+
 #    if SLIRP_CHECK_VERSION(4, 9, 0)
         slirp_pollfds_fill_socket(slirp->slirp, &timeout, net_slirp_add_poll, slirp);
 #    else
         slirp_pollfds_fill(slirp->slirp, &timeout, net_slirp_add_poll, slirp);
 #    endif
+        slirp->throttle = 0;
+        if (slirp->backlog_count && (timeout > SLIRP_BACKLOG_POLL))
+            timeout = SLIRP_BACKLOG_POLL;
 
         int ret = poll(slirp->pfd, slirp->pfd_len, timeout);
 
@@ -454,10 +539,15 @@ net_slirp_thread(void *priv)
         if (slirp->pfd[NET_EVENT_TX].revents & POLLIN) {
             net_event_clear(&slirp->tx_event);
 
+            int packets;
+
             slirp->during_tx = 1;
-            int packets = network_tx_popv(slirp->card, slirp->pkt_tx_v, SLIRP_PKT_BATCH);
-            for (int i = 0; i < packets; i++)
-                net_slirp_in(slirp, slirp->pkt_tx_v[i].data, slirp->pkt_tx_v[i].len);
+            /* In throughput mode, feed SLiRP everything the guest has queued. */
+            do {
+                packets = network_tx_popv(slirp->card, slirp->pkt_tx_v, SLIRP_PKT_BATCH);
+                for (int i = 0; i < packets; i++)
+                    net_slirp_in(slirp, slirp->pkt_tx_v[i].data, slirp->pkt_tx_v[i].len);
+            } while (slirp->throughput && (packets == SLIRP_PKT_BATCH));
             slirp->during_tx = 0;
 
             net_slirp_rx_deferred_packets(slirp);
@@ -569,10 +659,18 @@ net_slirp_init(const netcard_t *card, const uint8_t *mac_addr, UNUSED(void *priv
         i++;
     }
 
+    slirp->throughput = !!config_get_int(category, "throughput", 0);
+    if (slirp->throughput) {
+        slirp->backlog = malloc(SLIRP_BACKLOG_LEN * NET_FRAME_BUF_SIZE);
+        if (slirp->backlog == NULL)
+            slirp->throughput = 0;
+        else
+            pclog("SLiRP: Throughput mode enabled\n");
+    }
+
     for (int i = 0; i < SLIRP_PKT_BATCH; i++) {
-        slirp->pkt_tx_v[i].data = calloc(1, NET_MAX_FRAME);
+        slirp->pkt_tx_v[i].data = calloc(1, NET_FRAME_BUF_SIZE);
     }
-    slirp->pkt.data = calloc(1, NET_MAX_FRAME);
     net_event_init(&slirp->rx_event);
     net_event_init(&slirp->tx_event);
     net_event_init(&slirp->stop_event);
@@ -635,7 +733,7 @@ net_slirp_close(void *priv)
     for (int i = 0; i < SLIRP_PKT_BATCH; i++) {
         free(slirp->pkt_tx_v[i].data);
     }
-    free(slirp->pkt.data);
+    free(slirp->backlog);
     free(slirp);
 }
 
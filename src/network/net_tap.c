@@ -166,13 +166,17 @@ static void net_tap_thread(void *priv) {
             }
         }
         if (pfd[NET_EVENT_RX].revents & POLLIN) {
-            ssize_t len = read(tap->fd, tap->pkt_rx.data, NET_MAX_FRAME);
+            /* Read straight into the ring, or drop the frame if it is full. */
+            uint8_t *buf = network_rx_get_buf(tap->card);
+            ssize_t  len = read(tap->fd, buf ? buf : tap->pkt_rx.data, NET_MAX_FRAME);
             if (len < 0) {
                 tap_log("TAP: read error: %s\n", strerror(errno));
                 continue;
             }
-            tap->pkt_rx.len = len;
-            network_rx_put_pkt(tap->card, &tap->pkt_rx);
+            if (buf != NULL)
+                network_rx_commit(tap->card, len);
+            else
+                network_rx_drop(tap->card);
         }
         if (pfd[NET_EVENT_STOP].revents & POLLIN) {
             net_event_clear(&tap->stop_event);
@@ -320,12 +324,12 @@ net_tap_init(
     if (!tap) {
         goto alloc_fail;
     }
-    tap->pkt_rx.data = calloc(1, NET_MAX_FRAME);
+    tap->pkt_rx.data = calloc(1, NET_FRAME_BUF_SIZE);
     if (!tap->pkt_rx.data) {
         goto alloc_fail;
     }
     for(int i = 0; i < NET_QUEUE_LEN; i++) {
-        tap->pkts_tx[i].data = calloc(1, NET_MAX_FRAME);
+        tap->pkts_tx[i].data = calloc(1, NET_FRAME_BUF_SIZE);
         if (!tap->pkts_tx[i].data) {
             goto alloc_fail;
         }
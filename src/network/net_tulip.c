@@ -420,7 +420,7 @@ tulip_next_rx_descriptor(TULIPState              *s,
 }
 
 static void
-tulip_copy_rx_bytes(TULIPState *s, struct tulip_descriptor *desc)
+tulip_copy_rx_bytes(TULIPState *s, struct tulip_descriptor *desc, const uint8_t *frame)
 {
     int len1 = (desc->control >> RDES1_BUF1_SIZE_SHIFT) & RDES1_BUF1_SIZE_MASK;
     int len2 = (desc->control >> RDES1_BUF2_SIZE_SHIFT) & RDES1_BUF2_SIZE_MASK;
@@ -433,7 +433,7 @@ tulip_copy_rx_bytes(TULIPState *s, struct tulip_descriptor *desc)
             len = s->rx_frame_len;
         }
 
-        dma_bm_write(desc->buf_addr1, s->rx_frame + (s->rx_frame_size - s->rx_frame_len), len, 4);
+        dma_bm_write(desc->buf_addr1, frame + (s->rx_frame_size - s->rx_frame_len), len, 4);
         s->rx_frame_len -= len;
     }
 
@@ -444,7 +444,7 @@ tulip_copy_rx_bytes(TULIPState *s, struct tulip_descriptor *desc)
             len = s->rx_frame_len;
         }
 
-        dma_bm_write(desc->buf_addr2, s->rx_frame + (s->rx_frame_size - s->rx_frame_len), len, 4);
+        dma_bm_write(desc->buf_addr2, frame + (s->rx_frame_size - s->rx_frame_len), len, 4);
         s->rx_frame_len -= len;
     }
 }
@@ -491,46 +491,26 @@ tulip_filter_address(TULIPState *s, const uint8_t *addr)
     return ret;
 }
 
+/* Hand the frame to the guest's descriptors, returns 0 if they ran out before the end. */
 static int
-tulip_receive(void *priv, uint8_t *buf, int size)
+tulip_rx_frame(TULIPState *s, const uint8_t *frame)
 {
     struct tulip_descriptor desc;
-    TULIPState             *s = (TULIPState *) priv;
-    int                     first = 1;
-
-    if (size < 14 || size > sizeof(s->rx_frame) - 4
-        || s->rx_frame_len || tulip_rx_stopped(s))
-        return 0;
 
-    if (!tulip_filter_address(s, buf)) {
-        //pclog("Not a filter address.\n");
-        return 1;
-    }
-
-    //pclog("Size = %d, FrameLen = %d, Buffer[%02x:%02x:%02x:%02x:%02x:%02x].\n", size, s->rx_frame_len, buf[0], buf[1], buf[2], buf[3], buf[4], buf[5]);
-    do {
+    while (s->rx_frame_len) {
         tulip_desc_read(s, s->current_rx_desc, &desc);
 
         if (!(desc.status & RDES0_OWN)) {
             s->csr[5] |= CSR5_RU;
             tulip_update_int(s);
-            if (first)
-                /* Stop at the very beginning, tell the host 0 bytes have been received. */
-                return 0;
-            else
-                return (s->rx_frame_size - s->rx_frame_len) % s->rx_frame_size;
+            return 0;
         }
         desc.status = 0;
 
-        if (!s->rx_frame_len) {
-            s->rx_frame_size = size + 4;
-            s->rx_status     = RDES0_LS | ((s->rx_frame_size & RDES0_FL_MASK) << RDES0_FL_SHIFT);
+        if (s->rx_frame_len == s->rx_frame_size)
             desc.status |= RDES0_FS;
-            memcpy(s->rx_frame, buf, size);
-            s->rx_frame_len = s->rx_frame_size;
-        }
 
-        tulip_copy_rx_bytes(s, &desc);
+        tulip_copy_rx_bytes(s, &desc, frame);
 
         if (!s->rx_frame_len) {
             desc.status |= s->rx_status;
@@ -539,8 +519,44 @@ tulip_receive(void *priv, uint8_t *buf, int size)
         }
         tulip_desc_write(s, s->current_rx_desc, &desc);
         tulip_next_rx_descriptor(s, &desc);
-        first = 0;
-    } while (s->rx_frame_len);
+    }
+
+    return 1;
+}
+
+static int
+tulip_receive(void *priv, uint8_t *buf, int size)
+{
+    TULIPState *s = (TULIPState *) priv;
+
+    if (size < 14 || size > sizeof(s->rx_frame) - 4 || tulip_rx_stopped(s))
+        return 0;
+
+    /* The rest of a frame the guest ran out of descriptors for goes first. */
+    if (s->rx_frame_len && !tulip_rx_frame(s, s->rx_frame))
+        return 0;
+
+    if (!tulip_filter_address(s, buf)) {
+        //pclog("Not a filter address.\n");
+        return 1;
+    }
+
+    //pclog("Size = %d, FrameLen = %d, Buffer[%02x:%02x:%02x:%02x:%02x:%02x].\n", size, s->rx_frame_len, buf[0], buf[1], buf[2], buf[3], buf[4], buf[5]);
+    s->rx_frame_size = size + 4;
+    s->rx_status     = RDES0_LS | ((s->rx_frame_size & RDES0_FL_MASK) << RDES0_FL_SHIFT);
+    s->rx_frame_len  = s->rx_frame_size;
+
+    /* The buffer has room for the FCS, so the frame goes to the guest from there. */
+    if (!tulip_rx_frame(s, buf)) {
+        if (s->rx_frame_len == s->rx_frame_size) {
+            /* Stop at the very beginning, tell the host 0 bytes have been received. */
+            s->rx_frame_len = 0;
+            return 0;
+        }
+
+        /* Keep the rest of the frame, the caller's buffer is going away. */
+        memcpy(s->rx_frame, buf, s->rx_frame_size);
+    }
 
     return 1;
 }
@@ -906,6 +922,7 @@ tulip_reset(void *priv)
     s->csr[13]                  = 0xffff0000;
     s->csr[14]                  = 0xffffffff;
     s->csr[15]                  = 0x8ff00000;
+    s->rx_frame_len             = 0;
     if (s->device_info->local != 3) {
         s->subsys_id                = eeprom_data[1];
         s->subsys_ven_id            = eeprom_data[0];
@@ -934,6 +951,9 @@ tulip_write(uint32_t addr, uint32_t data, void *opaque)
             break;
 
         case CSR(2):
+            /* Receive poll demand, finish a frame that was waiting for descriptors. */
+            if (s->rx_frame_len && !tulip_rx_stopped(s))
+                tulip_rx_frame(s, s->rx_frame);
             break;
 
         case CSR(3):
@@ -161,9 +161,13 @@ static void net_vde_thread(void *priv) {
 
         // Packets are available for reading. Read packet and queue it
         if (pfd[NET_EVENT_RX].revents & POLLIN) {
-            int nc = f_vde_recv(vde->vdeconn, vde->pkt.data, NET_MAX_FRAME, 0);
-            vde->pkt.len = nc;
-            network_rx_put_pkt(vde->card, &vde->pkt);
+            /* Receive straight into the ring, or drop the packet if it is full. */
+            uint8_t *buf = network_rx_get_buf(vde->card);
+            int      nc  = f_vde_recv(vde->vdeconn, buf ? buf : vde->pkt.data, NET_MAX_FRAME, 0);
+            if (buf != NULL)
+                network_rx_commit(vde->card, nc);
+            else
+                network_rx_drop(vde->card);
         }
 
         // We have been told to close
@@ -288,9 +292,9 @@ void *net_vde_init(const netcard_t *card, const uint8_t *mac_addr, void *priv, c
     vde_log("VDE: Socket opened (%s).\n", socket_name);
 
     for(uint8_t i = 0; i < VDE_PKT_BATCH; i++) {
-        vde->pktv[i].data = calloc(1, NET_MAX_FRAME);
+        vde->pktv[i].data = calloc(1, NET_FRAME_BUF_SIZE);
     }
-    vde->pkt.data = calloc(1,NET_MAX_FRAME);
+    vde->pkt.data = calloc(1, NET_FRAME_BUF_SIZE);
     net_event_init(&vde->tx_event);
     net_event_init(&vde->stop_event);
     vde->poll_tid = thread_create(net_vde_thread, vde);     // Fire up the read-write thread!
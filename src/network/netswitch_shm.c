@@ -0,0 +1,530 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Shared memory transport for the local Network Switch.
+ *
+ *          All the VMs on a switch group map the same shared memory
+ *          segment. It holds a port for every card, each with a ring
+ *          of frames that any other port can write into, and the MAC
+ *          addresses that were seen coming from it. There is no switch
+ *          process: whoever sends a frame does the switching, copying
+ *          it straight into the ring(s) of the port(s) it is meant for,
+ *          which saves the multicast socket and protobuf round trips of
+ *          the network based switch.
+ *
+ *          A port that has run out of frames arms its doorbell, a
+ *          datagram socket, before going to sleep on it; senders only
+ *          ring armed doorbells, so a busy port is never woken up for
+ *          each frame.
+ *
+ *          The locks in the segment hold the pid of their owner, so
+ *          that a VM killed while holding one can't hang the others:
+ *          a waiter that finds the owner gone takes the lock over.
+ *          Nothing is published before the lock is let go, so what
+ *          the dead owner left half done is never seen.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/timer.h>
+#include <86box/network.h>
+#include "netswitch.h"
+#include "netswitch_shm.h"
+
+#define NS_SHM_MAGIC   0x4d48534e /* "NSHM" */
+#define NS_SHM_VERSION 2
+/* Spins on a lock before checking on its owner and yielding */
+#define NS_SHM_SPINS   1024
+
+enum {
+    NS_SHM_STATE_NEW = 0,
+    NS_SHM_STATE_SETUP,
+    NS_SHM_STATE_READY
+};
+
+typedef struct {
+    uint32_t len;
+    uint8_t  data[NET_FRAME_BUF_SIZE];
+} ns_shm_frame_t;
+
+typedef struct {
+    atomic_int  pid;       /* Owning process, 0 if the port is free */
+    atomic_uint active;    /* Set while the owner takes frames */
+    atomic_uint promisc;
+    atomic_uint armed;     /* The owner is about to sleep, ring its doorbell */
+    atomic_int  lock;      /* Pid of the sender filling a slot, 0 if free */
+    atomic_uint mac_count; /* Only ever written by the owner */
+    uint8_t     macs[NS_SHM_MACS][6];
+    atomic_uint drops;
+
+    atomic_uint    head;
+    atomic_uint    tail;
+    ns_shm_frame_t ring[NS_SHM_RING_LEN];
+} ns_shm_port_t;
+
+typedef struct {
+    atomic_uint   state;
+    atomic_int    lock;     /* Pid of whoever claims or releases a port, 0 if free */
+    atomic_uint   unlinked; /* The last one out removed the name, don't join */
+    uint32_t      magic;
+    uint32_t      version;
+    uint32_t      size;
+    ns_shm_port_t ports[NS_SHM_PORTS];
+} ns_shm_switch_t;
+
+struct ns_shm {
+    ns_shm_switch_t *sw;
+    ns_shm_port_t   *port;
+    int              port_num;
+    int              fd; /* Doorbell */
+    uint8_t          group;
+    uint8_t          mac_addr[6];
+    char             name[32];
+};
+
+static void
+ns_shm_name(char *name, size_t len, uint8_t group)
+{
+    /* Per user, so that someone else's VMs can't show up on our switch */
+    snprintf(name, len, "/86box-nsw-%u-%u", (unsigned) getuid(), group);
+}
+
+static socklen_t
+ns_shm_doorbell_addr(struct sockaddr_un *addr, uint8_t group, int port)
+{
+    memset(addr, 0x00, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+#ifdef __linux__
+    /* Abstract socket, nothing is left behind in the filesystem */
+    snprintf(&addr->sun_path[1], sizeof(addr->sun_path) - 1, "86box-nsw-%u-%u-%d", (unsigned) getuid(), group, port);
+    return offsetof(struct sockaddr_un, sun_path) + 1 + strlen(&addr->sun_path[1]);
+#else
+    snprintf(addr->sun_path, sizeof(addr->sun_path), "/tmp/86box-nsw-%u-%u-%d", (unsigned) getuid(), group, port);
+    return sizeof(struct sockaddr_un);
+#endif
+}
+
+static bool
+ns_shm_pid_gone(int pid)
+{
+    return (kill(pid, 0) < 0) && (errno == ESRCH);
+}
+
+static void
+ns_shm_lock(atomic_int *lock)
+{
+    const int mypid = getpid();
+    int       spins = 0;
+
+    for (;;) {
+        int owner = 0;
+
+        if (atomic_compare_exchange_weak_explicit(lock, &owner, mypid, memory_order_acquire, memory_order_relaxed))
+            return;
+
+        if ((owner != 0) && (++spins >= NS_SHM_SPINS)) {
+            spins = 0;
+            /* Died holding it, whatever it was doing was never published */
+            if (ns_shm_pid_gone(owner) &&
+                atomic_compare_exchange_strong_explicit(lock, &owner, mypid, memory_order_acquire, memory_order_relaxed))
+                return;
+            sched_yield();
+        }
+    }
+}
+
+static void
+ns_shm_unlock(atomic_int *lock)
+{
+    atomic_store_explicit(lock, 0, memory_order_release);
+}
+
+static ns_shm_switch_t *
+ns_shm_map(const char *name)
+{
+    ns_shm_switch_t *sw;
+    struct stat      st;
+    int              fd;
+
+    fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    /* A new segment is created empty, anything else must be our size */
+    if ((st.st_size != 0) && (st.st_size != sizeof(ns_shm_switch_t))) {
+        close(fd);
+        errno = EPROTO;
+        return NULL;
+    }
+    if ((st.st_size == 0) && (ftruncate(fd, sizeof(ns_shm_switch_t)) < 0)) {
+        close(fd);
+        return NULL;
+    }
+
+    sw = mmap(NULL, sizeof(ns_shm_switch_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (sw == MAP_FAILED)
+        return NULL;
+
+    /* The first one in sets it up, everyone else waits for that */
+    unsigned int state = NS_SHM_STATE_NEW;
+    if (atomic_compare_exchange_strong(&sw->state, &state, NS_SHM_STATE_SETUP)) {
+        sw->magic   = NS_SHM_MAGIC;
+        sw->version = NS_SHM_VERSION;
+        sw->size    = sizeof(ns_shm_switch_t);
+        atomic_store(&sw->state, NS_SHM_STATE_READY);
+    } else {
+        for (int i = 0; (i < 1000) && (atomic_load(&sw->state) != NS_SHM_STATE_READY); i++)
+            usleep(1000);
+    }
+
+    if ((atomic_load(&sw->state) != NS_SHM_STATE_READY) || (sw->magic != NS_SHM_MAGIC) ||
+        (sw->version != NS_SHM_VERSION) || (sw->size != sizeof(ns_shm_switch_t))) {
+        munmap(sw, sizeof(ns_shm_switch_t));
+        errno = EPROTO;
+        return NULL;
+    }
+
+    return sw;
+}
+
+static ns_shm_port_t *
+ns_shm_claim(ns_shm_switch_t *sw, int *num)
+{
+    const int mypid = getpid();
+
+    for (int i = 0; i < NS_SHM_PORTS; i++) {
+        ns_shm_port_t *port = &sw->ports[i];
+        int            pid  = atomic_load(&port->pid);
+
+        /* Ports of VMs that went away without closing are up for grabs */
+        if ((pid != 0) && ((pid == mypid) || !ns_shm_pid_gone(pid)))
+            continue;
+
+        if (atomic_compare_exchange_strong(&port->pid, &pid, mypid)) {
+            *num = i;
+            return port;
+        }
+    }
+
+    errno = EBUSY;
+    return NULL;
+}
+
+static void
+ns_shm_release(ns_shm_t *conn)
+{
+    ns_shm_port_t *port = conn->port;
+    bool           last = true;
+
+    atomic_store(&port->active, 0);
+    atomic_store(&port->armed, 0);
+
+    /* Under the switch lock, so that nobody claims a port in between */
+    ns_shm_lock(&conn->sw->lock);
+    atomic_store(&port->pid, 0);
+
+    for (int i = 0; i < NS_SHM_PORTS; i++) {
+        if (atomic_load(&conn->sw->ports[i].pid) != 0)
+            last = false;
+    }
+    /* Nobody left, don't keep the memory around */
+    if (last) {
+        atomic_store(&conn->sw->unlinked, 1);
+        shm_unlink(conn->name);
+    }
+    ns_shm_unlock(&conn->sw->lock);
+
+    munmap(conn->sw, sizeof(ns_shm_switch_t));
+}
+
+static bool
+ns_shm_mac_known(ns_shm_port_t *port, const uint8_t *mac)
+{
+    const unsigned int count = atomic_load_explicit(&port->mac_count, memory_order_acquire);
+
+    for (unsigned int i = 0; i < count; i++) {
+        if (!memcmp(port->macs[i], mac, 6))
+            return true;
+    }
+
+    return false;
+}
+
+static void
+ns_shm_learn(ns_shm_t *conn, const uint8_t *mac)
+{
+    ns_shm_port_t     *port  = conn->port;
+    const unsigned int count = atomic_load_explicit(&port->mac_count, memory_order_relaxed);
+
+    if ((mac[0] & 1) || (count >= NS_SHM_MACS) || ns_shm_mac_known(port, mac))
+        return;
+
+    /* Entries are never changed once published, so readers need no lock */
+    memcpy(port->macs[count], mac, 6);
+    atomic_store_explicit(&port->mac_count, count + 1, memory_order_release);
+}
+
+static void
+ns_shm_ring(ns_shm_t *conn, int num)
+{
+    struct sockaddr_un addr;
+    const socklen_t    len = ns_shm_doorbell_addr(&addr, conn->group, num);
+
+    (void) !sendto(conn->fd, "", 1, MSG_DONTWAIT, (struct sockaddr *) &addr, len);
+}
+
+static void
+ns_shm_deliver(ns_shm_t *conn, int num, const netpkt_t *pkt)
+{
+    ns_shm_port_t  *port = &conn->sw->ports[num];
+    ns_shm_frame_t *slot;
+    uint32_t        head;
+
+    /* Only ever held for one frame copy */
+    ns_shm_lock(&port->lock);
+
+    if (!atomic_load_explicit(&port->active, memory_order_relaxed)) {
+        ns_shm_unlock(&port->lock);
+        return;
+    }
+
+    head = atomic_load_explicit(&port->head, memory_order_relaxed);
+    if ((head - atomic_load_explicit(&port->tail, memory_order_acquire)) >= NS_SHM_RING_LEN) {
+        atomic_fetch_add_explicit(&port->drops, 1, memory_order_relaxed);
+        ns_shm_unlock(&port->lock);
+        return;
+    }
+
+    slot      = &port->ring[head & (NS_SHM_RING_LEN - 1)];
+    slot->len = pkt->len;
+    memcpy(slot->data, pkt->data, pkt->len);
+    atomic_store_explicit(&port->head, head + 1, memory_order_seq_cst);
+
+    ns_shm_unlock(&port->lock);
+
+    if (atomic_exchange_explicit(&port->armed, 0, memory_order_seq_cst))
+        ns_shm_ring(conn, num);
+}
+
+ns_shm_t *
+ns_shm_open(uint8_t group, const uint8_t *mac_addr, bool promisc)
+{
+    struct sockaddr_un addr;
+    socklen_t          len;
+    ns_shm_t          *conn;
+
+    conn = calloc(1, sizeof(ns_shm_t));
+    if (conn == NULL)
+        return NULL;
+
+    conn->group = group;
+    memcpy(conn->mac_addr, mac_addr, 6);
+    ns_shm_name(conn->name, sizeof(conn->name), group);
+
+    for (;;) {
+        if ((conn->sw = ns_shm_map(conn->name)) == NULL)
+            goto fail;
+
+        ns_shm_lock(&conn->sw->lock);
+        /* The last one out unlinked it while we were mapping it, the
+           name now belongs to a new switch or to nobody yet. */
+        if (!atomic_load(&conn->sw->unlinked))
+            break;
+        ns_shm_unlock(&conn->sw->lock);
+
+        net_switch_log("SHM Net Switch: group %d was torn down under us, retrying\n", group);
+        munmap(conn->sw, sizeof(ns_shm_switch_t));
+    }
+
+    conn->port = ns_shm_claim(conn->sw, &conn->port_num);
+    ns_shm_unlock(&conn->sw->lock);
+    if (conn->port == NULL) {
+        munmap(conn->sw, sizeof(ns_shm_switch_t));
+        goto fail;
+    }
+
+    conn->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (conn->fd < 0)
+        goto fail_port;
+    fcntl(conn->fd, F_SETFD, FD_CLOEXEC);
+    fcntl(conn->fd, F_SETFL, O_NONBLOCK);
+
+    len = ns_shm_doorbell_addr(&addr, group, conn->port_num);
+#ifndef __linux__
+    unlink(addr.sun_path);
+#endif
+    if (bind(conn->fd, (struct sockaddr *) &addr, len) < 0)
+        goto fail_sock;
+
+    /* Whatever a previous owner left behind goes, under the sender lock */
+    ns_shm_lock(&conn->port->lock);
+    atomic_store(&conn->port->head, 0);
+    atomic_store(&conn->port->tail, 0);
+    atomic_store(&conn->port->drops, 0);
+    atomic_store(&conn->port->mac_count, 0);
+    atomic_store(&conn->port->promisc, promisc);
+    atomic_store(&conn->port->armed, 0);
+    atomic_store(&conn->port->active, 1);
+    ns_shm_unlock(&conn->port->lock);
+
+    net_switch_log("SHM Net Switch: group %d, port %d\n", group, conn->port_num);
+
+    return conn;
+
+fail_sock:
+    close(conn->fd);
+fail_port:
+    ns_shm_release(conn);
+fail:
+    free(conn);
+    return NULL;
+}
+
+int
+ns_shm_pollfd(const ns_shm_t *conn)
+{
+    return conn->fd;
+}
+
+void
+ns_shm_send(ns_shm_t *conn, const netpkt_t *pkt)
+{
+    const uint8_t *dest   = pkt->data;
+    int            target = -1;
+
+    if ((pkt->len < 14) || (pkt->len > NET_MAX_FRAME))
+        return;
+
+    ns_shm_learn(conn, &pkt->data[6]);
+
+    if (!(dest[0] & 1)) {
+        for (int i = 0; i < NS_SHM_PORTS; i++) {
+            if ((i != conn->port_num) && atomic_load_explicit(&conn->sw->ports[i].active, memory_order_acquire) &&
+                ns_shm_mac_known(&conn->sw->ports[i], dest)) {
+                target = i;
+                break;
+            }
+        }
+    }
+
+    /* Known unicast goes to its port and promiscuous ones, everything else floods */
+    for (int i = 0; i < NS_SHM_PORTS; i++) {
+        const ns_shm_port_t *port = &conn->sw->ports[i];
+
+        if ((i == conn->port_num) || !atomic_load_explicit(&port->active, memory_order_acquire))
+            continue;
+
+        if ((target < 0) || (i == target) || atomic_load_explicit(&port->promisc, memory_order_relaxed))
+            ns_shm_deliver(conn, i, pkt);
+    }
+}
+
+static bool
+ns_shm_accept(ns_shm_t *conn, const ns_shm_frame_t *slot)
+{
+    const uint8_t *dest = slot->data;
+
+    /*
+     * Accept frames that are
+     *   Unicast for us (or an address we have sent from)
+     *   Multicasts and broadcasts that are not from us
+     *   All other frames *if* promiscuous mode is enabled (excluding our own)
+     */
+    if (!memcmp(&slot->data[6], conn->mac_addr, 6))
+        return false;
+
+    return !memcmp(dest, conn->mac_addr, 6) || (dest[0] & 1) ||
+           atomic_load_explicit(&conn->port->promisc, memory_order_relaxed) || ns_shm_mac_known(conn->port, dest);
+}
+
+bool
+ns_shm_recv(ns_shm_t *conn, netcard_t *card)
+{
+    ns_shm_port_t *port = conn->port;
+    uint8_t        bell[16];
+    uint8_t       *buf;
+    uint32_t       tail;
+    uint32_t       head;
+
+    while (recv(conn->fd, bell, sizeof(bell), MSG_DONTWAIT) > 0)
+        ;
+
+    tail = atomic_load_explicit(&port->tail, memory_order_relaxed);
+    for (;;) {
+        head = atomic_load_explicit(&port->head, memory_order_acquire);
+
+        for (; tail != head; tail++) {
+            const ns_shm_frame_t *slot = &port->ring[tail & (NS_SHM_RING_LEN - 1)];
+
+            if ((slot->len > NET_MAX_FRAME) || !ns_shm_accept(conn, slot))
+                continue;
+
+            if ((buf = network_rx_get_buf(card)) == NULL) {
+                /* The card is full, leave the rest for later */
+                atomic_store_explicit(&port->tail, tail, memory_order_release);
+                return true;
+            }
+            memcpy(buf, slot->data, slot->len);
+            network_rx_commit(card, slot->len);
+        }
+        atomic_store_explicit(&port->tail, tail, memory_order_release);
+
+        /* Arm the doorbell, then make sure nothing got in before it was */
+        atomic_store_explicit(&port->armed, 1, memory_order_seq_cst);
+        if (atomic_load_explicit(&port->head, memory_order_seq_cst) == tail)
+            return false;
+        atomic_store_explicit(&port->armed, 0, memory_order_relaxed);
+    }
+}
+
+void
+ns_shm_close(ns_shm_t *conn)
+{
+    if (conn == NULL)
+        return;
+
+    if (atomic_load(&conn->port->drops))
+        net_switch_log("SHM Net Switch: port %d dropped %u frames\n", conn->port_num, atomic_load(&conn->port->drops));
+
+    close(conn->fd);
+#ifndef __linux__
+    struct sockaddr_un addr;
+    ns_shm_doorbell_addr(&addr, conn->group, conn->port_num);
+    unlink(addr.sun_path);
+#endif
+
+    ns_shm_release(conn);
+    free(conn);
+}
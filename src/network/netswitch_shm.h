@@ -0,0 +1,45 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Shared memory transport for the local Network Switch.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#ifndef NET_SWITCH_SHM_H
+#define NET_SWITCH_SHM_H
+
+/* Ports per switch group, i.e. cards that can be on one switch */
+#define NS_SHM_PORTS     16
+/* Frames each port can hold, must be a power of 2 */
+#define NS_SHM_RING_LEN  256
+/* Source addresses learned per port */
+#define NS_SHM_MACS      8
+/* In ms, how soon to retry when the card could not take everything */
+#define NS_SHM_RETRY     1
+
+typedef struct ns_shm ns_shm_t;
+
+/* Attach a port to the shared memory switch of a group, creating the switch if needed */
+ns_shm_t *ns_shm_open(uint8_t group, const uint8_t *mac_addr, bool promisc);
+
+/* Returns the doorbell file descriptor for polling */
+int ns_shm_pollfd(const ns_shm_t *conn);
+
+/* Switch a frame from our port to the port(s) it is meant for */
+void ns_shm_send(ns_shm_t *conn, const netpkt_t *pkt);
+
+/* Move the frames waiting on our port into the card's RX ring.
+ * Returns true if some had to stay behind because the card was full. */
+bool ns_shm_recv(ns_shm_t *conn, netcard_t *card);
+
+/* Detaches the port and cleans up */
+void ns_shm_close(ns_shm_t *conn);
+
+#endif
@@ -47,6 +47,7 @@
 #include <stdarg.h>
 #include <stdatomic.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -133,6 +134,8 @@ int  network_ndev;
 netdev_t network_devs[NET_HOST_INTF_MAX];
 
 /* Local variables. */
+static netcard_t *net_card_list[NET_CARD_MAX];
+
 #ifdef ENABLE_NETWORK_LOG
 int             network_do_log = ENABLE_NETWORK_LOG;
 static FILE    *network_dump   = NULL;
@@ -274,26 +277,67 @@ network_init(void)
 #endif
 }
 
-void
-network_queue_init(netqueue_t *queue)
+/* Round a configured ring depth to a power of 2 within the limits. */
+static uint32_t
+network_queue_len(uint16_t len)
 {
-    queue->head = queue->tail = 0;
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
-        queue->packets[i].data = calloc(1, NET_MAX_FRAME);
-        queue->packets[i].len  = 0;
+    uint32_t size = NET_QUEUE_LEN_MIN;
+
+    if (len == 0)
+        return NET_QUEUE_LEN;
+
+    while ((size < len) && (size < NET_QUEUE_LEN_MAX))
+        size <<= 1;
+
+    return size;
+}
+
+/*
+ * The frame buffers are all allocated here, and afterwards only change
+ * hands by swapping pointers with the packets of the host drivers and
+ * with the other rings.
+ */
+int
+network_queue_init(netqueue_t *queue, uint32_t size)
+{
+    queue->packets = calloc(size, sizeof(netpkt_t));
+    if (queue->packets == NULL)
+        return 0;
+
+    queue->mask = size - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    for (uint32_t i = 0; i < size; i++) {
+        queue->packets[i].data = calloc(1, NET_FRAME_BUF_SIZE);
+        if (queue->packets[i].data == NULL)
+            return 0;
+        queue->packets[i].len = 0;
     }
+
+    return 1;
 }
 
-static bool
-network_queue_full(netqueue_t *queue)
+/* Number of frames waiting, may only be relied upon by the consumer. */
+static inline uint32_t
+network_queue_count(netqueue_t *queue)
 {
-    return ((queue->head + 1) & NET_QUEUE_LEN_MASK) == queue->tail;
+    return atomic_load_explicit(&queue->head, memory_order_acquire) -
+           atomic_load_explicit(&queue->tail, memory_order_relaxed);
+}
+
+/* Number of free slots, may only be relied upon by the producer. */
+static inline uint32_t
+network_queue_space(netqueue_t *queue)
+{
+    return queue->mask + 1 - (atomic_load_explicit(&queue->head, memory_order_relaxed) -
+                              atomic_load_explicit(&queue->tail, memory_order_acquire));
 }
 
 static bool
 network_queue_empty(netqueue_t *queue)
 {
-    return (queue->head == queue->tail);
+    return (atomic_load_explicit(&queue->head, memory_order_acquire) ==
+            atomic_load_explicit(&queue->tail, memory_order_acquire));
 }
 
 static inline void
@@ -307,23 +351,27 @@ network_swap_packet(netpkt_t *pkt1, netpkt_t *pkt2)
 int
 network_queue_put(netqueue_t *queue, uint8_t *data, int len)
 {
-    if (len == 0 || len > NET_MAX_FRAME || network_queue_full(queue)) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    if (len <= 0 || len > NET_MAX_FRAME || !network_queue_space(queue)) {
         return 0;
     }
 
-    netpkt_t *pkt = &queue->packets[queue->head];
+    netpkt_t *pkt = &queue->packets[head & queue->mask];
     memcpy(pkt->data, data, len);
-    pkt->len    = len;
-    queue->head = (queue->head + 1) & NET_QUEUE_LEN_MASK;
+    pkt->len = len;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
     return 1;
 }
 
 int
 network_queue_put_swap(netqueue_t *queue, netpkt_t *src_pkt)
 {
-    if (src_pkt->len == 0 || src_pkt->len > NET_MAX_FRAME || network_queue_full(queue)) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    if (src_pkt->len <= 0 || src_pkt->len > NET_MAX_FRAME || !network_queue_space(queue)) {
 #ifdef DEBUG
-        if (src_pkt->len == 0) {
+        if (src_pkt->len <= 0) {
             network_log("Discarded zero length packet.\n");
         } else if (src_pkt->len > NET_MAX_FRAME) {
             network_log("Discarded oversized packet of len=%d.\n", src_pkt->len);
@@ -334,53 +382,122 @@ network_queue_put_swap(netqueue_t *queue, netpkt_t *src_pkt)
         return 0;
     }
 
-    netpkt_t *dst_pkt = &queue->packets[queue->head];
+    netpkt_t *dst_pkt = &queue->packets[head & queue->mask];
     network_swap_packet(src_pkt, dst_pkt);
 
-    queue->head = (queue->head + 1) & NET_QUEUE_LEN_MASK;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
     return 1;
 }
 
+/* Take up to vec_size frames off the ring, releasing their slots in one go. */
 static int
-network_queue_get_swap(netqueue_t *queue, netpkt_t *dst_pkt)
+network_queue_getv_swap(netqueue_t *queue, netpkt_t *pkt_vec, int vec_size)
 {
-    if (network_queue_empty(queue))
-        return 0;
+    uint32_t tail  = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t count = network_queue_count(queue);
 
-    netpkt_t *src_pkt = &queue->packets[queue->tail];
-    network_swap_packet(src_pkt, dst_pkt);
-    queue->tail = (queue->tail + 1) & NET_QUEUE_LEN_MASK;
-    return 1;
+    if (count > (uint32_t) vec_size)
+        count = vec_size;
+
+    for (uint32_t i = 0; i < count; i++)
+        network_swap_packet(&queue->packets[(tail + i) & queue->mask], &pkt_vec[i]);
+
+    if (count)
+        atomic_store_explicit(&queue->tail, tail + count, memory_order_release);
+
+    return count;
 }
 
 static int
-network_queue_move(netqueue_t *dst_q, netqueue_t *src_q)
+network_queue_get_swap(netqueue_t *queue, netpkt_t *dst_pkt)
 {
-    if (network_queue_empty(src_q))
-        return 0;
+    return network_queue_getv_swap(queue, dst_pkt, 1);
+}
 
-    if (network_queue_full(dst_q)) {
+/*
+ * Move as many frames as fit from one ring to another, the caller being the
+ * consumer of the source and the producer of the destination. Returns the
+ * number of bytes moved.
+ */
+static uint32_t
+network_queue_move(netqueue_t *dst_q, netqueue_t *src_q, uint32_t *frames)
+{
+    uint32_t src_tail = atomic_load_explicit(&src_q->tail, memory_order_relaxed);
+    uint32_t dst_head = atomic_load_explicit(&dst_q->head, memory_order_relaxed);
+    uint32_t count    = network_queue_count(src_q);
+    uint32_t space    = network_queue_space(dst_q);
+    uint32_t bytes    = 0;
+
+    if (count > space)
+        count = space;
+    *frames = count;
+    if (!count)
         return 0;
-    }
 
-    netpkt_t *src_pkt = &src_q->packets[src_q->tail];
-    netpkt_t *dst_pkt = &dst_q->packets[dst_q->head];
+    for (uint32_t i = 0; i < count; i++) {
+        netpkt_t *src_pkt = &src_q->packets[(src_tail + i) & src_q->mask];
+        netpkt_t *dst_pkt = &dst_q->packets[(dst_head + i) & dst_q->mask];
 
-    network_swap_packet(src_pkt, dst_pkt);
-    dst_q->head = (dst_q->head + 1) & NET_QUEUE_LEN_MASK;
-    src_q->tail = (src_q->tail + 1) & NET_QUEUE_LEN_MASK;
+        network_swap_packet(src_pkt, dst_pkt);
+        bytes += dst_pkt->len;
+    }
 
-    return dst_pkt->len;
+    atomic_store_explicit(&dst_q->head, dst_head + count, memory_order_release);
+    atomic_store_explicit(&src_q->tail, src_tail + count, memory_order_release);
+
+    return bytes;
 }
 
 void
 network_queue_clear(netqueue_t *queue)
 {
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
+    if (queue->packets == NULL)
+        return;
+
+    for (uint32_t i = 0; i <= queue->mask; i++)
         free(queue->packets[i].data);
-        queue->packets[i].len = 0;
-    }
-    queue->tail = queue->head = 0;
+    free(queue->packets);
+    queue->packets = NULL;
+    atomic_store(&queue->head, 0);
+    atomic_store(&queue->tail, 0);
+}
+
+static void
+network_update_stats(netcard_t *card, uint32_t rx_frames, uint32_t rx_bytes,
+                     uint32_t tx_frames, uint32_t tx_bytes, double period)
+{
+    netcard_stats_t *stats = &card->stats;
+    netcard_stats_t *last  = &card->stats_last;
+    double           scale;
+
+    stats->rx_frames += rx_frames;
+    stats->rx_bytes += rx_bytes;
+    stats->tx_frames += tx_frames;
+    stats->tx_bytes += tx_bytes;
+
+    if (atomic_load_explicit(&card->rx_drops, memory_order_relaxed))
+        stats->rx_drops += atomic_exchange_explicit(&card->rx_drops, 0, memory_order_relaxed);
+
+    card->stats_period += period;
+    if (card->stats_period < 1000000.0)
+        return;
+
+    scale         = 1000000.0 / card->stats_period;
+    stats->rx_fps = (uint32_t) ((stats->rx_frames - last->rx_frames) * scale);
+    stats->rx_bps = (uint32_t) ((stats->rx_bytes - last->rx_bytes) * scale);
+    stats->tx_fps = (uint32_t) ((stats->tx_frames - last->tx_frames) * scale);
+    stats->tx_bps = (uint32_t) ((stats->tx_bytes - last->tx_bytes) * scale);
+
+    if (stats->rx_fps || stats->tx_fps)
+        network_log("NETWORK: card %d: RX %u frames/s, %u bytes/s, TX %u frames/s, %u bytes/s\n",
+                    card->card_num + 1, stats->rx_fps, stats->rx_bps, stats->tx_fps, stats->tx_bps);
+    if ((stats->rx_drops != last->rx_drops) || (stats->tx_drops != last->tx_drops) ||
+        (stats->rx_overruns != last->rx_overruns))
+        network_log("NETWORK: card %d: %" PRIu64 " RX drops, %" PRIu64 " TX drops, %" PRIu64 " RX overruns so far\n",
+                    card->card_num + 1, stats->rx_drops, stats->tx_drops, stats->rx_overruns);
+
+    *last              = *stats;
+    card->stats_period = 0.0;
 }
 
 static void
@@ -395,35 +512,37 @@ network_rx_queue(void *priv)
         card->link_state = new_link_state;
     }
 
-    uint32_t rx_bytes = 0;
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
+    /* Hand over up to a full ring per tick, the byte rate pacing below evens it out. */
+    uint32_t rx_bytes  = 0;
+    uint32_t rx_frames = 0;
+    for (uint32_t i = 0; i <= card->queues[NET_QUEUE_RX].mask; i++) {
         if (card->queued_pkt.len == 0) {
-            thread_wait_mutex(card->rx_mutex);
-            int res = network_queue_get_swap(&card->queues[NET_QUEUE_RX], &card->queued_pkt);
-            thread_release_mutex(card->rx_mutex);
-            if (!res)
+            if (!network_queue_get_swap(&card->queues[NET_QUEUE_RX_LOCAL], &card->queued_pkt) &&
+                !network_queue_get_swap(&card->queues[NET_QUEUE_RX], &card->queued_pkt))
                 break;
         }
 
         network_dump_packet(&card->queued_pkt);
         int res = card->rx(card->card_drv, card->queued_pkt.data, card->queued_pkt.len);
-        if (!res)
+        if (!res) {
+            /* Count a frame the NIC holds off once, not on every retry. */
+            if (!card->rx_stalled)
+                card->stats.rx_overruns++;
+            card->rx_stalled = 1;
             break;
+        }
+        card->rx_stalled = 0;
+        if (card->capture)
+            net_capture_frame(card->capture, card->queued_pkt.data, card->queued_pkt.len, NET_CAPTURE_IN);
         rx_bytes += card->queued_pkt.len;
+        rx_frames++;
         card->queued_pkt.len = 0;
     }
 
     /* Transmission. */
-    uint32_t tx_bytes = 0;
-    thread_wait_mutex(card->tx_mutex);
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
-        uint32_t bytes = network_queue_move(&card->queues[NET_QUEUE_TX_HOST], &card->queues[NET_QUEUE_TX_VM]);
-        if (!bytes)
-            break;
-        tx_bytes += bytes;
-    }
-    thread_release_mutex(card->tx_mutex);
-    if (tx_bytes) {
+    uint32_t tx_frames;
+    uint32_t tx_bytes = network_queue_move(&card->queues[NET_QUEUE_TX_HOST], &card->queues[NET_QUEUE_TX_VM], &tx_frames);
+    if (tx_bytes || !network_queue_empty(&card->queues[NET_QUEUE_TX_HOST])) {
         /* Notify host that a packet is available in the TX queue */
         card->host_drv.notify_in(card->host_drv.priv);
     }
@@ -434,6 +553,8 @@ network_rx_queue(void *priv)
 
     timer_on_auto(&card->timer, timer_period);
 
+    network_update_stats(card, rx_frames, rx_bytes, tx_frames, tx_bytes, timer_period);
+
     bool activity = rx_bytes || tx_bytes;
     bool led_on   = card->led_timer & 0x80000000;
     if ((activity && !led_on) || (card->led_timer & 0x7fffffff) >= 150000) {
@@ -457,12 +578,11 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
 {
     netcard_t *card       = calloc(1, sizeof(netcard_t));
     int net_type          = net_cards_conf[net_card_current].net_type;
-    card->queued_pkt.data = calloc(1, NET_MAX_FRAME);
+    uint32_t queue_len    = network_queue_len(net_cards_conf[net_card_current].queue_len);
+    card->queued_pkt.data = calloc(1, NET_FRAME_BUF_SIZE);
     card->card_drv        = card_drv;
     card->rx              = rx;
     card->set_link_state  = set_link_state;
-    card->tx_mutex        = thread_create_mutex();
-    card->rx_mutex        = thread_create_mutex();
     card->card_num        = net_card_current;
     card->byte_period     = NET_PERIOD_10M;
 
@@ -470,7 +590,8 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
     wchar_t tempmsg[NET_DRV_ERRBUF_SIZE * 2];
 
     for (int i = 0; i < NET_QUEUE_COUNT; i++) {
-        network_queue_init(&card->queues[i]);
+        if (!network_queue_init(&card->queues[i], queue_len))
+            fatal("Error initializing the network device: Unable to allocate the packet queues\n");
     }
 
     if ((!strcmp(network_card_get_internal_name(net_cards_conf[net_card_current].device_num), "modem") ||
@@ -543,8 +664,6 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
         // If null fails, something is very wrong
         // Clean up and fatal
         if(!card->host_drv.priv) {
-            thread_close_mutex(card->tx_mutex);
-            thread_close_mutex(card->rx_mutex);
             for (int i = 0; i < NET_QUEUE_COUNT; i++) {
                 network_queue_clear(&card->queues[i]);
             }
@@ -558,9 +677,14 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
 
     }
 
+    if (net_cards_conf[net_card_current].capture_fn[0] != '\0')
+        card->capture = net_capture_open(net_cards_conf[net_card_current].capture_fn, card->card_num);
+
     timer_add(&card->timer, network_rx_queue, card, 0);
     timer_on_auto(&card->timer, 100);
 
+    net_card_list[card->card_num] = card;
+
     return card;
 }
 
@@ -569,9 +693,11 @@ netcard_close(netcard_t *card)
 {
     timer_stop(&card->timer);
     card->host_drv.close(card->host_drv.priv);
+    net_capture_close(card->capture);
+
+    if (net_card_list[card->card_num] == card)
+        net_card_list[card->card_num] = NULL;
 
-    thread_close_mutex(card->tx_mutex);
-    thread_close_mutex(card->rx_mutex);
     for (int i = 0; i < NET_QUEUE_COUNT; i++) {
         network_queue_clear(&card->queues[i]);
     }
@@ -626,65 +752,79 @@ network_reset(void)
 void
 network_tx(netcard_t *card, uint8_t *bufp, int len)
 {
-    network_queue_put(&card->queues[NET_QUEUE_TX_VM], bufp, len);
+    if (!network_queue_put(&card->queues[NET_QUEUE_TX_VM], bufp, len)) {
+        card->stats.tx_drops++;
+        return;
+    }
+
+    if (card->capture)
+        net_capture_frame(card->capture, bufp, len, NET_CAPTURE_OUT);
 }
 
 int
 network_tx_pop(netcard_t *card, netpkt_t *out_pkt)
 {
-    int ret = 0;
-
-    thread_wait_mutex(card->tx_mutex);
-    ret = network_queue_get_swap(&card->queues[NET_QUEUE_TX_HOST], out_pkt);
-    thread_release_mutex(card->tx_mutex);
-
-    return ret;
+    return network_queue_get_swap(&card->queues[NET_QUEUE_TX_HOST], out_pkt);
 }
 
 int
 network_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size)
 {
-    int pkt_count = 0;
+    int pkt_count = network_queue_getv_swap(&card->queues[NET_QUEUE_TX_HOST], pkt_vec, vec_size);
 
-    netqueue_t *queue = &card->queues[NET_QUEUE_TX_HOST];
-    thread_wait_mutex(card->tx_mutex);
-    for (int i = 0; i < vec_size; i++) {
-        if (!network_queue_get_swap(queue, pkt_vec))
-            break;
-        network_dump_packet(pkt_vec);
-        pkt_count++;
-        pkt_vec++;
-    }
-    thread_release_mutex(card->tx_mutex);
+    for (int i = 0; i < pkt_count; i++)
+        network_dump_packet(&pkt_vec[i]);
 
     return pkt_count;
 }
 
-int
-network_rx_put(netcard_t *card, uint8_t *bufp, int len)
+/*
+ * Each ring has a single producer. Host drivers queue received frames from
+ * their own thread, anything received on the emulation thread (NIC loopback,
+ * SLiRP timers) goes through a ring of its own.
+ */
+static inline netqueue_t *
+network_rx_queue_get(netcard_t *card, int queue)
 {
-    int ret = 0;
+    return &card->queues[is_cpu_thread ? NET_QUEUE_RX_LOCAL : queue];
+}
 
-    thread_wait_mutex(card->rx_mutex);
-    ret = network_queue_put(&card->queues[NET_QUEUE_RX], bufp, len);
-    thread_release_mutex(card->rx_mutex);
+/* For host drivers that had to throw a received frame away. */
+void
+network_rx_drop(netcard_t *card)
+{
+    atomic_fetch_add_explicit(&card->rx_drops, 1, memory_order_relaxed);
+}
+
+/* For NICs that had to throw a frame away for lack of room in guest memory. */
+void
+network_rx_overrun(netcard_t *card)
+{
+    card->stats.rx_overruns++;
+}
+
+static inline int
+network_rx_count(netcard_t *card, int ret)
+{
+    if (!ret)
+        network_rx_drop(card);
 
     return ret;
 }
 
+int
+network_rx_put(netcard_t *card, uint8_t *bufp, int len)
+{
+    return network_rx_count(card, network_queue_put(network_rx_queue_get(card, NET_QUEUE_RX), bufp, len));
+}
+
 int
 network_rx_on_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size)
 {
-    int pkt_count = 0;
+    int pkt_count = network_queue_getv_swap(&card->queues[NET_QUEUE_RX_ON_TX], pkt_vec, vec_size);
 
-    netqueue_t *queue = &card->queues[NET_QUEUE_RX_ON_TX];
-    for (int i = 0; i < vec_size; i++) {
-        if (!network_queue_get_swap(queue, pkt_vec))
-            break;
-        network_dump_packet(pkt_vec);
-        pkt_count++;
-        pkt_vec++;
-    }
+    for (int i = 0; i < pkt_count; i++)
+        network_dump_packet(&pkt_vec[i]);
 
     return pkt_count;
 }
@@ -692,33 +832,51 @@ network_rx_on_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size)
 int
 network_rx_on_tx_put(netcard_t *card, uint8_t *bufp, int len)
 {
-    int ret = 0;
-
-    ret = network_queue_put(&card->queues[NET_QUEUE_RX_ON_TX], bufp, len);
-
-    return ret;
+    return network_rx_count(card, network_queue_put(network_rx_queue_get(card, NET_QUEUE_RX_ON_TX), bufp, len));
 }
 
 int
 network_rx_on_tx_put_pkt(netcard_t *card, netpkt_t *pkt)
 {
-    int ret = 0;
+    return network_rx_count(card, network_queue_put_swap(network_rx_queue_get(card, NET_QUEUE_RX_ON_TX), pkt));
+}
 
-    ret = network_queue_put_swap(&card->queues[NET_QUEUE_RX_ON_TX], pkt);
+int
+network_rx_put_pkt(netcard_t *card, netpkt_t *pkt)
+{
+    return network_rx_count(card, network_queue_put_swap(network_rx_queue_get(card, NET_QUEUE_RX), pkt));
+}
 
-    return ret;
+/*
+ * Let a host driver receive straight into the next free RX slot, which the
+ * NIC then copies to guest memory as is. Returns NULL if the ring is full,
+ * otherwise the buffer (NET_FRAME_BUF_SIZE bytes) stays reserved until
+ * network_rx_commit() is called from the same thread.
+ */
+uint8_t *
+network_rx_get_buf(netcard_t *card)
+{
+    netqueue_t *queue = network_rx_queue_get(card, NET_QUEUE_RX);
+    uint32_t    head  = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    if (!network_queue_space(queue))
+        return NULL;
+
+    return queue->packets[head & queue->mask].data;
 }
 
 int
-network_rx_put_pkt(netcard_t *card, netpkt_t *pkt)
+network_rx_commit(netcard_t *card, int len)
 {
-    int ret = 0;
+    netqueue_t *queue = network_rx_queue_get(card, NET_QUEUE_RX);
+    uint32_t    head  = atomic_load_explicit(&queue->head, memory_order_relaxed);
 
-    thread_wait_mutex(card->rx_mutex);
-    ret = network_queue_put_swap(&card->queues[NET_QUEUE_RX], pkt);
-    thread_release_mutex(card->rx_mutex);
+    if (len <= 0 || len > NET_MAX_FRAME)
+        return 0;
 
-    return ret;
+    queue->packets[head & queue->mask].len = len;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return 1;
 }
 
 void
@@ -816,6 +974,19 @@ network_card_get_internal_name(int card)
     return device_get_internal_name(net_cards[card].device);
 }
 
+/* Traffic and drop counters of an attached card, returns 0 if there is none. */
+int
+network_card_get_stats(int id, netcard_stats_t *stats)
+{
+    if ((id < 0) || (id >= NET_CARD_MAX) || (net_card_list[id] == NULL))
+        return 0;
+
+    *stats = net_card_list[id]->stats;
+    stats->rx_drops += atomic_load_explicit(&net_card_list[id]->rx_drops, memory_order_relaxed);
+
+    return 1;
+}
+
 /* UI */
 int
 network_card_get_from_internal_name(char *s)
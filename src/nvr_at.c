@@ -218,6 +218,7 @@
  *   USA.
  */
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
@@ -236,6 +237,7 @@
 #include <86box/rom.h>
 #include <86box/device.h>
 #include <86box/nvr.h>
+#include <86box/savestate.h>
 
 /* RTC registers and bit definitions. */
 #define RTC_SECONDS        0
@@ -1070,6 +1072,22 @@ nvr_at_reset(void *priv)
     nvr->regs[RTC_REGC] &= ~(REGC_PF | REGC_AF | REGC_UF | REGC_IRQF);
 }
 
+static void
+nvr_at_savestate(void *priv, savestate_t *st)
+{
+    nvr_t   *nvr   = (nvr_t *) priv;
+    local_t *local = (local_t *) nvr->data;
+
+    savestate_var(st, nvr->regs);
+    savestate_var(st, nvr->onesec_cnt);
+    savestate_timer(st, &nvr->onesec_time);
+
+    savestate_struct_until(st, local, local_t, lock);
+    savestate_data(st, &local->count, offsetof(local_t, update_timer) - offsetof(local_t, count));
+    savestate_timer(st, &local->update_timer);
+    savestate_timer(st, &local->rtc_timer);
+}
+
 static void *
 nvr_at_init(const device_t *info)
 {
@@ -1256,7 +1274,9 @@ const device_t at_nvr_old_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t at_nvr_device = {
@@ -1270,7 +1290,9 @@ const device_t at_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t at_mb_nvr_device = {
@@ -1284,7 +1306,9 @@ const device_t at_mb_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t ps_nvr_device = {
@@ -1298,7 +1322,9 @@ const device_t ps_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t amstrad_nvr_device = {
@@ -1312,7 +1338,9 @@ const device_t amstrad_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t ibmat_nvr_device = {
@@ -1326,7 +1354,9 @@ const device_t ibmat_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t piix4_nvr_device = {
@@ -1340,7 +1370,9 @@ const device_t piix4_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t ps_no_nmi_nvr_device = {
@@ -1354,7 +1386,9 @@ const device_t ps_no_nmi_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t amstrad_no_nmi_nvr_device = {
@@ -1368,7 +1402,9 @@ const device_t amstrad_no_nmi_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t ami_1992_nvr_device = {
@@ -1382,7 +1418,9 @@ const device_t ami_1992_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t ami_1994_nvr_device = {
@@ -1396,7 +1434,9 @@ const device_t ami_1994_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t ami_1995_nvr_device = {
@@ -1410,7 +1450,9 @@ const device_t ami_1995_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t via_nvr_device = {
@@ -1424,7 +1466,9 @@ const device_t via_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t p6rp4_nvr_device = {
@@ -1438,7 +1482,9 @@ const device_t p6rp4_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t amstrad_megapc_nvr_device = {
@@ -1452,7 +1498,9 @@ const device_t amstrad_megapc_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t martin_nvr_device = {
@@ -1466,7 +1514,9 @@ const device_t martin_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
 
 const device_t elt_nvr_device = {
@@ -1480,5 +1530,7 @@ const device_t elt_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = nvr_at_savestate,
+    .savestate_ver = 1
 };
@@ -17,6 +17,7 @@
  */
 #include <inttypes.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -36,6 +37,7 @@
 #include <86box/apm.h>
 #include <86box/nvr.h>
 #include <86box/acpi.h>
+#include <86box/savestate.h>
 #include <86box/plat_unused.h>
 
 enum {
@@ -278,6 +280,28 @@ pic_reset(void)
     pic_pci = 0;
 }
 
+/* The slave pointers and the pending update handler are set up by the
+   hard reset for the current machine and are left alone. */
+void
+pic_savestate(savestate_t *st)
+{
+    savestate_struct_until(st, &pic, pic_t, slaves);
+    savestate_struct_until(st, &pic2, pic_t, slaves);
+    savestate_timer(st, &pic_timer);
+
+    savestate_var(st, shadow);
+    savestate_var(st, elcr_enabled);
+    savestate_var(st, pic_pci);
+    savestate_var(st, kbd_latch);
+    savestate_var(st, mouse_latch);
+    savestate_var(st, smi_irq_mask);
+    savestate_var(st, smi_irq_status);
+    savestate_var(st, latched_irqs);
+
+    if (st->loading)
+        update_pending();
+}
+
 void
 pic_set_shadow(int sh)
 {
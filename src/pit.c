@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -35,6 +36,7 @@
 #include <86box/pit.h>
 #include <86box/pit_fast.h>
 #include <86box/ppi.h>
+#include <86box/savestate.h>
 #include <86box/machine.h>
 #include <86box/sound.h>
 #include <86box/snd_speaker.h>
@@ -937,6 +939,19 @@ pit_close(void *priv)
         free(dev);
 }
 
+static void
+pit_savestate(void *priv, savestate_t *st)
+{
+    pit_t *dev = (pit_t *) priv;
+
+    savestate_var(st, dev->clock);
+    savestate_timer(st, &dev->callback_timer);
+    for (int i = 0; i < NUM_COUNTERS; i++)
+        savestate_struct_until(st, &dev->counters[i], ctr_t, load_func);
+    savestate_var(st, dev->ctrl);
+    savestate_var(st, dev->pit_const);
+}
+
 static void *
 pit_init(const device_t *info)
 {
@@ -973,7 +988,9 @@ const device_t i8253_device = {
     .available     = NULL,
     .speed_changed = pit_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pit_savestate,
+    .savestate_ver = 1
 };
 
 const device_t i8253_ext_io_device = {
@@ -987,7 +1004,9 @@ const device_t i8253_ext_io_device = {
     .available     = NULL,
     .speed_changed = NULL,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pit_savestate,
+    .savestate_ver = 1
 };
 
 const device_t i8254_device = {
@@ -1001,7 +1020,9 @@ const device_t i8254_device = {
     .available     = NULL,
     .speed_changed = pit_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pit_savestate,
+    .savestate_ver = 1
 };
 
 const device_t i8254_sec_device = {
@@ -1015,7 +1036,9 @@ const device_t i8254_sec_device = {
     .available     = NULL,
     .speed_changed = pit_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pit_savestate,
+    .savestate_ver = 1
 };
 
 const device_t i8254_ext_io_device = {
@@ -1029,7 +1052,9 @@ const device_t i8254_ext_io_device = {
     .available     = NULL,
     .speed_changed = NULL,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pit_savestate,
+    .savestate_ver = 1
 };
 
 const device_t i8254_ps2_device = {
@@ -1043,7 +1068,9 @@ const device_t i8254_ps2_device = {
     .available     = NULL,
     .speed_changed = pit_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pit_savestate,
+    .savestate_ver = 1
 };
 
 pit_t *
@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -35,6 +36,7 @@
 #include <86box/pit.h>
 #include <86box/pit_fast.h>
 #include <86box/ppi.h>
+#include <86box/savestate.h>
 #include <86box/machine.h>
 #include <86box/sound.h>
 #include <86box/snd_speaker.h>
@@ -714,6 +716,18 @@ pitf_handler(int set, uint16_t base, int size, void *priv)
     io_handler(set, base, size, pitf_read, NULL, NULL, pitf_write, NULL, NULL, priv);
 }
 
+static void
+pitf_savestate(void *priv, savestate_t *st)
+{
+    pitf_t *dev = (pitf_t *) priv;
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        savestate_struct_until(st, &dev->counters[i], ctrf_t, timer);
+        savestate_timer(st, &dev->counters[i].timer);
+    }
+    savestate_var(st, dev->ctrl);
+}
+
 static void *
 pitf_init(const device_t *info)
 {
@@ -752,7 +766,9 @@ const device_t i8253_fast_device = {
     .available     = NULL,
     .speed_changed = pitf_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pitf_savestate,
+    .savestate_ver = 1
 };
 
 const device_t i8254_fast_device = {
@@ -766,7 +782,9 @@ const device_t i8254_fast_device = {
     .available     = NULL,
     .speed_changed = pitf_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pitf_savestate,
+    .savestate_ver = 1
 };
 
 const device_t i8254_sec_fast_device = {
@@ -780,7 +798,9 @@ const device_t i8254_sec_fast_device = {
     .available     = NULL,
     .speed_changed = pitf_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pitf_savestate,
+    .savestate_ver = 1
 };
 
 const device_t i8254_ext_io_fast_device = {
@@ -794,7 +814,9 @@ const device_t i8254_ext_io_fast_device = {
     .available     = NULL,
     .speed_changed = NULL,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pitf_savestate,
+    .savestate_ver = 1
 };
 
 const device_t i8254_ps2_fast_device = {
@@ -808,7 +830,9 @@ const device_t i8254_ps2_fast_device = {
     .available     = NULL,
     .speed_changed = pitf_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .savestate     = pitf_savestate,
+    .savestate_ver = 1
 };
 
 const pit_intf_t pit_fast_intf = {
@@ -576,7 +576,7 @@ HarddiskDialog::onExistingFileSelected(const QString &fileName, bool precheck)
     QByteArray fileNameUtf8 = fileName.toUtf8();
 
     QFileInfo fi(file);
-    if (image_is_hdi(fileNameUtf8.data()) || image_is_hdx(fileNameUtf8.data(), 1)) {
+    if (image_is_hdi(fileNameUtf8.data()) || image_is_hdx(fileNameUtf8.data(), 1) || image_is_hdz(fileNameUtf8.data(), 1)) {
         file.seek(0x10);
         QDataStream stream(&file);
         stream.setByteOrder(QDataStream::LittleEndian);
@@ -55,6 +55,7 @@ extern "C" {
 #include <86box/gdbstub.h>
 #include <86box/version.h>
 #include <86box/renderdefs.h>
+#include <86box/bench.h>
 #ifdef Q_OS_LINUX
 #define GAMEMODE_AUTO
 #include "../unix/gamemode/gamemode_client.h"
@@ -448,6 +449,8 @@ main_thread_fn()
     uint64_t old_time = elapsed_timer.elapsed();
     int drawits = frames = 0;
     is_cpu_thread = 1;
+    if (bench_seconds > 0)
+        bench_run();
     while (!is_quit && cpu_thread_run) {
         /* See if it is time to run a frame of code. */
         const uint64_t new_time = elapsed_timer.elapsed();
@@ -599,8 +602,9 @@ main(int argc, char *argv[])
     keyboard_getkeymap();
 #endif
 
-    if (!pc_init(argc, argv)) {
-        return 0;
+    const int init_ret = pc_init(argc, argv);
+    if (init_ret <= 0) {
+        return (init_ret < 0) ? 1 : 0;
     }
 
 #ifdef Q_OS_WINDOWS
@@ -764,10 +768,12 @@ main(int argc, char *argv[])
 #endif
 
     main_window = new MainWindow();
-    if (startMaximized) {
-        main_window->showMaximized();
-    } else {
-        main_window->show();
+    /* The benchmark mode runs headless, with the window hidden. */
+    if (bench_seconds <= 0) {
+        if (startMaximized)
+            main_window->showMaximized();
+        else
+            main_window->show();
     }
 #ifdef WAYLAND
     if (QApplication::platformName().contains("wayland")) {
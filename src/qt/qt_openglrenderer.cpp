@@ -41,6 +41,7 @@ extern MainWindow* main_window;
 
 #include <QImage>
 
+#include <algorithm>
 #include <cmath>
 
 #include "qt_openglrenderer.hpp"
@@ -904,6 +905,7 @@ OpenGLRenderer::initialize()
         scene_texture.mipmap                                = 0;
 
         create_texture(&scene_texture);
+        textureValid = false;
 
         /* load shader */
         //        const char* shaders[1];
@@ -1139,10 +1141,12 @@ OpenGLRenderer::finalize()
 }
 
 void
-OpenGLRenderer::onBlit(int buf_idx, int x, int y, int w, int h)
+OpenGLRenderer::onBlit(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h)
 {
-    if (notReady())
+    if (notReady()) {
+        textureValid = false;
         return;
+    }
 
     context->makeCurrent(this);
 
@@ -1150,15 +1154,28 @@ OpenGLRenderer::onBlit(int buf_idx, int x, int y, int w, int h)
         glw.glBindTexture(GL_TEXTURE_2D, scene_texture.id);
         glw.glTexImage2D(GL_TEXTURE_2D, 0, (GLenum) QOpenGLTexture::RGBA8_UNorm, w, h, 0, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, NULL);
         glw.glBindTexture(GL_TEXTURE_2D, 0);
+        textureValid = false;
+    }
+
+    /* The texture holds the previous frame, so only the changed rows need uploading. */
+    if (!textureValid || (source.x() != x) || (source.y() != y)) {
+        dirty_y      = y;
+        dirty_h      = h;
+        textureValid = true;
+    } else {
+        dirty_h = std::min(dirty_y + dirty_h, y + h) - std::max(dirty_y, y);
+        dirty_y = std::max(dirty_y, y);
     }
 
     source.setRect(x, y, w, h);
 
-    glw.glBindTexture(GL_TEXTURE_2D, scene_texture.id);
-    glw.glPixelStorei(GL_UNPACK_ROW_LENGTH, 2048);
-    glw.glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, (const void *) ((uintptr_t) imagebufs[buf_idx].get() + (uintptr_t) (2048 * 4 * y + x * 4)));
-    glw.glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glw.glBindTexture(GL_TEXTURE_2D, 0);
+    if (dirty_h > 0) {
+        glw.glBindTexture(GL_TEXTURE_2D, scene_texture.id);
+        glw.glPixelStorei(GL_UNPACK_ROW_LENGTH, 2048);
+        glw.glTexSubImage2D(GL_TEXTURE_2D, 0, 0, dirty_y - y, w, dirty_h, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, (const void *) ((uintptr_t) imagebufs[buf_idx].get() + (uintptr_t) (2048 * 4 * dirty_y + x * 4)));
+        glw.glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glw.glBindTexture(GL_TEXTURE_2D, 0);
+    }
 
     buf_usage[buf_idx].clear();
     source.setRect(x, y, w, h);
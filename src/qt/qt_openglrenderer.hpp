@@ -75,7 +75,7 @@ signals:
     void errorInitializing();
 
 public slots:
-    void onBlit(int buf_idx, int x, int y, int w, int h);
+    void onBlit(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h);
 
 protected:
     void exposeEvent(QExposeEvent *event) override;
@@ -92,6 +92,7 @@ private:
 
     bool isInitialized = false;
     bool isFinalized   = false;
+    bool textureValid  = false;
 
     int max_texture_size = 65536;
     int frameCounter     = 0;
@@ -420,6 +420,14 @@ plat_remove(char *path)
     QFile(path).remove();
 }
 
+/* Replaces an existing file at the destination, returns 0 on success. */
+int
+plat_rename(const char *from, const char *to)
+{
+    QFile::remove(to);
+    return QFile::rename(from, to) ? 0 : -1;
+}
+
 void *
 plat_mmap(size_t size, uint8_t executable)
 {
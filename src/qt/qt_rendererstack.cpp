@@ -47,6 +47,7 @@
 
 #include <atomic>
 #include <mutex>
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <memory>
@@ -462,32 +463,90 @@ RendererStack::createRenderer(Renderer renderer)
     }
 }
 
+void
+RendererStack::addDamage(int &y, int &h, int dy, int dh)
+{
+    if (dh <= 0)
+        return;
+
+    if (h <= 0) {
+        y = dy;
+        h = dh;
+    } else {
+        int y2 = std::max(y + h, dy + dh);
+
+        y = std::min(y, dy);
+        h = y2 - y;
+    }
+}
+
 // called from blitter thread
 void
 RendererStack::blit(int x, int y, int w, int h)
 {
+    int dy;
+    int dh;
+
     if ((x < 0) || (y < 0) || (w <= 0) || (h <= 0) ||
         (w > 2048) || (h > 2048) || (switchInProgress) ||
-        (monitors[m_monitor_index].target_buffer == NULL) || imagebufs.empty() ||
-        std::get<std::atomic_flag *>(imagebufs[currentBuf])->test_and_set()) {
+        (monitors[m_monitor_index].target_buffer == NULL) || imagebufs.empty()) {
+        damageFull = true;
         video_blit_complete_monitor(m_monitor_index);
         return;
     }
+
+    /* Every image buffer collects the rows it has not seen yet, so only
+       those have to be copied when its turn comes. */
+    video_get_damage_monitor(&dy, &dh, m_monitor_index);
+    if (damageFull || (x != dmgX) || (y != dmgY) || (w != dmgW) || (h != dmgH) ||
+        (bufDamage.size() != imagebufs.size())) {
+        bufDamage.assign(imagebufs.size(), std::make_tuple(nullptr, 0, 0));
+        dmgX       = x;
+        dmgY       = y;
+        dmgW       = w;
+        dmgH       = h;
+        unsentY    = y;
+        unsentH    = h;
+        damageFull = false;
+    } else if ((dh == 0) && (unsentH == 0) && !monitors[m_monitor_index].mon_screenshots) {
+        /* Nothing changed since the last frame the renderer got. */
+        video_blit_complete_monitor(m_monitor_index);
+        return;
+    } else {
+        for (auto &dmg : bufDamage)
+            addDamage(std::get<1>(dmg), std::get<2>(dmg), dy, dh);
+        addDamage(unsentY, unsentH, dy, dh);
+    }
+
+    if (std::get<std::atomic_flag *>(imagebufs[currentBuf])->test_and_set()) {
+        video_blit_complete_monitor(m_monitor_index);
+        return;
+    }
+
     sx = x;
     sy = y;
     sw = this->w = w;
     sh = this->h       = h;
     uint8_t *imagebits = std::get<uint8_t *>(imagebufs[currentBuf]);
-    for (int y1 = y; y1 < (y + h); y1++) {
+    auto    &bufDmg    = bufDamage[currentBuf];
+    if (std::get<uint8_t *>(bufDmg) != imagebits) {
+        /* A buffer we have not written to before. */
+        bufDmg = std::make_tuple(imagebits, y, h);
+    }
+    for (int y1 = std::get<1>(bufDmg); y1 < (std::get<1>(bufDmg) + std::get<2>(bufDmg)); y1++) {
         auto scanline = imagebits + (y1 * rendererWindow->getBytesPerRow()) + (x * 4);
         video_copy(scanline, &(monitors[m_monitor_index].target_buffer->line[y1][x]), w * 4);
     }
+    std::get<1>(bufDmg) = 0;
+    std::get<2>(bufDmg) = 0;
 
     if (monitors[m_monitor_index].mon_screenshots && !rendererTakesScreenshots) {
         video_screenshot_monitor((uint32_t *) imagebits, x, y, 2048, m_monitor_index);
     }
     video_blit_complete_monitor(m_monitor_index);
-    emit blitToRenderer(currentBuf, sx, sy, sw, sh);
+    emit blitToRenderer(currentBuf, sx, sy, sw, sh, unsentY, unsentH);
+    unsentY    = 0;
+    unsentH    = 0;
     currentBuf = (currentBuf + 1) % imagebufs.size();
 }
 
@@ -107,7 +107,7 @@ public:
     void (*mouse_exit_func)()                   = nullptr;
 
 signals:
-    void blitToRenderer(int buf_idx, int x, int y, int w, int h);
+    void blitToRenderer(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h);
     void rendererChanged();
 
 public slots:
@@ -135,6 +135,18 @@ private:
 
     std::vector<std::tuple<uint8_t *, std::atomic_flag *>> imagebufs;
 
+    /* Rows each image buffer is missing, and rows not yet sent to the renderer. */
+    std::vector<std::tuple<uint8_t *, int, int>> bufDamage;
+    int  dmgX       = -1;
+    int  dmgY       = -1;
+    int  dmgW       = -1;
+    int  dmgH       = -1;
+    int  unsentY    = 0;
+    int  unsentH    = 0;
+    bool damageFull = true;
+
+    static void addDamage(int &y, int &h, int dy, int dh);
+
     RendererCommon          *rendererWindow { nullptr };
     std::unique_ptr<QWidget> current;
 
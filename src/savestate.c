@@ -0,0 +1,270 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Implementation of the machine save state file format.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/timer.h>
+#include <86box/machine.h>
+#include <86box/plat.h>
+#include <86box/savestate.h>
+
+typedef struct savestate_header_t {
+    char     magic[8];
+    uint32_t version;
+    uint32_t mem_size;
+    uint32_t cpu_speed;
+    uint32_t pad;
+    char     machine[SAVESTATE_TAG_LEN];
+    char     cpu_family[SAVESTATE_TAG_LEN];
+} savestate_header_t;
+
+#ifdef ENABLE_SAVESTATE_LOG
+int savestate_do_log = ENABLE_SAVESTATE_LOG;
+
+static void
+savestate_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (savestate_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define savestate_log(fmt, ...)
+#endif
+
+static void
+savestate_fill_header(savestate_header_t *hdr)
+{
+    memset(hdr, 0x00, sizeof(savestate_header_t));
+
+    memcpy(hdr->magic, SAVESTATE_MAGIC, sizeof(hdr->magic));
+    hdr->version   = SAVESTATE_VERSION;
+    hdr->mem_size  = mem_size;
+    hdr->cpu_speed = cpu_s->rspeed;
+    strncpy(hdr->machine, machine_get_internal_name(), SAVESTATE_TAG_LEN - 1);
+    strncpy(hdr->cpu_family, cpu_f->internal_name, SAVESTATE_TAG_LEN - 1);
+}
+
+int
+savestate_open(savestate_t *st, const char *fn, int loading)
+{
+    savestate_header_t hdr;
+    savestate_header_t cur;
+
+    memset(st, 0x00, sizeof(savestate_t));
+    st->loading = loading;
+
+    st->fp = plat_fopen64(fn, loading ? "rb" : "wb");
+    if (st->fp == NULL) {
+        pclog("SaveState: unable to open %s\n", fn);
+        return 0;
+    }
+
+    savestate_fill_header(&cur);
+
+    if (!loading) {
+        if (fwrite(&cur, 1, sizeof(cur), st->fp) != sizeof(cur))
+            st->error = 1;
+        return !st->error;
+    }
+
+    if (fread(&hdr, 1, sizeof(hdr), st->fp) != sizeof(hdr))
+        st->error = 1;
+    else if (memcmp(hdr.magic, cur.magic, sizeof(hdr.magic))) {
+        pclog("SaveState: %s is not a save state\n", fn);
+        st->error = 1;
+    } else if (hdr.version > SAVESTATE_VERSION) {
+        pclog("SaveState: %s is version %i, this build supports up to %i\n",
+              fn, hdr.version, SAVESTATE_VERSION);
+        st->error = 1;
+    } else if (strncmp(hdr.machine, cur.machine, SAVESTATE_TAG_LEN) ||
+               strncmp(hdr.cpu_family, cur.cpu_family, SAVESTATE_TAG_LEN) ||
+               (hdr.cpu_speed != cur.cpu_speed) || (hdr.mem_size != cur.mem_size)) {
+        pclog("SaveState: %s was made on a different configuration (%s, %s @ %u, %u KB)\n",
+              fn, hdr.machine, hdr.cpu_family, hdr.cpu_speed, hdr.mem_size);
+        st->error = 1;
+    }
+
+    if (st->error) {
+        fclose(st->fp);
+        st->fp = NULL;
+    }
+
+    return !st->error;
+}
+
+int
+savestate_close(savestate_t *st)
+{
+    int ret = !st->error;
+
+    if (st->fp != NULL) {
+        if (fclose(st->fp))
+            ret = 0;
+        st->fp = NULL;
+    }
+
+    return ret;
+}
+
+/* Start writing a section. The length is patched in by savestate_end(). */
+void
+savestate_begin(savestate_t *st, const char *tag, uint32_t version)
+{
+    char     name[SAVESTATE_TAG_LEN] = { 0 };
+    uint64_t len                     = 0ULL;
+
+    if (st->error || st->loading)
+        return;
+
+    strncpy(name, tag, SAVESTATE_TAG_LEN - 1);
+
+    st->version = version;
+
+    if ((fwrite(name, 1, sizeof(name), st->fp) != sizeof(name)) ||
+        (fwrite(&version, 1, sizeof(version), st->fp) != sizeof(version)) ||
+        (fwrite(&len, 1, sizeof(len), st->fp) != sizeof(len))) {
+        st->error = 1;
+        return;
+    }
+
+    st->sect_start = ftello64(st->fp);
+}
+
+void
+savestate_end(savestate_t *st)
+{
+    int64_t  pos;
+    uint64_t len;
+
+    if (st->error)
+        return;
+
+    if (st->loading) {
+        /* Tolerate sections written by a newer minor revision of a module
+           that has more data than we consumed. */
+        if (fseeko64(st->fp, st->sect_start + (int64_t) st->sect_len, SEEK_SET))
+            st->error = 1;
+        return;
+    }
+
+    pos = ftello64(st->fp);
+    len = (uint64_t) (pos - st->sect_start);
+
+    if (fseeko64(st->fp, st->sect_start - (int64_t) sizeof(len), SEEK_SET) ||
+        (fwrite(&len, 1, sizeof(len), st->fp) != sizeof(len)) ||
+        fseeko64(st->fp, pos, SEEK_SET))
+        st->error = 1;
+}
+
+/* Read the next section header, returns 0 at the end of the file. */
+int
+savestate_next(savestate_t *st, char *tag)
+{
+    if (st->error || !st->loading)
+        return 0;
+
+    if (fread(tag, 1, SAVESTATE_TAG_LEN, st->fp) != SAVESTATE_TAG_LEN)
+        return 0;
+
+    tag[SAVESTATE_TAG_LEN - 1] = '\0';
+
+    if ((fread(&st->version, 1, sizeof(st->version), st->fp) != sizeof(st->version)) ||
+        (fread(&st->sect_len, 1, sizeof(st->sect_len), st->fp) != sizeof(st->sect_len))) {
+        st->error = 1;
+        return 0;
+    }
+
+    st->sect_start = ftello64(st->fp);
+
+    savestate_log("SaveState: section \"%s\", version %i, %" PRIu64 " bytes\n",
+                  tag, st->version, st->sect_len);
+
+    return 1;
+}
+
+void
+savestate_skip(savestate_t *st)
+{
+    savestate_end(st);
+}
+
+void
+savestate_data(savestate_t *st, void *data, size_t len)
+{
+    if (st->error || (len == 0))
+        return;
+
+    if (st->loading) {
+        if (((uint64_t) (ftello64(st->fp) - st->sect_start) + len) > st->sect_len) {
+            /* Section is shorter than expected, keep the reset value. */
+            return;
+        }
+        if (fread(data, 1, len, st->fp) != len)
+            st->error = 1;
+    } else if (fwrite(data, 1, len, st->fp) != len)
+        st->error = 1;
+}
+
+/*
+ * Timers are owned by the devices that embed them, so they cannot be
+ * saved as a queue. Instead, every owner syncs its own timers, which
+ * are stored relative to the TSC and re-inserted into the queue on
+ * load. The TSC itself is restored by timer_savestate() before any
+ * device section is processed.
+ */
+void
+savestate_timer(savestate_t *st, pc_timer_t *timer)
+{
+    int     enabled = 0;
+    int     flags   = 0;
+    int64_t rel     = 0;
+    double  period  = 0.0;
+
+    if (!st->loading) {
+        enabled = timer_is_enabled(timer);
+        flags   = timer->flags & TIMER_SPLIT;
+        period  = timer->period;
+        if (enabled)
+            rel = (int64_t) (timer->ts.ts64 - (tsc << 32));
+    }
+
+    savestate_var(st, enabled);
+    savestate_var(st, flags);
+    savestate_var(st, period);
+    savestate_var(st, rel);
+
+    if (st->loading && !st->error) {
+        timer_disable(timer);
+        timer->period = period;
+        timer->flags  = (timer->flags & ~TIMER_SPLIT) | flags;
+        if (enabled) {
+            timer->ts.ts64 = (tsc << 32) + (uint64_t) rel;
+            timer_enable(timer);
+        }
+    }
+}
@@ -66,6 +66,7 @@ const uint8_t scsi_disk_command_flags[0x100] = {
     [0x2a ... 0x2b] = IMPLEMENTED | CHECK_READY,
     [0x2e]          = IMPLEMENTED | CHECK_READY,
     [0x2f]          = IMPLEMENTED | CHECK_READY | SCSI_ONLY,
+    [0x35]          = IMPLEMENTED | CHECK_READY,
     [0x41]          = IMPLEMENTED | CHECK_READY,
     [0x55]          = IMPLEMENTED,
     [0x5a]          = IMPLEMENTED,
@@ -783,22 +784,19 @@ scsi_disk_blocks(scsi_disk_t *dev, int32_t *len, UNUSED(int first_batch), const
 
     *len = dev->requested_blocks << 9;
 
-    for (int i = 0; i < dev->requested_blocks; i++) {
-        if (out) {
-            if (hdd_image_write(dev->id, dev->sector_pos, 1, dev->temp_buffer +
-                                (i << 9)) < 0) {
-                scsi_disk_write_error(dev);
-                return -1;
-            }
-        } else {
-            if (hdd_image_read(dev->id, dev->sector_pos, 1, dev->temp_buffer +
-                               (i << 9)) < 0) {
-                scsi_disk_read_error(dev);
-                return -1;
-            }
+    /* The whole batch in one image request, the timing is done per block elsewhere. */
+    if (out) {
+        if (hdd_image_write_async(dev->id, dev->sector_pos, dev->requested_blocks, dev->temp_buffer) < 0) {
+            scsi_disk_write_error(dev);
+            return -1;
+        }
+    } else {
+        if (hdd_image_read(dev->id, dev->sector_pos, dev->requested_blocks, dev->temp_buffer) < 0) {
+            scsi_disk_read_error(dev);
+            return -1;
         }
-        dev->sector_pos++;
     }
+    dev->sector_pos += dev->requested_blocks;
 
     scsi_disk_log(dev->log, "%s %i bytes of blocks...\n", out ? "Written" : "Read", *len);
 
@@ -1018,6 +1016,15 @@ scsi_disk_command(scsi_common_t *sc, const uint8_t *cdb)
             scsi_disk_command_complete(dev);
             break;
 
+        case GPCMD_SYNCHRONIZE_CACHE:
+            if (hdd_image_flush(dev->id) < 0) {
+                scsi_disk_write_error(dev);
+                break;
+            }
+            scsi_disk_set_phase(dev, SCSI_PHASE_STATUS);
+            scsi_disk_command_complete(dev);
+            break;
+
         case GPCMD_REZERO_UNIT:
             dev->sector_pos = dev->sector_len = 0;
 
@@ -1580,7 +1587,7 @@ scsi_disk_phase_data_out(scsi_common_t *sc)
                     dev->temp_buffer[6] = (s >> 8) & 0xff;
                     dev->temp_buffer[7] = s & 0xff;
                 }
-                if (hdd_image_write(dev->id, i, 1, dev->temp_buffer) < 0)
+                if (hdd_image_write_async(dev->id, i, 1, dev->temp_buffer) < 0)
                     scsi_disk_write_error(dev);
             }
             break;
@@ -1,24 +1,164 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #include <86box/86box.h>
 #include "cpu.h"
 #include <86box/timer.h>
+#include <86box/savestate.h>
+#include <86box/bench.h>
 #include <86box/nv/vid_nv_rivatimer.h>
 
 uint64_t TIMER_USEC;
 uint32_t timer_target;
 
+#ifdef USE_TIMER_HEAP
+/*Enabled timers are stored in a binary min-heap ordered by expiry, with the
+  first timer to expire at timer_heap[0]. Enabling and disabling a timer is
+  O(log n) rather than a scan of the list, which matters on machines that
+  re-arm many timers per emulated millisecond.*/
+static pc_timer_t **timer_heap       = NULL;
+static int          timer_heap_size  = 0;
+static int          timer_heap_alloc = 0;
+static uint32_t     timer_heap_seq   = 0;
+
+#    define timer_first() (timer_heap_size ? timer_heap[0] : NULL)
+#else
 /*Enabled timers are stored in a linked list, with the first timer to expire at
   the head.*/
 pc_timer_t *timer_head = NULL;
 
+#    define timer_first() timer_head
+#endif
+
 /* Are we initialized? */
 int timer_inited = 0;
 
 static void timer_advance_ex(pc_timer_t *timer, int start);
 
+#ifdef USE_TIMER_HEAP
+/*True if timer a should be processed before timer b. The list inserts a newly
+  enabled timer in front of those with the same timestamp, so the most recently
+  enabled timer wins a tie here as well.*/
+static __inline int
+timer_heap_before(const pc_timer_t *a, const pc_timer_t *b)
+{
+    int64_t diff = (int64_t) (a->ts.ts64 - b->ts.ts64);
+
+    if (diff != 0)
+        return diff < 0;
+
+    return (int32_t) (a->heap_seq - b->heap_seq) > 0;
+}
+
+static __inline void
+timer_heap_set(int pos, pc_timer_t *timer)
+{
+    timer_heap[pos] = timer;
+    timer->heap_pos = pos + 1;
+}
+
+static void
+timer_heap_up(int pos)
+{
+    pc_timer_t *timer = timer_heap[pos];
+    int         parent;
+
+    while (pos > 0) {
+        parent = (pos - 1) >> 1;
+        if (!timer_heap_before(timer, timer_heap[parent]))
+            break;
+        timer_heap_set(pos, timer_heap[parent]);
+        pos = parent;
+    }
+
+    timer_heap_set(pos, timer);
+}
+
+static void
+timer_heap_down(int pos)
+{
+    pc_timer_t *timer = timer_heap[pos];
+    int         child;
+
+    while ((child = (pos << 1) + 1) < timer_heap_size) {
+        if (((child + 1) < timer_heap_size) && timer_heap_before(timer_heap[child + 1], timer_heap[child]))
+            child++;
+        if (!timer_heap_before(timer_heap[child], timer))
+            break;
+        timer_heap_set(pos, timer_heap[child]);
+        pos = child;
+    }
+
+    timer_heap_set(pos, timer);
+}
+
+static void
+timer_heap_remove(pc_timer_t *timer)
+{
+    int         pos  = timer->heap_pos - 1;
+    pc_timer_t *last = timer_heap[--timer_heap_size];
+
+    timer->heap_pos = 0;
+
+    if (last == timer)
+        return;
+
+    timer_heap_set(pos, last);
+    if ((pos > 0) && timer_heap_before(last, timer_heap[(pos - 1) >> 1]))
+        timer_heap_up(pos);
+    else
+        timer_heap_down(pos);
+}
+
+void
+timer_enable(pc_timer_t *timer)
+{
+    if (!timer_inited || (timer == NULL))
+        return;
+
+    if (timer->flags & TIMER_ENABLED)
+        timer_disable(timer);
+
+    if (timer->heap_pos)
+        fatal("timer_enable(): Attempting to enable a queued "
+              "timer incorrectly marked as disabled\n");
+
+    if (timer_heap_size == timer_heap_alloc) {
+        timer_heap_alloc = timer_heap_alloc ? (timer_heap_alloc << 1) : 64;
+        timer_heap       = (pc_timer_t **) realloc(timer_heap, timer_heap_alloc * sizeof(pc_timer_t *));
+        if (timer_heap == NULL)
+            fatal("timer_enable(): Out of memory\n");
+    }
+
+    timer->heap_seq = timer_heap_seq++;
+    timer_heap_set(timer_heap_size++, timer);
+    timer_heap_up(timer_heap_size - 1);
+
+    /* Like the list, only move the target when the timer is the new head. */
+    if (timer_heap[0] == timer)
+        timer_target = timer->ts.ts32.integer;
+
+    timer->flags |= TIMER_ENABLED;
+}
+
+void
+timer_disable(pc_timer_t *timer)
+{
+    if (!timer_inited || (timer == NULL) || !(timer->flags & TIMER_ENABLED))
+        return;
+
+    if (!timer->heap_pos)
+        fatal("timer_disable(): Attempting to disable a non-queued "
+              "timer incorrectly marked as enabled\n");
+
+    timer->flags &= ~TIMER_ENABLED;
+    timer->in_callback = 0;
+
+    timer_heap_remove(timer);
+}
+#else
 void
 timer_enable(pc_timer_t *timer)
 {
@@ -108,26 +248,35 @@ timer_disable(pc_timer_t *timer)
         timer->next->prev = timer->prev;
     timer->prev = timer->next = NULL;
 }
+#endif
 
 void
 timer_process(void)
 {
     pc_timer_t *timer;
+    uint64_t    start = 0;
 
-    if (!timer_head)
+    if (!timer_first())
         return;
 
+    if (bench_active)
+        start = bench_time_us();
+
     while (1) {
-        timer = timer_head;
+        timer = timer_first();
 
         if (!TIMER_LESS_THAN_VAL(timer, (uint32_t) tsc))
             break;
 
+#ifdef USE_TIMER_HEAP
+        timer_heap_remove(timer);
+#else
         timer_head = timer->next;
         if (timer_head)
             timer_head->prev = NULL;
 
         timer->next = timer->prev = NULL;
+#endif
         timer->flags &= ~TIMER_ENABLED;
 
         if (timer->flags & TIMER_SPLIT)
@@ -143,12 +292,23 @@ timer_process(void)
         }
     }
 
-    timer_target = timer_head->ts.ts32.integer;
+    timer_target = timer_first()->ts.ts32.integer;
+
+    if (bench_active)
+        bench_timer_us += bench_time_us() - start;
 }
 
 void
 timer_close(void)
 {
+#ifdef USE_TIMER_HEAP
+    /* Mark the queued timers as no longer queued, the heap itself is kept
+       for the next session. */
+    for (int i = 0; i < timer_heap_size; i++)
+        timer_heap[i]->heap_pos = 0;
+
+    timer_heap_size = 0;
+#else
     pc_timer_t *t = timer_head;
     pc_timer_t *r;
 
@@ -162,6 +322,7 @@ timer_close(void)
     }
 
     timer_head = NULL;
+#endif
 
     timer_inited = 0;
 }
@@ -271,13 +432,23 @@ timer_set_new_tsc(uint64_t new_tsc)
         update_tsc();
 #endif
 
-    if (!timer_head) {
+    if (!timer_first()) {
         tsc = new_tsc;
         return;
     }
 
+    timer_target = new_tsc + (int32_t)(timer_get_ts_int(timer_first()) - (uint32_t)tsc);
+
+#ifdef USE_TIMER_HEAP
+    /* Every timer moves by the same amount, so the heap order holds. */
+    for (int i = 0; i < timer_heap_size; i++) {
+        timer = timer_heap[i];
+
+        int32_t offset_from_current_tsc = (int32_t)(timer_get_ts_int(timer) - (uint32_t)tsc);
+        timer->ts.ts32.integer = new_tsc + offset_from_current_tsc;
+    }
+#else
     timer = timer_head;
-    timer_target = new_tsc + (int32_t)(timer_get_ts_int(timer_head) - (uint32_t)tsc);
 
     while (timer) {
         int32_t offset_from_current_tsc = (int32_t)(timer_get_ts_int(timer) - (uint32_t)tsc);
@@ -285,6 +456,21 @@ timer_set_new_tsc(uint64_t new_tsc)
 
         timer = timer->next;
     }
+#endif
 
     tsc = new_tsc;
 }
+
+/* Only the TSC is saved here, the timers themselves are saved by their
+   owners through savestate_timer(). Timers nobody restores keep their
+   distance from the TSC. */
+void
+timer_savestate(savestate_t *st)
+{
+    uint64_t new_tsc = tsc;
+
+    savestate_var(st, new_tsc);
+
+    if (st->loading && !st->error)
+        timer_set_new_tsc(new_tsc);
+}
@@ -48,6 +48,7 @@
 #include <86box/video.h>
 #include <86box/ui.h>
 #include <86box/gdbstub.h>
+#include <86box/bench.h>
 
 #define __USE_GNU 1 /* shouldn't be done, yet it is */
 #include <pthread.h>
@@ -185,9 +186,11 @@ typedef struct sdl_blit_params {
     int y;
     int w;
     int h;
+    int dmg_y;
+    int dmg_h;
 } sdl_blit_params;
 
-sdl_blit_params params  = { 0, 0, 0, 0 };
+sdl_blit_params params  = { 0, 0, 0, 0, 0, 0 };
 int             blitreq = 0;
 
 void *
@@ -480,6 +483,12 @@ plat_remove(char *path)
     remove(path);
 }
 
+int
+plat_rename(const char *from, const char *to)
+{
+    return rename(from, to);
+}
+
 void
 ui_sb_update_icon_state(UNUSED(int tag), UNUSED(int state))
 {
@@ -574,6 +583,9 @@ main_thread(UNUSED(void *param))
     // title_update = 1;
     old_time = SDL_GetTicks();
     drawits = frames = 0;
+    is_cpu_thread = 1;
+    if (bench_seconds > 0)
+        bench_run();
     while (!is_quit && cpu_thread_run) {
         /* See if it is time to run a frame of code. */
         new_time = SDL_GetTicks();
@@ -1242,8 +1254,8 @@ main(int argc, char **argv)
 
     SDL_Init(0);
     ret = pc_init(argc, argv);
-    if (ret == 0)
-        return 0;
+    if (ret <= 0)
+        return (ret < 0) ? 1 : 0;
     if (!pc_init_roms()) {
         ui_msgbox_header(MBX_FATAL, L"No ROMs found.", L"86Box could not find any usable ROM images.\n\nPlease download a ROM set and extract it into the \"roms\" directory.");
         SDL_Quit();
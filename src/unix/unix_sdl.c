@@ -27,6 +27,8 @@ typedef struct sdl_blit_params {
     int y;
     int w;
     int h;
+    int dmg_y;
+    int dmg_h;
 } sdl_blit_params;
 extern sdl_blit_params params;
 extern int             blitreq;
@@ -52,6 +54,8 @@ int                 resize_pending    = 0;
 int                 resize_w          = 0;
 int                 resize_h          = 0;
 static void        *pixeldata;
+static int          pixeldata_full = 1;
+static int          tex_full       = 1;
 
 extern void RenderImGui(void);
 static void
@@ -146,15 +150,42 @@ sdl_stretch(int *w, int *h, int *x, int *y)
 void
 sdl_blit_shim(int x, int y, int w, int h, int monitor_index)
 {
+    int dy;
+    int dh;
+
     params.x = x;
     params.y = y;
     params.w = w;
     params.h = h;
 
-    if (!(!sdl_enabled || (x < 0) || (y < 0) || (w <= 0) || (h <= 0) || (w > 2048) || (h > 2048) || (buffer32 == NULL) || (sdl_render == NULL) || (sdl_tex == NULL)) || (monitor_index >= 1))
-        for (int row = 0; row < h; ++row)
+    if (!(!sdl_enabled || (x < 0) || (y < 0) || (w <= 0) || (h <= 0) || (w > 2048) || (h > 2048) || (buffer32 == NULL) || (sdl_render == NULL) || (sdl_tex == NULL)) || (monitor_index >= 1)) {
+        video_get_damage_monitor(&dy, &dh, monitor_index);
+        if (pixeldata_full) {
+            dy             = y;
+            dh             = h;
+            pixeldata_full = 0;
+        }
+
+        for (int row = dy - y; row < (dy - y + dh); ++row)
             video_copy(&(((uint8_t *) pixeldata)[row * 2048 * sizeof(uint32_t)]), &(buffer32->line[y + row][x]), w * sizeof(uint32_t));
 
+        /* The event thread may not have picked the previous frame up yet. */
+        if (blitreq && (params.dmg_h > 0) && (dh > 0)) {
+            dh = MAX(dy + dh, params.dmg_y + params.dmg_h);
+            dy = MIN(dy, params.dmg_y);
+            dh -= dy;
+        } else if (blitreq && (dh == 0)) {
+            dy = params.dmg_y;
+            dh = params.dmg_h;
+        }
+        params.dmg_y = dy;
+        params.dmg_h = dh;
+    } else {
+        pixeldata_full = 1;
+        params.dmg_y   = y;
+        params.dmg_h   = h;
+    }
+
     if (monitors[monitor_index].mon_screenshots)
         video_screenshot((uint32_t *) pixeldata, 0, 0, 2048);
     blitreq = 1;
@@ -196,6 +227,7 @@ void
 sdl_blit(int x, int y, int w, int h)
 {
     SDL_Rect r_src;
+    SDL_Rect r_upd;
 
     if (!sdl_enabled || (x < 0) || (y < 0) || (w <= 0) || (h <= 0) || (w > 2048) || (h > 2048) || (buffer32 == NULL) || (sdl_render == NULL) || (sdl_tex == NULL)) {
         r_src.x = x;
@@ -218,7 +250,19 @@ sdl_blit(int x, int y, int w, int h)
     r_src.y = y;
     r_src.w = w;
     r_src.h = h;
-    SDL_UpdateTexture(sdl_tex, &r_src, pixeldata, 2048 * 4);
+
+    /* Upload only the rows the emulator changed. */
+    if (tex_full) {
+        r_upd    = r_src;
+        tex_full = 0;
+    } else {
+        r_upd.x = x;
+        r_upd.y = MAX(params.dmg_y, y);
+        r_upd.w = w;
+        r_upd.h = MIN(params.dmg_y + params.dmg_h, y + h) - r_upd.y;
+    }
+    if (r_upd.h > 0)
+        SDL_UpdateTexture(sdl_tex, &r_upd, &(((uint8_t *) pixeldata)[(r_upd.y - y) * 2048 * 4]), 2048 * 4);
     blitreq = 0;
 
     sdl_real_blit(&r_src);
@@ -324,6 +368,7 @@ sdl_reinit_texture(void)
 
     sdl_tex = SDL_CreateTexture(sdl_render, SDL_PIXELFORMAT_ARGB8888,
                                 SDL_TEXTUREACCESS_STREAMING, 2048, 2048);
+    tex_full = 1;
 }
 
 void
@@ -1281,9 +1281,51 @@ svga_recalctimings(svga_t *svga)
     }
 }
 
+/* Cursors and overlays are drawn over lines the renderer may have skipped. */
+static void
+svga_damage_line(svga_t *svga, int line)
+{
+    if ((svga->firstline_draw == 2000) || (line < svga->firstline_draw))
+        svga->firstline_draw = line;
+    if (line > svga->lastline_draw)
+        svga->lastline_draw = line;
+}
+
+/*
+ * Report the rows of the target buffer this frame has changed, from the
+ * lines the renderers drew. Anything that repaints the overscan or moves
+ * the picture makes the whole frame dirty.
+ */
+static void
+svga_report_damage(svga_t *svga)
+{
+    int y_add = svga->vertical_linedbl ? (svga->y_add << 1) : svga->y_add;
+
+    /* Renderers that hand the line over to the parent do not track it. */
+    if (svga->render_override)
+        return;
+
+    if (!svga->damage_valid || (svga->damage_y_add != y_add) || (svga->damage_dpms != svga->dpms) ||
+        (svga->damage_overscan_color != svga->overscan_color)) {
+        svga->damage_valid          = 1;
+        svga->damage_y_add          = y_add;
+        svga->damage_dpms           = svga->dpms;
+        svga->damage_overscan_color = svga->overscan_color;
+        return;
+    }
+
+    if (svga->firstline_draw == 2000)
+        video_set_damage_monitor(0, 0, svga->monitor_index);
+    else
+        video_set_damage_monitor(svga->firstline_draw + y_add,
+                                 svga->lastline_draw - svga->firstline_draw + 1, svga->monitor_index);
+}
+
 static void
 svga_do_render(svga_t *svga)
 {
+    int queued = 0;
+
     /* Always render a blank screen and nothing else while in DPMS mode. */
     if (svga->dpms) {
         svga_render_blank(svga);
@@ -1292,28 +1334,36 @@ svga_do_render(svga_t *svga)
 
     if (!svga->override) {
         svga->render_line_offset = svga->start_retrace_latch - svga->crtc[0x4];
-        svga->render(svga);
+        queued                   = svga_render_mt_queue(svga);
+        if (!queued)
+            svga->render(svga);
     }
 
     if (svga->overlay_on) {
-        if (!svga->override && svga->overlay_draw)
+        if (!svga->override && svga->overlay_draw) {
             svga->overlay_draw(svga, svga->displine + svga->y_add);
+            svga_damage_line(svga, svga->displine);
+        }
         svga->overlay_on--;
         if (svga->overlay_on && svga->interlace)
             svga->overlay_on--;
     }
 
     if (svga->dac_hwcursor_on) {
-        if (!svga->override && svga->dac_hwcursor_draw)
+        if (!svga->override && svga->dac_hwcursor_draw) {
             svga->dac_hwcursor_draw(svga, (svga->displine + svga->y_add + ((svga->dac_hwcursor_latch.y >= 0) ? 0 : svga->dac_hwcursor_latch.y)) & 2047);
+            svga_damage_line(svga, svga->displine + ((svga->dac_hwcursor_latch.y >= 0) ? 0 : svga->dac_hwcursor_latch.y));
+        }
         svga->dac_hwcursor_on--;
         if (svga->dac_hwcursor_on && svga->interlace)
             svga->dac_hwcursor_on--;
     }
 
     if (svga->hwcursor_on) {
-        if (!svga->override && svga->hwcursor_draw)
+        if (!svga->override && svga->hwcursor_draw) {
             svga->hwcursor_draw(svga, (svga->displine + svga->y_add + ((svga->hwcursor_latch.y >= 0) ? 0 : svga->hwcursor_latch.y)) & 2047);
+            svga_damage_line(svga, svga->displine + ((svga->hwcursor_latch.y >= 0) ? 0 : svga->hwcursor_latch.y));
+        }
 
         svga->hwcursor_on--;
         if (svga->hwcursor_on && svga->interlace)
@@ -1322,8 +1372,11 @@ svga_do_render(svga_t *svga)
 
     if (!svga->override) {
         svga->x_add = svga->left_overscan;
-        svga_render_overscan_left(svga);
-        svga_render_overscan_right(svga);
+        /* A queued line gets its overscan painted by the render thread. */
+        if (!queued) {
+            svga_render_overscan_left(svga);
+            svga_render_overscan_right(svga);
+        }
         svga->x_add = svga->left_overscan - svga->scrollcache;
     }
 }
@@ -1416,8 +1469,10 @@ svga_poll(void *priv)
         if ((svga->cgastat & 8) && ((svga->displine & 15) == (svga->crtc[0x11] & 15)) && svga->vslines)
             svga->cgastat &= ~8;
         svga->vslines++;
-        if (svga->displine > 2000)
+        if (svga->displine > 2000) {
             svga->displine = 0;
+            svga_render_mt_fence();
+        }
     } else {
         timer_advance_u64(&svga->timer, svga->dispontime);
 
@@ -1522,6 +1577,8 @@ svga_poll(void *priv)
             wx = x;
 
             if (!svga->override) {
+                if ((wx > 0) && (svga->lastline > svga->firstline))
+                    svga_report_damage(svga);
                 if (svga->vertical_linedbl) {
                     wy = (svga->lastline - svga->firstline) << 1;
                     svga->vdisp = wy + 1;
@@ -1732,6 +1789,8 @@ svga_init(const device_t *info, svga_t *svga, void *priv, int memsize,
 void
 svga_close(svga_t *svga)
 {
+    svga_render_mt_close();
+
     free(svga->changedvram);
     free(svga->vram);
 
@@ -2119,6 +2178,9 @@ svga_doblit(int wx, int wy, svga_t *svga)
         bottom <<= 1;
     }
 
+    /* Let the render threads finish the frame before it is resized or blitted. */
+    svga_render_mt_fence();
+
     if ((wx <= 0) || (wy <= 0))
         return;
 
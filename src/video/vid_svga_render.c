@@ -42,6 +42,14 @@ svga_lookup_lut_ram(svga_t* svga, uint32_t val)
 
 #define lookup_lut(val) svga_lookup_lut_ram(svga, val)
 
+/* Whether len bytes starting at addr can be handed to the svga_conv_*
+   kernels, that is they do not wrap around the end of the VRAM. */
+static inline int
+svga_vram_linear(svga_t *svga, uint32_t addr, uint32_t len)
+{
+    return (addr + len + SVGA_CONV_SLACK) <= (MIN(svga->vram_display_mask, svga->vram_mask) + 1);
+}
+
 void
 svga_render_null(svga_t *svga)
 {
@@ -807,6 +815,23 @@ svga_render_indexed_gfx(svga_t *svga, bool highres, bool combine8bits)
     uint32_t edat         = 0;
     static uint32_t col          = 0;
     static uint32_t col2         = 0;
+
+    /* Plain packed 8bpp, every byte is one pixel. */
+    if (highres8bpp && combine8bits && highres && !svga->ati_4color && !svga->packed_4bpp && !svga->half_pixel &&
+        !svga->force_old_addr && !svga->remap_required && !svga->render_line_offset && !attrblink &&
+        (planemask == 0xffffffff) && (incbypow2 == 0) && (incevery == 1) && (loadevery == 1) &&
+        ((svga->hdisp + svga->scrollcache) >= 0)) {
+        const int count = (((svga->hdisp + svga->scrollcache) >> 2) + 1) << 2;
+
+        addr = svga->memaddr & svga->vram_display_mask;
+        if (svga_vram_linear(svga, addr, count)) {
+            svga_conv_8bpp(p, &svga->vram[addr], count, svga->map8, svga->dac_mask);
+            svga->memaddr = (addr + count) & svga->vram_display_mask;
+            col           = p[count - 1];
+            return;
+        }
+    }
+
     for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += charwidth) {
         if (load_counter == 0) {
             /* Find our address */
@@ -1611,22 +1636,27 @@ svga_render_15bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+                x = (((svga->hdisp + svga->scrollcache) >> 3) + 1) << 3;
+                if ((x > 0) && (svga->conv_16to32 == svga_conv_16to32) && svga_vram_linear(svga, svga->memaddr, x << 1)) {
+                    svga_conv_15bpp(p, &svga->vram[svga->memaddr], x);
+                } else {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+                    }
                 }
                 svga->memaddr += x << 1;
             } else {
@@ -1843,22 +1873,27 @@ svga_render_16bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+                x = (((svga->hdisp + svga->scrollcache) >> 3) + 1) << 3;
+                if ((x > 0) && (svga->conv_16to32 == svga_conv_16to32) && svga_vram_linear(svga, svga->memaddr, x << 1)) {
+                    svga_conv_16bpp(p, &svga->vram[svga->memaddr], x);
+                } else {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+                    }
                 }
                 svga->memaddr += x << 1;
             } else {
@@ -2004,17 +2039,23 @@ svga_render_24bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
-                    dat0 = *(uint32_t *) (&svga->vram[svga->memaddr & svga->vram_display_mask]);
-                    dat1 = *(uint32_t *) (&svga->vram[(svga->memaddr + 4) & svga->vram_display_mask]);
-                    dat2 = *(uint32_t *) (&svga->vram[(svga->memaddr + 8) & svga->vram_display_mask]);
+                x = (((svga->hdisp + svga->scrollcache) >> 2) + 1) << 2;
+                if ((x > 0) && !svga->lut_map && svga_vram_linear(svga, svga->memaddr, x * 3)) {
+                    svga_conv_24bpp(p, &svga->vram[svga->memaddr], x);
+                    svga->memaddr += x * 3;
+                } else {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
+                        dat0 = *(uint32_t *) (&svga->vram[svga->memaddr & svga->vram_display_mask]);
+                        dat1 = *(uint32_t *) (&svga->vram[(svga->memaddr + 4) & svga->vram_display_mask]);
+                        dat2 = *(uint32_t *) (&svga->vram[(svga->memaddr + 8) & svga->vram_display_mask]);
 
-                    *p++ = lookup_lut(dat0 & 0xffffff);
-                    *p++ = lookup_lut((dat0 >> 24) | ((dat1 & 0xffff) << 8));
-                    *p++ = lookup_lut((dat1 >> 16) | ((dat2 & 0xff) << 16));
-                    *p++ = lookup_lut(dat2 >> 8);
+                        *p++ = lookup_lut(dat0 & 0xffffff);
+                        *p++ = lookup_lut((dat0 >> 24) | ((dat1 & 0xffff) << 8));
+                        *p++ = lookup_lut((dat1 >> 16) | ((dat2 & 0xff) << 16));
+                        *p++ = lookup_lut(dat2 >> 8);
 
-                    svga->memaddr += 12;
+                        svga->memaddr += 12;
+                    }
                 }
             } else {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
@@ -2132,9 +2173,14 @@ svga_render_32bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x++) {
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 2)) & svga->vram_display_mask]);
-                    *p++ = lookup_lut(dat & 0xffffff);
+                x = svga->hdisp + svga->scrollcache + 1;
+                if ((x > 0) && !svga->lut_map && svga_vram_linear(svga, svga->memaddr, x << 2)) {
+                    svga_conv_32bpp(p, &svga->vram[svga->memaddr], x);
+                } else {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x++) {
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 2)) & svga->vram_display_mask]);
+                        *p++ = lookup_lut(dat & 0xffffff);
+                    }
                 }
                 svga->memaddr += (x * 4);
             } else {
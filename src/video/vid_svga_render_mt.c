@@ -0,0 +1,462 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Threaded SVGA scanline rendering.
+ *
+ *          The CPU thread still decides which scanlines need redrawing
+ *          and advances the CRTC address exactly as the synchronous
+ *          renderers do, but the VRAM to target buffer conversion of
+ *          the plain high color and true color modes is handed to a
+ *          small pool of worker threads. All outstanding lines are
+ *          waited for before the frame is blitted.
+ *
+ *          Lines are converted a little later than the emulated beam
+ *          passed them, but always within the same frame. Lines that
+ *          carry a hardware cursor or overlay, and modes that need
+ *          per-card address remapping or color conversion, are still
+ *          rendered synchronously.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/timer.h>
+#include <86box/thread.h>
+#include <86box/video.h>
+#include <86box/vid_svga.h>
+#include <86box/vid_svga_render.h>
+#include <86box/plat_unused.h>
+
+#define SVGA_MT_MAX_THREADS 8
+#define SVGA_MT_BATCH_LINES 32
+#define SVGA_MT_RING        16
+
+enum {
+    SVGA_MT_15BPP = 0,
+    SVGA_MT_16BPP,
+    SVGA_MT_24BPP,
+    SVGA_MT_32BPP
+};
+
+enum {
+    SVGA_MT_FREE = 0,
+    SVGA_MT_FILLING,
+    SVGA_MT_QUEUED
+};
+
+typedef struct svga_mt_line_t {
+    uint32_t *line;     /* start of the target buffer line */
+    uint32_t *p;        /* first pixel written by the renderer */
+    uint32_t  memaddr;
+    int       left;     /* pixels of left overscan */
+    int       right_x;  /* first pixel of right overscan */
+    int       right;    /* pixels of right overscan */
+    uint32_t  overscan_color;
+} svga_mt_line_t;
+
+typedef struct svga_mt_batch_t {
+    int             state;
+    int             mode;
+    svga_t         *svga;
+    const uint8_t  *vram;
+    uint32_t        mask;
+    uint32_t        limit;  /* end of the VRAM the svga_conv_* kernels may read */
+    int             width;  /* hdisp + scrollcache */
+    const uint32_t *conv;   /* video_15to32 or video_16to32 */
+    int             lines;
+    svga_mt_line_t  line[SVGA_MT_BATCH_LINES];
+} svga_mt_batch_t;
+
+static struct {
+    int             threads;
+    volatile int    quit;
+    thread_t       *thread[SVGA_MT_MAX_THREADS];
+    mutex_t        *mutex;
+    event_t        *wake;
+    event_t        *done;
+    svga_mt_batch_t batch[SVGA_MT_RING];
+    svga_mt_batch_t *cur;  /* batch being filled by the CPU thread */
+    uint32_t        submitted;
+    uint32_t        taken;
+    uint32_t        completed;
+} svga_mt;
+
+static int svga_mt_failed = 0;
+
+#ifdef ENABLE_SVGA_MT_LOG
+int svga_mt_do_log = ENABLE_SVGA_MT_LOG;
+
+static void
+svga_mt_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (svga_mt_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define svga_mt_log(fmt, ...)
+#endif
+
+/* Convert one line, the loops mirror the !remap_required paths of the
+   svga_render_*_highres() functions exactly. */
+static void
+svga_mt_render_line(const svga_mt_batch_t *b, const svga_mt_line_t *l)
+{
+    const uint8_t *vram    = b->vram;
+    uint32_t       mask    = b->mask;
+    uint32_t       memaddr = l->memaddr;
+    uint32_t      *p       = l->p;
+    uint32_t       dat;
+    uint32_t       dat0;
+    uint32_t       dat1;
+    uint32_t       dat2;
+    int            x;
+
+    switch (b->mode) {
+        case SVGA_MT_15BPP:
+        case SVGA_MT_16BPP:
+            x = ((b->width >> 3) + 1) << 3;
+            if ((x > 0) && ((memaddr + (x << 1) + SVGA_CONV_SLACK) <= b->limit)) {
+                if (b->mode == SVGA_MT_15BPP)
+                    svga_conv_15bpp(p, &vram[memaddr], x);
+                else
+                    svga_conv_16bpp(p, &vram[memaddr], x);
+                break;
+            }
+            for (x = 0; x <= b->width; x += 8) {
+                for (int i = 0; i < 16; i += 4) {
+                    dat  = *(const uint32_t *) (&vram[(memaddr + (x << 1) + i) & mask]);
+                    *p++ = b->conv[dat & 0xffff];
+                    *p++ = b->conv[dat >> 16];
+                }
+            }
+            break;
+
+        case SVGA_MT_24BPP:
+            x = ((b->width >> 2) + 1) << 2;
+            if ((x > 0) && ((memaddr + (x * 3) + SVGA_CONV_SLACK) <= b->limit)) {
+                svga_conv_24bpp(p, &vram[memaddr], x);
+                break;
+            }
+            for (x = 0; x <= b->width; x += 4) {
+                dat0 = *(const uint32_t *) (&vram[memaddr & mask]);
+                dat1 = *(const uint32_t *) (&vram[(memaddr + 4) & mask]);
+                dat2 = *(const uint32_t *) (&vram[(memaddr + 8) & mask]);
+
+                *p++ = dat0 & 0xffffff;
+                *p++ = (dat0 >> 24) | ((dat1 & 0xffff) << 8);
+                *p++ = (dat1 >> 16) | ((dat2 & 0xff) << 16);
+                *p++ = dat2 >> 8;
+
+                memaddr += 12;
+            }
+            break;
+
+        case SVGA_MT_32BPP:
+            x = b->width + 1;
+            if ((x > 0) && ((memaddr + (x << 2) + SVGA_CONV_SLACK) <= b->limit)) {
+                svga_conv_32bpp(p, &vram[memaddr], x);
+                break;
+            }
+            for (x = 0; x <= b->width; x++) {
+                dat  = *(const uint32_t *) (&vram[(memaddr + (x << 2)) & mask]);
+                *p++ = dat & 0xffffff;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    /* The renderers overrun into the overscan, which svga_do_render()
+       then paints over, so it has to be done here too. */
+    for (x = 0; x < l->left; x++)
+        l->line[x] = l->overscan_color;
+    for (x = 0; x < l->right; x++)
+        l->line[l->right_x + x] = l->overscan_color;
+}
+
+static void
+svga_mt_thread(UNUSED(void *priv))
+{
+    svga_mt_batch_t *b;
+
+    while (1) {
+        thread_wait_event(svga_mt.wake, -1);
+
+        while (1) {
+            thread_wait_mutex(svga_mt.mutex);
+            if (svga_mt.quit) {
+                thread_release_mutex(svga_mt.mutex);
+                return;
+            }
+            if (svga_mt.taken == svga_mt.submitted) {
+                thread_reset_event(svga_mt.wake);
+                thread_release_mutex(svga_mt.mutex);
+                break;
+            }
+            b = &svga_mt.batch[svga_mt.taken % SVGA_MT_RING];
+            svga_mt.taken++;
+            thread_release_mutex(svga_mt.mutex);
+
+            for (int i = 0; i < b->lines; i++)
+                svga_mt_render_line(b, &b->line[i]);
+
+            thread_wait_mutex(svga_mt.mutex);
+            b->state = SVGA_MT_FREE;
+            svga_mt.completed++;
+            thread_set_event(svga_mt.done);
+            thread_release_mutex(svga_mt.mutex);
+        }
+    }
+}
+
+static int
+svga_mt_init(void)
+{
+    int threads = svga_render_threads;
+
+    if (threads > SVGA_MT_MAX_THREADS)
+        threads = SVGA_MT_MAX_THREADS;
+
+    memset(&svga_mt, 0x00, sizeof(svga_mt));
+
+    svga_mt.mutex = thread_create_mutex();
+    svga_mt.wake  = thread_create_event();
+    svga_mt.done  = thread_create_event();
+
+    for (int i = 0; i < threads; i++) {
+        svga_mt.thread[i] = thread_create_named(svga_mt_thread, NULL, "SVGA render");
+        if (svga_mt.thread[i] == NULL)
+            break;
+        svga_mt.threads++;
+    }
+
+    svga_mt_log("SVGA MT: started %i render threads\n", svga_mt.threads);
+
+    if (!svga_mt.threads) {
+        svga_render_mt_close();
+        /* Do not try again on every scanline. */
+        svga_mt_failed = 1;
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Wait until the given batch slot is free, or until every submitted
+   batch has been completed if slot is NULL. Called with the mutex held. */
+static void
+svga_mt_wait(svga_mt_batch_t *slot)
+{
+    while (slot ? (slot->state != SVGA_MT_FREE) : (svga_mt.completed != svga_mt.submitted)) {
+        thread_reset_event(svga_mt.done);
+        thread_release_mutex(svga_mt.mutex);
+        thread_wait_event(svga_mt.done, -1);
+        thread_wait_mutex(svga_mt.mutex);
+    }
+}
+
+/* Hand the batch being filled over to the workers. Called with the
+   mutex held. */
+static void
+svga_mt_submit(void)
+{
+    if (svga_mt.cur == NULL)
+        return;
+
+    if (svga_mt.cur->lines) {
+        svga_mt.cur->state = SVGA_MT_QUEUED;
+        svga_mt.submitted++;
+        thread_set_event(svga_mt.wake);
+    } else
+        svga_mt.cur->state = SVGA_MT_FREE;
+
+    svga_mt.cur = NULL;
+}
+
+static svga_mt_batch_t *
+svga_mt_get_batch(svga_t *svga, int mode, const uint32_t *conv)
+{
+    svga_mt_batch_t *b = svga_mt.cur;
+
+    if ((b != NULL) && ((b->svga != svga) || (b->mode != mode) || (b->width != (svga->hdisp + svga->scrollcache)) ||
+                        (b->mask != svga->vram_display_mask) || (b->lines == SVGA_MT_BATCH_LINES))) {
+        thread_wait_mutex(svga_mt.mutex);
+        svga_mt_submit();
+        thread_release_mutex(svga_mt.mutex);
+        b = NULL;
+    }
+
+    if (b == NULL) {
+        b = &svga_mt.batch[svga_mt.submitted % SVGA_MT_RING];
+
+        thread_wait_mutex(svga_mt.mutex);
+        svga_mt_wait(b);
+        thread_release_mutex(svga_mt.mutex);
+
+        b->state = SVGA_MT_FILLING;
+        b->mode  = mode;
+        b->svga  = svga;
+        b->vram  = svga->vram;
+        b->mask  = svga->vram_display_mask;
+        b->limit = MIN(svga->vram_display_mask, svga->vram_mask) + 1;
+        b->width = svga->hdisp + svga->scrollcache;
+        b->conv  = conv;
+        b->lines = 0;
+
+        svga_mt.cur = b;
+    }
+
+    return b;
+}
+
+/*
+ * Queue the current scanline for rendering on the worker threads,
+ * doing all the bookkeeping the synchronous renderer would have done.
+ * Returns 0 if the line has to be rendered synchronously instead, in
+ * which case nothing has been touched. On success the overscan of the
+ * line is painted by the worker as well.
+ */
+int
+svga_render_mt_queue(svga_t *svga)
+{
+    svga_mt_batch_t *b;
+    svga_mt_line_t  *l;
+    const uint32_t  *conv = NULL;
+    uint32_t         changed_addr;
+    int              mode;
+    int              width;
+    int              y;
+
+    if ((svga_render_threads <= 0) || svga_mt_failed || svga->force_old_addr || svga->remap_required ||
+        svga->hwcursor_on || svga->dac_hwcursor_on || svga->overlay_on)
+        return 0;
+
+    if (svga->render == svga_render_15bpp_highres) {
+        if (svga->conv_16to32 != svga_conv_16to32)
+            return 0;
+        mode = SVGA_MT_15BPP;
+        conv = video_15to32;
+    } else if (svga->render == svga_render_16bpp_highres) {
+        if (svga->conv_16to32 != svga_conv_16to32)
+            return 0;
+        mode = SVGA_MT_16BPP;
+        conv = video_16to32;
+    } else if ((svga->render == svga_render_24bpp_highres) && !svga->lut_map)
+        mode = SVGA_MT_24BPP;
+    else if ((svga->render == svga_render_32bpp_highres) && !svga->lut_map)
+        mode = SVGA_MT_32BPP;
+    else
+        return 0;
+
+    y = svga->displine + svga->y_add;
+    if ((y < 0) || (y >= 2048))
+        return 0;
+
+    changed_addr = svga->remap_func(svga, svga->memaddr);
+    if (!svga->changedvram[changed_addr >> 12] && !svga->changedvram[(changed_addr >> 12) + 1] && !svga->fullchange)
+        return 0;
+
+    if ((svga_mt.threads == 0) && !svga_mt_init())
+        return 0;
+
+    b = svga_mt_get_batch(svga, mode, conv);
+    l = &b->line[b->lines++];
+
+    l->line           = svga->monitor->target_buffer->line[y];
+    l->p              = &l->line[svga->x_add];
+    l->memaddr        = svga->memaddr;
+    l->overscan_color = svga->overscan_color;
+    if (svga->scrblank || (svga->hdisp <= 0))
+        l->left = l->right = 0;
+    else {
+        l->left    = (svga->left_overscan >= 0) ? svga->left_overscan : 0;
+        l->right_x = svga->left_overscan + svga->hdisp;
+        l->right   = overscan_x - svga->left_overscan;
+    }
+
+    if (svga->firstline_draw == 2000)
+        svga->firstline_draw = svga->displine;
+    svga->lastline_draw = svga->displine;
+
+    width = svga->hdisp + svga->scrollcache;
+    switch (mode) {
+        case SVGA_MT_15BPP:
+        case SVGA_MT_16BPP:
+            if (width >= 0)
+                svga->memaddr += ((width >> 3) + 1) << 4;
+            break;
+        case SVGA_MT_24BPP:
+            if (width >= 0)
+                svga->memaddr += ((width >> 2) + 1) * 12;
+            break;
+        default:
+            if (width >= 0)
+                svga->memaddr += (width + 1) << 2;
+            break;
+    }
+    svga->memaddr &= svga->vram_display_mask;
+
+    if (b->lines == SVGA_MT_BATCH_LINES) {
+        thread_wait_mutex(svga_mt.mutex);
+        svga_mt_submit();
+        thread_release_mutex(svga_mt.mutex);
+    }
+
+    return 1;
+}
+
+/* Wait for every queued line to land in the target buffers. */
+void
+svga_render_mt_fence(void)
+{
+    if (svga_mt.threads == 0)
+        return;
+
+    thread_wait_mutex(svga_mt.mutex);
+    svga_mt_submit();
+    svga_mt_wait(NULL);
+    thread_release_mutex(svga_mt.mutex);
+}
+
+void
+svga_render_mt_close(void)
+{
+    if (svga_mt.mutex == NULL)
+        return;
+
+    svga_render_mt_fence();
+
+    thread_wait_mutex(svga_mt.mutex);
+    svga_mt.quit = 1;
+    thread_set_event(svga_mt.wake);
+    thread_release_mutex(svga_mt.mutex);
+
+    for (int i = 0; i < svga_mt.threads; i++)
+        thread_wait(svga_mt.thread[i]);
+
+    thread_destroy_event(svga_mt.done);
+    thread_destroy_event(svga_mt.wake);
+    thread_close_mutex(svga_mt.mutex);
+
+    memset(&svga_mt, 0x00, sizeof(svga_mt));
+}
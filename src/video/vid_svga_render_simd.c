@@ -0,0 +1,535 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Vectorized SVGA pixel format conversion.
+ *
+ *          The kernels convert a run of pixels that lies contiguously
+ *          in VRAM into the target buffer. SSE2 is always available on
+ *          x86-64 and NEON on arm64, AVX2 is detected at run time. The
+ *          15/16 bpp kernels compute the colors instead of looking them
+ *          up in video_15to32/video_16to32, so every selected kernel is
+ *          compared against the scalar one at start-up and replaced by
+ *          it if the results differ in any way.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/timer.h>
+#include <86box/video.h>
+#include <86box/vid_svga.h>
+#include <86box/vid_svga_render.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#    define USE_SVGA_SSE2
+#    if defined(_MSC_VER) && !defined(__clang__)
+#        include <intrin.h>
+#        define USE_SVGA_AVX2
+#        define SVGA_AVX2_FUNC
+#    elif defined(__GNUC__) || defined(__clang__)
+#        define USE_SVGA_AVX2
+#        define SVGA_AVX2_FUNC __attribute__((target("avx2")))
+#    endif
+#    include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define USE_SVGA_NEON
+#    include <arm_neon.h>
+#endif
+
+svga_conv_8bpp_t svga_conv_8bpp;
+svga_conv_func_t svga_conv_15bpp;
+svga_conv_func_t svga_conv_16bpp;
+svga_conv_func_t svga_conv_24bpp;
+svga_conv_func_t svga_conv_32bpp;
+
+#ifdef ENABLE_SVGA_SIMD_LOG
+int svga_simd_do_log = ENABLE_SVGA_SIMD_LOG;
+
+static void
+svga_simd_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (svga_simd_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define svga_simd_log(fmt, ...)
+#endif
+
+/* Scalar kernels, these give exactly the results of the renderer loops. */
+static void
+svga_conv_8bpp_c(uint32_t *dst, const uint8_t *src, int count, const uint32_t *pal, uint8_t mask)
+{
+    for (int x = 0; x < count; x++)
+        dst[x] = pal[src[x] & mask];
+}
+
+static void
+svga_conv_15bpp_c(uint32_t *dst, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        dst[x] = video_15to32[src[x << 1] | (src[(x << 1) + 1] << 8)];
+}
+
+static void
+svga_conv_16bpp_c(uint32_t *dst, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        dst[x] = video_16to32[src[x << 1] | (src[(x << 1) + 1] << 8)];
+}
+
+static void
+svga_conv_24bpp_c(uint32_t *dst, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++, src += 3)
+        dst[x] = src[0] | (src[1] << 8) | (src[2] << 16);
+}
+
+static void
+svga_conv_32bpp_c(uint32_t *dst, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++, src += 4)
+        dst[x] = src[0] | (src[1] << 8) | (src[2] << 16);
+}
+
+/*
+ * The 5 and 6 bit color components are scaled to 8 bits the same way
+ * calc_15to32() and calc_16to32() do, that is floor(c * 255 / 31) and
+ * floor(c * 255 / 63), which for the whole input range is exactly
+ * (c * 1053) >> 7 and (c * 259 + 3) >> 6 in 16-bit arithmetic.
+ */
+#ifdef USE_SVGA_SSE2
+static void
+svga_conv_hicolor_sse2(uint32_t *dst, const uint8_t *src, int count, int is_565)
+{
+    const __m128i m31   = _mm_set1_epi16(0x1f);
+    const __m128i m63   = _mm_set1_epi16(0x3f);
+    const __m128i k1053 = _mm_set1_epi16(1053);
+    const __m128i k259  = _mm_set1_epi16(259);
+    const __m128i k3    = _mm_set1_epi16(3);
+    __m128i       c;
+    __m128i       r;
+    __m128i       g;
+    __m128i       b;
+    int           x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        c = _mm_loadu_si128((const __m128i *) &src[x << 1]);
+        b = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(c, m31), k1053), 7);
+        if (is_565) {
+            g = _mm_and_si128(_mm_srli_epi16(c, 5), m63);
+            g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(g, k259), k3), 6);
+            r = _mm_srli_epi16(_mm_mullo_epi16(_mm_srli_epi16(c, 11), k1053), 7);
+        } else {
+            g = _mm_and_si128(_mm_srli_epi16(c, 5), m31);
+            g = _mm_srli_epi16(_mm_mullo_epi16(g, k1053), 7);
+            r = _mm_and_si128(_mm_srli_epi16(c, 10), m31);
+            r = _mm_srli_epi16(_mm_mullo_epi16(r, k1053), 7);
+        }
+        b = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+        _mm_storeu_si128((__m128i *) &dst[x], _mm_unpacklo_epi16(b, r));
+        _mm_storeu_si128((__m128i *) &dst[x + 4], _mm_unpackhi_epi16(b, r));
+    }
+
+    if (is_565)
+        svga_conv_16bpp_c(&dst[x], &src[x << 1], count - x);
+    else
+        svga_conv_15bpp_c(&dst[x], &src[x << 1], count - x);
+}
+
+static void
+svga_conv_15bpp_sse2(uint32_t *dst, const uint8_t *src, int count)
+{
+    svga_conv_hicolor_sse2(dst, src, count, 0);
+}
+
+static void
+svga_conv_16bpp_sse2(uint32_t *dst, const uint8_t *src, int count)
+{
+    svga_conv_hicolor_sse2(dst, src, count, 1);
+}
+
+static void
+svga_conv_24bpp_sse2(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m128i mask = _mm_set1_epi32(0x00ffffff);
+    __m128i       v;
+    __m128i       lo;
+    __m128i       hi;
+    int           x;
+
+    /* Reads 4 bytes past the last pixel of every group. */
+    for (x = 0; x <= (count - 4); x += 4) {
+        v  = _mm_loadu_si128((const __m128i *) &src[x * 3]);
+        lo = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+        hi = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+        _mm_storeu_si128((__m128i *) &dst[x], _mm_and_si128(_mm_unpacklo_epi64(lo, hi), mask));
+    }
+
+    svga_conv_24bpp_c(&dst[x], &src[x * 3], count - x);
+}
+
+static void
+svga_conv_32bpp_sse2(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m128i mask = _mm_set1_epi32(0x00ffffff);
+    int           x;
+
+    for (x = 0; x <= (count - 4); x += 4)
+        _mm_storeu_si128((__m128i *) &dst[x],
+                         _mm_and_si128(_mm_loadu_si128((const __m128i *) &src[x << 2]), mask));
+
+    svga_conv_32bpp_c(&dst[x], &src[x << 2], count - x);
+}
+#endif
+
+#ifdef USE_SVGA_AVX2
+static SVGA_AVX2_FUNC void
+svga_conv_8bpp_avx2(uint32_t *dst, const uint8_t *src, int count, const uint32_t *pal, uint8_t mask)
+{
+    const __m256i m = _mm256_set1_epi32(mask);
+    __m256i       idx;
+    int           x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) &src[x]));
+        idx = _mm256_and_si256(idx, m);
+        _mm256_storeu_si256((__m256i *) &dst[x], _mm256_i32gather_epi32((const int *) pal, idx, 4));
+    }
+
+    svga_conv_8bpp_c(&dst[x], &src[x], count - x, pal, mask);
+}
+
+static SVGA_AVX2_FUNC void
+svga_conv_hicolor_avx2(uint32_t *dst, const uint8_t *src, int count, int is_565)
+{
+    const __m256i m31   = _mm256_set1_epi16(0x1f);
+    const __m256i m63   = _mm256_set1_epi16(0x3f);
+    const __m256i k1053 = _mm256_set1_epi16(1053);
+    const __m256i k259  = _mm256_set1_epi16(259);
+    const __m256i k3    = _mm256_set1_epi16(3);
+    __m256i       c;
+    __m256i       r;
+    __m256i       g;
+    __m256i       b;
+    __m256i       lo;
+    __m256i       hi;
+    int           x;
+
+    for (x = 0; x <= (count - 16); x += 16) {
+        c = _mm256_loadu_si256((const __m256i *) &src[x << 1]);
+        b = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(c, m31), k1053), 7);
+        if (is_565) {
+            g = _mm256_and_si256(_mm256_srli_epi16(c, 5), m63);
+            g = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(g, k259), k3), 6);
+            r = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_srli_epi16(c, 11), k1053), 7);
+        } else {
+            g = _mm256_and_si256(_mm256_srli_epi16(c, 5), m31);
+            g = _mm256_srli_epi16(_mm256_mullo_epi16(g, k1053), 7);
+            r = _mm256_and_si256(_mm256_srli_epi16(c, 10), m31);
+            r = _mm256_srli_epi16(_mm256_mullo_epi16(r, k1053), 7);
+        }
+        b = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+
+        /* The unpacks work within 128-bit lanes, put the pixels back in order. */
+        lo = _mm256_unpacklo_epi16(b, r);
+        hi = _mm256_unpackhi_epi16(b, r);
+        _mm256_storeu_si256((__m256i *) &dst[x], _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *) &dst[x + 8], _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    if (is_565)
+        svga_conv_16bpp_c(&dst[x], &src[x << 1], count - x);
+    else
+        svga_conv_15bpp_c(&dst[x], &src[x << 1], count - x);
+}
+
+static SVGA_AVX2_FUNC void
+svga_conv_15bpp_avx2(uint32_t *dst, const uint8_t *src, int count)
+{
+    svga_conv_hicolor_avx2(dst, src, count, 0);
+}
+
+static SVGA_AVX2_FUNC void
+svga_conv_16bpp_avx2(uint32_t *dst, const uint8_t *src, int count)
+{
+    svga_conv_hicolor_avx2(dst, src, count, 1);
+}
+
+static SVGA_AVX2_FUNC void
+svga_conv_24bpp_avx2(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m256i perm = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+    const __m256i shuf = _mm256_setr_epi8(0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128,
+                                          0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128);
+    __m256i       v;
+    int           x;
+
+    /* Reads 8 bytes past the last pixel of every group. */
+    for (x = 0; x <= (count - 8); x += 8) {
+        v = _mm256_loadu_si256((const __m256i *) &src[x * 3]);
+        v = _mm256_permutevar8x32_epi32(v, perm);
+        _mm256_storeu_si256((__m256i *) &dst[x], _mm256_shuffle_epi8(v, shuf));
+    }
+
+    svga_conv_24bpp_c(&dst[x], &src[x * 3], count - x);
+}
+
+static SVGA_AVX2_FUNC void
+svga_conv_32bpp_avx2(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m256i mask = _mm256_set1_epi32(0x00ffffff);
+    int           x;
+
+    for (x = 0; x <= (count - 8); x += 8)
+        _mm256_storeu_si256((__m256i *) &dst[x],
+                            _mm256_and_si256(_mm256_loadu_si256((const __m256i *) &src[x << 2]), mask));
+
+    svga_conv_32bpp_c(&dst[x], &src[x << 2], count - x);
+}
+
+static int
+svga_has_avx2(void)
+{
+#    if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+        return 0;
+
+    /* The OS has to save the YMM registers. */
+    __cpuid(regs, 1);
+    if (!(regs[2] & (1 << 27)) || ((_xgetbv(0) & 6) != 6))
+        return 0;
+
+    __cpuidex(regs, 7, 0);
+    return !!(regs[1] & (1 << 5));
+#    else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#    endif
+}
+#endif
+
+#ifdef USE_SVGA_NEON
+static void
+svga_conv_hicolor_neon(uint32_t *dst, const uint8_t *src, int count, int is_565)
+{
+    uint16x8_t   c;
+    uint16x8_t   r;
+    uint16x8_t   g;
+    uint16x8_t   b;
+    uint16x8x2_t z;
+    int          x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        c = vreinterpretq_u16_u8(vld1q_u8(&src[x << 1]));
+        b = vshrq_n_u16(vmulq_n_u16(vandq_u16(c, vdupq_n_u16(0x1f)), 1053), 7);
+        if (is_565) {
+            g = vandq_u16(vshrq_n_u16(c, 5), vdupq_n_u16(0x3f));
+            g = vshrq_n_u16(vaddq_u16(vmulq_n_u16(g, 259), vdupq_n_u16(3)), 6);
+            r = vshrq_n_u16(vmulq_n_u16(vshrq_n_u16(c, 11), 1053), 7);
+        } else {
+            g = vandq_u16(vshrq_n_u16(c, 5), vdupq_n_u16(0x1f));
+            g = vshrq_n_u16(vmulq_n_u16(g, 1053), 7);
+            r = vandq_u16(vshrq_n_u16(c, 10), vdupq_n_u16(0x1f));
+            r = vshrq_n_u16(vmulq_n_u16(r, 1053), 7);
+        }
+        b = vorrq_u16(b, vshlq_n_u16(g, 8));
+        z = vzipq_u16(b, r);
+        vst1q_u32(&dst[x], vreinterpretq_u32_u16(z.val[0]));
+        vst1q_u32(&dst[x + 4], vreinterpretq_u32_u16(z.val[1]));
+    }
+
+    if (is_565)
+        svga_conv_16bpp_c(&dst[x], &src[x << 1], count - x);
+    else
+        svga_conv_15bpp_c(&dst[x], &src[x << 1], count - x);
+}
+
+static void
+svga_conv_15bpp_neon(uint32_t *dst, const uint8_t *src, int count)
+{
+    svga_conv_hicolor_neon(dst, src, count, 0);
+}
+
+static void
+svga_conv_16bpp_neon(uint32_t *dst, const uint8_t *src, int count)
+{
+    svga_conv_hicolor_neon(dst, src, count, 1);
+}
+
+static void
+svga_conv_24bpp_neon(uint32_t *dst, const uint8_t *src, int count)
+{
+    uint8x16x3_t v;
+    uint8x16x4_t o;
+    int          x;
+
+    o.val[3] = vdupq_n_u8(0);
+    for (x = 0; x <= (count - 16); x += 16) {
+        v        = vld3q_u8(&src[x * 3]);
+        o.val[0] = v.val[0];
+        o.val[1] = v.val[1];
+        o.val[2] = v.val[2];
+        vst4q_u8((uint8_t *) &dst[x], o);
+    }
+
+    svga_conv_24bpp_c(&dst[x], &src[x * 3], count - x);
+}
+
+static void
+svga_conv_32bpp_neon(uint32_t *dst, const uint8_t *src, int count)
+{
+    const uint32x4_t mask = vdupq_n_u32(0x00ffffff);
+    int              x;
+
+    for (x = 0; x <= (count - 4); x += 4)
+        vst1q_u32(&dst[x], vandq_u32(vreinterpretq_u32_u8(vld1q_u8(&src[x << 2])), mask));
+
+    svga_conv_32bpp_c(&dst[x], &src[x << 2], count - x);
+}
+#endif
+
+/*
+ * Run a kernel and its scalar counterpart over the same data and
+ * compare the results. The 15/16 bpp ones get every possible pixel
+ * value, the others a pseudo-random buffer with a count that also
+ * exercises the scalar tail.
+ */
+#define SVGA_CHECK_PIXELS 65536
+
+static int
+svga_conv_check(svga_conv_func_t func, svga_conv_func_t ref, const uint8_t *src, int count,
+                uint32_t *out, uint32_t *out_ref)
+{
+    memset(out, 0x55, count * sizeof(uint32_t));
+    memset(out_ref, 0xaa, count * sizeof(uint32_t));
+
+    func(out, src, count);
+    ref(out_ref, src, count);
+
+    return !memcmp(out, out_ref, count * sizeof(uint32_t));
+}
+
+static void
+svga_conv_self_test(void)
+{
+    uint8_t  *src;
+    uint32_t *out;
+    uint32_t *out_ref;
+    uint32_t  pal[256];
+    uint32_t  seed = 0x86b0c5;
+
+    src     = (uint8_t *) malloc((SVGA_CHECK_PIXELS * 4) + SVGA_CONV_SLACK);
+    out     = (uint32_t *) malloc(SVGA_CHECK_PIXELS * sizeof(uint32_t));
+    out_ref = (uint32_t *) malloc(SVGA_CHECK_PIXELS * sizeof(uint32_t));
+    if ((src == NULL) || (out == NULL) || (out_ref == NULL))
+        goto out;
+
+    for (int i = 0; i < SVGA_CHECK_PIXELS; i++) {
+        src[i << 1]       = i & 0xff;
+        src[(i << 1) + 1] = i >> 8;
+    }
+
+    if (!svga_conv_check(svga_conv_15bpp, svga_conv_15bpp_c, src, SVGA_CHECK_PIXELS, out, out_ref)) {
+        pclog("SVGA: vectorized 15 bpp conversion mismatch, using scalar code\n");
+        svga_conv_15bpp = svga_conv_15bpp_c;
+    }
+    if (!svga_conv_check(svga_conv_16bpp, svga_conv_16bpp_c, src, SVGA_CHECK_PIXELS, out, out_ref)) {
+        pclog("SVGA: vectorized 16 bpp conversion mismatch, using scalar code\n");
+        svga_conv_16bpp = svga_conv_16bpp_c;
+    }
+
+    for (int i = 0; i < ((SVGA_CHECK_PIXELS * 4) + SVGA_CONV_SLACK); i++) {
+        seed   = (seed * 1103515245) + 12345;
+        src[i] = seed >> 16;
+    }
+    for (int i = 0; i < 256; i++) {
+        seed   = (seed * 1103515245) + 12345;
+        pal[i] = seed;
+    }
+
+    if (!svga_conv_check(svga_conv_24bpp, svga_conv_24bpp_c, src, SVGA_CHECK_PIXELS - 3, out, out_ref)) {
+        pclog("SVGA: vectorized 24 bpp conversion mismatch, using scalar code\n");
+        svga_conv_24bpp = svga_conv_24bpp_c;
+    }
+    if (!svga_conv_check(svga_conv_32bpp, svga_conv_32bpp_c, src, SVGA_CHECK_PIXELS - 3, out, out_ref)) {
+        pclog("SVGA: vectorized 32 bpp conversion mismatch, using scalar code\n");
+        svga_conv_32bpp = svga_conv_32bpp_c;
+    }
+
+    memset(out, 0x55, SVGA_CHECK_PIXELS * sizeof(uint32_t));
+    memset(out_ref, 0xaa, SVGA_CHECK_PIXELS * sizeof(uint32_t));
+    svga_conv_8bpp(out, src, SVGA_CHECK_PIXELS - 3, pal, 0x7f);
+    svga_conv_8bpp_c(out_ref, src, SVGA_CHECK_PIXELS - 3, pal, 0x7f);
+    if (memcmp(out, out_ref, (SVGA_CHECK_PIXELS - 3) * sizeof(uint32_t))) {
+        pclog("SVGA: vectorized 8 bpp conversion mismatch, using scalar code\n");
+        svga_conv_8bpp = svga_conv_8bpp_c;
+    }
+
+out:
+    free(src);
+    free(out);
+    free(out_ref);
+}
+
+/* Select the conversion kernels, must be called after the color tables
+   have been built. */
+void
+svga_render_simd_init(void)
+{
+    svga_conv_8bpp  = svga_conv_8bpp_c;
+    svga_conv_15bpp = svga_conv_15bpp_c;
+    svga_conv_16bpp = svga_conv_16bpp_c;
+    svga_conv_24bpp = svga_conv_24bpp_c;
+    svga_conv_32bpp = svga_conv_32bpp_c;
+
+#if defined(USE_SVGA_SSE2)
+    svga_simd_log("SVGA: using SSE2 pixel conversion\n");
+    svga_conv_15bpp = svga_conv_15bpp_sse2;
+    svga_conv_16bpp = svga_conv_16bpp_sse2;
+    svga_conv_24bpp = svga_conv_24bpp_sse2;
+    svga_conv_32bpp = svga_conv_32bpp_sse2;
+#    ifdef USE_SVGA_AVX2
+    if (svga_has_avx2()) {
+        svga_simd_log("SVGA: using AVX2 pixel conversion\n");
+        svga_conv_8bpp  = svga_conv_8bpp_avx2;
+        svga_conv_15bpp = svga_conv_15bpp_avx2;
+        svga_conv_16bpp = svga_conv_16bpp_avx2;
+        svga_conv_24bpp = svga_conv_24bpp_avx2;
+        svga_conv_32bpp = svga_conv_32bpp_avx2;
+    }
+#    endif
+#elif defined(USE_SVGA_NEON)
+    svga_simd_log("SVGA: using NEON pixel conversion\n");
+    svga_conv_15bpp = svga_conv_15bpp_neon;
+    svga_conv_16bpp = svga_conv_16bpp_neon;
+    svga_conv_24bpp = svga_conv_24bpp_neon;
+    svga_conv_32bpp = svga_conv_32bpp_neon;
+#endif
+
+
+    if (svga_conv_15bpp != svga_conv_15bpp_c)
+        svga_conv_self_test();
+}
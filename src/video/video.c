@@ -71,6 +71,8 @@
 #include <86box/thread.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/vid_svga_render.h>
+#include <86box/bench.h>
 
 #include <minitrace/minitrace.h>
 
@@ -91,6 +93,7 @@ int          frames               = 0;
 int          fullchange           = 0;
 int          video_grayscale      = 0;
 int          video_graytype       = 0;
+int          svga_render_threads  = 0;
 int          monitor_index_global = 0;
 uint32_t    *video_6to8           = NULL;
 uint32_t    *video_8togs          = NULL;
@@ -234,6 +237,12 @@ const uint32_t shade[5][256] = {
 
 typedef struct blit_data_struct {
     int x, y, w, h;
+    int dmg_y, dmg_h;     /* rows that changed since the previous blit */
+    int last_x, last_y, last_w, last_h;
+    int pending_y, pending_h;
+    int dmg_pending;      /* the renderer reported the damage of the next frame */
+    int dmg_prev;         /* ... and of the previous one, which it is relative to */
+    int dmg_full;         /* the next frame has to be blitted in full */
     int busy;
     int buffer_in_use;
     int thread_run;
@@ -271,6 +280,56 @@ void
 video_setblit(void (*blit)(int, int, int, int, int))
 {
     blit_func = blit;
+
+    /* A new consumer has none of the picture yet. */
+    for (int i = 0; i < MONITORS_NUM; i++) {
+        if (monitors[i].mon_blit_data_ptr != NULL)
+            monitors[i].mon_blit_data_ptr->dmg_full = 1;
+    }
+}
+
+/*
+ * Tell the blitter which rows of the target buffer have changed since
+ * the previous frame of the monitor, before the frame is handed over
+ * with video_blit_memtoscreen_monitor(). A height of 0 means nothing
+ * changed. Frames with no damage reported are treated as fully damaged,
+ * so renderers that do not track changes need not call this.
+ */
+void
+video_set_damage_monitor(int y, int h, int monitor_index)
+{
+    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+    int          y2;
+
+    if (blit_data_ptr == NULL)
+        return;
+
+    if (h < 0)
+        h = 0;
+
+    if (blit_data_ptr->dmg_pending && (blit_data_ptr->pending_h > 0) && (h > 0)) {
+        y2 = MAX(y + h, blit_data_ptr->pending_y + blit_data_ptr->pending_h);
+        y  = MIN(y, blit_data_ptr->pending_y);
+        h  = y2 - y;
+    } else if (blit_data_ptr->dmg_pending && (h == 0)) {
+        y = blit_data_ptr->pending_y;
+        h = blit_data_ptr->pending_h;
+    }
+
+    blit_data_ptr->pending_y   = y;
+    blit_data_ptr->pending_h   = h;
+    blit_data_ptr->dmg_pending = 1;
+}
+
+/* For the blit callbacks: the rows of the frame being blitted that
+   changed, always within the blit rectangle. */
+void
+video_get_damage_monitor(int *y, int *h, int monitor_index)
+{
+    const blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+
+    *y = blit_data_ptr->dmg_y;
+    *h = blit_data_ptr->dmg_h;
 }
 
 void
@@ -448,7 +507,10 @@ blit_thread(void *param)
         thread_reset_event(data->wake_blit_thread);
         MTR_BEGIN("video", "blit_thread");
 
-        if (blit_func)
+        /* The benchmark runs headless, drop the frame right away. */
+        if (bench_active)
+            video_blit_complete_monitor(data->monitor_index);
+        else if (blit_func)
             blit_func(data->x, data->y, data->w, data->h, data->monitor_index);
 
         data->busy = 0;
@@ -461,6 +523,10 @@ blit_thread(void *param)
 void
 video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index)
 {
+    blit_data_t *blit_data_ptr;
+    int          y1;
+    int          y2;
+
     MTR_BEGIN("video", "video_blit_memtoscreen");
 
     if ((w <= 0) || (h <= 0))
@@ -468,12 +534,34 @@ video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index)
 
     video_wait_for_blit_monitor(monitor_index);
 
-    monitors[monitor_index].mon_blit_data_ptr->busy          = 1;
-    monitors[monitor_index].mon_blit_data_ptr->buffer_in_use = 1;
-    monitors[monitor_index].mon_blit_data_ptr->x             = x;
-    monitors[monitor_index].mon_blit_data_ptr->y             = y;
-    monitors[monitor_index].mon_blit_data_ptr->w             = w;
-    monitors[monitor_index].mon_blit_data_ptr->h             = h;
+    blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+
+    blit_data_ptr->busy          = 1;
+    blit_data_ptr->buffer_in_use = 1;
+    blit_data_ptr->x             = x;
+    blit_data_ptr->y             = y;
+    blit_data_ptr->w             = w;
+    blit_data_ptr->h             = h;
+
+    if (!blit_data_ptr->dmg_pending || !blit_data_ptr->dmg_prev || blit_data_ptr->dmg_full || (x != blit_data_ptr->last_x) ||
+        (y != blit_data_ptr->last_y) || (w != blit_data_ptr->last_w) || (h != blit_data_ptr->last_h)) {
+        blit_data_ptr->dmg_y = y;
+        blit_data_ptr->dmg_h = h;
+    } else {
+        y1 = MAX(blit_data_ptr->pending_y, y);
+        y2 = MIN(blit_data_ptr->pending_y + blit_data_ptr->pending_h, y + h);
+
+        blit_data_ptr->dmg_y = y1;
+        blit_data_ptr->dmg_h = (y2 > y1) ? (y2 - y1) : 0;
+    }
+    blit_data_ptr->dmg_prev    = blit_data_ptr->dmg_pending;
+    blit_data_ptr->dmg_pending = 0;
+    blit_data_ptr->dmg_full    = 0;
+    blit_data_ptr->last_x      = x;
+    blit_data_ptr->last_y      = y;
+    blit_data_ptr->last_w      = w;
+    blit_data_ptr->last_h      = h;
+
     monitors[monitor_index].mon_renderedframes++;
 
     thread_set_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
@@ -966,6 +1054,8 @@ video_init(void)
     for (uint32_t c = 0; c < 65536; c++)
         video_16to32[c] = calc_16to32(c);
 
+    svga_render_simd_init();
+
     memset(monitors, 0, sizeof(monitors));
     video_monitor_init(0);
 }
@@ -28,6 +28,7 @@
 #include <86box/mouse.h>
 #include <86box/plat.h>
 #include <86box/ui.h>
+#include <86box/thread.h>
 #include <86box/vnc.h>
 
 #define VNC_MIN_X 320
@@ -35,9 +36,43 @@
 #define VNC_MIN_Y 200
 #define VNC_MAX_Y 2048
 
+#define VNC_TILE    64 /* size of the squares the frame is compared in */
+#define VNC_ENC_MAX 16
+
+typedef struct vnc_client_t {
+    sraRegionPtr pending; /* changes held back by the update rate limit */
+    uint32_t     last_update;
+} vnc_client_t;
+
+static const struct {
+    const char *name;
+    int         encoding;
+} vnc_encoding_names[] = {
+  // clang-format off
+    { "raw",     rfbEncodingRaw     },
+    { "rre",     rfbEncodingRRE     },
+    { "corre",   rfbEncodingCoRRE   },
+    { "hextile", rfbEncodingHextile },
+    { "zlib",    rfbEncodingZlib    },
+    { "zlibhex", rfbEncodingZlibHex },
+    { "tight",   rfbEncodingTight   },
+    { "zrle",    rfbEncodingZRLE    },
+    { "zywrle",  rfbEncodingZYWRLE  },
+    { "ultra",   rfbEncodingUltra   },
+    { NULL,      0                  }
+  // clang-format on
+};
+
+int  vnc_max_fps        = 0;
+char vnc_encodings[128] = "";
+
 static rfbScreenInfoPtr rfb = NULL;
+static mutex_t         *client_mutex;
+static int              encodings[VNC_ENC_MAX];
+static int              encodings_num;
 static int              clients;
 static int              updatingSize;
+static int              full_update = 1;
 static int              allowedX;
 static int              allowedY;
 static int              ptr_x;
@@ -111,8 +146,20 @@ vnc_ptrevent(int but, int x, int y, rfbClientPtr cl)
 static void
 vnc_clientgone(UNUSED(rfbClientPtr cl))
 {
+    vnc_client_t *vc;
+
     vnc_log("VNC: client disconnected: %s\n", cl->host);
 
+    thread_wait_mutex(client_mutex);
+    vc             = (vnc_client_t *) cl->clientData;
+    cl->clientData = NULL;
+    thread_release_mutex(client_mutex);
+
+    if (vc != NULL) {
+        sraRgnDestroy(vc->pending);
+        free(vc);
+    }
+
     if (clients > 0)
         clients--;
     if (clients == 0) {
@@ -131,9 +178,18 @@ vnc_clientgone(UNUSED(rfbClientPtr cl))
 static enum rfbNewClientAction
 vnc_newclient(rfbClientPtr cl)
 {
+    vnc_client_t *vc;
+
     /* Hook the ClientGone function so we know when they're gone. */
     cl->clientGoneHook = vnc_clientgone;
 
+    vc          = (vnc_client_t *) calloc(1, sizeof(vnc_client_t));
+    vc->pending = sraRgnCreate();
+
+    thread_wait_mutex(client_mutex);
+    cl->clientData = vc;
+    thread_release_mutex(client_mutex);
+
     vnc_log("VNC: new client: %s\n", cl->host);
     if (++clients == 1) {
         /* Reset the mouse. */
@@ -157,9 +213,55 @@ vnc_newclient(rfbClientPtr cl)
     return RFB_CLIENT_ACCEPT;
 }
 
+/*
+ * LibVNCServer only keeps the first encoding of the client's list that it
+ * supports. If that one is not allowed by the configuration, fall back to
+ * Raw, which every client has to accept.
+ */
+static void
+vnc_set_encoding(rfbClientPtr cl)
+{
+    if ((encodings_num == 0) || (cl->preferredEncoding == -1))
+        return;
+
+    for (int i = 0; i < encodings_num; i++) {
+        if (cl->preferredEncoding == encodings[i])
+            return;
+    }
+
+    vnc_log("VNC: encoding %i of %s not allowed, using raw\n", cl->preferredEncoding, cl->host);
+    cl->preferredEncoding = rfbEncodingRaw;
+}
+
+static void
+vnc_parse_encodings(void)
+{
+    char  temp[sizeof(vnc_encodings)];
+    char *tok;
+    int   i;
+
+    encodings_num = 0;
+
+    strncpy(temp, vnc_encodings, sizeof(temp) - 1);
+    temp[sizeof(temp) - 1] = '\0';
+
+    for (tok = strtok(temp, ", "); (tok != NULL) && (encodings_num < VNC_ENC_MAX); tok = strtok(NULL, ", ")) {
+        for (i = 0; vnc_encoding_names[i].name != NULL; i++) {
+            if (!strcasecmp(tok, vnc_encoding_names[i].name))
+                break;
+        }
+        if (vnc_encoding_names[i].name != NULL)
+            encodings[encodings_num++] = vnc_encoding_names[i].encoding;
+        else
+            vnc_log("VNC: unknown encoding \"%s\"\n", tok);
+    }
+}
+
 static void
 vnc_display(rfbClientPtr cl)
 {
+    vnc_set_encoding(cl);
+
     /* Avoid race condition between resize and update. */
     if (!updatingSize && cl->newFBSizePending) {
         updatingSize = 1;
@@ -171,24 +273,140 @@ vnc_display(rfbClientPtr cl)
     }
 }
 
+static void
+vnc_region_add(sraRegionPtr region, int x1, int y1, int x2, int y2)
+{
+    sraRegionPtr rect = sraRgnCreateRect(x1, y1, x2, y2);
+
+    sraRgnOr(region, rect);
+    sraRgnDestroy(rect);
+}
+
+/*
+ * Compare the damaged rows of the frame against what the clients were
+ * last sent, tile by tile, and bring the tiles that differ up to date.
+ * Runs of changed tiles are added to the region.
+ */
+static void
+vnc_diff_tiles(int x, int y, int w, int dy, int dh, sraRegionPtr region)
+{
+    uint32_t *fb = (uint32_t *) rfb->frameBuffer;
+    uint32_t *dst;
+    uint32_t *src;
+    int       r1;
+    int       r2;
+    int       tw;
+    int       run;
+    int       changed;
+
+    for (int ty = dy - (dy % VNC_TILE); ty < (dy + dh); ty += VNC_TILE) {
+        r1  = MAX(ty, dy);
+        r2  = MIN(ty + VNC_TILE, dy + dh);
+        run = -1;
+
+        for (int tx = 0; tx < w; tx += VNC_TILE) {
+            tw      = MIN(VNC_TILE, w - tx);
+            changed = 0;
+
+            for (int row = r1; row < r2; row++) {
+                dst = &fb[(row * VNC_MAX_X) + tx];
+                src = &buffer32->line[y + row][x + tx];
+                if (memcmp(dst, src, tw * sizeof(uint32_t))) {
+                    video_copy(dst, src, tw * sizeof(uint32_t));
+                    changed = 1;
+                }
+            }
+
+            if (changed && (run < 0))
+                run = tx;
+            else if (!changed && (run >= 0)) {
+                vnc_region_add(region, run, r1, tx, r2);
+                run = -1;
+            }
+        }
+
+        if (run >= 0)
+            vnc_region_add(region, run, r1, w, r2);
+    }
+}
+
+/* Hand the changes to every client, as often as its update rate allows. */
+static void
+vnc_update_clients(sraRegionPtr region)
+{
+    rfbClientIteratorPtr iterator;
+    rfbClientPtr         cl;
+    vnc_client_t        *vc;
+    uint32_t             now = plat_get_ticks();
+
+    thread_wait_mutex(client_mutex);
+
+    iterator = rfbGetClientIterator(rfb);
+    while ((cl = rfbClientIteratorNext(iterator)) != NULL) {
+        vc = (vnc_client_t *) cl->clientData;
+        if (vc == NULL)
+            continue;
+
+        sraRgnOr(vc->pending, region);
+
+        if (sraRgnEmpty(vc->pending) ||
+            ((vnc_max_fps > 0) && ((now - vc->last_update) < (uint32_t) (1000 / vnc_max_fps))))
+            continue;
+
+        LOCK(cl->updateMutex);
+        sraRgnOr(cl->modifiedRegion, vc->pending);
+        TSIGNAL(cl->updateCond);
+        UNLOCK(cl->updateMutex);
+
+        sraRgnMakeEmpty(vc->pending);
+        vc->last_update = now;
+    }
+    rfbReleaseClientIterator(iterator);
+
+    thread_release_mutex(client_mutex);
+}
+
 static void
 vnc_blit(int x, int y, int w, int h, int monitor_index)
 {
+    sraRegionPtr region;
+    int          dy;
+    int          dh;
+
     if (monitor_index || (x < 0) || (y < 0) || (w < VNC_MIN_X) || (h < VNC_MIN_Y) || (w > VNC_MAX_X) || (h > VNC_MAX_Y) || (buffer32 == NULL)) {
         video_blit_complete_monitor(monitor_index);
         return;
     }
 
-    for (int row = 0; row < h; ++row)
-        video_copy(&(((uint8_t *) rfb->frameBuffer)[row * 2048 * sizeof(uint32_t)]), &(buffer32->line[y + row][x]), w * sizeof(uint32_t));
+    /* Only the rows that changed since the previous frame are compared. */
+    video_get_damage_monitor(&dy, &dh, monitor_index);
+    dy -= y;
+
+    region = sraRgnCreate();
+    vnc_diff_tiles(x, y, w, dy, dh, region);
 
     if (screenshots)
         video_screenshot((uint32_t *) rfb->frameBuffer, 0, 0, VNC_MAX_X);
 
     video_blit_complete_monitor(monitor_index);
 
-    if (!updatingSize)
-        rfbMarkRectAsModified(rfb, 0, 0, allowedX, allowedY);
+    if (updatingSize)
+        full_update = 1;
+    else {
+        if (full_update) {
+            vnc_region_add(region, 0, 0, allowedX, allowedY);
+            full_update = 0;
+        } else {
+            sraRegionPtr clip = sraRgnCreateRect(0, 0, allowedX, allowedY);
+
+            sraRgnAnd(region, clip);
+            sraRgnDestroy(clip);
+        }
+
+        vnc_update_clients(region);
+    }
+
+    sraRgnDestroy(region);
 }
 
 /* Initialize VNC for operation. */
@@ -213,8 +431,12 @@ vnc_init(UNUSED(void *arg))
     cgapal_rebuild_monitor(0);
 
     if (rfb == NULL) {
+        client_mutex = thread_create_mutex();
+        vnc_parse_encodings();
+
         wcstombs(title, ui_window_title(NULL), sizeof(title));
         updatingSize = 0;
+        full_update  = 1;
         allowedX     = scrnsz_x;
         allowedY     = scrnsz_y;
 
@@ -259,6 +481,9 @@ vnc_close(void)
         rfbScreenCleanup(rfb);
 
         rfb = NULL;
+
+        thread_close_mutex(client_mutex);
+        client_mutex = NULL;
     }
 }
 